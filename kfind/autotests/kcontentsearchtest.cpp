@@ -0,0 +1,163 @@
+/*******************************************************************
+* kcontentsearchtest.cpp
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 2 of
+* the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+******************************************************************/
+
+#include <QTest>
+#include <QObject>
+#include <QFile>
+#include <QTemporaryDir>
+#include <QTextCodec>
+
+#include "kcontentsearch.h"
+
+class KContentSearchTest : public QObject
+{
+  Q_OBJECT
+
+ private Q_SLOTS:
+  void initTestCase();
+  void testLineNumber();
+  void testBlockBoundary();
+  void testAfterLongLine();
+  void testCaseInsensitive();
+  void testNotSearchable();
+  void testCanceled();
+
+ private:
+  QString writeFile( const QString &name, const QByteArray &contents );
+  KContentSearch::Result search( const QString &text, bool caseSensitive,
+                                 const QString &fileName, QString *matchingLine );
+
+  QTemporaryDir m_dir;
+};
+
+QTEST_GUILESS_MAIN(KContentSearchTest)
+
+void KContentSearchTest::initTestCase()
+{
+  QVERIFY(m_dir.isValid());
+}
+
+QString KContentSearchTest::writeFile( const QString &name, const QByteArray &contents )
+{
+  const QString fileName = m_dir.path() + QLatin1Char('/') + name;
+  QFile file(fileName);
+  if (!file.open(QIODevice::WriteOnly) || file.write(contents) != contents.size())
+    return QString();
+  return fileName;
+}
+
+KContentSearch::Result KContentSearchTest::search( const QString &text, bool caseSensitive,
+                                                   const QString &fileName, QString *matchingLine )
+{
+  KContentSearch contentSearch;
+  contentSearch.setText(text, caseSensitive, QTextCodec::codecForName("UTF-8"));
+  const QAtomicInt generation(1);
+  return contentSearch.search(fileName, matchingLine, generation, 1);
+}
+
+void KContentSearchTest::testLineNumber()
+{
+  const QString fileName = writeFile(QStringLiteral("lines.txt"),
+                                     "one\r\ntwo\r\n\r\nthe needle\r\nneedle again\r\n");
+  QVERIFY(!fileName.isEmpty());
+
+  QString line;
+  QCOMPARE(search(QStringLiteral("needle"), true, fileName, &line), KContentSearch::Found);
+  QCOMPARE(line, QStringLiteral("4: the needle"));
+  QCOMPARE(search(QStringLiteral("one"), true, fileName, &line), KContentSearch::Found);
+  QCOMPARE(line, QStringLiteral("1: one"));
+  QCOMPARE(search(QStringLiteral("haystack"), true, fileName, &line), KContentSearch::NotFound);
+}
+
+void KContentSearchTest::testBlockBoundary()
+{
+  // 1 MiB of 64 byte lines, the last one ending with the text
+  QByteArray contents;
+  const QByteArray filler = QByteArray(63, 'a') + '\n';
+  for (int i = 0; i < 16383; ++i)
+    contents += filler;
+  const QByteArray last = QByteArray(61, 'b') + "needle";
+  contents += last + '\n' + filler;
+  const QString fileName = writeFile(QStringLiteral("boundary.txt"), contents);
+  QVERIFY(!fileName.isEmpty());
+  // the text starts 3 bytes before the end of the first block read
+  QCOMPARE(contents.indexOf("needle"), 1024 * 1024 - 3);
+
+  QString line;
+  QCOMPARE(search(QStringLiteral("needle"), true, fileName, &line), KContentSearch::Found);
+  QCOMPARE(line, QStringLiteral("16384: ") + QString::fromLatin1(last));
+}
+
+void KContentSearchTest::testAfterLongLine()
+{
+  // longer than the part of a line kept while searching
+  QByteArray contents(5 * 1024 * 1024, 'c');
+  contents += "\nfirst needle\nsecond needle\n";
+  const QString fileName = writeFile(QStringLiteral("long.txt"), contents);
+  QVERIFY(!fileName.isEmpty());
+
+  QString line;
+  QCOMPARE(search(QStringLiteral("needle"), true, fileName, &line), KContentSearch::Found);
+  QCOMPARE(line, QStringLiteral("2: first needle"));
+}
+
+void KContentSearchTest::testCaseInsensitive()
+{
+  const QString fileName = writeFile(QStringLiteral("case.txt"),
+                                     "N\xc3\xa4he\nNeedle\nA NEEDLE\n");
+  QVERIFY(!fileName.isEmpty());
+
+  QString line;
+  QCOMPARE(search(QStringLiteral("NEEDLE"), true, fileName, &line), KContentSearch::Found);
+  QCOMPARE(line, QStringLiteral("3: A NEEDLE"));
+  QCOMPARE(search(QStringLiteral("nEEDLE"), false, fileName, &line), KContentSearch::Found);
+  QCOMPARE(line, QStringLiteral("2: Needle"));
+  QCOMPARE(search(QStringLiteral("nEEDLES"), false, fileName, &line), KContentSearch::NotFound);
+
+  // other letters can't be folded byte by byte
+  KContentSearch contentSearch;
+  contentSearch.setText(QString::fromUtf8("N\xc3\x84HE"), false, QTextCodec::codecForName("UTF-8"));
+  QVERIFY(!contentSearch.isValid());
+}
+
+void KContentSearchTest::testNotSearchable()
+{
+  QTextCodec *codec = QTextCodec::codecForName("UTF-16LE");
+  QVERIFY(codec);
+  const QString fileName = writeFile(QStringLiteral("utf16.txt"),
+                                     QByteArray("\xff\xfe", 2) + codec->fromUnicode(QStringLiteral("a needle\n")));
+  QVERIFY(!fileName.isEmpty());
+
+  QString line;
+  QCOMPARE(search(QStringLiteral("needle"), true, fileName, &line), KContentSearch::NotSearchable);
+}
+
+void KContentSearchTest::testCanceled()
+{
+  const QString fileName = writeFile(QStringLiteral("canceled.txt"), "needle\n");
+  QVERIFY(!fileName.isEmpty());
+
+  KContentSearch contentSearch;
+  contentSearch.setText(QStringLiteral("needle"), true, QTextCodec::codecForName("UTF-8"));
+  const QAtomicInt generation(2);
+  QString line;
+  QCOMPARE(contentSearch.search(fileName, &line, generation, 1), KContentSearch::NotFound);
+  QCOMPARE(contentSearch.search(fileName, &line, generation, 2), KContentSearch::Found);
+}
+
+#include "kcontentsearchtest.moc"
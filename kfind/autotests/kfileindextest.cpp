@@ -0,0 +1,245 @@
+/*******************************************************************
+* kfileindextest.cpp
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 2 of
+* the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+******************************************************************/
+
+#include <QTest>
+#include <QObject>
+#include <QDir>
+#include <QFile>
+#include <QScopedPointer>
+#include <QTemporaryDir>
+
+#include "kfileindex.h"
+
+/* Collects the paths found, relative to a folder */
+class KFileIndexCollector : public KFileIndexReceiver
+{
+ public:
+  explicit KFileIndexCollector( const QString &root ) : m_root( root + QLatin1Char('/') ) {}
+
+  void foundPaths( const QStringList &paths ) Q_DECL_OVERRIDE
+  {
+    foreach ( const QString &path, paths )
+      m_paths.append( path.startsWith( m_root ) ? path.mid( m_root.length() ) : path );
+  }
+
+  QStringList sortedPaths() const
+  {
+    QStringList paths = m_paths;
+    paths.sort();
+    return paths;
+  }
+
+ private:
+  QString m_root;
+  QStringList m_paths;
+};
+
+class KFileIndexTest : public QObject
+{
+  Q_OBJECT
+
+ private Q_SLOTS:
+  void init();
+  void testRequiredLiteral();
+  void testFind();
+  void testNotRecursive();
+  void testRefresh();
+  void testRemovedFolder();
+  void testCanceled();
+  void testSaveAndLoad();
+  void testBrokenFile();
+
+ private:
+  bool createFile( const QString &path );
+  QStringList find( const KFileIndex &index, const QString &literal, bool recursive = true );
+
+  QScopedPointer<QTemporaryDir> m_dir;
+};
+
+QTEST_GUILESS_MAIN(KFileIndexTest)
+
+void KFileIndexTest::init()
+{
+  m_dir.reset( new QTemporaryDir );
+  QVERIFY(m_dir->isValid());
+  QVERIFY(createFile(QStringLiteral("a/report.txt")));
+  QVERIFY(createFile(QStringLiteral("a/b/Report2.pdf")));
+  QVERIFY(createFile(QStringLiteral("a/b/other.txt")));
+  QVERIFY(createFile(QStringLiteral("c/notes.txt")));
+}
+
+bool KFileIndexTest::createFile( const QString &path )
+{
+  const QString fileName = m_dir->path() + QLatin1Char('/') + path;
+  if (!QDir().mkpath(fileName.left(fileName.lastIndexOf(QLatin1Char('/')))))
+    return false;
+  QFile file(fileName);
+  return file.open(QIODevice::WriteOnly);
+}
+
+QStringList KFileIndexTest::find( const KFileIndex &index, const QString &literal, bool recursive )
+{
+  KFileIndexCollector collector(m_dir->path());
+  const QAtomicInt generation(1);
+  QStringList literals;
+  if (!literal.isEmpty())
+    literals.append(literal);
+  index.find(m_dir->path(), recursive, literals, &collector, generation, 1);
+  return collector.sortedPaths();
+}
+
+void KFileIndexTest::testRequiredLiteral()
+{
+  QCOMPARE(KFileIndex::requiredLiteral(QStringLiteral("report")), QStringLiteral("report"));
+  QCOMPARE(KFileIndex::requiredLiteral(QStringLiteral("*.txt")), QStringLiteral(".txt"));
+  QCOMPARE(KFileIndex::requiredLiteral(QStringLiteral("report*2016?.pdf")), QStringLiteral("report"));
+  QCOMPARE(KFileIndex::requiredLiteral(QStringLiteral("a[bcdefgh]xyz")), QStringLiteral("xyz"));
+  // "]" right after "[" or "[!" is part of the set
+  QCOMPARE(KFileIndex::requiredLiteral(QStringLiteral("[]abcde]xy")), QStringLiteral("xy"));
+  QCOMPARE(KFileIndex::requiredLiteral(QStringLiteral("[!]abcde]xy")), QStringLiteral("xy"));
+  // an unterminated set ends the pattern
+  QCOMPARE(KFileIndex::requiredLiteral(QStringLiteral("ab[cdefgh")), QStringLiteral("ab"));
+  QCOMPARE(KFileIndex::requiredLiteral(QStringLiteral("*")), QString());
+}
+
+void KFileIndexTest::testFind()
+{
+  KFileIndex index;
+  const QAtomicInt generation(1);
+  index.refresh(m_dir->path(), true, generation, 1);
+  QVERIFY(index.isModified());
+
+  // looked up through the trigrams, case insensitively
+  QCOMPARE(find(index, QStringLiteral("report")),
+           QStringList() << QStringLiteral("a/b/Report2.pdf") << QStringLiteral("a/report.txt"));
+  QCOMPARE(find(index, QStringLiteral("OTHER")), QStringList() << QStringLiteral("a/b/other.txt"));
+  QCOMPARE(find(index, QStringLiteral("missing")), QStringList());
+  // too short for the trigrams, every folder is looked at
+  QCOMPARE(find(index, QStringLiteral("no")), QStringList() << QStringLiteral("c/notes.txt"));
+  QCOMPARE(find(index, QString()),
+           QStringList() << QStringLiteral("a") << QStringLiteral("a/b") << QStringLiteral("a/b/Report2.pdf")
+                         << QStringLiteral("a/b/other.txt") << QStringLiteral("a/report.txt")
+                         << QStringLiteral("c") << QStringLiteral("c/notes.txt"));
+}
+
+void KFileIndexTest::testNotRecursive()
+{
+  KFileIndex index;
+  const QAtomicInt generation(1);
+  index.refresh(m_dir->path(), false, generation, 1);
+  QCOMPARE(find(index, QString(), false), QStringList() << QStringLiteral("a") << QStringLiteral("c"));
+  // the folders below were not read
+  QCOMPARE(find(index, QStringLiteral("report")), QStringList());
+
+  index.refresh(m_dir->path() + QLatin1String("/a"), true, generation, 1);
+  QCOMPARE(find(index, QStringLiteral("report")),
+           QStringList() << QStringLiteral("a/b/Report2.pdf") << QStringLiteral("a/report.txt"));
+}
+
+void KFileIndexTest::testRefresh()
+{
+  KFileIndex index;
+  const QAtomicInt generation(1);
+  const QStringList literals = QStringList() << QStringLiteral("report");
+  {
+    // everything is new the first time
+    KFileIndexCollector collector(m_dir->path());
+    index.refresh(m_dir->path(), true, generation, 1, literals, &collector);
+    QCOMPARE(collector.sortedPaths(),
+             QStringList() << QStringLiteral("a/b/Report2.pdf") << QStringLiteral("a/report.txt"));
+  }
+
+  // folders read within the last second are read again, only new entries are reported
+  QVERIFY(createFile(QStringLiteral("a/b/new report.odt")));
+  KFileIndexCollector collector(m_dir->path());
+  index.refresh(m_dir->path(), true, generation, 1, literals, &collector);
+  QCOMPARE(collector.sortedPaths(), QStringList() << QStringLiteral("a/b/new report.odt"));
+  QCOMPARE(find(index, QStringLiteral("report")),
+           QStringList() << QStringLiteral("a/b/Report2.pdf") << QStringLiteral("a/b/new report.odt")
+                         << QStringLiteral("a/report.txt"));
+}
+
+void KFileIndexTest::testRemovedFolder()
+{
+  KFileIndex index;
+  const QAtomicInt generation(1);
+  index.refresh(m_dir->path(), true, generation, 1);
+  QCOMPARE(find(index, QStringLiteral("notes")), QStringList() << QStringLiteral("c/notes.txt"));
+
+  QVERIFY(QDir(m_dir->path() + QLatin1String("/c")).removeRecursively());
+  QVERIFY(createFile(QStringLiteral("d/notes.md")));
+  index.refresh(m_dir->path(), true, generation, 1);
+  QCOMPARE(find(index, QStringLiteral("notes")), QStringList() << QStringLiteral("d/notes.md"));
+  QCOMPARE(find(index, QString(), false), QStringList() << QStringLiteral("a") << QStringLiteral("d"));
+}
+
+void KFileIndexTest::testCanceled()
+{
+  KFileIndex index;
+  const QAtomicInt generation(2);
+  index.refresh(m_dir->path(), true, generation, 1);
+  QVERIFY(!index.isModified());
+  QCOMPARE(find(index, QString()), QStringList());
+}
+
+void KFileIndexTest::testSaveAndLoad()
+{
+  const QString fileName = m_dir->path() + QLatin1String("/index/fileindex");
+  {
+    KFileIndex index;
+    const QAtomicInt generation(1);
+    index.refresh(m_dir->path() + QLatin1String("/a"), true, generation, 1);
+    index.refresh(m_dir->path() + QLatin1String("/c"), true, generation, 1);
+    // leaves an unused id behind, which is not saved
+    QVERIFY(QDir(m_dir->path() + QLatin1String("/a/b")).removeRecursively());
+    index.refresh(m_dir->path() + QLatin1String("/a"), true, generation, 1);
+    QVERIFY(index.save(fileName));
+    QVERIFY(!index.isModified());
+  }
+
+  KFileIndex index;
+  QVERIFY(index.load(fileName));
+  QVERIFY(!index.isModified());
+  // the trigrams came from the file as well
+  QCOMPARE(find(index, QStringLiteral("report")), QStringList() << QStringLiteral("a/report.txt"));
+  QCOMPARE(find(index, QStringLiteral("notes")), QStringList() << QStringLiteral("c/notes.txt"));
+  QCOMPARE(find(index, QStringLiteral("other")), QStringList());
+}
+
+void KFileIndexTest::testBrokenFile()
+{
+  const QString fileName = m_dir->path() + QLatin1String("/fileindex");
+  KFileIndex index;
+  const QAtomicInt generation(1);
+  index.refresh(m_dir->path(), true, generation, 1);
+  QVERIFY(index.save(fileName));
+
+  QFile file(fileName);
+  QVERIFY(file.open(QIODevice::ReadWrite));
+  QVERIFY(file.resize(file.size() - 3));
+  file.close();
+
+  KFileIndex loaded;
+  QVERIFY(!loaded.load(fileName));
+  QCOMPARE(find(loaded, QString()), QStringList());
+  // a broken file doesn't replace what is in memory
+  QVERIFY(!index.load(fileName));
+  QCOMPARE(find(index, QStringLiteral("notes")), QStringList() << QStringLiteral("c/notes.txt"));
+}
+
+#include "kfileindextest.moc"
@@ -0,0 +1,145 @@
+/*******************************************************************
+* knamematchertest.cpp
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 2 of
+* the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+******************************************************************/
+
+#include <QTest>
+#include <QObject>
+
+#include "knamematcher.h"
+
+/*
+ * KNameMatcher has to give the same results as matching each pattern
+ * with a QRegExp::Wildcard, as kfind did before.
+ */
+class KNameMatcherTest : public QObject
+{
+  Q_OBJECT
+
+ private Q_SLOTS:
+  void testMatches_data();
+  void testMatches();
+  void testEmpty();
+};
+
+QTEST_GUILESS_MAIN(KNameMatcherTest)
+
+static QStringList fileNames()
+{
+  return QStringList()
+      << QString()
+      << QStringLiteral("a")
+      << QStringLiteral("A")
+      << QStringLiteral("ab")
+      << QStringLiteral("abc")
+      << QStringLiteral("aBc")
+      << QStringLiteral("main.cpp")
+      << QStringLiteral("MAIN.CPP")
+      << QStringLiteral("main.cpp.orig")
+      << QStringLiteral(".cpp")
+      << QStringLiteral("cpp")
+      << QStringLiteral("kfind.h")
+      << QStringLiteral("kfind.H")
+      << QStringLiteral("file1.txt")
+      << QStringLiteral("fileA.txt")
+      << QStringLiteral("file12.txt")
+      << QStringLiteral("file[1].txt")
+      << QStringLiteral("README")
+      << QStringLiteral("readme")
+      << QStringLiteral("a*b")
+      << QStringLiteral("x?y")
+      << QStringLiteral("\\")
+      << QStringLiteral("back\\slash")
+      << QString::fromUtf8("\xc3\x84rger.txt")                   // Ärger.txt
+      << QString::fromUtf8("\xc3\xa4rger.TXT")                   // ärger.TXT
+      << QString::fromUtf8("\xce\xa3\xce\x8a\xce\xa3\xce\xa5\xce\xa6\xce\x9f\xce\xa3.txt") // ΣΊΣΥΦΟΣ.txt
+      << QString::fromUtf8("\xcf\x83\xce\xaf\xcf\x83\xcf\x85\xcf\x86\xce\xbf\xcf\x82.cpp") // σίσυφος.cpp
+      << QString::fromUtf8("\xe6\x97\xa5\xe6\x9c\xac.h");        // 日本.h
+}
+
+void KNameMatcherTest::testMatches_data()
+{
+  QTest::addColumn<QString>("patterns");
+  QTest::addColumn<bool>("caseSensitive");
+
+  const QStringList patterns = QStringList()
+      << QStringLiteral("*")
+      << QStringLiteral("*.cpp;*.H")
+      << QStringLiteral("*.cpp;*.h;main.cpp;README")
+      << QStringLiteral("?")
+      << QStringLiteral("a?c;???")
+      << QStringLiteral("file?.txt")
+      << QStringLiteral("*a*b*")
+      << QStringLiteral("main.*")
+      << QStringLiteral("file[0-9].txt")
+      << QStringLiteral("[abc]*;*.h")
+      << QStringLiteral("[!a-z]*")
+      << QStringLiteral("\\")
+      << QStringLiteral("back\\*")
+      << QStringLiteral("a*b;x?y;*.txt")
+      << QString::fromUtf8("\xc3\xa4rger.txt;*.\xce\xa4\xce\xa7\xce\xa4")   // ärger.txt;*.ΤΧΤ
+      << QString::fromUtf8("\xcf\x83*;*\xcf\x82.cpp")                        // σ*;*ς.cpp
+      << QString::fromUtf8("\xe6\x97\xa5?.h;*.CPP");                         // 日?.h;*.CPP
+
+  for (int i = 0; i < patterns.count(); ++i)
+  {
+    const QByteArray name = patterns.at(i).toUtf8();
+    QTest::newRow(QByteArray(name + " case sensitive").constData()) << patterns.at(i) << true;
+    QTest::newRow(QByteArray(name + " case insensitive").constData()) << patterns.at(i) << false;
+  }
+}
+
+void KNameMatcherTest::testMatches()
+{
+  QFETCH(QString, patterns);
+  QFETCH(bool, caseSensitive);
+
+  const Qt::CaseSensitivity cs = caseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive;
+  const QStringList patternList = patterns.split(QLatin1Char(';'), QString::SkipEmptyParts);
+
+  KNameMatcher matcher;
+  matcher.setPatterns(patternList, cs);
+  QVERIFY(!matcher.isEmpty());
+
+  QList<QRegExp> regExps;
+  for (int i = 0; i < patternList.count(); ++i)
+    regExps.append(QRegExp(patternList.at(i), cs, QRegExp::Wildcard));
+
+  const QStringList names = fileNames();
+  for (int i = 0; i < names.count(); ++i)
+  {
+    bool expected = false;
+    for (int j = 0; j < regExps.count() && !expected; ++j)
+      expected = regExps.at(j).exactMatch(names.at(i));
+    if (matcher.matches(names.at(i)) != expected)
+      QFAIL(qPrintable(QStringLiteral("\"%1\" should %2match").arg(names.at(i), expected ? QString() : QStringLiteral("not "))));
+  }
+}
+
+void KNameMatcherTest::testEmpty()
+{
+  KNameMatcher matcher;
+  QVERIFY(matcher.isEmpty());
+  QVERIFY(!matcher.matches(QStringLiteral("main.cpp")));
+
+  matcher.setPatterns(QStringList() << QStringLiteral("*.cpp"), Qt::CaseSensitive);
+  QVERIFY(!matcher.isEmpty());
+  matcher.setPatterns(QStringList(), Qt::CaseSensitive);
+  QVERIFY(matcher.isEmpty());
+  QVERIFY(!matcher.matches(QStringLiteral("main.cpp")));
+}
+
+#include "knamematchertest.moc"
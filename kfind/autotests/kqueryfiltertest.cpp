@@ -0,0 +1,134 @@
+/*******************************************************************
+* kqueryfiltertest.cpp
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 2 of
+* the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+******************************************************************/
+
+#include <QTest>
+#include <QObject>
+#include <QFile>
+#include <QTemporaryDir>
+
+#include <kfileitem.h>
+
+#include "kqueryfilter.h"
+
+class KQueryFilterTest : public QObject
+{
+  Q_OBJECT
+
+ private Q_SLOTS:
+  void initTestCase();
+  void testCheapChecksFirst();
+  void testContentOnlyForMatchingNames();
+  void testStatistics();
+
+ private:
+  KFileItem writeFile( const QString &name, const QByteArray &contents );
+  bool matches( KQueryFilter &filter, const KFileItem &file );
+
+  QTemporaryDir m_dir;
+};
+
+QTEST_GUILESS_MAIN(KQueryFilterTest)
+
+void KQueryFilterTest::initTestCase()
+{
+  QVERIFY(m_dir.isValid());
+}
+
+KFileItem KQueryFilterTest::writeFile( const QString &name, const QByteArray &contents )
+{
+  const QString fileName = m_dir.path() + QLatin1Char('/') + name;
+  QFile file(fileName);
+  if (!file.open(QIODevice::WriteOnly) || file.write(contents) != contents.size())
+    return KFileItem();
+  file.close();
+  return KFileItem(KFileItem::Unknown, KFileItem::Unknown, QUrl::fromLocalFile(fileName));
+}
+
+bool KQueryFilterTest::matches( KQueryFilter &filter, const KFileItem &file )
+{
+  const QAtomicInt generation(1);
+  QString matchingLine;
+  return filter.matches(file, &matchingLine, generation, 1);
+}
+
+void KQueryFilterTest::testCheapChecksFirst()
+{
+  KQueryFilter filter;
+  filter.setRegExp(QStringLiteral("match*"), false);
+  filter.setSizeRange(1, 1, 0); // at least one byte
+  filter.setContext(QStringLiteral("needle"), false, false, false);
+
+  // each one is rejected by another check, the last one matches
+  QVERIFY(!matches(filter, writeFile(QStringLiteral(".match-hidden.txt"), "needle\n")));
+  QVERIFY(!matches(filter, writeFile(QStringLiteral("match-empty.txt"), QByteArray())));
+  QVERIFY(!matches(filter, writeFile(QStringLiteral("other.txt"), "needle\n")));
+  QVERIFY(!matches(filter, writeFile(QStringLiteral("match-hay.txt"), "hay\n")));
+  QVERIFY(matches(filter, writeFile(QStringLiteral("match.txt"), "a needle\n")));
+
+  // every check only sees the files all checks before it let through
+  const KQueryStatistics &statistics = filter.statistics();
+  QCOMPARE(statistics.files, qint64(5));
+  QCOMPARE(statistics.checked[KQueryStatistics::Hidden], qint64(5));
+  QCOMPARE(statistics.rejected[KQueryStatistics::Hidden], qint64(1));
+  QCOMPARE(statistics.checked[KQueryStatistics::Size], qint64(4));
+  QCOMPARE(statistics.rejected[KQueryStatistics::Size], qint64(1));
+  QCOMPARE(statistics.checked[KQueryStatistics::Name], qint64(3));
+  QCOMPARE(statistics.rejected[KQueryStatistics::Name], qint64(1));
+  QCOMPARE(statistics.checked[KQueryStatistics::Content], qint64(2));
+  QCOMPARE(statistics.rejected[KQueryStatistics::Content], qint64(1));
+}
+
+void KQueryFilterTest::testContentOnlyForMatchingNames()
+{
+  // the content is asked for first, but still checked last
+  KQueryFilter filter;
+  filter.setContext(QStringLiteral("needle"), false, false, false);
+  filter.setShowHiddenFiles(true);
+  filter.setRegExp(QStringLiteral("*.log;*.txt"), false);
+
+  for (int i = 0; i < 10; ++i)
+    QVERIFY(!matches(filter, writeFile(QStringLiteral("skipped%1.dat").arg(i), "needle\n")));
+  QVERIFY(matches(filter, writeFile(QStringLiteral("found.log"), "needle\n")));
+
+  const KQueryStatistics &statistics = filter.statistics();
+  QCOMPARE(statistics.checked[KQueryStatistics::Hidden], qint64(0));
+  QCOMPARE(statistics.checked[KQueryStatistics::Name], qint64(11));
+  QCOMPARE(statistics.rejected[KQueryStatistics::Name], qint64(10));
+  QCOMPARE(statistics.checked[KQueryStatistics::Content], qint64(1));
+  QCOMPARE(statistics.rejected[KQueryStatistics::Content], qint64(0));
+}
+
+void KQueryFilterTest::testStatistics()
+{
+  KQueryFilter filter;
+  filter.setRegExp(QStringLiteral("*.txt"), false);
+  QVERIFY(matches(filter, writeFile(QStringLiteral("statistics.txt"), "x\n")));
+
+  // what KQuery sums up from its worker threads
+  KQueryStatistics sum;
+  sum.add(filter.statistics());
+  sum.add(filter.statistics());
+  QCOMPARE(sum.files, qint64(2));
+  QCOMPARE(sum.checked[KQueryStatistics::Name], qint64(2));
+  QCOMPARE(sum.rejected[KQueryStatistics::Name], qint64(0));
+  sum.clear();
+  QCOMPARE(sum.files, qint64(0));
+  QCOMPARE(sum.checked[KQueryStatistics::Name], qint64(0));
+}
+
+#include "kqueryfiltertest.moc"
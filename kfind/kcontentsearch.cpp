@@ -0,0 +1,268 @@
+/*******************************************************************
+* kcontentsearch.cpp
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 2 of
+* the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+******************************************************************/
+
+#include "kcontentsearch.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+#include <QFile>
+#include <QTextCodec>
+
+// bytes read at a time
+static const int s_blockSize = 1024 * 1024;
+// longer lines are only shown in part
+static const int s_maxLineLength = 4 * 1024 * 1024;
+
+/* ASCII letters to lower case, all other bytes unchanged */
+struct AsciiFoldTable
+{
+  AsciiFoldTable()
+  {
+    for (int i = 0; i < 256; ++i)
+      table[i] = (i >= 'A' && i <= 'Z') ? uchar(i - 'A' + 'a') : uchar(i);
+  }
+  uchar table[256];
+};
+
+static const uchar *asciiFoldTable()
+{
+  static const AsciiFoldTable fold;
+  return fold.table;
+}
+
+/* Position of the first line feed in buffer from pos to filled, or -1 */
+static inline int lineFeed( const QByteArray &buffer, int pos, int filled )
+{
+  const char *data = buffer.constData();
+  const void *found = memchr(data + pos, '\n', filled - pos);
+  return found ? static_cast<const char *>(found) - data : -1;
+}
+
+/* Encodings in which a byte sequence can't start inside another character */
+static bool isSearchableCodec( QTextCodec *codec )
+{
+  switch (codec->mibEnum())
+  {
+    case 3:    // US-ASCII
+    case 4:    // ISO-8859-1
+    case 106:  // UTF-8
+    case 111:  // ISO-8859-15
+    case 2252: // windows-1252
+      return true;
+    default:
+      return false;
+  }
+}
+
+KContentSearch::KContentSearch()
+  : m_caseSensitivity(Qt::CaseSensitive), m_codec(0), m_fold(0)
+{
+}
+
+void KContentSearch::setText( const QString &text, bool caseSensitive, QTextCodec *codec )
+{
+  m_text = text;
+  m_caseSensitivity = caseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive;
+  m_codec = codec;
+  m_needle.clear();
+  m_fold = 0;
+
+  if (text.isEmpty() || !codec || !isSearchableCodec(codec))
+    return;
+
+  if (!caseSensitive)
+  {
+    // other letters have case variants of different lengths in UTF-8
+    for (int i = 0; i < text.length(); ++i)
+      if (text.at(i).unicode() >= 0x80)
+        return;
+    m_fold = asciiFoldTable();
+  }
+
+  QByteArray needle = codec->fromUnicode(text);
+  if (needle.isEmpty())
+    return;
+  if (m_fold)
+  {
+    for (int i = 0; i < needle.size(); ++i)
+      needle[i] = char(m_fold[uchar(needle.at(i))]);
+  }
+
+  const int length = needle.size();
+  for (int i = 0; i < 256; ++i)
+    m_shift[i] = length;
+  for (int i = 0; i < length - 1; ++i)
+    m_shift[uchar(needle.at(i))] = length - 1 - i;
+  if (m_fold)
+  {
+    // upper case bytes shift like their lower case ones
+    for (int i = 'A'; i <= 'Z'; ++i)
+      m_shift[i] = m_shift[m_fold[i]];
+  }
+
+  m_needle = needle;
+}
+
+const char *KContentSearch::find( const char *begin, const char *end ) const
+{
+  const int length = m_needle.size();
+  if (end - begin < length)
+    return 0;
+
+#ifdef __GLIBC__
+  // glibc has a vectorized two way search
+  if (!m_fold)
+    return static_cast<const char *>(memmem(begin, end - begin, m_needle.constData(), length));
+#endif
+
+  // Boyer-Moore-Horspool
+  const uchar *needle = reinterpret_cast<const uchar *>(m_needle.constData());
+  const uchar last = needle[length - 1];
+  const uchar *p = reinterpret_cast<const uchar *>(begin);
+  const uchar *stop = reinterpret_cast<const uchar *>(end) - length;
+
+  if (m_fold)
+  {
+    while (p <= stop)
+    {
+      const uchar c = p[length - 1];
+      if (m_fold[c] == last)
+      {
+        int i = 0;
+        while (i < length - 1 && m_fold[p[i]] == needle[i])
+          ++i;
+        if (i == length - 1)
+          return reinterpret_cast<const char *>(p);
+      }
+      p += m_shift[c];
+    }
+  }
+  else
+  {
+    while (p <= stop)
+    {
+      const uchar c = p[length - 1];
+      if (c == last && memcmp(p, needle, length - 1) == 0)
+        return reinterpret_cast<const char *>(p);
+      p += m_shift[c];
+    }
+  }
+  return 0;
+}
+
+KContentSearch::Result KContentSearch::search( const QString &fileName, QString *matchingLine,
+                                               const QAtomicInt &generation, int expectedGeneration ) const
+{
+  if (!isValid())
+    return NotFound;
+
+  QFile file(fileName);
+  if (!file.open(QIODevice::ReadOnly | QIODevice::Unbuffered))
+    return NotFound;
+
+  // a match may start in the last keep bytes of what was read
+  const int keep = m_needle.size() - 1;
+  QByteArray buffer;
+  int filled = 0;      // bytes in buffer
+  int lineStart = 0;   // where the line being read starts in buffer
+  int lineNumber = 1;  // of that line
+  int searchFrom = 0;  // matches starting before were looked for
+  bool firstBlock = true;
+
+  for (;;)
+  {
+    // The search was canceled or restarted
+    if (generation.load() != expectedGeneration)
+      return NotFound;
+
+    // only keep the current line, or its end if it is too long
+    int drop = lineStart;
+    if (filled - lineStart > s_maxLineLength)
+      drop = filled - keep;
+    if (drop > 0)
+    {
+      filled -= drop;
+      memmove(buffer.data(), buffer.constData() + drop, filled);
+      lineStart = qMax(lineStart - drop, 0);
+      searchFrom = qMax(searchFrom - drop, 0);
+    }
+
+    if (buffer.size() < filled + s_blockSize)
+      buffer.resize(filled + s_blockSize);
+    const qint64 n = file.read(buffer.data() + filled, s_blockSize);
+    if (n <= 0)
+      return NotFound;
+    filled += n;
+
+    if (firstBlock)
+    {
+      // QTextStream would switch to the encoding of a byte order mark
+      const QTextCodec *bomCodec = QTextCodec::codecForUtfText(
+          QByteArray::fromRawData(buffer.constData(), qMin(filled, 4)), 0);
+      if (bomCodec && bomCodec->mibEnum() != m_codec->mibEnum())
+        return NotSearchable;
+      firstBlock = false;
+    }
+
+    for (;;)
+    {
+      const char *data = buffer.constData();
+      const char *hit = find(data + searchFrom, data + filled);
+      if (!hit)
+        break;
+      const int pos = hit - data;
+
+      lineNumber += std::count(data + lineStart, hit, '\n');
+      if (pos > lineStart)
+        lineStart = qMax(buffer.lastIndexOf('\n', pos - 1) + 1, lineStart);
+
+      // read on to the end of the line
+      int lineEnd = lineFeed(buffer, pos, filled);
+      while (lineEnd < 0 && filled - lineStart < s_maxLineLength)
+      {
+        if (buffer.size() < filled + s_blockSize)
+          buffer.resize(filled + s_blockSize);
+        const qint64 more = file.read(buffer.data() + filled, s_blockSize);
+        if (more <= 0)
+          break;
+        filled += more;
+        lineEnd = lineFeed(buffer, filled - more, filled);
+      }
+      if (lineEnd < 0)
+        lineEnd = filled;
+
+      // only now decode, and make sure the bytes found are the text
+      QString line = m_codec->toUnicode(buffer.constData() + lineStart, lineEnd - lineStart);
+      if (line.endsWith(QLatin1Char('\r')))
+        line.chop(1);
+      if (line.contains(m_text, m_caseSensitivity))
+      {
+        *matchingLine = QString::number(lineNumber) + QStringLiteral(": ") + line;
+        return Found;
+      }
+      searchFrom = pos + 1;
+    }
+
+    const char *data = buffer.constData();
+    lineNumber += std::count(data + lineStart, data + filled, '\n');
+    lineStart = qMax(buffer.lastIndexOf('\n', filled - 1) + 1, lineStart);
+    searchFrom = qMax(searchFrom, filled - keep);
+  }
+}
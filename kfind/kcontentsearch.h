@@ -0,0 +1,75 @@
+/*******************************************************************
+* kcontentsearch.h
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 2 of
+* the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+******************************************************************/
+
+#ifndef KCONTENTSEARCH_H
+#define KCONTENTSEARCH_H
+
+#include <QAtomicInt>
+#include <QByteArray>
+#include <QString>
+
+class QTextCodec;
+
+/*
+ * Searches local files for a text, without decoding them.
+ *
+ * The text is encoded once, and the files are searched for its bytes a
+ * large block at a time. Only the line of a hit is decoded, to check it
+ * and to show it. Without case sensitivity, the text has to be ASCII; the
+ * bytes are then compared through a table folding ASCII letters.
+ *
+ * This only works for encodings in which the bytes of a character can't
+ * be part of another one: UTF-8 and the ISO 8859 like ones. isValid() is
+ * false for others, and for texts which can't be searched this way.
+ */
+class KContentSearch
+{
+ public:
+  KContentSearch();
+
+  /* Prepare for searching text in files encoded with codec */
+  void setText( const QString &text, bool caseSensitive, QTextCodec *codec );
+  bool isValid() const { return !m_needle.isEmpty(); }
+
+  enum Result { NotFound, Found, NotSearchable };
+
+  /*
+   * Check if file fileName contains the text. matchingLine is set to the
+   * number and text of the first line containing it. Gives up as soon as
+   * generation doesn't hold expectedGeneration anymore. NotSearchable means
+   * the file starts with the byte order mark of another encoding, like
+   * UTF-16; it has to be decoded to be searched.
+   */
+  Result search( const QString &fileName, QString *matchingLine,
+                 const QAtomicInt &generation, int expectedGeneration ) const;
+
+ private:
+  const char *find( const char *begin, const char *end ) const;
+
+  QString m_text;
+  Qt::CaseSensitivity m_caseSensitivity;
+  QTextCodec *m_codec;
+  // the encoded text, case folded without case sensitivity
+  QByteArray m_needle;
+  // 0 with case sensitivity
+  const uchar *m_fold;
+  // Horspool's shift for the last byte of a window
+  int m_shift[256];
+};
+
+#endif
@@ -0,0 +1,575 @@
+/*******************************************************************
+* kfileindex.cpp
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 2 of
+* the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+******************************************************************/
+
+#include "kfileindex.h"
+#include "kfind_debug.h"
+
+#include <algorithm>
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QSet>
+#include <QStandardPaths>
+
+// increase when the file format changes, old indexes are dropped then
+static const qint32 s_indexVersion = 2;
+
+// number of paths handed to the receiver at once
+static const int s_batchSize = 256;
+
+static inline quint64 trigramKey( const QChar *c )
+{
+  return ( quint64( c[0].unicode() ) << 32 ) | ( quint64( c[1].unicode() ) << 16 ) | c[2].unicode();
+}
+
+static void collectTrigrams( const QString &name, QSet<quint64> *trigrams )
+{
+  const QString folded = name.toCaseFolded();
+  const QChar *c = folded.constData();
+  for ( int i = 0; i + 2 < folded.length(); i++ )
+    trigrams->insert( trigramKey( c + i ) );
+}
+
+static inline bool isBelow( const QString &path, const QString &root )
+{
+  if ( root == QLatin1String("/") )
+    return true;
+  return path.startsWith( root ) &&
+         ( path.length() == root.length() || path.at( root.length() ) == QLatin1Char('/') );
+}
+
+static inline bool containsAny( const QString &name, const QStringList &literals )
+{
+  if ( literals.isEmpty() )
+    return true;
+  foreach ( const QString &literal, literals )
+  {
+    if ( name.contains( literal, Qt::CaseInsensitive ) )
+      return true;
+  }
+  return false;
+}
+
+static inline QString childPath( const QString &dir, const QString &name )
+{
+  if ( dir.endsWith( QLatin1Char('/') ) )
+    return dir + name;
+  return dir + QLatin1Char('/') + name;
+}
+
+void KFileIndex::Dir::setNames( const QStringList &subdirs, const QStringList &files )
+{
+  names.clear();
+  ends.clear();
+  ends.reserve( subdirs.count() + files.count() );
+  foreach ( const QString &name, subdirs )
+  {
+    names += name.toUtf8();
+    ends.append( names.size() );
+  }
+  foreach ( const QString &name, files )
+  {
+    names += name.toUtf8();
+    ends.append( names.size() );
+  }
+  names.squeeze();
+  subdirCount = subdirs.count();
+}
+
+QString KFileIndex::Dir::name( int i ) const
+{
+  const int begin = i > 0 ? ends.at( i - 1 ) : 0;
+  return QString::fromUtf8( names.constData() + begin, ends.at( i ) - begin );
+}
+
+QStringList KFileIndex::Dir::subdirs() const
+{
+  QStringList result;
+  result.reserve( subdirCount );
+  for ( int i = 0; i < subdirCount; i++ )
+    result.append( name( i ) );
+  return result;
+}
+
+KFileIndex::KFileIndex()
+  : m_modified(false)
+{
+}
+
+KFileIndex::KFileIndex( const QString &fileName )
+  : m_modified(false)
+{
+  load( fileName );
+}
+
+KFileIndex *KFileIndex::self()
+{
+  static KFileIndex index( defaultFileName() );
+  return &index;
+}
+
+QString KFileIndex::defaultFileName()
+{
+  return QStandardPaths::writableLocation( QStandardPaths::CacheLocation ) + QLatin1String("/fileindex");
+}
+
+bool KFileIndex::load( const QString &fileName )
+{
+  QFile file( fileName );
+  if ( !file.open( QIODevice::ReadOnly ) )
+    return false;
+
+  QDataStream stream( &file );
+  qint32 version;
+  quint32 count;
+  stream >> version;
+  if ( version != s_indexVersion )
+    return false;
+  stream >> count;
+
+  QVector<Dir> dirs;
+  QHash<QString, int> dirIds;
+  bool broken = false;
+  for ( quint32 i = 0; i < count && stream.status() == QDataStream::Ok && !broken; i++ )
+  {
+    Dir dir;
+    qint32 subdirCount;
+    stream >> dir.path >> dir.mtime >> subdirCount >> dir.names >> dir.ends;
+    dir.subdirCount = subdirCount;
+    quint32 previous = 0;
+    foreach ( quint32 end, dir.ends )
+    {
+      broken = broken || end < previous;
+      previous = end;
+    }
+    broken = broken || previous != quint32( dir.names.size() ) ||
+             subdirCount < 0 || subdirCount > dir.ends.count();
+    dirIds.insert( dir.path, dirs.count() );
+    dirs.append( dir );
+  }
+
+  // the ids in the file are the positions of the directories in it
+  QHash<quint64, QVector<int> > trigrams;
+  stream >> count;
+  for ( quint32 i = 0; i < count && stream.status() == QDataStream::Ok && !broken; i++ )
+  {
+    quint64 trigram;
+    QVector<qint32> ids;
+    stream >> trigram >> ids;
+    for ( int j = 0; j < ids.count(); j++ )
+      broken = broken || ids.at( j ) < 0 || ids.at( j ) >= dirs.count() || ( j > 0 && ids.at( j ) <= ids.at( j - 1 ) );
+    trigrams.insert( trigram, ids );
+  }
+
+  if ( broken || stream.status() != QDataStream::Ok )
+  {
+    qCDebug(KFIND_LOG) << "Dropping broken file index" << fileName;
+    return false;
+  }
+
+  m_dirs.swap( dirs );
+  m_freeIds.clear();
+  m_dirIds.swap( dirIds );
+  m_trigrams.swap( trigrams );
+  m_modified = false;
+  return true;
+}
+
+bool KFileIndex::save( const QString &fileName )
+{
+  QDir().mkpath( QFileInfo( fileName ).absolutePath() );
+  QSaveFile file( fileName );
+  if ( !file.open( QIODevice::WriteOnly ) )
+    return false;
+
+  // unused ids are left out, the others are numbered again in the same order
+  QVector<qint32> savedIds( m_dirs.count(), -1 );
+  qint32 savedCount = 0;
+  QDataStream stream( &file );
+  stream << s_indexVersion << quint32( m_dirIds.count() );
+  for ( int id = 0; id < m_dirs.count(); id++ )
+  {
+    const Dir &dir = m_dirs.at( id );
+    if ( dir.path.isEmpty() )
+      continue;
+    savedIds[id] = savedCount++;
+    stream << dir.path << dir.mtime << qint32( dir.subdirCount ) << dir.names << dir.ends;
+  }
+
+  stream << quint32( m_trigrams.count() );
+  QVector<qint32> ids;
+  for ( QHash<quint64, QVector<int> >::const_iterator it = m_trigrams.constBegin(); it != m_trigrams.constEnd(); ++it )
+  {
+    ids.clear();
+    foreach ( int id, it.value() )
+      ids.append( savedIds.at( id ) );
+    stream << it.key() << ids;
+  }
+
+  if ( !file.commit() )
+    return false;
+  m_modified = false;
+  return true;
+}
+
+/* Hands the new entries found by refresh() to the receiver, a batch at a time */
+class KFileIndex::Report
+{
+ public:
+  Report( const QStringList &literals, KFileIndexReceiver *receiver )
+    : m_literals( literals ), m_receiver( receiver )
+  {
+  }
+
+  ~Report()
+  {
+    if ( !m_paths.isEmpty() )
+      m_receiver->foundPaths( m_paths );
+  }
+
+  /* The entries of dir which are not in oldNames */
+  void addNew( const QString &dir, const QStringList &names, const QSet<QString> &oldNames )
+  {
+    foreach ( const QString &name, names )
+    {
+      if ( !oldNames.contains( name ) && containsAny( name, m_literals ) )
+        m_paths.append( childPath( dir, name ) );
+    }
+    if ( m_paths.count() >= s_batchSize )
+    {
+      m_receiver->foundPaths( m_paths );
+      m_paths.clear();
+    }
+  }
+
+ private:
+  const QStringList &m_literals;
+  KFileIndexReceiver *m_receiver;
+  QStringList m_paths;
+};
+
+void KFileIndex::refresh( const QString &root, bool recursive,
+                          const QAtomicInt &generation, int expectedGeneration,
+                          const QStringList &literals, KFileIndexReceiver *receiver )
+{
+  if ( receiver )
+  {
+    Report report( literals, receiver );
+    refreshDir( QDir::cleanPath( root ), recursive, generation, expectedGeneration, &report );
+  }
+  else
+    refreshDir( QDir::cleanPath( root ), recursive, generation, expectedGeneration, 0 );
+}
+
+int KFileIndex::refreshDir( const QString &path, bool recursive,
+                            const QAtomicInt &generation, int expectedGeneration,
+                            Report *report )
+{
+  if ( generation.load() != expectedGeneration )
+    return -1;
+
+  int id = m_dirIds.value( path, -1 );
+  const QFileInfo info( path );
+  if ( !info.isDir() )
+  {
+    if ( id >= 0 )
+    {
+      removeTree( id );
+      m_modified = true;
+    }
+    return -1;
+  }
+
+  const qint64 mtime = info.lastModified().toMSecsSinceEpoch();
+  if ( id < 0 || m_dirs.at( id ).mtime != mtime )
+  {
+    Dir dir;
+    dir.path = path;
+    // A directory changed within the second it was read in may change
+    // again without getting another modification time: read it again next time.
+    if ( mtime < QDateTime::currentMSecsSinceEpoch() - 1000 )
+      dir.mtime = mtime;
+
+    const QDir d( path );
+    const QDir::Filters filters = QDir::NoDotAndDotDot | QDir::Hidden | QDir::System;
+    const QStringList subdirNames = d.entryList( QDir::Dirs | QDir::NoSymLinks | filters, QDir::Unsorted );
+    const QSet<QString> subdirs = subdirNames.toSet();
+    QStringList fileNames;
+    foreach ( const QString &name, d.entryList( QDir::AllEntries | filters, QDir::Unsorted ) )
+    {
+      if ( !subdirs.contains( name ) )
+        fileNames.append( name );
+    }
+    dir.setNames( subdirNames, fileNames );
+
+    if ( report )
+    {
+      QSet<QString> oldNames;
+      if ( id >= 0 )
+      {
+        const Dir &old = m_dirs.at( id );
+        for ( int i = 0; i < old.nameCount(); i++ )
+          oldNames.insert( old.name( i ) );
+      }
+      report->addNew( path, subdirNames, oldNames );
+      report->addNew( path, fileNames, oldNames );
+    }
+
+    if ( id >= 0 )
+    {
+      // forget about subdirectories which are gone
+      foreach ( const QString &name, m_dirs.at( id ).subdirs() )
+      {
+        if ( !subdirs.contains( name ) )
+        {
+          const int childId = m_dirIds.value( childPath( path, name ), -1 );
+          if ( childId >= 0 )
+            removeTree( childId );
+        }
+      }
+      removeTrigrams( id );
+      m_dirs[id] = dir;
+      addTrigrams( id );
+    }
+    else
+      id = addDir( dir );
+    m_modified = true;
+  }
+
+  if ( recursive )
+  {
+    // m_dirs may grow while we go down
+    const QStringList subdirs = m_dirs.at( id ).subdirs();
+    foreach ( const QString &name, subdirs )
+      refreshDir( childPath( path, name ), true, generation, expectedGeneration, report );
+  }
+  return id;
+}
+
+void KFileIndex::find( const QString &root, bool recursive, const QStringList &literals,
+                       KFileIndexReceiver *receiver,
+                       const QAtomicInt &generation, int expectedGeneration ) const
+{
+  const QString cleanRoot = QDir::cleanPath( root );
+
+  // The directories which may have matching names
+  QVector<int> ids;
+  if ( !recursive )
+  {
+    const int id = m_dirIds.value( cleanRoot, -1 );
+    if ( id >= 0 )
+      ids.append( id );
+  }
+  else
+  {
+    bool all = literals.isEmpty();
+    QSet<int> candidates;
+    foreach ( const QString &literal, literals )
+    {
+      if ( literal.length() < 3 )
+      {
+        all = true;
+        break;
+      }
+      foreach ( int id, candidateDirs( literal ) )
+        candidates.insert( id );
+    }
+
+    if ( all )
+    {
+      for ( int id = 0; id < m_dirs.count(); id++ )
+      {
+        if ( !m_dirs.at( id ).path.isEmpty() )
+          ids.append( id );
+      }
+    }
+    else
+    {
+      ids.reserve( candidates.count() );
+      foreach ( int id, candidates )
+        ids.append( id );
+      std::sort( ids.begin(), ids.end() );
+    }
+  }
+
+  QStringList paths;
+  foreach ( int id, ids )
+  {
+    if ( generation.load() != expectedGeneration )
+      return;
+    if ( !isBelow( m_dirs.at( id ).path, cleanRoot ) )
+      continue;
+
+    findInDir( id, literals, &paths );
+
+    if ( paths.count() >= s_batchSize )
+    {
+      receiver->foundPaths( paths );
+      paths.clear();
+    }
+  }
+
+  if ( !paths.isEmpty() )
+    receiver->foundPaths( paths );
+}
+
+void KFileIndex::findInDir( int id, const QStringList &literals, QStringList *paths ) const
+{
+  const Dir &dir = m_dirs.at( id );
+  for ( int i = 0; i < dir.nameCount(); i++ )
+  {
+    const QString name = dir.name( i );
+    if ( containsAny( name, literals ) )
+      paths->append( childPath( dir.path, name ) );
+  }
+}
+
+QVector<int> KFileIndex::candidateDirs( const QString &literal ) const
+{
+  const QString folded = literal.toCaseFolded();
+  const QChar *c = folded.constData();
+
+  QVector<int> ids;
+  for ( int i = 0; i + 2 < folded.length(); i++ )
+  {
+    const QHash<quint64, QVector<int> >::const_iterator it = m_trigrams.constFind( trigramKey( c + i ) );
+    if ( it == m_trigrams.constEnd() )
+      return QVector<int>();
+
+    if ( i == 0 )
+      ids = it.value();
+    else
+    {
+      QVector<int> both;
+      std::set_intersection( ids.constBegin(), ids.constEnd(),
+                             it.value().constBegin(), it.value().constEnd(),
+                             std::back_inserter( both ) );
+      ids.swap( both );
+    }
+    if ( ids.isEmpty() )
+      break;
+  }
+  return ids;
+}
+
+int KFileIndex::addDir( const Dir &dir )
+{
+  int id;
+  if ( m_freeIds.isEmpty() )
+  {
+    id = m_dirs.count();
+    m_dirs.append( dir );
+  }
+  else
+  {
+    id = m_freeIds.takeLast();
+    m_dirs[id] = dir;
+  }
+  m_dirIds.insert( dir.path, id );
+  addTrigrams( id );
+  return id;
+}
+
+void KFileIndex::removeTree( int id )
+{
+  const Dir dir = m_dirs.at( id );
+  foreach ( const QString &name, dir.subdirs() )
+  {
+    const int childId = m_dirIds.value( childPath( dir.path, name ), -1 );
+    if ( childId >= 0 )
+      removeTree( childId );
+  }
+
+  removeTrigrams( id );
+  m_dirIds.remove( dir.path );
+  m_dirs[id] = Dir();
+  m_freeIds.append( id );
+}
+
+void KFileIndex::addTrigrams( int id )
+{
+  QSet<quint64> trigrams;
+  const Dir &dir = m_dirs.at( id );
+  for ( int i = 0; i < dir.nameCount(); i++ )
+    collectTrigrams( dir.name( i ), &trigrams );
+
+  foreach ( quint64 trigram, trigrams )
+  {
+    QVector<int> &ids = m_trigrams[trigram];
+    ids.insert( std::lower_bound( ids.begin(), ids.end(), id ), id );
+  }
+}
+
+void KFileIndex::removeTrigrams( int id )
+{
+  QSet<quint64> trigrams;
+  const Dir &dir = m_dirs.at( id );
+  for ( int i = 0; i < dir.nameCount(); i++ )
+    collectTrigrams( dir.name( i ), &trigrams );
+
+  foreach ( quint64 trigram, trigrams )
+  {
+    QHash<quint64, QVector<int> >::iterator it = m_trigrams.find( trigram );
+    if ( it == m_trigrams.end() )
+      continue;
+    QVector<int> &ids = it.value();
+    QVector<int>::iterator pos = std::lower_bound( ids.begin(), ids.end(), id );
+    if ( pos != ids.end() && *pos == id )
+      ids.erase( pos );
+    if ( ids.isEmpty() )
+      m_trigrams.erase( it );
+  }
+}
+
+QString KFileIndex::requiredLiteral( const QString &wildcard )
+{
+  QString longest;
+  QString current;
+  for ( int i = 0; i < wildcard.length(); i++ )
+  {
+    const QChar c = wildcard.at( i );
+    if ( c == QLatin1Char('*') || c == QLatin1Char('?') || c == QLatin1Char('[') )
+    {
+      if ( current.length() > longest.length() )
+        longest = current;
+      current.clear();
+      if ( c == QLatin1Char('[') )
+      {
+        // skip the character set, "[]...]" and "[!]...]" include the "]"
+        int end = i + 1;
+        if ( end < wildcard.length() && ( wildcard.at( end ) == QLatin1Char('!') || wildcard.at( end ) == QLatin1Char('^') ) )
+          end++;
+        if ( end < wildcard.length() && wildcard.at( end ) == QLatin1Char(']') )
+          end++;
+        end = wildcard.indexOf( QLatin1Char(']'), end );
+        if ( end < 0 )
+          return longest;
+        i = end;
+      }
+    }
+    else
+      current += c;
+  }
+  if ( current.length() > longest.length() )
+    longest = current;
+  return longest;
+}
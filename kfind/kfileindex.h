@@ -0,0 +1,151 @@
+/*******************************************************************
+* kfileindex.h
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 2 of
+* the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+******************************************************************/
+
+#ifndef KFILEINDEX_H
+#define KFILEINDEX_H
+
+#include <QAtomicInt>
+#include <QByteArray>
+#include <QHash>
+#include <QMutex>
+#include <QStringList>
+#include <QVector>
+
+/*
+ * Receives the paths found by KFileIndex::find(), a batch at a time.
+ */
+class KFileIndexReceiver
+{
+ public:
+  virtual ~KFileIndexReceiver() {}
+  virtual void foundPaths( const QStringList &paths ) = 0;
+};
+
+/*
+ * KFind's own index of file names, used for "Use files index".
+ *
+ * For every directory indexed, it keeps the names of the entries and the
+ * modification time the directory had when it was read. refresh() visits
+ * all directories below a folder again, but only reads the ones whose
+ * modification time changed; new folders are read completely.
+ *
+ * Finding names goes through a trigram index: every trigram (three
+ * consecutive characters, case folded) points to the directories which
+ * have an entry with that trigram in its name. A search for a name
+ * containing "report" only looks into the directories which have all of
+ * "rep", "epo", "por" and "ort".
+ *
+ * The names of a directory are kept packed one after the other in UTF-8.
+ * The index lives in memory while KFind runs, and is saved to a file in
+ * the cache directory together with the trigrams, which are not computed
+ * again when loading. Use self() with the mutex locked.
+ */
+class KFileIndex
+{
+ public:
+  /* An empty index, not shared with anybody */
+  KFileIndex();
+
+  /* The index of KFind's searches, loaded from defaultFileName() */
+  static KFileIndex *self();
+  QMutex *mutex() { return &m_mutex; }
+
+  /* Default location of the index file */
+  static QString defaultFileName();
+
+  bool load( const QString &fileName );
+  bool save( const QString &fileName );
+  bool isModified() const { return m_modified; }
+
+  /*
+   * Bring the index of root, and of the tree below it if recursive is
+   * true, up to date. Gives up as soon as generation doesn't hold
+   * expectedGeneration anymore.
+   *
+   * With a receiver, the entries which were not in the index before and
+   * match literals (see find()) are handed to it as they are read. So a
+   * find() followed by a refresh() with the same receiver reports every
+   * current entry, and the first ones right away.
+   */
+  void refresh( const QString &root, bool recursive,
+                const QAtomicInt &generation, int expectedGeneration,
+                const QStringList &literals = QStringList(),
+                KFileIndexReceiver *receiver = 0 );
+
+  /*
+   * Hand the paths of all entries below root (only the ones directly in
+   * root if recursive is false) whose name contains one of literals,
+   * case insensitively, to receiver. An empty literal, or no literals at
+   * all, match every name.
+   */
+  void find( const QString &root, bool recursive, const QStringList &literals,
+             KFileIndexReceiver *receiver,
+             const QAtomicInt &generation, int expectedGeneration ) const;
+
+  /*
+   * The longest part of a wildcard pattern without special characters,
+   * which every name matching the pattern contains.
+   */
+  static QString requiredLiteral( const QString &wildcard );
+
+ private:
+  explicit KFileIndex( const QString &fileName );
+
+  class Dir
+  {
+   public:
+    Dir() : mtime(-1), subdirCount(0) {}
+
+    void setNames( const QStringList &subdirs, const QStringList &files );
+    int nameCount() const { return ends.count(); }
+    QString name( int i ) const;
+    QStringList subdirs() const;
+
+    QString path;
+    qint64 mtime;
+    /* The names of the subdirectories and then of the files, in UTF-8 */
+    QByteArray names;
+    /* Where each name ends in names */
+    QVector<quint32> ends;
+    int subdirCount;
+  };
+
+  class Report;
+
+  int refreshDir( const QString &path, bool recursive,
+                  const QAtomicInt &generation, int expectedGeneration,
+                  Report *report );
+  int addDir( const Dir &dir );
+  void removeTree( int id );
+  void addTrigrams( int id );
+  void removeTrigrams( int id );
+  QVector<int> candidateDirs( const QString &literal ) const;
+  void findInDir( int id, const QStringList &literals, QStringList *paths ) const;
+
+  QMutex m_mutex;
+
+  /* Directories by id, unused ids have an empty path */
+  QVector<Dir> m_dirs;
+  QVector<int> m_freeIds;
+  QHash<QString, int> m_dirIds;
+  /* Sorted ids of the directories with names containing a trigram */
+  QHash<quint64, QVector<int> > m_trigrams;
+  bool m_modified;
+};
+
+#endif
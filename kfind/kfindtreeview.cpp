@@ -29,6 +29,7 @@
 #include <QApplication>
 #include <QDate>
 #include <QMenu>
+#include <QSet>
 
 #include <KActionCollection>
 #include <kfiledialog.h>
@@ -95,23 +96,35 @@ QVariant KFindItemModel::headerData(int section, Qt::Orientation orientation, in
 
 void KFindItemModel::insertFileItems( const QList< QPair<KFileItem,QString> > & pairs)
 {
-    if ( pairs.size() > 0 )
+    // the same file may be reported twice, e.g. by KDirWatch and the search
+    QList< QPair<KFileItem,QString> > newPairs;
+    QSet<QUrl> newUrls;
+    QList< QPair<KFileItem,QString> >::const_iterator it = pairs.constBegin();
+    QList< QPair<KFileItem,QString> >::const_iterator end = pairs.constEnd();
+    for (; it != end; ++it)
     {
-        beginInsertRows( QModelIndex(), m_itemList.size(), m_itemList.size()+pairs.size()-1 );
-        
-        QList< QPair<KFileItem,QString> >::const_iterator it = pairs.constBegin();
-        QList< QPair<KFileItem,QString> >::const_iterator end = pairs.constEnd();
-        
-        for (; it != end; ++it)
-        {
-            QPair<KFileItem,QString> pair = *it;
+        const QUrl url = (*it).first.url();
+        if ( m_rows.contains( url ) || newUrls.contains( url ) )
+            continue;
+        newUrls.insert( url );
+        newPairs.append( *it );
+    }
 
-            QString subDir = m_view->reducedDir(pair.first.url().adjusted(QUrl::RemoveFilename).path());
-            m_itemList.append( KFindItem( pair.first, subDir, pair.second ) );
-        }
+    if ( newPairs.isEmpty() )
+        return;
+
+    const int first = m_itemList.size();
+    beginInsertRows( QModelIndex(), first, first + newPairs.size() - 1 );
 
-        endInsertRows();
+    m_itemList.reserve( first + newPairs.size() );
+    m_rows.reserve( first + newPairs.size() );
+    for (it = newPairs.constBegin(); it != newPairs.constEnd(); ++it)
+    {
+        m_rows.insert( (*it).first.url(), m_itemList.size() );
+        m_itemList.append( KFindItem( (*it).first, m_baseDir, (*it).second ) );
     }
+
+    endInsertRows();
 }
 
 int KFindItemModel::rowCount ( const QModelIndex & parent ) const
@@ -124,7 +137,7 @@ int KFindItemModel::rowCount ( const QModelIndex & parent ) const
 
 KFindItem KFindItemModel::itemAtIndex( const QModelIndex & index ) const
 {
-    if ( index.isValid() && m_itemList.size() >= index.row() )
+    if ( index.isValid() && index.row() < m_itemList.size() )
         return m_itemList.at( index.row() );
 
     return KFindItem();
@@ -152,39 +165,32 @@ QVariant KFindItemModel::data ( const QModelIndex & index, int role ) const
 
 void KFindItemModel::removeItem( const QUrl & url )
 {
-    int itemCount = m_itemList.size();
-    for ( int i = 0; i < itemCount; i++)
-    {
-        KFindItem item = m_itemList.at(i);
-        if ( item.getFileItem().url() == url )
-        {
-            beginRemoveRows( QModelIndex(), i, i ); 
-            m_itemList.removeAt( i );
-            endRemoveRows();
-            return;
-        }
-    }
+    QHash<QUrl, int>::iterator found = m_rows.find( url );
+    if ( found == m_rows.end() )
+        return;
+    const int row = found.value();
+
+    beginRemoveRows( QModelIndex(), row, row );
+    m_rows.erase( found );
+    m_itemList.remove( row );
+    // rare enough to renumber the rows below
+    for ( int i = row; i < m_itemList.size(); i++ )
+        m_rows[ m_itemList.at(i).getFileItem().url() ] = i;
+    endRemoveRows();
 }
 
-bool KFindItemModel::isInserted( const QUrl & url )
+bool KFindItemModel::isInserted( const QUrl & url ) const
 {
-    int itemCount = m_itemList.size();
-    for ( int i = 0; i < itemCount; i++)
-    {
-        KFindItem item = m_itemList.at(i);
-        if ( item.getFileItem().url() == url )
-        {
-            return true;
-        }
-    }
-    return false;
+    return m_rows.contains( url );
 }
 
-void KFindItemModel::clear()
+void KFindItemModel::clear( const QDir & baseDir )
 {
-    beginRemoveRows( QModelIndex(), 0, m_itemList.size() );
+    beginResetModel();
     m_itemList.clear();
-    endRemoveRows();
+    m_rows.clear();
+    m_baseDir = baseDir;
+    endResetModel();
 }
 
 Qt::ItemFlags KFindItemModel::flags(const QModelIndex &index) const
@@ -223,14 +229,31 @@ QMimeData * KFindItemModel::mimeData(const QModelIndexList &indexes) const
 
 //BEGIN KFindItem
 
-KFindItem::KFindItem( const KFileItem & _fileItem, const QString & subDir, const QString & matchingLine )
+KFindItem::KFindItem( const KFileItem & _fileItem, const QDir & baseDir, const QString & matchingLine )
 {
     m_fileItem = _fileItem;
-    m_subDir = subDir;
+    m_baseDir = baseDir;
     m_matchingLine = matchingLine;
+    m_subDirLoaded = false;
+    m_permissionLoaded = false;
+    m_iconLoaded = false;
+}
 
-    //TODO more caching ?
-    if ( !m_fileItem.isNull() && m_fileItem.isLocalFile() )
+const QString & KFindItem::subDir() const
+{
+    if ( !m_subDirLoaded )
+    {
+        const QString fullDir = m_fileItem.url().adjusted(QUrl::RemoveFilename).path();
+        const QString relDir = m_baseDir.relativeFilePath(fullDir);
+        m_subDir = relDir.startsWith(QLatin1String("..")) ? fullDir : relDir;
+        m_subDirLoaded = true;
+    }
+    return m_subDir;
+}
+
+const QString & KFindItem::permission() const
+{
+    if ( !m_permissionLoaded && m_fileItem.isLocalFile() )
     {
         QFileInfo fileInfo(m_fileItem.url().toLocalFile());
 
@@ -241,9 +264,17 @@ KFindItem::KFindItem( const KFileItem & _fileItem, const QString & subDir, const
             perm_index = fileInfo.isWritable() ? WO : NA;
             
         m_permission = i18n(perm[perm_index]);
-        
-        m_icon = QIcon::fromTheme( m_fileItem.iconName() );
     }
+    m_permissionLoaded = true;
+    return m_permission;
+}
+
+const QIcon & KFindItem::icon() const
+{
+    if ( !m_iconLoaded && m_fileItem.isLocalFile() )
+        m_icon = QIcon::fromTheme( m_fileItem.iconName() );
+    m_iconLoaded = true;
+    return m_icon;
 }
 
 QVariant KFindItem::data( int column, int role ) const
@@ -254,7 +285,7 @@ QVariant KFindItem::data( int column, int role ) const
     if( role == Qt::DecorationRole )
     {
         if (column == 0)
-            return m_icon;
+            return icon();
         else
             return QVariant();
     }
@@ -265,13 +296,13 @@ QVariant KFindItem::data( int column, int role ) const
             case 0:
                 return m_fileItem.url().fileName();
             case 1:
-                return m_subDir;
+                return subDir();
             case 2:
                 return KIO::convertSize( m_fileItem.size() );
             case 3:
                 return m_fileItem.timeString(KFileItem::ModificationTime);
             case 4:
-                return m_permission;
+                return permission();
             case 5:
                 return m_matchingLine;
             default:
@@ -386,19 +417,10 @@ void KFindTreeView::resizeToContents()
     resizeColumnToContents( 3 );
 }
 
-QString KFindTreeView::reducedDir(const QString& fullDir)
-{
-    QString relDir = m_baseDir.relativeFilePath(fullDir);
-    if (!relDir.startsWith(QLatin1String("..")))
-        return relDir;
-    return fullDir;
-}
-
 void KFindTreeView::beginSearch(const QUrl& baseUrl)
 {
     //qDebug() << QString("beginSearch in: %1").arg(baseUrl.path());
-    m_baseDir = QDir(baseUrl.toLocalFile());
-    m_model->clear();
+    m_model->clear( QDir(baseUrl.toLocalFile()) );
 }
 
 void KFindTreeView::endSearch()
@@ -469,7 +491,7 @@ void KFindTreeView::saveResults()
         QTextStream stream( &file );
         stream.setCodec( QTextCodec::codecForLocale() );
         
-        QList<KFindItem> itemList = m_model->getItemList();
+        const QVector<KFindItem> itemList = m_model->getItemList();
         if ( filter == QLatin1String("*.html") ) 
         {
             stream << QString::fromLatin1("<!DOCTYPE html PUBLIC \"-//W3C//DTD XHTML 1.0 Strict//EN\""
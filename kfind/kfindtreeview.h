@@ -26,10 +26,12 @@
 #include <QAbstractTableModel>
 #include <QDir>
 #include <QDragMoveEvent>
+#include <QHash>
 #include <QIcon>
 #include <QSortFilterProxyModel>
 #include <QTreeView>
 #include <QUrl>
+#include <QVector>
 
 class QMenu;
 class KFindTreeView;
@@ -39,7 +41,7 @@ class KfindDlg;
 class KFindItem
 {
     public:
-        explicit KFindItem( const KFileItem & = KFileItem(), const QString & subDir = QString(), const QString & matchingLine = QString() );
+        explicit KFindItem( const KFileItem & = KFileItem(), const QDir & baseDir = QDir(), const QString & matchingLine = QString() );
         
         QVariant data(int column, int role) const;
         
@@ -47,11 +49,20 @@ class KFindItem
         bool isValid() const { return !m_fileItem.isNull(); }
         
     private:
+        // What is only shown is looked up when it is shown first
+        const QString & subDir() const;
+        const QString & permission() const;
+        const QIcon & icon() const;
+
         KFileItem       m_fileItem;
+        QDir            m_baseDir;
         QString         m_matchingLine;
-        QString         m_subDir;
-        QString         m_permission;
-        QIcon           m_icon;
+        mutable QString m_subDir;
+        mutable QString m_permission;
+        mutable QIcon   m_icon;
+        mutable bool    m_subDirLoaded;
+        mutable bool    m_permissionLoaded;
+        mutable bool    m_iconLoaded;
 };
  
 class KFindItemModel: public QAbstractTableModel
@@ -59,12 +70,14 @@ class KFindItemModel: public QAbstractTableModel
     public:
         KFindItemModel( KFindTreeView* parent);
 
+        /* Appends the files not shown yet, in one go */
         void insertFileItems( const QList< QPair<KFileItem,QString> > &);
 
         void removeItem(const QUrl &);
-        bool isInserted(const QUrl &);
+        bool isInserted(const QUrl &) const;
         
-        void clear();
+        /* Removes all files. The folders of the files inserted afterwards are shown relative to baseDir */
+        void clear( const QDir & baseDir = QDir() );
         
         Qt::DropActions supportedDropActions() const Q_DECL_OVERRIDE { return Qt::CopyAction | Qt::MoveAction; }
         
@@ -78,10 +91,12 @@ class KFindItemModel: public QAbstractTableModel
         
         KFindItem itemAtIndex( const QModelIndex & index ) const;
         
-        QList<KFindItem> getItemList() const { return m_itemList; }
+        QVector<KFindItem> getItemList() const { return m_itemList; }
         
     private:
-        QList<KFindItem>    m_itemList;
+        QVector<KFindItem>  m_itemList;
+        QHash<QUrl, int>    m_rows; // url -> index in m_itemList
+        QDir                m_baseDir;
         KFindTreeView*        m_view;
 };
 
@@ -113,8 +128,6 @@ class KFindTreeView: public QTreeView
         
         bool isInserted(const QUrl & url) { return m_model->isInserted( url ); }
         
-        QString reducedDir(const QString& fullDir);
-        
         int itemCount() { return m_model->rowCount(); }
         QList<QUrl> selectedUrls();
 
@@ -144,8 +157,6 @@ class KFindTreeView: public QTreeView
     private:
         void resizeToContents();
         
-        QDir                        m_baseDir;
-        
         KFindItemModel *            m_model;
         KFindSortFilterProxyModel * m_proxyModel;
         KActionCollection *         m_actionCollection;
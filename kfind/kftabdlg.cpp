@@ -41,7 +41,6 @@
 #include <kfiledialog.h>
 #include <kregexpeditorinterface.h>
 #include <kservicetypetrader.h>
-#include <kstandarddirs.h>
 #include <kdialog.h>
 #include <kconfiggroup.h>
 #include <KShell>
@@ -98,8 +97,6 @@ KfindTabWidget::KfindTabWidget(QWidget *parent)
     caseSensCb->setChecked(false);
     useLocateCb->setChecked(false);
     hiddenFilesCb->setChecked(false);
-    if(KStandardDirs::findExe(QLatin1String("locate")).isEmpty())
-        useLocateCb->setEnabled(false);
 
     nameBox->setDuplicatesEnabled(false);
     nameBox->setFocus();
@@ -130,9 +127,9 @@ KfindTabWidget::KfindTabWidget(QWidget *parent)
     nameBox->setWhatsThis(nameWhatsThis);
     namedL->setWhatsThis(nameWhatsThis);
     const QString whatsfileindex
-        = i18n("<qt>This lets you use the files' index created by the <i>slocate</i> "
-               "package to speed-up the search; remember to update the index from time to time "
-               "(using <i>updatedb</i>)."
+        = i18n("<qt>This lets KFind keep an index of the file names in the folders you "
+               "search, to speed-up the search. The index is updated at the start of every "
+               "search, only the folders which changed since the last one are read again."
                "</qt>");
     useLocateCb->setWhatsThis(whatsfileindex);
 
@@ -0,0 +1,148 @@
+/*******************************************************************
+* knamematcher.cpp
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 2 of
+* the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+******************************************************************/
+
+#include "knamematcher.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+/* Position of the first of chars in pattern from from on, or -1 */
+static int indexOfAny( const QString &pattern, int from, const char *chars )
+{
+  for (int i = from; i < pattern.length(); ++i)
+  {
+    const QChar c = pattern.at(i);
+    if (c.unicode() < 0x80 && strchr(chars, c.toLatin1()))
+      return i;
+  }
+  return -1;
+}
+
+/* The regular expression QRegExp::Wildcard makes of a pattern with '*' and '?' only */
+static QString wildcardToRegExp( const QString &pattern )
+{
+  QString rx;
+  for (int i = 0; i < pattern.length(); ++i)
+  {
+    const QChar c = pattern.at(i);
+    if (c == QLatin1Char('*'))
+      rx += QLatin1String(".*");
+    else if (c == QLatin1Char('?'))
+      rx += QLatin1Char('.');
+    else
+      rx += QRegExp::escape(QString(c));
+  }
+  return rx;
+}
+
+KNameMatcher::KNameMatcher()
+  : m_caseSensitivity(Qt::CaseSensitive), m_matchAll(false)
+{
+}
+
+void KNameMatcher::setPatterns( const QStringList &patterns, Qt::CaseSensitivity caseSensitivity )
+{
+  m_caseSensitivity = caseSensitivity;
+  m_matchAll = false;
+  m_names.clear();
+  m_endings.clear();
+  m_endingLengths.clear();
+  m_joined = QRegExp();
+  m_others.clear();
+
+  QStringList joined;
+  for (QStringList::const_iterator it = patterns.constBegin(); it != patterns.constEnd(); ++it)
+  {
+    const QString &pattern = *it;
+    // sets, and what QRegExp makes of a backslash, are left to it
+    if (indexOfAny(pattern, 0, "[]\\") >= 0)
+      m_others.append(QRegExp(pattern, caseSensitivity, QRegExp::Wildcard));
+    else if (indexOfAny(pattern, 0, "*?") < 0)
+      m_names.insert(folded(pattern));
+    else if (pattern.at(0) == QLatin1Char('*') && indexOfAny(pattern, 1, "*?") < 0)
+    {
+      if (pattern.length() == 1)
+        m_matchAll = true;
+      m_endings.insert(folded(pattern.mid(1)));
+      if (!m_endingLengths.contains(pattern.length() - 1))
+        m_endingLengths.append(pattern.length() - 1);
+    }
+    else
+      joined.append(wildcardToRegExp(pattern));
+  }
+  std::sort(m_endingLengths.begin(), m_endingLengths.end());
+
+  if (!joined.isEmpty())
+    m_joined = QRegExp(QStringLiteral("(?:") + joined.join(QLatin1Char('|')) + QLatin1Char(')'),
+                       caseSensitivity, QRegExp::RegExp);
+}
+
+bool KNameMatcher::isEmpty() const
+{
+  return m_names.isEmpty() && m_endings.isEmpty() && m_joined.isEmpty() && m_others.isEmpty();
+}
+
+int KNameMatcher::matchCount() const
+{
+  int count = m_others.count();
+  if (!m_joined.isEmpty())
+    count++;
+  if (!m_names.isEmpty() || !m_endings.isEmpty())
+    count++;
+  return count;
+}
+
+/* Like QRegExp without case sensitivity: a character at a time */
+QString KNameMatcher::folded( const QString &name ) const
+{
+  if (m_caseSensitivity == Qt::CaseSensitive)
+    return name;
+  QString result = name;
+  QChar *c = result.data();
+  for (int i = 0; i < result.length(); ++i)
+    c[i] = c[i].toLower();
+  return result;
+}
+
+bool KNameMatcher::matches( const QString &fileName ) const
+{
+  if (m_matchAll)
+    return true;
+
+  if (!m_names.isEmpty() || !m_endings.isEmpty())
+  {
+    const QString name = folded(fileName);
+    if (m_names.contains(name))
+      return true;
+    for (QVector<int>::const_iterator it = m_endingLengths.constBegin(); it != m_endingLengths.constEnd(); ++it)
+    {
+      if (*it > name.length())
+        break;
+      if (m_endings.contains(QString::fromRawData(name.constData() + name.length() - *it, *it)))
+        return true;
+    }
+  }
+
+  if (!m_joined.isEmpty() && m_joined.exactMatch(fileName))
+    return true;
+  for (QList<QRegExp>::const_iterator it = m_others.constBegin(); it != m_others.constEnd(); ++it)
+    if ((*it).exactMatch(fileName))
+      return true;
+  return false;
+}
@@ -0,0 +1,69 @@
+/*******************************************************************
+* knamematcher.h
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 2 of
+* the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+******************************************************************/
+
+#ifndef KNAMEMATCHER_H
+#define KNAMEMATCHER_H
+
+#include <QList>
+#include <QRegExp>
+#include <QSet>
+#include <QStringList>
+#include <QVector>
+
+/*
+ * Matches file names against a set of wildcard patterns, with the
+ * results of a QRegExp::Wildcard per pattern.
+ *
+ * Patterns without wildcards are looked up in a set of names, and
+ * patterns like "*.cpp" in a set of endings, one lookup per length of
+ * the endings. The ones using only '*' and '?' are joined into a single
+ * regular expression. Only patterns with character sets are matched one
+ * by one.
+ */
+class KNameMatcher
+{
+ public:
+  KNameMatcher();
+
+  void setPatterns( const QStringList &patterns, Qt::CaseSensitivity caseSensitivity );
+  /* Nothing matches without patterns */
+  bool isEmpty() const;
+
+  /* Rough number of wildcard matches per name, the lookups counting as one */
+  int matchCount() const;
+
+  bool matches( const QString &fileName ) const;
+
+ private:
+  QString folded( const QString &name ) const;
+
+  Qt::CaseSensitivity m_caseSensitivity;
+  // a "*" pattern
+  bool m_matchAll;
+  // without case sensitivity, in lower case
+  QSet<QString> m_names;
+  QSet<QString> m_endings;
+  // of the endings, ascending
+  QVector<int> m_endingLengths;
+  // the patterns with '*' and '?' only, or nothing
+  QRegExp m_joined;
+  // the patterns with character sets
+  QList<QRegExp> m_others;
+};
+
+#endif
@@ -17,102 +17,349 @@
 ******************************************************************/
 
 #include "kquery.h"
+#include "kfileindex.h"
+#include "kfind_debug.h"
 
 #include <stdlib.h>
 
-#include <QCoreApplication>
+#include <QRunnable>
+#include <QFile>
 #include <QFileInfo>
-#include <QTextCodec>
-#include <QTextStream>
 #include <QList>
-#include <QDebug>
-#include <kmimetype.h>
 #include <kfileitem.h>
-#include <kfilemetainfo.h>
-#include <kmessagebox.h>
-#include <klocale.h>
-#include <kstandarddirs.h>
-#include <kzip.h>
+
+#ifdef Q_OS_UNIX
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// number of files checked by one task of the worker threads
+static const int s_filesPerTask = 32;
+
+// milliseconds after the last search using the name index before it is saved
+static const int s_saveIndexDelay = 10 * 1000;
+
+static void saveFileIndex()
+{
+  KFileIndex *index = KFileIndex::self();
+  QMutexLocker locker(index->mutex());
+  if (index->isModified())
+    index->save(KFileIndex::defaultFileName());
+}
+
+/* Checks a few files in a worker thread */
+class KQueryTask : public QRunnable
+{
+ public:
+  KQueryTask(KQuery *query, const KQueryFilter &filter, int generation, const QList<KFileItem> &files)
+    : m_query(query), m_filter(filter), m_generation(generation), m_files(files)
+  {
+  }
+
+  void run() Q_DECL_OVERRIDE
+  {
+    QString matchingLine;
+    for (QList<KFileItem>::const_iterator it = m_files.constBegin(); it != m_files.constEnd(); ++it)
+    {
+      if (m_query->m_generation.load() != m_generation)
+        break;
+      matchingLine.clear();
+      if (m_filter.matches(*it, &matchingLine, m_query->m_generation, m_generation))
+        m_query->addMatch(m_generation, *it, matchingLine);
+    }
+    m_query->taskFinished(m_generation, m_filter.statistics());
+  }
+
+ private:
+  KQuery *m_query;
+  KQueryFilter m_filter; // our own copy, see KQueryFilter
+  int m_generation;
+  QList<KFileItem> m_files;
+};
+
+#ifdef Q_OS_UNIX
+/*
+ * Fill entry like the file ioslave does for name, relative to the folder
+ * dirFd, or for the full path name with AT_FDCWD: links show what they
+ * point to. Returns false if there is no such entry (anymore).
+ */
+static bool statEntry(int dirFd, const char *name, KIO::UDSEntry *entry, bool *isFolder)
+{
+  struct stat buff;
+  if (fstatat(dirFd, name, &buff, AT_SYMLINK_NOFOLLOW) != 0)
+    return false;
+
+  // links to folders are not listed as folders
+  *isFolder = S_ISDIR(buff.st_mode);
+  if (S_ISLNK(buff.st_mode))
+  {
+    char target[PATH_MAX];
+    const ssize_t length = readlinkat(dirFd, name, target, sizeof(target));
+    if (length > 0)
+      entry->insert(KIO::UDSEntry::UDS_LINK_DEST, QFile::decodeName(QByteArray(target, length)));
+    struct stat targetBuff;
+    if (fstatat(dirFd, name, &targetBuff, 0) == 0)
+      buff = targetBuff;
+  }
+  entry->insert(KIO::UDSEntry::UDS_FILE_TYPE, buff.st_mode & S_IFMT);
+  entry->insert(KIO::UDSEntry::UDS_ACCESS, buff.st_mode & 07777);
+  entry->insert(KIO::UDSEntry::UDS_SIZE, buff.st_size);
+  entry->insert(KIO::UDSEntry::UDS_MODIFICATION_TIME, buff.st_mtime);
+  entry->insert(KIO::UDSEntry::UDS_ACCESS_TIME, buff.st_atime);
+  return true;
+}
+#endif
+
+/*
+ * Lists a local folder in a worker thread, and checks the files in it.
+ * Subfolders get tasks of their own, so the tree is listed by all worker
+ * threads at once.
+ */
+class KQueryListTask : public QRunnable
+{
+ public:
+  KQueryListTask(KQuery *query, const KQueryFilter &filter, int generation, const QString &path, bool recursive)
+    : m_query(query), m_filter(filter), m_generation(generation), m_path(path), m_recursive(recursive)
+  {
+  }
+
+  void run() Q_DECL_OVERRIDE
+  {
+    if (m_query->m_generation.load() == m_generation)
+      listFolder();
+    m_query->listTaskFinished(m_generation, m_filter.statistics());
+  }
+
+ private:
+  void listFolder();
+
+  KQuery *m_query;
+  KQueryFilter m_filter; // our own copy, see KQueryFilter
+  int m_generation;
+  QString m_path;
+  bool m_recursive;
+};
+
+void KQueryListTask::listFolder()
+{
+#ifdef Q_OS_UNIX
+  const int fd = open(QFile::encodeName(m_path).constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fd < 0)
+    return;
+  DIR *dir = fdopendir(fd);
+  if (!dir)
+  {
+    close(fd);
+    return;
+  }
+
+  // entries are looked up relative to the folder, without resolving its path again
+  const QUrl folderUrl = QUrl::fromLocalFile(m_path);
+  QList<KFileItem> files;
+  QStringList folders;
+  while (struct dirent *ent = readdir(dir))
+  {
+    if (m_query->m_generation.load() != m_generation)
+      break;
+
+    const char *name = ent->d_name;
+    if (name[0] == '.' && (name[1] == 0 || (name[1] == '.' && name[2] == 0)))
+      continue;
+
+    KIO::UDSEntry entry;
+    bool isFolder;
+    if (!statEntry(fd, name, &entry, &isFolder))
+      continue;
+    entry.insert(KIO::UDSEntry::UDS_NAME, QFile::decodeName(name));
+    if (m_recursive && isFolder)
+      folders.append(entry.stringValue(KIO::UDSEntry::UDS_NAME));
+
+    files.append(KFileItem(entry, folderUrl, true, true));
+  }
+  closedir(dir);
+
+  // let other threads go on with the subfolders while the files are
+  // checked, and before our filter counts anything
+  const QString prefix = m_path.endsWith(QLatin1Char('/')) ? m_path : m_path + QLatin1Char('/');
+  for (QStringList::const_iterator it = folders.constBegin(); it != folders.constEnd(); ++it)
+    m_query->startListTask(m_generation, new KQueryListTask(m_query, m_filter, m_generation, prefix + *it, true));
+
+  QString matchingLine;
+  for (QList<KFileItem>::const_iterator it = files.constBegin(); it != files.constEnd(); ++it)
+  {
+    if (m_query->m_generation.load() != m_generation)
+      break;
+    matchingLine.clear();
+    if (m_filter.matches(*it, &matchingLine, m_query->m_generation, m_generation))
+      m_query->addMatch(m_generation, *it, matchingLine);
+  }
+#endif
+}
+
+/* Looks up and checks local files found in the name index, in a worker thread */
+class KQueryPathTask : public QRunnable
+{
+ public:
+  KQueryPathTask(KQuery *query, const KQueryFilter &filter, int generation, const QStringList &paths)
+    : m_query(query), m_filter(filter), m_generation(generation), m_paths(paths)
+  {
+  }
+
+  void run() Q_DECL_OVERRIDE
+  {
+    QString matchingLine;
+    for (QStringList::const_iterator it = m_paths.constBegin(); it != m_paths.constEnd(); ++it)
+    {
+      if (m_query->m_generation.load() != m_generation)
+        break;
+      KFileItem file;
+      // the index may be older than the file system
+      if (!fileItem(*it, &file))
+        continue;
+      matchingLine.clear();
+      if (m_filter.matches(file, &matchingLine, m_query->m_generation, m_generation))
+        m_query->addMatch(m_generation, file, matchingLine);
+    }
+    m_query->listTaskFinished(m_generation, m_filter.statistics());
+  }
+
+ private:
+  static bool fileItem(const QString &path, KFileItem *file)
+  {
+#ifdef Q_OS_UNIX
+    KIO::UDSEntry entry;
+    bool isFolder;
+    if (!statEntry(AT_FDCWD, QFile::encodeName(path).constData(), &entry, &isFolder))
+      return false;
+    entry.insert(KIO::UDSEntry::UDS_NAME, path.mid(path.lastIndexOf(QLatin1Char('/')) + 1));
+    *file = KFileItem(entry, QUrl::fromLocalFile(path), true);
+#else
+    if (!QFileInfo::exists(path))
+      return false;
+    *file = KFileItem(KFileItem::Unknown, KFileItem::Unknown, QUrl::fromLocalFile(path));
+#endif
+    return true;
+  }
+
+  KQuery *m_query;
+  KQueryFilter m_filter; // our own copy, see KQueryFilter
+  int m_generation;
+  QStringList m_paths;
+};
+
+/*
+ * Looks the files up in the name index and then updates it, in a worker
+ * thread. What is found is checked by KQueryPathTasks meanwhile.
+ */
+class KQueryIndexTask : public QRunnable, public KFileIndexReceiver
+{
+ public:
+  KQueryIndexTask(KQuery *query, const KQueryFilter &filter, int generation,
+                  const QString &root, bool recursive, const QStringList &literals)
+    : m_query(query), m_filter(filter), m_generation(generation),
+      m_root(root), m_recursive(recursive), m_literals(literals)
+  {
+  }
+
+  void run() Q_DECL_OVERRIDE
+  {
+    KFileIndex *index = KFileIndex::self();
+    {
+      QMutexLocker locker(index->mutex());
+      // what was indexed before shows up right away, what is new while
+      // the folders are read again
+      index->find(m_root, m_recursive, m_literals, this, m_query->m_generation, m_generation);
+      index->refresh(m_root, m_recursive, m_query->m_generation, m_generation, m_literals, this);
+    }
+    m_query->listTaskFinished(m_generation, m_filter.statistics());
+  }
+
+  void foundPaths(const QStringList &paths) Q_DECL_OVERRIDE
+  {
+    m_query->startListTask(m_generation, new KQueryPathTask(m_query, m_filter, m_generation, paths));
+  }
+
+ private:
+  KQuery *m_query;
+  KQueryFilter m_filter;
+  int m_generation;
+  QString m_root;
+  bool m_recursive;
+  QStringList m_literals;
+};
+
+/* Saves the name index in a worker thread, see KQuery::slotSaveIndex() */
+class KQuerySaveIndexTask : public QRunnable
+{
+ public:
+  void run() Q_DECL_OVERRIDE
+  {
+    saveFileIndex();
+  }
+};
 
 KQuery::KQuery(QObject *parent)
   : QObject(parent),
-    m_filetype(0), m_sizemode(0), m_sizeboundary1(0),
-    m_sizeboundary2(0), m_timeFrom(0), m_timeTo(0),
-    m_recursive(false),m_casesensitive(false),
-    m_search_binary(false), m_regexpForContent(false),
-    m_useLocate(false), m_showHiddenFiles(false),
-    job(0), m_insideCheckEntries(false), m_result(0)
-{
-  processLocate = new KProcess(this);
-  connect(processLocate,SIGNAL(readyReadStandardOutput()),this,SLOT(slotreadyReadStandardOutput()));
-  connect(processLocate,SIGNAL(readyReadStandardError()),this,SLOT(slotreadyReadStandardError()));
-  connect(processLocate,SIGNAL(finished(int,QProcess::ExitStatus)),this,SLOT(slotendProcessLocate(int,QProcess::ExitStatus)));
-
-  // Files with these mime types can be ignored, even if
-  // findFormatByFileContent() in some cases may claim that
-  // these are text files:
-  ignore_mimetypes.append(QLatin1String("application/pdf"));
-  ignore_mimetypes.append(QLatin1String("application/postscript"));
-
-  // PLEASE update the documentation when you add another
-  // file type here:
-  ooo_mimetypes.append(QLatin1String("application/vnd.sun.xml.writer"));
-  ooo_mimetypes.append(QLatin1String("application/vnd.sun.xml.calc"));
-  ooo_mimetypes.append(QLatin1String("application/vnd.sun.xml.impress"));
-  // OASIS mimetypes, used by OOo-2.x and KOffice >= 1.4
-  //ooo_mimetypes.append("application/vnd.oasis.opendocument.chart");
-  //ooo_mimetypes.append("application/vnd.oasis.opendocument.graphics");
-  //ooo_mimetypes.append("application/vnd.oasis.opendocument.graphics-template");
-  //ooo_mimetypes.append("application/vnd.oasis.opendocument.formula");
-  //ooo_mimetypes.append("application/vnd.oasis.opendocument.image");
-  ooo_mimetypes.append(QLatin1String("application/vnd.oasis.opendocument.presentation-template"));
-  ooo_mimetypes.append(QLatin1String("application/vnd.oasis.opendocument.presentation"));
-  ooo_mimetypes.append(QLatin1String("application/vnd.oasis.opendocument.spreadsheet-template"));
-  ooo_mimetypes.append(QLatin1String("application/vnd.oasis.opendocument.spreadsheet"));
-  ooo_mimetypes.append(QLatin1String("application/vnd.oasis.opendocument.text-template"));
-  ooo_mimetypes.append(QLatin1String("application/vnd.oasis.opendocument.text"));
-  // KOffice-1.3 mimetypes
-  koffice_mimetypes.append(QLatin1String("application/x-kword"));
-  koffice_mimetypes.append(QLatin1String("application/x-kspread"));
-  koffice_mimetypes.append(QLatin1String("application/x-kpresenter"));
+    m_recursive(false), m_useFileIndex(false), m_indexUsed(false), m_localListing(false), job(0), m_result(0), m_generation(0), m_pendingTasks(0),
+    m_listingFinished(false), m_pendingListTasks(0), m_finishedTasks(0), m_deliveryScheduled(0)
+{
+  m_saveIndexTimer.setSingleShot(true);
+  m_saveIndexTimer.setInterval(s_saveIndexDelay);
+  connect(&m_saveIndexTimer, SIGNAL(timeout()), SLOT(slotSaveIndex()));
 }
 
 KQuery::~KQuery()
 {
-  while (!m_regexps.isEmpty())
-    delete m_regexps.takeFirst();
-  m_fileItems.clear();
-  if( processLocate->state() == QProcess::Running)
-  {
-    disconnect( processLocate );
-    processLocate->kill();
-    processLocate->waitForFinished( 5000 );
-    delete processLocate;
-  }
+  cancelTasks();
+  m_pool.waitForDone();
+  // what the last searches added to the name index is not lost
+  if (m_indexUsed)
+    saveFileIndex();
+}
+
+void KQuery::slotSaveIndex()
+{
+  m_pool.start(new KQuerySaveIndexTask);
 }
 
 void KQuery::kill()
 {
+  cancelTasks();
   if (job)
     job->kill(KJob::EmitResult);
-  if (processLocate->state() == QProcess::Running)
-    processLocate->kill();
-  m_fileItems.clear();
+  if (m_localListing)
+  {
+    // the listing tasks give up, and nobody listens to them anymore
+    m_localListing = false;
+    m_result = KIO::ERR_USER_CANCELED;
+    m_listingFinished = true;
+    checkFinished();
+  }
 }
 
 void KQuery::start()
 {
-  m_fileItems.clear();
-  if( m_useLocate ) //Use "locate" instead of the internal search method
+  cancelTasks();
+  m_listingFinished = false;
+  m_localListing = false;
+  m_result = 0;
+  m_statistics.clear();
+  if( m_useFileIndex && m_url.isLocalFile() ) //Use our own index instead of listing the folders
   {
-    bufferLocate.clear();
     m_url = m_url.adjusted(QUrl::NormalizePathSegments);
-
-    processLocate->clearProgram();
-    processLocate->setProgram( QLatin1String("locate"), QStringList() <<  m_url.toLocalFile() );
-
-    processLocate->setOutputChannelMode(KProcess::SeparateChannels);
-    processLocate->start();
+    m_localListing = true;
+    m_indexUsed = true;
+    const int generation = m_generation.load();
+    startListTask( generation, new KQueryIndexTask( this, m_filter, generation, m_url.toLocalFile(), m_recursive, m_nameLiterals ) );
+  }
+  else if( m_url.isLocalFile() && canListLocally( m_url.toLocalFile() ) ) //List local folders ourselves, without the ioslave
+  {
+    m_localListing = true;
+    const int generation = m_generation.load();
+    startListTask( generation, new KQueryListTask( this, m_filter, generation, m_url.toLocalFile(), m_recursive ) );
   }
   else //Use KIO
   {
@@ -128,13 +375,66 @@ void KQuery::start()
   }
 }
 
+bool KQuery::canListLocally( const QString &path )
+{
+#ifdef Q_OS_UNIX
+  // errors about the folder itself are left to the ioslave
+  const QFileInfo info( path );
+  return info.isDir() && info.isReadable() && info.isExecutable();
+#else
+  Q_UNUSED( path );
+  return false;
+#endif
+}
+
+void KQuery::startListTask( int generation, QRunnable *task )
+{
+  QMutexLocker locker(&m_resultMutex);
+  if (generation != m_generation.load())
+  {
+    delete task;
+    return;
+  }
+  m_pendingListTasks++;
+  m_pool.start( task );
+}
+
+void KQuery::listTaskFinished( int generation, const KQueryStatistics &statistics )
+{
+  bool listingFinished;
+  {
+    QMutexLocker locker(&m_resultMutex);
+    if (generation != m_generation.load())
+      return;
+    m_finishedStatistics.add(statistics);
+    listingFinished = --m_pendingListTasks == 0;
+  }
+  scheduleDelivery();
+
+  // after the delivery of the files found, see scheduleDelivery()
+  if (listingFinished)
+    QMetaObject::invokeMethod(this, "slotLocalListingFinished", Qt::QueuedConnection,
+                              Q_ARG(int, generation));
+}
+
+void KQuery::slotLocalListingFinished( int generation )
+{
+  if (generation != m_generation.load())
+    return;
+  m_localListing = false;
+  m_listingFinished = true;
+  checkFinished();
+}
+
 void KQuery::slotResult( KJob * _job )
 {
   if (job != _job) return;
   job = 0;
 
   m_result=_job->error();
+  m_listingFinished = true;
   checkEntries();
+  checkFinished();
 }
 
 void KQuery::slotCanceled( KJob * _job )
@@ -142,10 +442,11 @@ void KQuery::slotCanceled( KJob * _job )
   if (job != _job) return;
   job = 0;
 
-  m_fileItems.clear();
+  cancelTasks();
 
   m_result=KIO::ERR_USER_CANCELED;
-  checkEntries();
+  m_listingFinished = true;
+  checkFinished();
 }
 
 void KQuery::slotListEntries(KIO::Job*, const KIO::UDSEntryList& list)
@@ -160,374 +461,164 @@ void KQuery::slotListEntries(KIO::Job*, const KIO::UDSEntryList& list)
 
 void KQuery::checkEntries()
 {
-  if (m_insideCheckEntries) return;
-      
-  m_insideCheckEntries=true;
-  
-  metaKeyRx = QRegExp(m_metainfokey);
-  metaKeyRx.setPatternSyntax( QRegExp::Wildcard );
-  
-  m_foundFilesList.clear();
+  const int generation = m_generation.load();
 
-  int processingCount = 0;
-  while( !m_fileItems.isEmpty() ) 
+  while( !m_fileItems.isEmpty() )
   {
-    processQuery( m_fileItems.dequeue() );
-    processingCount++;
-    
-    /* This is a workaround. As the qApp->processEvents() call inside processQuery
-     * will bring more KIO entries, m_fileItems will increase even inside this loop
-     * and that will lead to a big loop, it will take time to report found items to the GUI
-     * so we are going to force emit results every 100 files processed */
-    if( processingCount==100 )
-    {
-      processingCount = 0;
-      if( m_foundFilesList.size() > 0 )
-      {
-        emit foundFileList( m_foundFilesList );
-        m_foundFilesList.clear();
-      }
-    }
+    QList<KFileItem> files;
+    while( !m_fileItems.isEmpty() && files.count() < s_filesPerTask )
+      files.append( m_fileItems.dequeue() );
+
+    m_pendingTasks++;
+    m_pool.start( new KQueryTask( this, m_filter, generation, files ) );
   }
+}
 
-  if( m_foundFilesList.size() > 0 )
-    emit foundFileList( m_foundFilesList );
-  
-  if (job==0)
+void KQuery::checkFinished()
+{
+  if( m_listingFinished && m_pendingTasks == 0 )
+  {
+    // Files added later on (see KfindDlg::slotNewItems) don't finish the search again
+    m_listingFinished = false;
+    qCDebug(KFIND_LOG) << "KQuery: checked" << m_statistics;
+    // searches changing the index often are not slowed down by saving it each time
+    if (m_indexUsed)
+      m_saveIndexTimer.start();
     emit result(m_result);
-      
-  m_insideCheckEntries=false;
+  }
 }
 
-/* List of files found using slocate */
-void KQuery::slotListEntries( QStringList list )
+void KQuery::cancelTasks()
 {
-  metaKeyRx = QRegExp(m_metainfokey);
-  metaKeyRx.setPatternSyntax( QRegExp::Wildcard );
-
-  QStringList::const_iterator it = list.constBegin();
-  QStringList::const_iterator end = list.constEnd();
-
-  m_foundFilesList.clear();
-  for (; it != end; ++it)
-    processQuery( KFileItem( KFileItem::Unknown, KFileItem::Unknown, QUrl::fromLocalFile(*it)) );
-
-  if( m_foundFilesList.size() > 0 )
-    emit foundFileList( m_foundFilesList );
-      
+  {
+    QMutexLocker locker(&m_resultMutex);
+    m_generation.fetchAndAddOrdered(1);
+    m_foundFilesList.clear();
+    m_finishedTasks = 0;
+    m_finishedStatistics.clear();
+    m_pendingListTasks = 0;
+  }
+  // Tasks not started yet are simply dropped, running ones notice
+  // the new generation within a line of the file they are reading
+  m_pool.clear();
+  m_pendingTasks = 0;
+  m_fileItems.clear();
 }
 
-/* Check if file meets the find's requirements*/
-void KQuery::processQuery( const KFileItem &file)
+void KQuery::addMatch(int generation, const KFileItem &file, const QString &matchingLine)
 {
-  if ( file.name() == QLatin1String(".") || file.name() == QLatin1String("..") )
-    return;
-    
-  if ( !m_showHiddenFiles && file.isHidden() )
-    return;
-  
-  bool matched=false;
-
-  QListIterator<QRegExp *> nextItem( m_regexps );
-  while ( nextItem.hasNext() )
   {
-    QRegExp *reg = nextItem.next();
-    matched = matched || ( reg == 0L ) || ( reg->exactMatch( file.url().adjusted(QUrl::StripTrailingSlash).fileName() ) ) ;
+    QMutexLocker locker(&m_resultMutex);
+    if (generation != m_generation.load())
+      return;
+    m_foundFilesList.append( QPair<KFileItem,QString>(file, matchingLine) );
   }
-  if (!matched)
-    return;
+  scheduleDelivery();
+}
 
-  // make sure the files are in the correct range
-  switch( m_sizemode )
+void KQuery::taskFinished(int generation, const KQueryStatistics &statistics)
+{
   {
-    case 1: // "at least"
-      if ( file.size() < m_sizeboundary1 ) return;
-      break;
-    case 2: // "at most"
-      if ( file.size() > m_sizeboundary1 ) return;
-      break;
-    case 3: // "equal"
-      if ( file.size() != m_sizeboundary1 ) return;
-      break;
-    case 4: // "between"
-      if ( (file.size() < m_sizeboundary1) ||
-              (file.size() > m_sizeboundary2) ) return;
-      break;
-    case 0: // "none" -> Fall to default
-    default:
-            break;
+    QMutexLocker locker(&m_resultMutex);
+    if (generation != m_generation.load())
+      return;
+    m_finishedTasks++;
+    m_finishedStatistics.add(statistics);
   }
+  scheduleDelivery();
+}
 
-  // make sure it's in the correct date range
-  // what about 0 times?
-  if ( m_timeFrom && ((uint) m_timeFrom) > file.time(KFileItem::ModificationTime).toTime_t() )
-    return;
-  if ( m_timeTo && ((uint) m_timeTo) < file.time(KFileItem::ModificationTime).toTime_t() )
-    return;
-
-  // username / group match
-  if ( (!m_username.isEmpty()) && (m_username != file.user()) )
-    return;
-  if ( (!m_groupname.isEmpty()) && (m_groupname != file.group()) )
-    return;
+void KQuery::scheduleDelivery()
+{
+  // One pending delivery takes everything found until it runs
+  if (m_deliveryScheduled.testAndSetOrdered(0, 1))
+    QMetaObject::invokeMethod(this, "slotDeliverResults", Qt::QueuedConnection);
+}
 
-  // file type
-  switch (m_filetype)
-  {
-    case 0:
-      break;
-    case 1: // plain file
-      if ( !S_ISREG( file.mode() ) )
-        return;
-      break;
-    case 2:
-      if ( !file.isDir() )
-        return;
-      break;
-    case 3:
-      if ( !file.isLink() )
-        return;
-      break;
-    case 4:
-      if ( !S_ISCHR ( file.mode() ) && !S_ISBLK ( file.mode() ) &&
-            !S_ISFIFO( file.mode() ) && !S_ISSOCK( file.mode() ) )
-            return;
-      break;
-    case 5: // binary
-      if ( (file.permissions() & 0111) != 0111 || file.isDir() )
-        return;
-      break;
-    case 6: // suid
-      if ( (file.permissions() & 04000) != 04000 ) // fixme
-        return;
-      break;
-    default:
-      if (!m_mimetype.isEmpty() && !m_mimetype.contains(file.mimetype()))
-        return;
-  }
+void KQuery::slotDeliverResults()
+{
+  m_deliveryScheduled.storeRelease(0);
 
-  // match data in metainfo...
-  if ((!m_metainfo.isEmpty())  && (!m_metainfokey.isEmpty()))
+  QList< QPair<KFileItem,QString> > foundFilesList;
+  int finishedTasks;
   {
-      //Avoid sequential files (fifo,char devices)
-      if (!file.isRegularFile())
-        return;
-          
-      bool foundmeta=false;
-      QString filename = file.url().path();
-
-      if(filename.startsWith( QLatin1String("/dev/") ))
-        return;
-
-      KFileMetaInfo metadatas(filename);
-      QStringList metakeys;
-      QString strmetakeycontent;
-
-      metakeys = metadatas.supportedKeys();
-      for (QStringList::const_iterator it = metakeys.constBegin(); it != metakeys.constEnd(); ++it )
-      {
-        if (!metaKeyRx.exactMatch(*it))
-          continue;
-        strmetakeycontent=metadatas.item(*it).value().toString();
-        if(strmetakeycontent.indexOf(m_metainfo)!=-1)
-        {
-          foundmeta=true;
-          break;
-        }
-      }
-      if (!foundmeta)
-        return;
+    QMutexLocker locker(&m_resultMutex);
+    foundFilesList.swap(m_foundFilesList);
+    finishedTasks = m_finishedTasks;
+    m_finishedTasks = 0;
+    m_statistics.add(m_finishedStatistics);
+    m_finishedStatistics.clear();
   }
 
-  // match contents...
-  QString matchingLine;
-  if (!m_context.isEmpty())
-  {
-    //Avoid sequential files (fifo,char devices)
-    if (!file.isRegularFile())
-        return;
-        
-    if( !m_search_binary && ignore_mimetypes.indexOf(file.mimetype()) != -1 ) {
-      //qDebug() << "ignoring, mime type is in exclusion list: " << file.url();
-      return;
-    }
-
-    bool found = false;
-    bool isZippedOfficeDocument=false;
-    int matchingLineNumber=0;
+  if( !foundFilesList.isEmpty() )
+    emit foundFileList( foundFilesList );
 
-    // FIXME: doesn't work with non local files
-
-    QString filename;
-    QTextStream* stream=0;
-    QFile qf;
-    QRegExp xmlTags;
-    QByteArray zippedXmlFileContent;
-
-    // KWord's and OpenOffice.org's files are zipped...
-    if( ooo_mimetypes.indexOf(file.mimetype()) != -1 ||
-        koffice_mimetypes.indexOf(file.mimetype()) != -1 )
-    {
-      KZip zipfile(file.url().path());
-      KZipFileEntry *zipfileEntry;
-
-      if(zipfile.open(QIODevice::ReadOnly))
-      {
-        const KArchiveDirectory *zipfileContent = zipfile.directory();
-
-        if( koffice_mimetypes.indexOf(file.mimetype()) != -1 )
-          zipfileEntry = (KZipFileEntry*)zipfileContent->entry(QLatin1String("maindoc.xml"));
-        else
-          zipfileEntry = (KZipFileEntry*)zipfileContent->entry(QLatin1String("content.xml")); //for OpenOffice.org
-
-        if(!zipfileEntry) {
-          qWarning() << "Expected XML file not found in ZIP archive " << file.url() ;
-          return;
-        }
-
-        zippedXmlFileContent = zipfileEntry->data();
-        xmlTags.setPattern(QLatin1String("<.*>"));
-        xmlTags.setMinimal(true);
-        stream = new QTextStream(zippedXmlFileContent, QIODevice::ReadOnly);
-        stream->setCodec("UTF-8");
-        isZippedOfficeDocument = true;
-      } else {
-        qWarning() << "Cannot open supposed ZIP file " << file.url() ;
-      }
-      
-    } else if( !m_search_binary && !file.mimetype().startsWith( QLatin1String("text/") ) &&
-        file.url().isLocalFile() && !file.url().path().startsWith( QLatin1String("/dev") ) ) {
-      if ( KMimeType::isBinaryData(file.url().path()) ) {
-        //qDebug() << "ignoring, not a text file: " << file.url();
-        return;
-      }
-    }
+  m_pendingTasks -= finishedTasks;
+  checkFinished();
+}
 
-    if(!isZippedOfficeDocument) //any other file or non-compressed KWord
-    {
-      filename = file.url().path();
-      if(filename.startsWith(QLatin1String("/dev/")))
-        return;
-      qf.setFileName(filename);
-      qf.open(QIODevice::ReadOnly);
-      stream=new QTextStream(&qf);
-      stream->setCodec(QTextCodec::codecForLocale());
-    }
+/* List of local files to check */
+void KQuery::slotListEntries( QStringList list )
+{
+  QStringList::const_iterator it = list.constBegin();
+  QStringList::const_iterator end = list.constEnd();
 
-    while ( ! stream->atEnd() )
-    {
-      QString str = stream->readLine();
-      matchingLineNumber++;
-
-      //If the stream ended (readLine().isNull() is true) the file was read completely
-      //Do *not* use isEmpty() because that will exit if there is an empty line in the file
-      if (str.isNull()) break;
-      if(isZippedOfficeDocument)
-        str.remove(xmlTags);
-
-      if (m_regexpForContent)
-      {
-        if (m_regexp.indexIn(str)>=0)
-        {
-          matchingLine=QString::number(matchingLineNumber)+QStringLiteral(": ")+str;
-          found = true;
-          break;
-        }
-      }
-      else
-      {
-        if (str.indexOf(m_context, 0, m_casesensitive?Qt::CaseSensitive:Qt::CaseInsensitive) != -1)
-        {
-          matchingLine=QString::number(matchingLineNumber)+QStringLiteral(": ")+str;
-          found = true;
-          break;
-        }
-      }
-      qApp->processEvents();
-    }
-    
-    delete stream;
+  for (; it != end; ++it)
+    m_fileItems.enqueue( KFileItem( KFileItem::Unknown, KFileItem::Unknown, QUrl::fromLocalFile(*it)) );
 
-    if (!found)
-      return;
-  }
-  
-  m_foundFilesList.append( QPair<KFileItem,QString>(file, matchingLine) );
+  checkEntries();
 }
 
 void KQuery::setContext(const QString & context, bool casesensitive,
   bool search_binary, bool useRegexp)
 {
-  m_context = context;
-  m_casesensitive = casesensitive;
-  m_search_binary = search_binary;
-  m_regexpForContent=useRegexp;
-  if ( !m_regexpForContent )
-    m_regexp.setPatternSyntax(QRegExp::Wildcard);
-  else
-    m_regexp.setPatternSyntax(QRegExp::RegExp);
-  if ( casesensitive )
-    m_regexp.setCaseSensitivity(Qt::CaseSensitive);
-  else
-    m_regexp.setCaseSensitivity(Qt::CaseInsensitive);
-  if (m_regexpForContent)
-     m_regexp.setPattern(m_context);
+  m_filter.setContext(context, casesensitive, search_binary, useRegexp);
 }
 
 void KQuery::setMetaInfo(const QString &metainfo, const QString &metainfokey)
 {
-  m_metainfo=metainfo;
-  m_metainfokey=metainfokey;
+  m_filter.setMetaInfo(metainfo, metainfokey);
 }
 
 void KQuery::setMimeType(const QStringList &mimetype)
 {
-  m_mimetype = mimetype;
+  m_filter.setMimeType(mimetype);
 }
 
 void KQuery::setFileType(int filetype)
 {
-  m_filetype = filetype;
+  m_filter.setFileType(filetype);
 }
 
 void KQuery::setSizeRange(int mode, KIO::filesize_t value1, KIO::filesize_t value2)
 {
-  m_sizemode = mode;
-  m_sizeboundary1 = value1;
-  m_sizeboundary2 = value2;
+  m_filter.setSizeRange(mode, value1, value2);
 }
 
 void KQuery::setTimeRange(time_t from, time_t to)
 {
-  m_timeFrom = from;
-  m_timeTo = to;
+  m_filter.setTimeRange(from, to);
 }
 
 void KQuery::setUsername(const QString &username)
 {
-  m_username = username;
+  m_filter.setUsername(username);
 }
 
 void KQuery::setGroupname(const QString &groupname)
 {
-  m_groupname = groupname;
+  m_filter.setGroupname(groupname);
 }
 
 void KQuery::setRegExp(const QString &regexp, bool caseSensitive)
 {
-  QRegExp *regExp;
-  QRegExp sep(QStringLiteral(";"));
-  const QStringList strList=regexp.split( sep, QString::SkipEmptyParts);
-  //  QRegExp globChars ("[\\*\\?\\[\\]]", TRUE, FALSE);
-  while (!m_regexps.isEmpty())
-      delete m_regexps.takeFirst();
-
-  //  m_regexpsContainsGlobs.clear();
-  for ( QStringList::ConstIterator it = strList.constBegin(); it != strList.constEnd(); ++it ) {
-    regExp = new QRegExp((*it),( caseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive ), QRegExp::Wildcard);
-    //m_regexpsContainsGlobs.append(regExp->pattern().contains(globChars));
-    m_regexps.append(regExp);
-  }
+  m_filter.setRegExp(regexp, caseSensitive);
+
+  // The index only narrows the files down, the filter checks them
+  m_nameLiterals.clear();
+  const QStringList patterns = regexp.split(QLatin1Char(';'), QString::SkipEmptyParts);
+  for (QStringList::const_iterator it = patterns.constBegin(); it != patterns.constEnd(); ++it)
+    m_nameLiterals.append(KFileIndex::requiredLiteral(*it));
 }
 
 void KQuery::setRecursive(bool recursive)
@@ -540,36 +631,12 @@ void KQuery::setPath(const QUrl &url)
   m_url = url;
 }
 
-void KQuery::setUseFileIndex(bool useLocate)
+void KQuery::setUseFileIndex(bool useFileIndex)
 {
-  m_useLocate=useLocate;
+  m_useFileIndex=useFileIndex;
 }
 
 void KQuery::setShowHiddenFiles(bool showHidden)
 {
-  m_showHiddenFiles = showHidden;
-}
-
-void KQuery::slotreadyReadStandardError()
-{
-  KMessageBox::error(NULL, QString::fromLocal8Bit(processLocate->readAllStandardOutput()), i18nc("@title:window", "Error while using locate"));
-}
-
-void KQuery::slotreadyReadStandardOutput()
-{
-  bufferLocate += processLocate->readAllStandardOutput();
-}
-
-void KQuery::slotendProcessLocate(int code, QProcess::ExitStatus)
-{
-  if (code == 0 )
-  {
-    if( !bufferLocate.isEmpty() )
-    {
-      QString str = QString::fromLocal8Bit(bufferLocate);
-      bufferLocate.clear();
-      slotListEntries(str.split(QLatin1Char('\n'), QString::SkipEmptyParts));
-    }
-  }
-  emit result(0);
+  m_filter.setShowHiddenFiles(showHidden);
 }
@@ -22,17 +22,26 @@
 #include <time.h>
 
 #include <QObject>
-#include <QRegExp>
+#include <QAtomicInt>
+#include <QMutex>
 #include <QQueue>
 #include <QList>
 #include <QDir>
 #include <QPair>
 #include <QStringList>
+#include <QThreadPool>
+#include <QTimer>
 
 #include <kio/job.h>
-#include <kprocess.h>
+
+#include "kqueryfilter.h"
 
 class KFileItem;
+class KQueryTask;
+class KQueryListTask;
+class KQueryPathTask;
+class KQueryIndexTask;
+class QRunnable;
 
 class KQuery : public QObject
 {
@@ -62,12 +71,11 @@ class KQuery : public QObject
   void kill();
   const QUrl& url()              {return m_url;}
 
- private:
-  /* Check if file meets the find's requirements*/
-  inline void processQuery(const KFileItem &);
+  /* Where the files checked by the current search were rejected, see KFIND_LOG */
+  const KQueryStatistics &statistics() const {return m_statistics;}
 
  public Q_SLOTS:
-  /* List of files found using slocate */
+  /* List of local files to check */
   void slotListEntries(QStringList);
   
  protected Q_SLOTS:
@@ -75,53 +83,77 @@ class KQuery : public QObject
   void slotListEntries(KIO::Job *, const KIO::UDSEntryList &);
   void slotResult(KJob *);
   void slotCanceled(KJob *);
-  
-  void slotreadyReadStandardOutput();
-  void slotreadyReadStandardError();
-  void slotendProcessLocate(int, QProcess::ExitStatus);
+
+ private Q_SLOTS:
+  /* Hand the results of the worker threads to the GUI */
+  void slotDeliverResults();
+
+  /* All local folders were listed, or looked up in the name index */
+  void slotLocalListingFinished(int generation);
+
+  /* Save the name index in a worker thread */
+  void slotSaveIndex();
 
  Q_SIGNALS:
     void foundFileList( QList< QPair<KFileItem,QString> >);
     void result(int);
 
  private:
+  friend class KQueryTask;
+  friend class KQueryListTask;
+  friend class KQueryPathTask;
+  friend class KQueryIndexTask;
+
+  /* Local folders can be listed in the worker threads, see KQueryListTask */
+  static bool canListLocally(const QString &path);
+
+  /* Hand the queued files to the worker threads */
   void checkEntries();
+  /* Emit result() once listing and checking are done */
+  void checkFinished();
+  /* Drop the queued files, and make the worker threads give up */
+  void cancelTasks();
+
+  /* Called by the worker threads */
+  void addMatch(int generation, const KFileItem &file, const QString &matchingLine);
+  void taskFinished(int generation, const KQueryStatistics &statistics);
+  /* Start a KQueryListTask, KQueryIndexTask or KQueryPathTask */
+  void startListTask(int generation, QRunnable *task);
+  void listTaskFinished(int generation, const KQueryStatistics &statistics);
+  void scheduleDelivery();
 
-  int m_filetype;
-  int m_sizemode;
-  KIO::filesize_t m_sizeboundary1;
-  KIO::filesize_t m_sizeboundary2;
+  KQueryFilter m_filter;
   QUrl m_url;
-  time_t m_timeFrom;
-  time_t m_timeTo;
-  QRegExp m_regexp;// regexp for file content
   bool m_recursive;
-  QStringList m_mimetype;
-  QString m_context;
-  QString m_username;
-  QString m_groupname;
-  QString m_metainfo;
-  QString m_metainfokey;
-  bool m_casesensitive;
-  bool m_search_binary;
-  bool m_regexpForContent;
-  bool m_useLocate;
-  bool m_showHiddenFiles;
-  QByteArray bufferLocate;
-  QStringList locateList;
-  KProcess *processLocate;
-  QList<QRegExp*> m_regexps;// regexps for file name
-//  QValueList<bool> m_regexpsContainsGlobs;  // what should this be good for ? Alex
+  bool m_useFileIndex;
+  /* The name index was searched, and may need to be saved */
+  bool m_indexUsed;
+  QTimer m_saveIndexTimer;
+  /* Parts of the file name patterns, for looking names up in the index */
+  QStringList m_nameLiterals;
+  /* Tasks of the current generation are listing local folders, or the name index */
+  bool m_localListing;
   KIO::ListJob *job;
-  bool m_insideCheckEntries;
   QQueue<KFileItem> m_fileItems;
-  QRegExp metaKeyRx;
   int m_result;
-  QStringList ignore_mimetypes;
-  QStringList ooo_mimetypes;     // OpenOffice.org mimetypes
-  QStringList koffice_mimetypes;
-  
+
+  /* Worker threads checking the files against m_filter */
+  QThreadPool m_pool;
+  /* Bumped when a search starts or is killed, tasks of older generations give up */
+  QAtomicInt m_generation;
+  /* Tasks of the current generation not reported finished yet */
+  int m_pendingTasks;
+  bool m_listingFinished;
+
+  QMutex m_resultMutex;
   QList< QPair<KFileItem,QString> > m_foundFilesList;
+  /* Listing tasks of the current generation started and not finished */
+  int m_pendingListTasks;
+  int m_finishedTasks;
+  KQueryStatistics m_finishedStatistics;
+  QAtomicInt m_deliveryScheduled;
+
+  KQueryStatistics m_statistics;
 };
 
 #endif
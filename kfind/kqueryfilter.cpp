@@ -0,0 +1,581 @@
+/*******************************************************************
+* kqueryfilter.cpp
+* 
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 2 of 
+* the License, or (at your option) any later version.
+* 
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+* 
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+* 
+******************************************************************/
+
+#include "kqueryfilter.h"
+
+#include <algorithm>
+
+#include <QFile>
+#include <QTextCodec>
+#include <QTextStream>
+#include <QDebug>
+#include <kmimetype.h>
+#include <kfileitem.h>
+#include <kfilemetainfo.h>
+#include <kzip.h>
+
+KQueryStatistics::KQueryStatistics()
+{
+  clear();
+}
+
+void KQueryStatistics::clear()
+{
+  files = 0;
+  for (int i = 0; i < StageCount; ++i)
+  {
+    checked[i] = 0;
+    rejected[i] = 0;
+  }
+}
+
+void KQueryStatistics::add(const KQueryStatistics &other)
+{
+  files += other.files;
+  for (int i = 0; i < StageCount; ++i)
+  {
+    checked[i] += other.checked[i];
+    rejected[i] += other.rejected[i];
+  }
+}
+
+const char *KQueryStatistics::stageName(Stage stage)
+{
+  static const char *const names[StageCount] = {
+    "hidden", "type", "size", "time", "name", "owner", "mimetype", "metainfo", "content"
+  };
+  return (stage >= 0 && stage < StageCount) ? names[stage] : "";
+}
+
+QDebug operator<<(QDebug dbg, const KQueryStatistics &statistics)
+{
+  QDebugStateSaver saver(dbg);
+  dbg.nospace() << statistics.files << " files";
+  for (int i = 0; i < KQueryStatistics::StageCount; ++i)
+  {
+    if (statistics.checked[i] == 0)
+      continue;
+    dbg << ", " << KQueryStatistics::stageName(KQueryStatistics::Stage(i))
+        << " rejected " << statistics.rejected[i] << "/" << statistics.checked[i];
+  }
+  return dbg;
+}
+
+KQueryFilter::KQueryFilter()
+  : m_filetype(0), m_sizemode(0), m_sizeboundary1(0),
+    m_sizeboundary2(0), m_timeFrom(0), m_timeTo(0),
+    m_casesensitive(false), m_search_binary(false),
+    m_regexpForContent(false), m_showHiddenFiles(false),
+    m_planned(false)
+{
+  // Files with these mime types can be ignored, even if
+  // findFormatByFileContent() in some cases may claim that
+  // these are text files:
+  ignore_mimetypes.append(QLatin1String("application/pdf"));
+  ignore_mimetypes.append(QLatin1String("application/postscript"));
+
+  // PLEASE update the documentation when you add another
+  // file type here:
+  ooo_mimetypes.append(QLatin1String("application/vnd.sun.xml.writer"));
+  ooo_mimetypes.append(QLatin1String("application/vnd.sun.xml.calc"));
+  ooo_mimetypes.append(QLatin1String("application/vnd.sun.xml.impress"));
+  // OASIS mimetypes, used by OOo-2.x and KOffice >= 1.4
+  //ooo_mimetypes.append("application/vnd.oasis.opendocument.chart");
+  //ooo_mimetypes.append("application/vnd.oasis.opendocument.graphics");
+  //ooo_mimetypes.append("application/vnd.oasis.opendocument.graphics-template");
+  //ooo_mimetypes.append("application/vnd.oasis.opendocument.formula");
+  //ooo_mimetypes.append("application/vnd.oasis.opendocument.image");
+  ooo_mimetypes.append(QLatin1String("application/vnd.oasis.opendocument.presentation-template"));
+  ooo_mimetypes.append(QLatin1String("application/vnd.oasis.opendocument.presentation"));
+  ooo_mimetypes.append(QLatin1String("application/vnd.oasis.opendocument.spreadsheet-template"));
+  ooo_mimetypes.append(QLatin1String("application/vnd.oasis.opendocument.spreadsheet"));
+  ooo_mimetypes.append(QLatin1String("application/vnd.oasis.opendocument.text-template"));
+  ooo_mimetypes.append(QLatin1String("application/vnd.oasis.opendocument.text"));
+  // KOffice-1.3 mimetypes
+  koffice_mimetypes.append(QLatin1String("application/x-kword"));
+  koffice_mimetypes.append(QLatin1String("application/x-kspread"));
+  koffice_mimetypes.append(QLatin1String("application/x-kpresenter"));
+}
+
+/*
+ * A file being checked, with what the checks find out about it on
+ * the way, so nothing is looked up twice.
+ */
+class KQueryFilter::FileData
+{
+ public:
+  explicit FileData(const KFileItem &f)
+    : file(f), m_mimeTypeKnown(false)
+  {
+  }
+
+  /* May read the start of the file to tell */
+  const QString &mimeType()
+  {
+    if (!m_mimeTypeKnown)
+    {
+      m_mimeType = file.mimetype();
+      m_mimeTypeKnown = true;
+    }
+    return m_mimeType;
+  }
+
+  const KFileItem &file;
+
+ private:
+  QString m_mimeType;
+  bool m_mimeTypeKnown;
+};
+
+// Rough cost of a check relative to comparing two numbers. Checks
+// costing the same run in the order of KQueryStatistics::Stage.
+static int stageCost(KQueryStatistics::Stage stage, int nameMatches)
+{
+  switch (stage)
+  {
+    case KQueryStatistics::Hidden:
+    case KQueryStatistics::FileType:
+    case KQueryStatistics::Size:
+      return 1;
+    case KQueryStatistics::Time:
+      return 2;
+    case KQueryStatistics::Name: // see KNameMatcher::matchCount()
+      return 2 * nameMatches;
+    case KQueryStatistics::Owner: // user and group names are looked up
+      return 10;
+    case KQueryStatistics::MimeType: // may read the start of the file
+      return 1000;
+    case KQueryStatistics::MetaInfo: // reads parts of the file
+      return 10000;
+    case KQueryStatistics::Content: // reads the whole file
+    default:
+      return 100000;
+  }
+}
+
+namespace {
+struct PlannedStage
+{
+  KQueryStatistics::Stage stage;
+  int cost;
+
+  bool operator<(const PlannedStage &other) const
+  {
+    return cost < other.cost || (cost == other.cost && stage < other.stage);
+  }
+};
+}
+
+static void addStage(QVector<PlannedStage> &stages, KQueryStatistics::Stage stage, int nameMatches)
+{
+  PlannedStage planned;
+  planned.stage = stage;
+  planned.cost = stageCost(stage, nameMatches);
+  stages.append(planned);
+}
+
+void KQueryFilter::plan()
+{
+  const int nameMatches = m_names.matchCount();
+  QVector<PlannedStage> stages;
+
+  if (!m_showHiddenFiles)
+    addStage(stages, KQueryStatistics::Hidden, nameMatches);
+  if (m_filetype >= 1 && m_filetype <= 6)
+    addStage(stages, KQueryStatistics::FileType, nameMatches);
+  if (m_sizemode >= 1 && m_sizemode <= 4)
+    addStage(stages, KQueryStatistics::Size, nameMatches);
+  if (m_timeFrom || m_timeTo)
+    addStage(stages, KQueryStatistics::Time, nameMatches);
+  addStage(stages, KQueryStatistics::Name, nameMatches); // without patterns nothing matches
+  if (!m_username.isEmpty() || !m_groupname.isEmpty())
+    addStage(stages, KQueryStatistics::Owner, nameMatches);
+  if (m_filetype > 6 && !m_mimetype.isEmpty())
+    addStage(stages, KQueryStatistics::MimeType, nameMatches);
+  if (!m_metainfo.isEmpty() && !m_metainfokey.isEmpty())
+    addStage(stages, KQueryStatistics::MetaInfo, nameMatches);
+  if (!m_context.isEmpty())
+    addStage(stages, KQueryStatistics::Content, nameMatches);
+
+  std::sort(stages.begin(), stages.end());
+
+  m_plan.clear();
+  m_plan.reserve(stages.count());
+  for (QVector<PlannedStage>::const_iterator it = stages.constBegin(); it != stages.constEnd(); ++it)
+    m_plan.append((*it).stage);
+  m_planned = true;
+}
+
+/* Check if file meets the find's requirements*/
+bool KQueryFilter::matches( const KFileItem &file, QString *matchingLine,
+  const QAtomicInt &generation, int expectedGeneration )
+{
+  if ( file.name() == QLatin1String(".") || file.name() == QLatin1String("..") )
+    return false;
+
+  if (!m_planned)
+    plan();
+
+  m_statistics.files++;
+  FileData data(file);
+  for (QVector<KQueryStatistics::Stage>::const_iterator it = m_plan.constBegin(); it != m_plan.constEnd(); ++it)
+  {
+    m_statistics.checked[*it]++;
+    if (!matchesStage(*it, data, matchingLine, generation, expectedGeneration))
+    {
+      m_statistics.rejected[*it]++;
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool KQueryFilter::matchesStage( KQueryStatistics::Stage stage, FileData &data,
+  QString *matchingLine, const QAtomicInt &generation, int expectedGeneration )
+{
+  const KFileItem &file = data.file;
+
+  switch (stage)
+  {
+    case KQueryStatistics::Hidden:
+      return !file.isHidden();
+
+    case KQueryStatistics::FileType:
+      return matchesFileType(file);
+
+    case KQueryStatistics::Size:
+      // make sure the files are in the correct range
+      switch( m_sizemode )
+      {
+        case 1: // "at least"
+          return file.size() >= m_sizeboundary1;
+        case 2: // "at most"
+          return file.size() <= m_sizeboundary1;
+        case 3: // "equal"
+          return file.size() == m_sizeboundary1;
+        case 4: // "between"
+          return (file.size() >= m_sizeboundary1) &&
+                 (file.size() <= m_sizeboundary2);
+        case 0: // "none" -> Fall to default
+        default:
+          return true;
+      }
+
+    case KQueryStatistics::Time:
+    {
+      // make sure it's in the correct date range
+      // what about 0 times?
+      const uint time = file.time(KFileItem::ModificationTime).toTime_t();
+      if ( m_timeFrom && ((uint) m_timeFrom) > time )
+        return false;
+      if ( m_timeTo && ((uint) m_timeTo) < time )
+        return false;
+      return true;
+    }
+
+    case KQueryStatistics::Name:
+    {
+      return m_names.matches( file.url().adjusted(QUrl::StripTrailingSlash).fileName() );
+    }
+
+    case KQueryStatistics::Owner:
+      // username / group match
+      if ( (!m_username.isEmpty()) && (m_username != file.user()) )
+        return false;
+      if ( (!m_groupname.isEmpty()) && (m_groupname != file.group()) )
+        return false;
+      return true;
+
+    case KQueryStatistics::MimeType:
+      return m_mimetype.contains(data.mimeType());
+
+    case KQueryStatistics::MetaInfo:
+      // match data in metainfo...
+      return matchesMetaInfo(file);
+
+    case KQueryStatistics::Content:
+      // match contents...
+      return matchesContent(data, matchingLine, generation, expectedGeneration);
+
+    default:
+      return true;
+  }
+}
+
+bool KQueryFilter::matchesFileType( const KFileItem &file ) const
+{
+  switch (m_filetype)
+  {
+    case 1: // plain file
+      return S_ISREG( file.mode() );
+    case 2:
+      return file.isDir();
+    case 3:
+      return file.isLink();
+    case 4:
+      return S_ISCHR ( file.mode() ) || S_ISBLK ( file.mode() ) ||
+             S_ISFIFO( file.mode() ) || S_ISSOCK( file.mode() );
+    case 5: // binary
+      return (file.permissions() & 0111) == 0111 && !file.isDir();
+    case 6: // suid
+      return (file.permissions() & 04000) == 04000; // fixme
+    default:
+      return true;
+  }
+}
+
+bool KQueryFilter::matchesMetaInfo( const KFileItem &file )
+{
+  //Avoid sequential files (fifo,char devices)
+  if (!file.isRegularFile())
+    return false;
+
+  QString filename = file.url().path();
+
+  if(filename.startsWith( QLatin1String("/dev/") ))
+    return false;
+
+  KFileMetaInfo metadatas(filename);
+  QStringList metakeys;
+  QString strmetakeycontent;
+
+  metakeys = metadatas.supportedKeys();
+  for (QStringList::const_iterator it = metakeys.constBegin(); it != metakeys.constEnd(); ++it )
+  {
+    if (!metaKeyRx.exactMatch(*it))
+      continue;
+    strmetakeycontent=metadatas.item(*it).value().toString();
+    if(strmetakeycontent.indexOf(m_metainfo)!=-1)
+      return true;
+  }
+  return false;
+}
+
+bool KQueryFilter::matchesContent( FileData &data, QString *matchingLine,
+  const QAtomicInt &generation, int expectedGeneration )
+{
+  const KFileItem &file = data.file;
+
+  //Avoid sequential files (fifo,char devices)
+  if (!file.isRegularFile())
+    return false;
+
+  const QString &mimeType = data.mimeType();
+  if( !m_search_binary && ignore_mimetypes.indexOf(mimeType) != -1 ) {
+    //qDebug() << "ignoring, mime type is in exclusion list: " << file.url();
+    return false;
+  }
+
+  bool found = false;
+  bool isZippedOfficeDocument=false;
+  int matchingLineNumber=0;
+
+  // FIXME: doesn't work with non local files
+
+  QString filename;
+  QTextStream* stream=0;
+  QFile qf;
+  QRegExp xmlTags;
+  QByteArray zippedXmlFileContent;
+
+  // KWord's and OpenOffice.org's files are zipped...
+  const bool isKOfficeDocument = koffice_mimetypes.indexOf(mimeType) != -1;
+  if( isKOfficeDocument || ooo_mimetypes.indexOf(mimeType) != -1 )
+  {
+    KZip zipfile(file.url().path());
+    KZipFileEntry *zipfileEntry;
+
+    if(zipfile.open(QIODevice::ReadOnly))
+    {
+      const KArchiveDirectory *zipfileContent = zipfile.directory();
+
+      if( isKOfficeDocument )
+        zipfileEntry = (KZipFileEntry*)zipfileContent->entry(QLatin1String("maindoc.xml"));
+      else
+        zipfileEntry = (KZipFileEntry*)zipfileContent->entry(QLatin1String("content.xml")); //for OpenOffice.org
+
+      if(!zipfileEntry) {
+        qWarning() << "Expected XML file not found in ZIP archive " << file.url() ;
+        return false;
+      }
+
+      zippedXmlFileContent = zipfileEntry->data();
+      xmlTags.setPattern(QLatin1String("<.*>"));
+      xmlTags.setMinimal(true);
+      stream = new QTextStream(zippedXmlFileContent, QIODevice::ReadOnly);
+      stream->setCodec("UTF-8");
+      isZippedOfficeDocument = true;
+    } else {
+      qWarning() << "Cannot open supposed ZIP file " << file.url() ;
+    }
+
+  } else if( !m_search_binary && !mimeType.startsWith( QLatin1String("text/") ) &&
+      file.url().isLocalFile() && !file.url().path().startsWith( QLatin1String("/dev") ) ) {
+    if ( KMimeType::isBinaryData(file.url().path()) ) {
+      //qDebug() << "ignoring, not a text file: " << file.url();
+      return false;
+    }
+  }
+
+  if(!isZippedOfficeDocument) //any other file or non-compressed KWord
+  {
+    filename = file.url().path();
+    if(filename.startsWith(QLatin1String("/dev/")))
+      return false;
+    // search the bytes, only the matching line is decoded
+    if (m_contentSearch.isValid() && file.url().isLocalFile())
+    {
+      const KContentSearch::Result result =
+          m_contentSearch.search(filename, matchingLine, generation, expectedGeneration);
+      // UTF-16 and UTF-32 files are decoded by QTextStream below
+      if (result != KContentSearch::NotSearchable)
+        return result == KContentSearch::Found;
+    }
+    qf.setFileName(filename);
+    qf.open(QIODevice::ReadOnly);
+    stream=new QTextStream(&qf);
+    stream->setCodec(QTextCodec::codecForLocale());
+  }
+
+  while ( ! stream->atEnd() )
+  {
+    // The search was canceled or restarted
+    if (generation.load() != expectedGeneration)
+      break;
+
+    QString str = stream->readLine();
+    matchingLineNumber++;
+
+    //If the stream ended (readLine().isNull() is true) the file was read completely
+    //Do *not* use isEmpty() because that will exit if there is an empty line in the file
+    if (str.isNull()) break;
+    if(isZippedOfficeDocument)
+      str.remove(xmlTags);
+
+    if (m_regexpForContent)
+    {
+      if (m_regexp.indexIn(str)>=0)
+      {
+        *matchingLine=QString::number(matchingLineNumber)+QStringLiteral(": ")+str;
+        found = true;
+        break;
+      }
+    }
+    else
+    {
+      if (str.indexOf(m_context, 0, m_casesensitive?Qt::CaseSensitive:Qt::CaseInsensitive) != -1)
+      {
+        *matchingLine=QString::number(matchingLineNumber)+QStringLiteral(": ")+str;
+        found = true;
+        break;
+      }
+    }
+  }
+
+  delete stream;
+
+  return found;
+}
+
+void KQueryFilter::setContext(const QString & context, bool casesensitive,
+  bool search_binary, bool useRegexp)
+{
+  m_planned = false;
+  m_context = context;
+  m_casesensitive = casesensitive;
+  m_search_binary = search_binary;
+  m_regexpForContent=useRegexp;
+  if ( !m_regexpForContent )
+    m_regexp.setPatternSyntax(QRegExp::Wildcard);
+  else
+    m_regexp.setPatternSyntax(QRegExp::RegExp);
+  if ( casesensitive )
+    m_regexp.setCaseSensitivity(Qt::CaseSensitive);
+  else
+    m_regexp.setCaseSensitivity(Qt::CaseInsensitive);
+  if (m_regexpForContent)
+     m_regexp.setPattern(m_context);
+
+  m_contentSearch.setText(m_regexpForContent ? QString() : m_context, casesensitive,
+                          QTextCodec::codecForLocale());
+}
+
+void KQueryFilter::setMetaInfo(const QString &metainfo, const QString &metainfokey)
+{
+  m_planned = false;
+  m_metainfo=metainfo;
+  m_metainfokey=metainfokey;
+
+  metaKeyRx = QRegExp(m_metainfokey);
+  metaKeyRx.setPatternSyntax( QRegExp::Wildcard );
+}
+
+void KQueryFilter::setMimeType(const QStringList &mimetype)
+{
+  m_planned = false;
+  m_mimetype = mimetype;
+}
+
+void KQueryFilter::setFileType(int filetype)
+{
+  m_planned = false;
+  m_filetype = filetype;
+}
+
+void KQueryFilter::setSizeRange(int mode, KIO::filesize_t value1, KIO::filesize_t value2)
+{
+  m_planned = false;
+  m_sizemode = mode;
+  m_sizeboundary1 = value1;
+  m_sizeboundary2 = value2;
+}
+
+void KQueryFilter::setTimeRange(time_t from, time_t to)
+{
+  m_planned = false;
+  m_timeFrom = from;
+  m_timeTo = to;
+}
+
+void KQueryFilter::setUsername(const QString &username)
+{
+  m_planned = false;
+  m_username = username;
+}
+
+void KQueryFilter::setGroupname(const QString &groupname)
+{
+  m_planned = false;
+  m_groupname = groupname;
+}
+
+void KQueryFilter::setRegExp(const QString &regexp, bool caseSensitive)
+{
+  m_planned = false;
+  QRegExp sep(QStringLiteral(";"));
+  const QStringList strList=regexp.split( sep, QString::SkipEmptyParts);
+
+  m_names.setPatterns( strList, caseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive );
+}
+
+void KQueryFilter::setShowHiddenFiles(bool showHidden)
+{
+  m_planned = false;
+  m_showHiddenFiles = showHidden;
+}
@@ -0,0 +1,143 @@
+/*******************************************************************
+* kqueryfilter.h
+* 
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 2 of 
+* the License, or (at your option) any later version.
+* 
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+* 
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+* 
+******************************************************************/
+
+#ifndef KQUERYFILTER_H
+#define KQUERYFILTER_H
+
+#include <time.h>
+
+#include <QAtomicInt>
+#include <QList>
+#include <QRegExp>
+#include <QStringList>
+#include <QVector>
+
+#include <kio/global.h>
+
+#include "kcontentsearch.h"
+#include "knamematcher.h"
+
+class KFileItem;
+class QDebug;
+
+/*
+ * How many files each check of a KQueryFilter got to see, and how many
+ * of them it rejected. For tuning the order of the checks.
+ */
+class KQueryStatistics
+{
+ public:
+  /* The checks, in the order they are run if they cost the same */
+  enum Stage { Hidden, FileType, Size, Time, Name, Owner, MimeType,
+               MetaInfo, Content, StageCount };
+
+  KQueryStatistics();
+
+  void clear();
+  void add(const KQueryStatistics &other);
+
+  static const char *stageName(Stage stage);
+
+  qint64 files;
+  qint64 checked[StageCount];
+  qint64 rejected[StageCount];
+};
+
+QDebug operator<<(QDebug dbg, const KQueryStatistics &statistics);
+
+/*
+ * The requirements of a search, checked for every file found.
+ *
+ * KQuery runs the checks in worker threads. Every worker gets its own
+ * copy of the filter, as QRegExp objects must not be used by several
+ * threads at once.
+ */
+class KQueryFilter
+{
+ public:
+  KQueryFilter();
+
+  void setSizeRange( int mode, KIO::filesize_t value1, KIO::filesize_t value2);
+  void setTimeRange( time_t from, time_t to );
+  void setRegExp( const QString &regexp, bool caseSensitive );
+  void setFileType( int filetype );
+  void setMimeType( const QStringList & mimetype );
+  void setContext( const QString & context, bool casesensitive,
+  bool search_binary, bool useRegexp );
+  void setUsername( const QString &username );
+  void setGroupname( const QString &groupname );
+  void setMetaInfo(const QString &metainfo, const QString &metainfokey);
+  void setShowHiddenFiles(bool);
+
+  /*
+   * Check if file meets the find's requirements.
+   * matchingLine is set to the first matching line if there is a
+   * content search. The search of the contents gives up as soon as
+   * generation doesn't hold expectedGeneration anymore.
+   */
+  bool matches( const KFileItem &file, QString *matchingLine,
+  const QAtomicInt &generation, int expectedGeneration );
+
+  /* Files checked by matches() so far, and where they were rejected */
+  const KQueryStatistics &statistics() const { return m_statistics; }
+
+ private:
+  class FileData;
+
+  /*
+   * Order the checks needed for the current requirements cheapest
+   * first, so a file is only opened if everything else matched.
+   */
+  void plan();
+  bool matchesStage( KQueryStatistics::Stage stage, FileData &data,
+  QString *matchingLine, const QAtomicInt &generation, int expectedGeneration );
+  bool matchesFileType( const KFileItem &file ) const;
+  bool matchesMetaInfo( const KFileItem &file );
+  bool matchesContent( FileData &data, QString *matchingLine,
+  const QAtomicInt &generation, int expectedGeneration );
+
+  int m_filetype;
+  int m_sizemode;
+  KIO::filesize_t m_sizeboundary1;
+  KIO::filesize_t m_sizeboundary2;
+  time_t m_timeFrom;
+  time_t m_timeTo;
+  QRegExp m_regexp;// regexp for file content
+  KContentSearch m_contentSearch;// for plain text contents
+  QStringList m_mimetype;
+  QString m_context;
+  QString m_username;
+  QString m_groupname;
+  QString m_metainfo;
+  QString m_metainfokey;
+  bool m_casesensitive;
+  bool m_search_binary;
+  bool m_regexpForContent;
+  bool m_showHiddenFiles;
+  KNameMatcher m_names;// patterns for file name
+  QRegExp metaKeyRx;
+  QStringList ignore_mimetypes;
+  QStringList ooo_mimetypes;     // OpenOffice.org mimetypes
+  QStringList koffice_mimetypes;
+
+  QVector<KQueryStatistics::Stage> m_plan;
+  bool m_planned;
+  KQueryStatistics m_statistics;
+};
+
+#endif
@@ -21,6 +21,12 @@
 #include <QSignalSpy>
 #include <konqhistorymanager.h>
 
+#include <QDataStream>
+#include <QDBusConnection>
+#include <QDBusMessage>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
 #include <QObject>
 #include <QStandardPaths>
 
@@ -33,6 +39,11 @@ private Q_SLOTS:
     void testGetSetMaxCount();
     void testGetSetMaxAge();
     void testAddHistoryEntry();
+    void testCoalescedEntries();
+    void testJournalReplay();
+    void testHistoryFileFormat();
+    void testCorruptedHistoryFile();
+    void testMissedBroadcast();
 };
 
 QTEST_MAIN(HistoryManagerTest)
@@ -141,4 +152,295 @@ void HistoryManagerTest::testAddHistoryEntry()
     QCOMPARE(int(entry.numberOfTimesVisited), 1);
 }
 
+void HistoryManagerTest::testCoalescedEntries()
+{
+    KonqHistoryManager mgr(0);
+    qRegisterMetaType<KonqHistoryEntry>("KonqHistoryEntry");
+    QSignalSpy addedSpy(&mgr, SIGNAL(entryAdded(KonqHistoryEntry)));
+    const QUrl url(QStringLiteral("http://coalescetest.org/"));
+    const QString title = QStringLiteral("Coalesced");
+
+    // Confirmed right away, like a page which loads quickly
+    mgr.addPending(url, QString(), title);
+    mgr.confirmPending(url, QString(), title);
+
+    waitForAddedSignal(&mgr);
+    QTest::qWait(200);
+
+    // Both go out in one broadcast
+    QCOMPARE(addedSpy.count(), 1);
+    const KonqHistoryEntry entry = qvariant_cast<KonqHistoryEntry>(addedSpy[0][0]);
+    QCOMPARE(entry.url.url(), url.url());
+    QCOMPARE(entry.title, title);
+    QCOMPARE(int(entry.numberOfTimesVisited), 1);
+
+    mgr.emitRemoveFromHistory(url);
+    waitForRemovedSignal(&mgr);
+}
+
+static bool containsUrl(const KonqHistoryList &entries, const QUrl &url, KonqHistoryEntry *found = 0)
+{
+    foreach (const KonqHistoryEntry &entry, entries) {
+        if (entry.url == url) {
+            if (found) {
+                *found = entry;
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+void HistoryManagerTest::testJournalReplay()
+{
+    const QUrl url(QStringLiteral("http://journaltest.org/"));
+    const QString title = QStringLiteral("Journal Title");
+    const QString journal = QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation) + QLatin1String("/konqueror/konq_history.journal");
+    {
+        KonqHistoryManager mgr(0);
+        mgr.addPending(url, QString(), title);
+        waitForAddedSignal(&mgr);
+        mgr.confirmPending(url, QString(), title);
+        waitForAddedSignal(&mgr);
+    }
+    QVERIFY(QFile::exists(journal));
+
+    // Simulate a writer which died in the middle of a record
+    {
+        QFile file(journal);
+        QVERIFY(file.open(QIODevice::WriteOnly | QIODevice::Append));
+        file.write("\x12\x34\x56\x78\x00\x00\x10");
+    }
+
+    {
+        KonqHistoryManager mgr(0);
+        KonqHistoryEntry entry;
+        QVERIFY(containsUrl(mgr.entries(), url, &entry));
+        QCOMPARE(entry.title, title);
+        QCOMPARE(int(entry.numberOfTimesVisited), 1);
+
+        mgr.emitRemoveFromHistory(url);
+        waitForRemovedSignal(&mgr);
+        QVERIFY(!containsUrl(mgr.entries(), url));
+        // The corrupted tail made the removal compact the history
+        QVERIFY(!QFile::exists(journal));
+    }
+
+    {
+        KonqHistoryManager mgr(0);
+        QVERIFY(!containsUrl(mgr.entries(), url));
+    }
+}
+
+static void addEntry(KonqHistoryManager *mgr, const QUrl &url, const QString &title)
+{
+    mgr->addPending(url, QString(), title);
+    waitForAddedSignal(mgr);
+    mgr->confirmPending(url, QString(), title);
+    waitForAddedSignal(mgr);
+}
+
+// The crc32 of zlib, as used by the history files
+static quint32 crc32Of(const QByteArray &data)
+{
+    quint32 crc = 0xffffffff;
+    for (int i = 0; i < data.size(); ++i) {
+        crc ^= uchar(data.at(i));
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = (crc >> 1) ^ (0xedb88320 & (0 - (crc & 1)));
+        }
+    }
+    return ~crc;
+}
+
+void HistoryManagerTest::testHistoryFileFormat()
+{
+    const QUrl oldUrl(QStringLiteral("http://oldformattest.org/"));
+    const QUrl newUrl(QStringLiteral("http://newformattest.org/"));
+    const QString dataDir = QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation);
+    const QString history = dataDir + QLatin1String("/konqueror/konq_history");
+    const QString journal = dataDir + QLatin1String("/konqueror/konq_history.journal");
+    {
+        KonqHistoryManager mgr(0);
+        addEntry(&mgr, oldUrl, QStringLiteral("Old"));
+        QTest::qWait(10);
+        addEntry(&mgr, newUrl, QStringLiteral("New"));
+        // Write out the whole history
+        mgr.emitSetMaxCount(mgr.maxCount());
+        QTest::qWait(100);   // ### fragile
+    }
+    QVERIFY(!QFile::exists(journal));
+
+    // Older versions still read it: version 4, one checksummed blob of
+    // entries, the oldest first
+    QFile file(history);
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    QDataStream fileStream(&file);
+    quint32 version;
+    quint32 crc;
+    QByteArray data;
+    fileStream >> version >> crc >> data;
+    QCOMPARE(fileStream.status(), QDataStream::Ok);
+    QVERIFY(fileStream.atEnd());
+    QCOMPARE(version, quint32(4));
+    QCOMPARE(crc, crc32Of(data));
+
+    KonqHistoryList entries;
+    QDataStream stream(data);
+    while (!stream.atEnd()) {
+        KonqHistoryEntry entry;
+        entry.load(stream, KonqHistoryEntry::NoFlags);
+        entries.append(entry);
+    }
+    QVERIFY(entries.count() >= 2);
+    QCOMPARE(entries.at(entries.count() - 2).url, oldUrl);
+    QCOMPARE(entries.last().url, newUrl);
+    QCOMPARE(entries.last().title, QStringLiteral("New"));
+    for (int i = 1; i < entries.count(); ++i) {
+        QVERIFY(!(entries.at(i).lastVisited < entries.at(i - 1).lastVisited));
+    }
+
+    {
+        KonqHistoryManager mgr(0);
+        QVERIFY(containsUrl(mgr.entries(), oldUrl));
+        QVERIFY(containsUrl(mgr.entries(), newUrl));
+        mgr.emitRemoveListFromHistory(QList<QUrl>() << oldUrl << newUrl);
+        waitForRemovedSignal(&mgr);
+    }
+}
+
+void HistoryManagerTest::testCorruptedHistoryFile()
+{
+    const QUrl url(QStringLiteral("http://corruptedfiletest.org/"));
+    const QString dataDir = QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation);
+    const QString history = dataDir + QLatin1String("/konqueror/konq_history");
+    const QString journal = dataDir + QLatin1String("/konqueror/konq_history.journal");
+
+    // A header promising entries which aren't there
+    {
+        QDir().mkpath(QFileInfo(history).absolutePath());
+        QFile file(history);
+        QVERIFY(file.open(QIODevice::WriteOnly | QIODevice::Truncate));
+        file.write(QByteArray("\x00\x00\x00\x04\x00\x00\x00\x00\x00\x00\x00\x10", 12));
+    }
+
+    {
+        KonqHistoryManager mgr(0);
+        QVERIFY(!containsUrl(mgr.entries(), url));
+        mgr.addPending(url, QString(), QStringLiteral("Corrupted"));
+        waitForAddedSignal(&mgr);
+        // The journal of a broken history file would be ignored when loading
+        QVERIFY(!QFile::exists(journal));
+        mgr.confirmPending(url, QString(), QStringLiteral("Corrupted"));
+        waitForAddedSignal(&mgr);
+    }
+
+    {
+        KonqHistoryManager mgr(0);
+        KonqHistoryEntry entry;
+        QVERIFY(containsUrl(mgr.entries(), url, &entry));
+        QCOMPARE(entry.title, QStringLiteral("Corrupted"));
+
+        mgr.emitRemoveFromHistory(url);
+        waitForRemovedSignal(&mgr);
+    }
+}
+
+// Sends entries the way another instance broadcasts them
+static bool broadcastEntries(const QDBusConnection &bus, quint32 sequence, const QList<KonqHistoryEntry> &entries)
+{
+    QList<QByteArray> serialized;
+    foreach (const KonqHistoryEntry &entry, entries) {
+        QByteArray data;
+        QDataStream stream(&data, QIODevice::WriteOnly);
+        entry.save(stream, KonqHistoryEntry::MarshalUrlAsStrings);
+        serialized.append(data);
+    }
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream << sequence << serialized;
+
+    QDBusMessage message = QDBusMessage::createSignal(QStringLiteral("/KonqHistoryManager"),
+                           QStringLiteral("org.kde.Konqueror.HistoryManager"),
+                           QStringLiteral("notifyHistoryEntries"));
+    message << data;
+    return bus.send(message);
+}
+
+// Saves entries the way another instance does after a broadcast
+static bool appendToJournal(const QString &journal, const QList<KonqHistoryEntry> &entries)
+{
+    QFile file(journal);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        return false;
+    }
+    QByteArray chunk;
+    QDataStream stream(&chunk, QIODevice::WriteOnly);
+    if (file.size() == 0) {
+        stream << quint32(4); // the history version
+    }
+    foreach (const KonqHistoryEntry &entry, entries) {
+        QByteArray record;
+        QDataStream recordStream(&record, QIODevice::WriteOnly);
+        recordStream << quint8(1); // an added or updated entry
+        entry.save(recordStream, KonqHistoryEntry::NoFlags);
+        stream << crc32Of(record) << record;
+    }
+    return file.write(chunk) == chunk.size();
+}
+
+static KonqHistoryEntry visit(const QUrl &url, const QDateTime &firstVisited, const QDateTime &lastVisited, int count)
+{
+    KonqHistoryEntry entry;
+    entry.url = url;
+    entry.firstVisited = firstVisited;
+    entry.lastVisited = lastVisited;
+    entry.numberOfTimesVisited = count;
+    return entry;
+}
+
+void HistoryManagerTest::testMissedBroadcast()
+{
+    const QUrl savedUrl(QStringLiteral("http://missedsavedtest.org/"));
+    const QUrl unsavedUrl(QStringLiteral("http://missedunsavedtest.org/"));
+    const QString journal = QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation) + QLatin1String("/konqueror/konq_history.journal");
+    const QString otherName = QStringLiteral("historymanagertest-other");
+    QDBusConnection other = QDBusConnection::connectToBus(QDBusConnection::SessionBus, otherName);
+    QVERIFY(other.isConnected());
+
+    KonqHistoryManager mgr(0);
+    const QDateTime start = QDateTime::currentDateTime();
+
+    // The first broadcast of the other instance arrives
+    QVERIFY(broadcastEntries(other, 1, QList<KonqHistoryEntry>()
+                             << visit(savedUrl, start, start, 1)
+                             << visit(unsavedUrl, start, start, 1)));
+    waitForAddedSignal(&mgr);
+    KonqHistoryEntry entry;
+    QVERIFY(containsUrl(mgr.entries(), savedUrl, &entry));
+    QCOMPARE(int(entry.numberOfTimesVisited), 1);
+
+    // The second one gets lost. By the time the third one arrives, the
+    // other instance saved both, or only the second one.
+    QVERIFY(appendToJournal(journal, QList<KonqHistoryEntry>()
+                            << visit(savedUrl, start, start.addSecs(2), 3)
+                            << visit(unsavedUrl, start, start.addSecs(1), 2)));
+    QVERIFY(broadcastEntries(other, 3, QList<KonqHistoryEntry>()
+                             << visit(savedUrl, start, start.addSecs(2), 1)
+                             << visit(unsavedUrl, start, start.addSecs(2), 1)));
+    waitForAddedSignal(&mgr);
+    QTest::qWait(100);   // ### fragile
+
+    QVERIFY(containsUrl(mgr.entries(), savedUrl, &entry));
+    QCOMPARE(int(entry.numberOfTimesVisited), 3);
+    QCOMPARE(entry.lastVisited, start.addSecs(2));
+    QVERIFY(containsUrl(mgr.entries(), unsavedUrl, &entry));
+    QCOMPARE(int(entry.numberOfTimesVisited), 3);
+    QCOMPARE(entry.lastVisited, start.addSecs(2));
+
+    mgr.emitRemoveListFromHistory(QList<QUrl>() << savedUrl << unsavedUrl);
+    waitForRemovedSignal(&mgr);
+    QDBusConnection::disconnectFromBus(otherName);
+}
+
 #include "historymanagertest.moc"
@@ -0,0 +1,220 @@
+/* This file is part of KDE
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public License
+    along with this library; see the file COPYING.LIB.  If not, write to
+    the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+    Boston, MA 02110-1301, USA.
+*/
+
+#include <QTest>
+#include <QObject>
+
+#include <konqcompletionindex.h>
+
+class KonqCompletionIndexTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testNormalizedUrl();
+    void testDuplicates();
+    void testRanking();
+    void testTitleAndTypedUrl();
+    void testRemove();
+    void testManyEntries();
+    void testUpdates();
+    void testBookmarks();
+    void benchmarkTopMatches();
+};
+
+QTEST_GUILESS_MAIN(KonqCompletionIndexTest)
+
+void KonqCompletionIndexTest::testNormalizedUrl()
+{
+    QCOMPARE(KonqCompletionIndex::normalizedUrl(QStringLiteral("http://www.KDE.org/")), QStringLiteral("kde.org"));
+    QCOMPARE(KonqCompletionIndex::normalizedUrl(QStringLiteral("https://kde.org/foo")), QStringLiteral("kde.org/foo"));
+    QCOMPARE(KonqCompletionIndex::normalizedUrl(QStringLiteral("ftp://ftp.kde.org")), QStringLiteral("ftp.kde.org"));
+    QCOMPARE(KonqCompletionIndex::normalizedUrl(QStringLiteral("file:///usr/")), QStringLiteral("/usr"));
+    QCOMPARE(KonqCompletionIndex::normalizedUrl(QStringLiteral("/")), QStringLiteral("/"));
+    QCOMPARE(KonqCompletionIndex::normalizedUrl(QStringLiteral("http://")), QString());
+}
+
+void KonqCompletionIndexTest::testDuplicates()
+{
+    const QDateTime now = QDateTime::currentDateTime();
+    KonqCompletionIndex index;
+    index.insert(QStringLiteral("http://www.kde.org/"), QString(), QString(), 1, now);
+    index.insert(QStringLiteral("https://kde.org"), QString(), QString(), 3, now);
+    index.insert(QStringLiteral("http://kde.org/"), QString(), QString(), 2, now);
+    QCOMPARE(index.count(), 3);
+
+    // one entry, shown with its most visited url
+    QCOMPARE(index.topMatches(QStringLiteral("kd"), 10), QStringList() << QStringLiteral("https://kde.org"));
+    QCOMPARE(index.topMatches(QStringLiteral("http://www.kd"), 10), QStringList() << QStringLiteral("https://kde.org"));
+
+    // typing the scheme doesn't match everything with that scheme
+    QVERIFY(index.topMatches(QStringLiteral("http://"), 10).isEmpty());
+    QVERIFY(index.topMatches(QStringLiteral("h"), 10).isEmpty());
+}
+
+void KonqCompletionIndexTest::testRanking()
+{
+    const QDateTime now = QDateTime::currentDateTime();
+    KonqCompletionIndex index;
+    index.insert(QStringLiteral("http://a.org/often"), QString(), QString(), 20, now);
+    index.insert(QStringLiteral("http://a.org/once"), QString(), QString(), 1, now);
+    index.insert(QStringLiteral("http://a.org/long-ago"), QString(), QString(), 10, now.addDays(-365));
+    index.insert(QStringLiteral("http://a.org/typed"), QString(), QStringLiteral("a.org/typed"), 2, now);
+
+    QCOMPARE(index.topMatches(QStringLiteral("a.org"), 10), QStringList()
+             << QStringLiteral("http://a.org/often")
+             << QStringLiteral("http://a.org/typed")
+             << QStringLiteral("http://a.org/once")
+             << QStringLiteral("http://a.org/long-ago"));
+    QCOMPARE(index.topMatches(QStringLiteral("a.org"), 2), QStringList()
+             << QStringLiteral("http://a.org/often")
+             << QStringLiteral("http://a.org/typed"));
+
+    // a new visit updates the entry
+    index.insert(QStringLiteral("http://a.org/once"), QString(), QString(), 50, now);
+    QCOMPARE(index.topMatches(QStringLiteral("a.org"), 1), QStringList() << QStringLiteral("http://a.org/once"));
+}
+
+void KonqCompletionIndexTest::testTitleAndTypedUrl()
+{
+    const QDateTime now = QDateTime::currentDateTime();
+    KonqCompletionIndex index;
+    index.insert(QStringLiteral("http://example.com/x"), QStringLiteral("The Konqueror Handbook"), QStringLiteral("handbook"), 1, now);
+
+    const QStringList expected = QStringList() << QStringLiteral("http://example.com/x");
+    QCOMPARE(index.topMatches(QStringLiteral("konq"), 10), expected);
+    QCOMPARE(index.topMatches(QStringLiteral("Hand"), 10), expected);
+    QCOMPARE(index.topMatches(QStringLiteral("exa"), 10), expected);
+    QVERIFY(index.topMatches(QStringLiteral("queror"), 10).isEmpty());
+}
+
+void KonqCompletionIndexTest::testRemove()
+{
+    const QDateTime now = QDateTime::currentDateTime();
+    KonqCompletionIndex index;
+    index.insert(QStringLiteral("http://kde.org"), QString(), QString(), 2, now);
+    index.insert(QStringLiteral("https://kde.org/"), QString(), QString(), 5, now);
+    index.insert(QStringLiteral("http://kde.org/foo"), QString(), QString(), 1, now);
+
+    index.remove(QStringLiteral("https://kde.org/"));
+    QCOMPARE(index.topMatches(QStringLiteral("kde.org"), 10), QStringList()
+             << QStringLiteral("http://kde.org") << QStringLiteral("http://kde.org/foo"));
+    index.remove(QStringLiteral("http://kde.org"));
+    QCOMPARE(index.topMatches(QStringLiteral("kde.org"), 10), QStringList() << QStringLiteral("http://kde.org/foo"));
+    QVERIFY(!index.contains(QStringLiteral("http://kde.org")));
+
+    index.clear();
+    QVERIFY(index.topMatches(QStringLiteral("kde"), 10).isEmpty());
+}
+
+static void fillIndex(KonqCompletionIndex *index, int count)
+{
+    const QDateTime now = QDateTime::currentDateTime();
+    for (int i = 0; i < count; ++i) {
+        index->insert(QStringLiteral("http://host%1.org/page%2").arg(i % 1000).arg(i),
+                      QStringLiteral("Page number %1").arg(i), QString(), 1 + i % 7, now.addSecs(-i));
+    }
+}
+
+void KonqCompletionIndexTest::testManyEntries()
+{
+    // enough to go through the sorted keys, not only the new ones
+    KonqCompletionIndex index;
+    fillIndex(&index, 20000);
+    QCOMPARE(index.count(), 20000);
+
+    // 20 pages per host, the ones visited 7 times first, the most recent first
+    const QStringList matches = index.topMatches(QStringLiteral("host42.org"), 3);
+    QCOMPARE(matches, QStringList()
+             << QStringLiteral("http://host42.org/page1042")
+             << QStringLiteral("http://host42.org/page8042")
+             << QStringLiteral("http://host42.org/page15042"));
+
+    for (int i = 0; i < 20000; i += 2) {
+        index.remove(QStringLiteral("http://host%1.org/page%2").arg(i % 1000).arg(i));
+    }
+    QCOMPARE(index.count(), 10000);
+    QCOMPARE(index.topMatches(QStringLiteral("host42.org"), 100).count(), 0);
+    QCOMPARE(index.topMatches(QStringLiteral("host43.org"), 100).count(), 20);
+    QCOMPARE(index.topMatches(QStringLiteral("number 1"), 5).count(), 0); // words, not titles
+    QCOMPARE(index.topMatches(QStringLiteral("page1234"), 5), QStringList());
+    QCOMPARE(index.topMatches(QStringLiteral("host235.org/page1235"), 5), QStringList() << QStringLiteral("http://host235.org/page1235"));
+}
+
+void KonqCompletionIndexTest::testUpdates()
+{
+    const QDateTime now = QDateTime::currentDateTime();
+    KonqCompletionIndex index;
+    fillIndex(&index, 20000);
+    QCOMPARE(index.topMatches(QStringLiteral("host42.org"), 1), QStringList() << QStringLiteral("http://host42.org/page1042"));
+
+    // only the nodes above the removed keys change
+    index.remove(QStringLiteral("http://host42.org/page1042"));
+    QCOMPARE(index.topMatches(QStringLiteral("host42.org"), 2), QStringList()
+             << QStringLiteral("http://host42.org/page8042")
+             << QStringLiteral("http://host42.org/page15042"));
+
+    // a new visit takes the keys of the entry out of the tree
+    index.insert(QStringLiteral("http://host42.org/page19042"), QStringLiteral("Page number 19042"), QString(), 100, now);
+    QCOMPARE(index.topMatches(QStringLiteral("host42.org"), 2), QStringList()
+             << QStringLiteral("http://host42.org/page19042")
+             << QStringLiteral("http://host42.org/page8042"));
+    QCOMPARE(index.topMatches(QStringLiteral("host42.org"), 100).count(), 19);
+    QCOMPARE(index.count(), 19999);
+}
+
+void KonqCompletionIndexTest::testBookmarks()
+{
+    const QDateTime now = QDateTime::currentDateTime();
+    const QString kde = QStringLiteral("http://kde.org/");
+    KonqCompletionIndex index;
+    index.insertBookmark(kde, QStringLiteral("Community Home"));
+    index.insert(kde, QStringLiteral("KDE"), QString(), 3, now);
+    QCOMPARE(index.count(), 1);
+    QCOMPARE(index.topMatches(QStringLiteral("commun"), 10), QStringList() << kde);
+
+    // removing the history entry keeps the bookmark
+    index.remove(kde);
+    QVERIFY(!index.contains(kde));
+    QCOMPARE(index.count(), 0);
+    QCOMPARE(index.topMatches(QStringLiteral("kde"), 10), QStringList() << kde);
+    QCOMPARE(index.topMatches(QStringLiteral("commun"), 10), QStringList() << kde);
+
+    // without visits, bookmarks come after the history
+    index.insert(QStringLiteral("http://kde.org/apps"), QString(), QString(), 1, now);
+    QCOMPARE(index.topMatches(QStringLiteral("kde"), 10), QStringList() << QStringLiteral("http://kde.org/apps") << kde);
+
+    index.clearHistory();
+    QCOMPARE(index.count(), 0);
+    QCOMPARE(index.topMatches(QStringLiteral("kde"), 10), QStringList() << kde);
+
+    index.clear();
+    QVERIFY(index.topMatches(QStringLiteral("kde"), 10).isEmpty());
+}
+
+void KonqCompletionIndexTest::benchmarkTopMatches()
+{
+    KonqCompletionIndex index;
+    fillIndex(&index, 100000);
+    index.topMatches(QStringLiteral("h"), 10);
+    QBENCHMARK {
+        index.topMatches(QStringLiteral("host1"), 20);
+    }
+}
+
+#include "konqcompletionindextest.moc"
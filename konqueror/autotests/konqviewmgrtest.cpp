@@ -820,6 +820,87 @@ void ViewMgrTest::testSaveProfile()
     QFile::remove(filePath);
 }
 
+void ViewMgrTest::testRestoreTabsOnDemand()
+{
+    MyKonqMainWindow mainWindow;
+    const QUrl url(QStringLiteral("data:text/html, <p>Hello World</p>"));
+    mainWindow.openUrl(0, url, QStringLiteral("text/html"));
+    KonqViewManager *viewManager = mainWindow.viewManager();
+    KonqView *view2 = viewManager->addTab(QStringLiteral("text/html"));
+    const QUrl url2(QStringLiteral("data:text/html, <title>view2</title>"));
+    view2->openUrl(url2, QStringLiteral("2"));
+    QSignalSpy spyCompleted(view2, SIGNAL(viewCompleted(KonqView*)));
+    QVERIFY(spyCompleted.wait(10000));
+    QCOMPARE(viewManager->tabContainer()->currentIndex(), 0);
+
+    KConfig cfg(QString(), KConfig::SimpleConfig);
+    KConfigGroup profileGroup(&cfg, "Window0");
+    viewManager->saveViewConfigToGroup(profileGroup, KonqFrameBase::saveHistoryItems);
+
+    // Only the current tab gets a view, the other one keeps its title
+    QScopedPointer<KonqMainWindow> restored(KonqViewManager::openSavedWindow(profileGroup));
+    KonqFrameTabs *tabs = restored->viewManager()->tabContainer();
+    QCOMPARE(DebugFrameVisitor::inspect(restored.data()), QString("MT[F]."));
+    QCOMPARE(tabs->count(), 2);
+    KonqPendingTab *pendingTab = dynamic_cast<KonqPendingTab *>(tabs->tabAt(1));
+    QVERIFY(pendingTab);
+    QCOMPARE(pendingTab->url(), url2);
+    QCOMPARE(tabs->tabText(1), QString("view2"));
+
+    // Saving again doesn't need the view
+    KConfigGroup savedGroup(&cfg, "Window1");
+    restored->viewManager()->saveViewConfigToGroup(savedGroup, KonqFrameBase::saveHistoryItems);
+    QCOMPARE(savedGroup.readEntry("HistoryItemViewT1_0Url"), url2.url());
+    QCOMPARE(savedGroup.readEntry("HistoryItemViewT1_0Title"), QString("view2"));
+    QCOMPARE(DebugFrameVisitor::inspect(restored.data()), QString("MT[F]."));
+
+    // Activating the tab creates the view
+    QPointer<KonqPendingTab> pendingTabPointer(pendingTab);
+    tabs->setCurrentIndex(1);
+    QTRY_VERIFY(pendingTabPointer.isNull());
+    QCOMPARE(DebugFrameVisitor::inspect(restored.data()), QString("MT[FF]."));
+    QCOMPARE(tabs->currentIndex(), 1);
+    QCOMPARE(restored->currentView()->url(), url2);
+}
+
+void ViewMgrTest::testSaveChangedProperties()
+{
+    MyKonqMainWindow mainWindow;
+    KonqViewManager *viewManager = mainWindow.viewManager();
+    KonqView *view = viewManager->createFirstView(QStringLiteral("text/html"), QString());
+    QSignalSpy spyCompleted(view, SIGNAL(viewCompleted(KonqView*)));
+    const QUrl url(QStringLiteral("data:text/html, <title>view1</title>"));
+    view->openUrl(url, QStringLiteral("1"));
+    QVERIFY(spyCompleted.wait(10000));
+
+    KConfig cfg(QString(), KConfig::SimpleConfig);
+    KConfigGroup profileGroup(&cfg, "Window0");
+    mainWindow.saveChangedProperties(profileGroup);
+    QCOMPARE(profileGroup.readEntry("HistoryItemViewT0_0Url"), url.url());
+    const QByteArray state = KonqSessionStateCollector::collect(&mainWindow);
+
+    // Saving an unchanged window again doesn't change anything
+    mainWindow.saveChangedProperties(profileGroup);
+    QCOMPARE(KonqSessionStateCollector::collect(&mainWindow), state);
+
+    // Saving it completely asks the part again, which is a change too
+    mainWindow.saveProperties(profileGroup);
+    const QByteArray savedState = KonqSessionStateCollector::collect(&mainWindow);
+    QVERIFY(savedState != state);
+    mainWindow.saveChangedProperties(profileGroup);
+    QCOMPARE(KonqSessionStateCollector::collect(&mainWindow), savedState);
+
+    // A new tab changes the state, and so does a change in a view
+    KonqView *view2 = viewManager->addTab(QStringLiteral("text/html"));
+    const QByteArray tabState = KonqSessionStateCollector::collect(&mainWindow);
+    QVERIFY(tabState != savedState);
+    view2->setLockedLocation(true);
+    QVERIFY(KonqSessionStateCollector::collect(&mainWindow) != tabState);
+    mainWindow.saveChangedProperties(profileGroup);
+    QCOMPARE(profileGroup.readEntry("Tabs0_Children"), QString("ViewT0,ViewT1"));
+    QVERIFY(profileGroup.readEntry("ViewT1_LockedLocation", false));
+}
+
 void ViewMgrTest::testDuplicateWindow()
 {
     MyKonqMainWindow mainWindow;
@@ -48,6 +48,8 @@ private Q_SLOTS:
     void testDuplicateSplittedTab();
     void testDeletePartInTab();
     void testSaveProfile();
+    void testRestoreTabsOnDemand();
+    void testSaveChangedProperties();
 
     void testDuplicateWindow();
 
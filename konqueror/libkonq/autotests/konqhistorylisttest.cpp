@@ -0,0 +1,159 @@
+/* This file is part of KDE
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public License
+    along with this library; see the file COPYING.LIB.  If not, write to
+    the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+    Boston, MA 02110-1301, USA.
+*/
+
+#include <QTest>
+#include <QObject>
+
+#include <algorithm>
+
+#include <konq_historyentry.h>
+
+class KonqHistoryListTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testFindEntry();
+    void testRemoveFirst();
+    void testRemoveInTheMiddle();
+    void testSort();
+    void benchmarkFindEntry_data();
+    void benchmarkFindEntry();
+};
+
+QTEST_GUILESS_MAIN(KonqHistoryListTest)
+
+static QUrl urlFor(int i)
+{
+    return QUrl(QStringLiteral("http://www.example.org/page%1.html").arg(i));
+}
+
+static KonqHistoryList makeList(int count)
+{
+    KonqHistoryList list;
+    for (int i = 0; i < count; ++i) {
+        KonqHistoryEntry entry;
+        entry.url = urlFor(i);
+        entry.lastVisited = QDateTime(QDate(2000, 1, 1)).addSecs(i);
+        list.append(entry);
+    }
+    return list;
+}
+
+static bool lastVisitedOrder(const KonqHistoryEntry &lhs, const KonqHistoryEntry &rhs)
+{
+    return lhs.lastVisited < rhs.lastVisited;
+}
+
+void KonqHistoryListTest::testFindEntry()
+{
+    KonqHistoryList list = makeList(10);
+    for (int i = 0; i < 10; ++i) {
+        KonqHistoryList::iterator it = list.findEntry(urlFor(i));
+        QVERIFY(it != list.end());
+        QCOMPARE((*it).url, urlFor(i));
+    }
+    QVERIFY(list.findEntry(urlFor(10)) == list.end());
+
+    // Inserting moves the entries after it
+    KonqHistoryEntry entry;
+    entry.url = urlFor(10);
+    list.insert(list.begin() + 2, entry);
+    QCOMPARE(list.findEntry(urlFor(10)) - list.begin(), 2);
+    QCOMPARE(list.findEntry(urlFor(2)) - list.begin(), 3);
+    QCOMPARE(list.findEntry(urlFor(9)) - list.begin(), 10);
+    entry.url = urlFor(11);
+    list.insert(list.end(), entry);
+    QCOMPARE(list.findEntry(urlFor(11)) - list.begin(), 11);
+
+    list.clear();
+    QVERIFY(list.findEntry(urlFor(0)) == list.end());
+}
+
+void KonqHistoryListTest::testRemoveFirst()
+{
+    KonqHistoryList list = makeList(10);
+    QVERIFY(list.findEntry(urlFor(0)) != list.end());
+    // the way KonqHistoryProvider trims the history
+    for (int i = 0; i < 5; ++i) {
+        list.erase(list.begin());
+    }
+    list.removeFirst();
+    QCOMPARE(list.count(), 4);
+    for (int i = 0; i < 6; ++i) {
+        QVERIFY(list.findEntry(urlFor(i)) == list.end());
+    }
+    for (int i = 6; i < 10; ++i) {
+        QCOMPARE((*list.findEntry(urlFor(i))).url, urlFor(i));
+    }
+
+    KonqHistoryEntry entry;
+    entry.url = urlFor(42);
+    list.append(entry);
+    QCOMPARE(list.findEntry(urlFor(42)) - list.begin(), 4);
+}
+
+void KonqHistoryListTest::testRemoveInTheMiddle()
+{
+    KonqHistoryList list = makeList(10);
+    list.removeEntry(urlFor(5));
+    list.removeEntry(urlFor(9));
+    QCOMPARE(list.count(), 8);
+    QVERIFY(list.findEntry(urlFor(5)) == list.end());
+    QVERIFY(list.findEntry(urlFor(9)) == list.end());
+    QCOMPARE((*list.findEntry(urlFor(6))).url, urlFor(6));
+    QCOMPARE((*list.findEntry(urlFor(8))).url, urlFor(8));
+}
+
+void KonqHistoryListTest::testSort()
+{
+    KonqHistoryList list = makeList(10);
+    QVERIFY(list.findEntry(urlFor(3)) != list.end());
+    std::reverse(list.begin(), list.end());
+    QCOMPARE(list.findEntry(urlFor(3)) - list.begin(), 6);
+    qSort(list.begin(), list.end(), lastVisitedOrder);
+    QCOMPARE(list.findEntry(urlFor(3)) - list.begin(), 3);
+}
+
+void KonqHistoryListTest::benchmarkFindEntry_data()
+{
+    QTest::addColumn<int>("count");
+    QTest::newRow("1000") << 1000;
+    QTest::newRow("10000") << 10000;
+    QTest::newRow("100000") << 100000;
+}
+
+// The time per iteration should not depend on the size of the history
+void KonqHistoryListTest::benchmarkFindEntry()
+{
+    QFETCH(int, count);
+    KonqHistoryList list = makeList(count);
+    QList<QUrl> urls;
+    for (int i = 0; i < 100; ++i) {
+        urls.append(urlFor(i * (count / 100)));
+    }
+    list.findEntry(urls.first()); // build the index
+
+    QBENCHMARK {
+        foreach (const QUrl &url, urls) {
+            QVERIFY(list.findEntry(url) != list.end());
+        }
+    }
+}
+
+#include "konqhistorylisttest.moc"
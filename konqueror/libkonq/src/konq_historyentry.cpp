@@ -89,30 +89,55 @@ void KonqHistoryEntry::save(QDataStream &s, Flags flags) const
 
 ////
 
-KonqHistoryList::iterator KonqHistoryList::findEntry(const QUrl &url)
+KonqHistoryList::KonqHistoryList()
+    : m_removedFront(0), m_indexedCount(-1)
 {
-    // we search backwards, probably faster to find an entry
-    KonqHistoryList::iterator it = end();
-    while (it != begin()) {
-        --it;
-        if ((*it).url == url) {
-            return it;
-        }
+}
+
+void KonqHistoryList::rebuildIndex() const
+{
+    m_index.clear();
+    m_index.reserve(count());
+    // later entries win, like the backwards search did
+    for (int i = 0; i < count(); ++i) {
+        m_index.insert(at(i).url, i);
     }
-    return end();
+    m_removedFront = 0;
+    m_indexedCount = count();
 }
 
-KonqHistoryList::const_iterator KonqHistoryList::constFindEntry(const QUrl &url) const
+int KonqHistoryList::indexOf(const QUrl &url) const
 {
-    // we search backwards, probably faster to find an entry
-    KonqHistoryList::const_iterator it = constEnd();
-    while (it != constBegin()) {
-        --it;
-        if ((*it).url == url) {
-            return it;
+    // Entries added or removed behind our back?
+    if (m_indexedCount != count()) {
+        rebuildIndex();
+    }
+
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        QHash<QUrl, int>::const_iterator it = m_index.constFind(url);
+        if (it == m_index.constEnd()) {
+            return -1;
         }
+        const int pos = it.value() - m_removedFront;
+        if (pos >= 0 && pos < count() && at(pos).url == url) {
+            return pos;
+        }
+        // the entries were reordered
+        rebuildIndex();
     }
-    return constEnd();
+    return -1;
+}
+
+KonqHistoryList::iterator KonqHistoryList::findEntry(const QUrl &url)
+{
+    const int pos = indexOf(url);
+    return pos == -1 ? end() : begin() + pos;
+}
+
+KonqHistoryList::const_iterator KonqHistoryList::constFindEntry(const QUrl &url) const
+{
+    const int pos = indexOf(url);
+    return pos == -1 ? constEnd() : constBegin() + pos;
 }
 
 void KonqHistoryList::removeEntry(const QUrl &url)
@@ -123,3 +148,62 @@ void KonqHistoryList::removeEntry(const QUrl &url)
     }
 }
 
+void KonqHistoryList::append(const KonqHistoryEntry &entry)
+{
+    const bool indexed = m_indexedCount == count();
+    QList<KonqHistoryEntry>::append(entry);
+    if (indexed) {
+        m_index.insert(entry.url, count() - 1 + m_removedFront);
+        m_indexedCount = count();
+    }
+}
+
+KonqHistoryList::iterator KonqHistoryList::insert(iterator before, const KonqHistoryEntry &entry)
+{
+    if (before == end()) {
+        append(entry);
+        return end() - 1;
+    }
+    // The entries after it move, rebuild lazily
+    m_indexedCount = -1;
+    return QList<KonqHistoryEntry>::insert(before, entry);
+}
+
+KonqHistoryList::iterator KonqHistoryList::erase(iterator it)
+{
+    const int pos = it - begin();
+    if (m_indexedCount == count()) {
+        QHash<QUrl, int>::iterator indexIt = m_index.find((*it).url);
+        if (indexIt != m_index.end() && indexIt.value() - m_removedFront == pos) {
+            m_index.erase(indexIt);
+        }
+        if (pos == 0) {
+            ++m_removedFront;
+            m_indexedCount = count() - 1;
+        } else if (pos == count() - 1) {
+            m_indexedCount = count() - 1;
+        } else {
+            // The entries after it move, rebuild lazily
+            m_indexedCount = -1;
+        }
+    }
+    return QList<KonqHistoryEntry>::erase(it);
+}
+
+void KonqHistoryList::removeFirst()
+{
+    erase(begin());
+}
+
+void KonqHistoryList::clear()
+{
+    QList<KonqHistoryEntry>::clear();
+    m_index.clear();
+    m_removedFront = 0;
+    m_indexedCount = 0;
+}
+
+void KonqHistoryList::invalidateIndex()
+{
+    m_indexedCount = -1;
+}
@@ -22,6 +22,7 @@
 #define KONQ_HISTORYENTRY_H
 
 #include <QDateTime>
+#include <QHash>
 #include <QMetaType>
 #include <QUrl>
 #include "libkonq_export.h"
@@ -60,9 +61,37 @@ KDE_DUMMY_QHASH_FUNCTION(KonqHistoryEntry)
 
 Q_DECLARE_METATYPE(KonqHistoryEntry)
 
-class LIBKONQ_EXPORT KonqHistoryList : public QList<KonqHistoryEntry>
+/**
+ * The list of history entries.
+ *
+ * Lookups by URL go through a hash index from URL to position. The index
+ * is kept up to date by append(), insert(), erase(), removeFirst(),
+ * removeEntry() and clear(), the only ways to add and remove entries:
+ * the other QList mutators are not available. Reordering the entries,
+ * e.g. sorting them, is fine. Changing the url of an entry in place
+ * requires a call to invalidateIndex().
+ */
+class LIBKONQ_EXPORT KonqHistoryList : private QList<KonqHistoryEntry>
 {
 public:
+    KonqHistoryList();
+
+    using QList<KonqHistoryEntry>::iterator;
+    using QList<KonqHistoryEntry>::const_iterator;
+    using QList<KonqHistoryEntry>::value_type;
+    using QList<KonqHistoryEntry>::begin;
+    using QList<KonqHistoryEntry>::end;
+    using QList<KonqHistoryEntry>::constBegin;
+    using QList<KonqHistoryEntry>::constEnd;
+    using QList<KonqHistoryEntry>::count;
+    using QList<KonqHistoryEntry>::size;
+    using QList<KonqHistoryEntry>::isEmpty;
+    using QList<KonqHistoryEntry>::at;
+    using QList<KonqHistoryEntry>::operator[];
+    using QList<KonqHistoryEntry>::first;
+    using QList<KonqHistoryEntry>::last;
+    using QList<KonqHistoryEntry>::reserve;
+
     /**
      * Finds an entry by URL and return an iterator to it.
      * If no matching entry is found, end() is returned.
@@ -79,6 +108,47 @@ public:
      * Finds an entry by URL and removes it
      */
     void removeEntry(const QUrl &url);
+
+    /**
+     * Appends an entry, and adds it to the index
+     */
+    void append(const KonqHistoryEntry &entry);
+
+    /**
+     * Inserts an entry before @p before. The positions of the entries
+     * after it change, so the index is rebuilt on the next lookup,
+     * unless @p before is end().
+     */
+    iterator insert(iterator before, const KonqHistoryEntry &entry);
+
+    /**
+     * Removes the entry at @p it, and removes it from the index
+     */
+    iterator erase(iterator it);
+
+    /**
+     * Removes the oldest entry. This doesn't need to touch
+     * the positions of the other entries in the index.
+     */
+    void removeFirst();
+
+    void clear();
+
+    /**
+     * Forces a rebuild of the index on the next lookup
+     */
+    void invalidateIndex();
+
+private:
+    int indexOf(const QUrl &url) const;
+    void rebuildIndex() const;
+
+    // url -> position in the list + m_removedFront
+    mutable QHash<QUrl, int> m_index;
+    // entries removed from the front since the index was built
+    mutable int m_removedFront;
+    // the number of entries m_index was built for, -1 if it's invalid
+    mutable int m_indexedCount;
 };
 
 #endif /* KONQ_HISTORYENTRY_H */
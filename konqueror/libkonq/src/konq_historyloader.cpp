@@ -24,20 +24,36 @@
 #include <QDebug>
 #include <QDataStream>
 #include <QFile>
+#include <QFileInfo>
+#include <QHash>
 #include <QStandardPaths>
+#include <QVector>
+#include <QtEndian>
+
+#include <algorithm>
 
 #include <zlib.h> // for crc32
 
 class KonqHistoryLoaderPrivate
 {
 public:
+    KonqHistoryLoaderPrivate()
+        : m_journalCorrupted(false), m_journalSize(0)
+    {
+    }
+
+    bool loadSnapshot(bool *missing);
+    bool replayJournal();
+
     KonqHistoryList m_history;
+    bool m_journalCorrupted;
+    qint64 m_journalSize;
+    QDateTime m_expiration;
 };
 
 KonqHistoryLoader::KonqHistoryLoader(QObject *parent)
     : QObject(parent), d(new KonqHistoryLoaderPrivate)
 {
-    loadHistory();
 }
 
 KonqHistoryLoader::~KonqHistoryLoader()
@@ -57,84 +73,207 @@ static bool lastVisitedOrder(const KonqHistoryEntry &lhs, const KonqHistoryEntry
 bool KonqHistoryLoader::loadHistory()
 {
     d->m_history.clear();
+    d->m_journalCorrupted = false;
+    d->m_journalSize = 0;
+
+    bool snapshotMissing = false;
+    if (!d->loadSnapshot(&snapshotMissing)) {
+        d->m_history.clear();
+        // A broken history file makes the journal meaningless, but when there
+        // is no history file yet, the journal may still hold the first entries.
+        if (!snapshotMissing || QFileInfo(journalFileName()).size() == 0) {
+            return false;
+        }
+    }
+
+    d->replayJournal();
 
-    const QString filename = QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation) + QLatin1String("/konqueror/konq_history");
+    //kDebug(1202) << "loaded:" << d->m_history.count() << "entries.";
+
+    // The history file is written sorted, only entries changed
+    // by the journal can be out of place
+    if (!std::is_sorted(d->m_history.constBegin(), d->m_history.constEnd(), lastVisitedOrder)) {
+        std::stable_sort(d->m_history.begin(), d->m_history.end(), lastVisitedOrder);
+    }
+
+    // Theoretically, we should emit update() here, but as we only ever
+    // load items on startup up to now, this doesn't make much sense.
+    // emit KParts::HistoryProvider::update(some list);
+    return true;
+}
+
+void KonqHistoryLoader::setExpirationDate(const QDateTime &date)
+{
+    d->m_expiration = date;
+}
+
+bool KonqHistoryLoaderPrivate::loadSnapshot(bool *missing)
+{
+    const QString filename = KonqHistoryLoader::historyFileName();
     QFile file(filename);
+    *missing = !file.exists();
     if (!file.open(QIODevice::ReadOnly)) {
-        if (file.exists()) {
+        if (!*missing) {
             qWarning() << "Can't open" << filename;
         }
         return false;
     }
 
-    QDataStream fileStream(&file);
-    QByteArray data; // only used for version == 2
-    // we construct the stream object now but fill in the data later.
-    QDataStream crcStream(&data, QIODevice::ReadOnly);
-    KonqHistoryEntry::Flags flags = KonqHistoryEntry::NoFlags;
+    const qint64 size = file.size();
+    if (size == 0) {
+        // empty history
+        return true;
+    }
 
-    if (!fileStream.atEnd()) {
-        quint32 version;
-        fileStream >> version;
+    // Map the file, so that decoding doesn't need a private copy of it
+    // and the pages are shared with the other processes reading it
+    QByteArray snapshot;
+    const uchar *map = file.map(0, size);
+    if (map) {
+        snapshot = QByteArray::fromRawData(reinterpret_cast<const char *>(map), size);
+    } else {
+        snapshot = file.readAll();
+    }
 
-        QDataStream *stream = &fileStream;
+    // version, crc32 of the entries, and the entries as a QByteArray:
+    // its length, then the data
+    const uchar *data = reinterpret_cast<const uchar *>(snapshot.constData());
+    const quint32 version = snapshot.size() >= 4 ? qFromBigEndian<quint32>(data) : 0;
 
-        bool crcChecked = false;
-        bool crcOk = false;
+    // We can't read v3 history anymore, because operator<<(KURL) disappeared.
 
-        if (version >= 2 && version <= 4) {
-            quint32 crc;
-            crcChecked = true;
-            fileStream >> crc >> data;
-            crcOk = crc32(0, reinterpret_cast<unsigned char *>(data.data()), data.size()) == crc;
-            stream = &crcStream; // pick up the right stream
-        }
+    if (KonqHistoryLoader::historyVersion() != int(version) || snapshot.size() < 12) {
+        qWarning() << "The history version doesn't match, aborting loading";
+        return false;
+    }
 
-        // We can't read v3 history anymore, because operator<<(KURL) disappeared.
+    const quint32 crc = qFromBigEndian<quint32>(data + 4);
+    const quint32 length = qFromBigEndian<quint32>(data + 8);
+    // 0xffffffff is a null QByteArray
+    const quint32 entriesSize = length == 0xffffffff ? 0 : length;
+    if (12 + qint64(entriesSize) > snapshot.size() || crc32(0, data + 12, entriesSize) != crc) {
+        qWarning() << "The history file" << filename << "is corrupted, aborting loading";
+        return false;
+    }
 
-        if (version == 4) {
-            // Use QUrl marshalling for V4 format.
-            flags = KonqHistoryEntry::NoFlags;
+    // Use QUrl marshalling for V4 format.
+    const QByteArray entries = QByteArray::fromRawData(reinterpret_cast<const char *>(data + 12), entriesSize);
+    QDataStream stream(entries);
+    while (!stream.atEnd()) {
+        KonqHistoryEntry entry;
+        entry.load(stream, KonqHistoryEntry::NoFlags);
+        // kDebug(1202) << "loaded entry:" << entry.url << ", Title:" << entry.title;
+        // Expired anyway, adjustSize() would remove it right away
+        if (m_expiration.isValid() && entry.lastVisited.isValid() && entry.lastVisited < m_expiration) {
+            continue;
         }
+        m_history.append(entry);
+    }
+    return true;
+}
 
-#if 0 // who cares for versions 1 and 2 nowadays...
-        if (version != 0 && version < 3) { //Versions 1,2 (but not 0) are also valid
-            //Turn on backwards compatibility mode..
-            marshalURLAsStrings = true;
-            // it doesn't make sense to save to save maxAge and maxCount  in the
-            // binary file, this would make backups impossible (they would clear
-            // themselves on startup, because all entries expire).
-            // [But V1 and V2 formats did it, so we do a dummy read]
-            quint32 dummy;
-            *stream >> dummy;
-            *stream >> dummy;
-
-            //OK.
-            version = 3;
+bool KonqHistoryLoader::readJournal(qint64 *offset, QList<JournalRecord> *records)
+{
+    QFile file(journalFileName());
+    if (!file.open(QIODevice::ReadOnly) || file.size() <= *offset) {
+        return true;
+    }
+
+    QDataStream stream(&file);
+    if (*offset == 0) {
+        quint32 version;
+        stream >> version;
+        if (stream.status() != QDataStream::Ok || int(version) != historyVersion()) {
+            qWarning() << "The history journal version doesn't match, ignoring it";
+            return false;
         }
-#endif
+        *offset = file.pos();
+    } else if (!file.seek(*offset)) {
+        return false;
+    }
 
-        if (historyVersion() != int(version) || (crcChecked && !crcOk)) {
-            qWarning() << "The history version doesn't match, aborting loading";
-            file.close();
+    while (!stream.atEnd()) {
+        quint32 crc;
+        QByteArray data;
+        stream >> crc >> data;
+        if (stream.status() != QDataStream::Ok ||
+                crc32(0, reinterpret_cast<const unsigned char *>(data.constData()), data.size()) != crc) {
+            // Most likely a record which was only partially written when
+            // the writer died. Everything before it is still fine.
+            qWarning() << "Dropping corrupted history journal records after offset" << *offset;
             return false;
         }
 
-        while (!stream->atEnd()) {
-            KonqHistoryEntry entry;
-            entry.load(*stream, flags);
-            // kDebug(1202) << "loaded entry:" << entry.url << ", Title:" << entry.title;
-            d->m_history.append(entry);
+        QDataStream recordStream(data);
+        quint8 type;
+        recordStream >> type;
+        JournalRecord record;
+        record.type = JournalRecordType(type);
+        if (type == JournalUpsert) {
+            record.entry.load(recordStream, KonqHistoryEntry::NoFlags);
+            records->append(record);
+        } else if (type == JournalRemove) {
+            recordStream >> record.entry.url;
+            records->append(record);
+        } else {
+            qWarning() << "Unknown history journal record type" << type;
         }
+        *offset = file.pos();
+    }
+    return true;
+}
 
-        //kDebug(1202) << "loaded:" << m_history.count() << "entries.";
+bool KonqHistoryLoaderPrivate::replayJournal()
+{
+    QList<KonqHistoryLoader::JournalRecord> records;
+    qint64 offset = 0;
+    m_journalCorrupted = !KonqHistoryLoader::readJournal(&offset, &records);
+    m_journalSize = offset;
+    if (records.isEmpty()) {
+        return !m_journalCorrupted && offset > 0;
+    }
 
-        qSort(d->m_history.begin(), d->m_history.end(), lastVisitedOrder);
+    // Index the entries by url, so that replaying doesn't need a linear
+    // search through the history for every record.
+    QHash<QUrl, int> index;
+    index.reserve(m_history.count());
+    for (int i = 0; i < m_history.count(); ++i) {
+        index.insert(m_history.at(i).url, i);
+    }
+    QVector<bool> removed(m_history.count(), false);
+    bool hasRemovals = false;
+
+    foreach (const KonqHistoryLoader::JournalRecord &record, records) {
+        if (record.type == KonqHistoryLoader::JournalUpsert) {
+            QHash<QUrl, int>::const_iterator it = index.constFind(record.entry.url);
+            if (it != index.constEnd()) {
+                m_history[it.value()] = record.entry;
+            } else {
+                index.insert(record.entry.url, m_history.count());
+                m_history.append(record.entry);
+                removed.append(false);
+            }
+        } else {
+            QHash<QUrl, int>::iterator it = index.find(record.entry.url);
+            if (it != index.end()) {
+                removed[it.value()] = true;
+                hasRemovals = true;
+                index.erase(it);
+            }
+        }
+    }
+
+    if (hasRemovals) {
+        KonqHistoryList history;
+        history.reserve(m_history.count());
+        for (int i = 0; i < m_history.count(); ++i) {
+            if (!removed.at(i)) {
+                history.append(m_history.at(i));
+            }
+        }
+        m_history = history;
     }
 
-    // Theoretically, we should emit update() here, but as we only ever
-    // load items on startup up to now, this doesn't make much sense.
-    // emit KParts::HistoryProvider::update(some list);
     return true;
 }
 
@@ -143,7 +282,27 @@ const KonqHistoryList &KonqHistoryLoader::entries() const
     return d->m_history;
 }
 
+bool KonqHistoryLoader::journalCorrupted() const
+{
+    return d->m_journalCorrupted;
+}
+
+qint64 KonqHistoryLoader::journalSize() const
+{
+    return d->m_journalSize;
+}
+
 int KonqHistoryLoader::historyVersion()
 {
     return 4;
 }
+
+QString KonqHistoryLoader::historyFileName()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation) + QLatin1String("/konqueror/konq_history");
+}
+
+QString KonqHistoryLoader::journalFileName()
+{
+    return historyFileName() + QLatin1String(".journal");
+}
@@ -22,9 +22,10 @@
 #define KONQ_HISTORYLOADER_H
 
 #include "libkonq_export.h"
+#include "konq_historyentry.h"
+#include <QDateTime>
 #include <QObject>
 
-class KonqHistoryList;
 class KonqHistoryLoaderPrivate;
 
 /**
@@ -42,17 +43,77 @@ public:
 
     /**
      * Load the history. No need to call this more than once...
+     *
+     * The history file is mapped, and its entries are decoded straight
+     * from the map; the records of the history journal are replayed on
+     * top of them. A corrupted or truncated record at the end of the
+     * journal stops the replay, all records before it are kept.
      */
     bool loadHistory();
 
+    /**
+     * Entries last visited before @p date are dropped while loading.
+     * Call this before loadHistory().
+     */
+    void setExpirationDate(const QDateTime &date);
+
     /**
      * @returns the list of all history entries, sorted by date
      * (oldest entries first)
      */
     const KonqHistoryList &entries() const;
 
+    /**
+     * @returns true if the journal had a corrupted tail which was dropped
+     * while loading. The caller should compact the history, so that
+     * new records don't get appended after the garbage.
+     */
+    bool journalCorrupted() const;
+
+    /**
+     * @returns the offset up to which the journal was read while loading,
+     * to be passed to readJournal() for the records appended later
+     */
+    qint64 journalSize() const;
+
     static int historyVersion();
 
+    /**
+     * The type of a record in the history journal
+     */
+    enum JournalRecordType {
+        JournalUpsert = 1, ///< followed by a KonqHistoryEntry, added or replacing the entry for its url
+        JournalRemove = 2  ///< followed by the QUrl of the entry to remove
+    };
+
+    /**
+     * A record of the history journal. For JournalRemove,
+     * only the url of @p entry is set.
+     */
+    struct JournalRecord {
+        JournalRecordType type;
+        KonqHistoryEntry entry;
+    };
+
+    /**
+     * Reads the records of the history journal which start at @p offset,
+     * 0 or the end of a record read before, and sets @p offset to the end
+     * of the last record read.
+     * @returns false if the journal has the wrong version or a corrupted record
+     */
+    static bool readJournal(qint64 *offset, QList<JournalRecord> *records);
+
+    /**
+     * @returns the full path of the compacted history file
+     */
+    static QString historyFileName();
+
+    /**
+     * @returns the full path of the history journal, which holds the changes
+     * made since the history file was last written out entirely.
+     */
+    static QString journalFileName();
+
 private:
     KonqHistoryLoaderPrivate *const d;
 };
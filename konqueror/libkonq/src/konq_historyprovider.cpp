@@ -27,8 +27,13 @@
 #include <KSharedConfig>
 
 #include <QtDBus>
+#include <QFileInfo>
 #include <QSaveFile>
+#include <QSet>
 #include <QStandardPaths>
+#include <QTimer>
+
+#include <algorithm>
 
 #include <zlib.h> // for crc32
 
@@ -46,10 +51,60 @@ public:
     void adjustSize();
 
     /**
-     * Saves the entire history.
+     * Saves the entire history and discards the journal.
      */
     bool saveHistory();
 
+    /**
+     * Saves new or updated entries. In journal mode, this only appends
+     * records to the journal, otherwise the entire history is saved.
+     */
+    bool saveEntries(const QList<KonqHistoryEntry> &entries);
+
+    /**
+     * Saves the removal of the entries for @p urls, like saveEntries().
+     */
+    bool saveRemovedEntries(const QList<QUrl> &urls);
+
+    /**
+     * Appends @p records to the journal, and compacts the history
+     * once the journal grew past s_journalCompactionThreshold.
+     */
+    bool appendToJournal(const QList<QByteArray> &records);
+
+    /**
+     * Merges an entry broadcast by some instance into the history.
+     * Doesn't notify anybody.
+     */
+    void applyEntry(const KonqHistoryEntry &e);
+
+    /**
+     * Notifies about the entries for @p urls after they were added
+     * or changed, and saves them if we are the sender.
+     */
+    void finishAddingEntries(const QList<QUrl> &urls, bool isSender);
+
+    /**
+     * @returns the entries queued for the next broadcast as one message,
+     * and empties the queue.
+     */
+    QByteArray takeOutgoingEntries();
+
+    /**
+     * Broadcasts the queued entries, and returns them as sent.
+     */
+    QByteArray broadcastOutgoingEntries();
+
+    /**
+     * Brings the history up to date with the disk after broadcasts of
+     * another instance were missed: re-reads the journal records appended
+     * since we last looked, or the whole history if it was compacted since.
+     * Entries only replace ours if they were visited later.
+     * @returns the urls of the entries replaced or added
+     */
+    QSet<QUrl> recoverFromDisk();
+    bool mergeFromDisk(const KonqHistoryEntry &entry);
+
 Q_SIGNALS: // DBUS methods/signals,  they have to match org.kde.Konqueror.HistoryManager.xml
     friend class KonqHistoryProvider;
     /**
@@ -57,12 +112,25 @@ Q_SIGNALS: // DBUS methods/signals,  they have to match org.kde.Konqueror.Histor
      * konqueror instances. Those add the entry to their list, but don't
      * save the list, because the sender saves the list.
      *
+     * Only sent for older versions now, along with a notifyHistoryEntries()
+     * holding just this entry. Entries broadcast together don't reach them.
+     *
      * @param e the new history entry
      * @param saveId is the dbus service of the sender so that
      * only the sender saves the new history.
      */
     void notifyHistoryEntry(const QByteArray &historyEntry);
 
+    /**
+     * Every konqueror instance collects its new history entries for a
+     * little while, and broadcasts them together. The sender saves them
+     * once it receives its own broadcast.
+     *
+     * @param historyEntries the sequence number of the broadcast, counting
+     * up from 1 for every sender, and the list of serialized entries
+     */
+    void notifyHistoryEntries(const QByteArray &historyEntries);
+
     /**
      * Called when the configuration of the maximum count changed.
      * Called via DBUS by some config-module
@@ -94,12 +162,19 @@ Q_SIGNALS: // DBUS methods/signals,  they have to match org.kde.Konqueror.Histor
 
 private Q_SLOTS: // connected to DBUS signals
     void slotNotifyHistoryEntry(const QByteArray &historyEntry);
+    void slotNotifyHistoryEntries(const QByteArray &historyEntries);
     void slotNotifyMaxCount(int count);
     void slotNotifyMaxAge(int days);
     void slotNotifyClear();
     void slotNotifyRemove(const QString &url);
     void slotNotifyRemoveList(const QStringList &urls);
 
+public Q_SLOTS:
+    /**
+     * Broadcasts the queued entries now
+     */
+    void flushOutgoingEntries();
+
 public:
     KSharedConfig::Ptr konqConfig()
     {
@@ -111,17 +186,35 @@ public:
     KonqHistoryList m_history;
     int m_maxCount;   // maximum of history entries
     int m_maxAgeDays; // maximum age of a history entry
+    bool m_useJournal; // append changes to the journal instead of saving everything
+    bool m_needsCompaction; // the journal is broken, next save must be a full one
+
+    QList<QByteArray> m_outgoingEntries; // serialized, for the next broadcast
+    QTimer m_broadcastTimer;
+    quint32 m_sequence; // of our last broadcast
+    QHash<QString, quint32> m_senderSequences; // D-Bus service -> sequence of the last broadcast we got
+    qint64 m_journalOffset; // how far we read the journal
+
     KonqHistoryProvider *q;
 };
 
+// New entries are collected for that long before they are broadcast...
+static const int s_broadcastDelay = 100;
+// ...unless there are that many
+static const int s_maxBroadcastEntries = 64;
+
+// The journal is merged into the history file once it grows larger than this
+static const qint64 s_journalCompactionThreshold = 256 * 1024;
+
 KonqHistoryProviderPrivate::KonqHistoryProviderPrivate(KonqHistoryProvider *qq)
-    : QObject(), QDBusContext(), q(qq)
+    : QObject(), QDBusContext(), m_needsCompaction(false), m_sequence(0), m_journalOffset(0), q(qq)
 {
     // defaults
     KConfigGroup cs(konqConfig(), "HistorySettings");
     m_maxCount = cs.readEntry("Maximum of History entries", 500);
     m_maxCount = qMax(1, m_maxCount);
     m_maxAgeDays = cs.readEntry("Maximum age of History entries", 90);
+    m_useJournal = cs.readEntry("Use History Journal", true);
 
     const QString dbusPath = QStringLiteral("/KonqHistoryManager");
     const QString dbusInterface = QStringLiteral("org.kde.Konqueror.HistoryManager");
@@ -130,10 +223,15 @@ KonqHistoryProviderPrivate::KonqHistoryProviderPrivate(KonqHistoryProvider *qq)
     dbus.registerObject(dbusPath, this, QDBusConnection::ExportAllSignals);
     dbus.connect(QString(), dbusPath, dbusInterface, QStringLiteral("notifyClear"), this, SLOT(slotNotifyClear()));
     dbus.connect(QString(), dbusPath, dbusInterface, QStringLiteral("notifyHistoryEntry"), this, SLOT(slotNotifyHistoryEntry(QByteArray)));
+    dbus.connect(QString(), dbusPath, dbusInterface, QStringLiteral("notifyHistoryEntries"), this, SLOT(slotNotifyHistoryEntries(QByteArray)));
     dbus.connect(QString(), dbusPath, dbusInterface, QStringLiteral("notifyMaxAge"), this, SLOT(slotNotifyMaxAge(int)));
     dbus.connect(QString(), dbusPath, dbusInterface, QStringLiteral("notifyMaxCount"), this, SLOT(slotNotifyMaxCount(int)));
     dbus.connect(QString(), dbusPath, dbusInterface, QStringLiteral("notifyRemove"), this, SLOT(slotNotifyRemove(QString)));
     dbus.connect(QString(), dbusPath, dbusInterface, QStringLiteral("notifyRemoveList"), this, SLOT(slotNotifyRemoveList(QStringList)));
+
+    m_broadcastTimer.setSingleShot(true);
+    m_broadcastTimer.setInterval(s_broadcastDelay);
+    connect(&m_broadcastTimer, SIGNAL(timeout()), this, SLOT(flushOutgoingEntries()));
 }
 
 ////
@@ -145,6 +243,27 @@ KonqHistoryProvider::KonqHistoryProvider(QObject *parent)
 
 KonqHistoryProvider::~KonqHistoryProvider()
 {
+    if (!d->m_outgoingEntries.isEmpty()) {
+        // We won't receive our own broadcast anymore, so save the entries now
+        const QByteArray data = d->broadcastOutgoingEntries();
+
+        QDataStream stream(data);
+        quint32 sequence;
+        QList<QByteArray> entries;
+        stream >> sequence >> entries;
+        QList<KonqHistoryEntry> saved;
+        foreach (const QByteArray &serialized, entries) {
+            QDataStream entryStream(serialized);
+            KonqHistoryEntry entry;
+            entry.load(entryStream, KonqHistoryEntry::MarshalUrlAsStrings);
+            d->applyEntry(entry);
+            KonqHistoryList::const_iterator it = d->m_history.constFindEntry(entry.url);
+            if (it != d->m_history.constEnd()) {
+                saved.append(*it);
+            }
+        }
+        d->saveEntries(saved);
+    }
     delete d;
 }
 
@@ -156,7 +275,17 @@ const KonqHistoryList &KonqHistoryProvider::entries() const
 bool KonqHistoryProvider::loadHistory()
 {
     KonqHistoryLoader loader;
-    if (!loader.loadHistory()) {
+    if (d->m_maxAgeDays > 0) {
+        // adjustSize() would remove them right away
+        loader.setExpirationDate(QDateTime(QDate::currentDate().addDays(-d->m_maxAgeDays)));
+    }
+    const bool loaded = loader.loadHistory();
+    // Don't append new records after a corrupted journal tail. The journal
+    // of a broken history file isn't read either, so it would be lost as well.
+    d->m_needsCompaction = loader.journalCorrupted() ||
+                           (!loaded && QFile::exists(KonqHistoryLoader::historyFileName()));
+    d->m_journalOffset = loader.journalSize();
+    if (!loaded) {
         return false;
     }
 
@@ -164,9 +293,8 @@ bool KonqHistoryProvider::loadHistory()
 
     d->adjustSize();
 
-    QListIterator<KonqHistoryEntry> it(d->m_history);
-    while (it.hasNext()) {
-        const KonqHistoryEntry &entry = it.next();
+    for (KonqHistoryList::const_iterator it = d->m_history.constBegin(); it != d->m_history.constEnd(); ++it) {
+        const KonqHistoryEntry &entry = *it;
 
         // Fill the entries into KParts::HistoryProvider.
         const QString urlString = entry.url.url();
@@ -212,21 +340,64 @@ void KonqHistoryProvider::emitAddToHistory(const KonqHistoryEntry &entry)
     QByteArray data;
     QDataStream stream(&data, QIODevice::WriteOnly);
     entry.save(stream, KonqHistoryEntry::MarshalUrlAsStrings);
-    stream << dbusService();
     // Protection against very long urls (like data:)
     if (data.size() > 4096) {
         return;
     }
-    emit d->notifyHistoryEntry(data);
+
+    // Loading a page usually adds a pending entry and confirms it shortly
+    // after, so collect the entries for a moment and broadcast them together.
+    d->m_outgoingEntries.append(data);
+    if (d->m_outgoingEntries.count() >= s_maxBroadcastEntries) {
+        d->flushOutgoingEntries();
+    } else if (!d->m_broadcastTimer.isActive()) {
+        d->m_broadcastTimer.start();
+    }
+}
+
+QByteArray KonqHistoryProviderPrivate::takeOutgoingEntries()
+{
+    m_broadcastTimer.stop();
+
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream << ++m_sequence << m_outgoingEntries;
+    m_outgoingEntries.clear();
+    return data;
+}
+
+QByteArray KonqHistoryProviderPrivate::broadcastOutgoingEntries()
+{
+    const QByteArray single = m_outgoingEntries.count() == 1 ? m_outgoingEntries.first() : QByteArray();
+    const QByteArray data = takeOutgoingEntries();
+    emit notifyHistoryEntries(data);
+    // For instances of older versions still running during an upgrade,
+    // the current ones ignore it (see slotNotifyHistoryEntry())
+    if (!single.isEmpty()) {
+        emit notifyHistoryEntry(single);
+    }
+    return data;
+}
+
+void KonqHistoryProviderPrivate::flushOutgoingEntries()
+{
+    if (!m_outgoingEntries.isEmpty()) {
+        broadcastOutgoingEntries();
+    }
 }
 
+// The queued entries are broadcast first in all of the following,
+// so that everybody sees the changes in the order they were made.
+
 void KonqHistoryProvider::emitRemoveFromHistory(const QUrl &url)
 {
+    d->flushOutgoingEntries();
     emit d->notifyRemove(url.url());
 }
 
 void KonqHistoryProvider::emitRemoveListFromHistory(const QList<QUrl> &urls)
 {
+    d->flushOutgoingEntries();
     QStringList result;
     foreach (const QUrl &url, urls) {
         result << url.url();
@@ -236,16 +407,19 @@ void KonqHistoryProvider::emitRemoveListFromHistory(const QList<QUrl> &urls)
 
 void KonqHistoryProvider::emitClear()
 {
+    d->flushOutgoingEntries();
     emit d->notifyClear();
 }
 
 void KonqHistoryProvider::emitSetMaxCount(int count)
 {
+    d->flushOutgoingEntries();
     emit d->notifyMaxCount(count);
 }
 
 void KonqHistoryProvider::emitSetMaxAge(int days)
 {
+    d->flushOutgoingEntries();
     emit d->notifyMaxAge(days);
 }
 
@@ -259,6 +433,13 @@ static bool isSenderOfSignal(const QDBusMessage &msg)
 
 void KonqHistoryProviderPrivate::slotNotifyHistoryEntry(const QByteArray &data)
 {
+    // Sent by an older version, one entry at a time, or by a current one
+    // after sending the entry with notifyHistoryEntries() already
+    const bool isSender = isSenderOfSignal(message());
+    if (isSender || m_senderSequences.contains(message().service())) {
+        return;
+    }
+
     KonqHistoryEntry e;
     QDataStream stream(const_cast<QByteArray *>(&data), QIODevice::ReadOnly);
 
@@ -269,6 +450,69 @@ void KonqHistoryProviderPrivate::slotNotifyHistoryEntry(const QByteArray &data)
     e.load(stream, KonqHistoryEntry::MarshalUrlAsStrings);
     //kDebug(1202) << "Got new entry from Broadcast:" << e.url;
 
+    applyEntry(e);
+    adjustSize();
+    finishAddingEntries(QList<QUrl>() << e.url, false);
+}
+
+void KonqHistoryProviderPrivate::slotNotifyHistoryEntries(const QByteArray &data)
+{
+    QDataStream stream(data);
+    quint32 sequence;
+    QList<QByteArray> entries;
+    stream >> sequence >> entries;
+
+    const bool isSender = isSenderOfSignal(message());
+    bool inSequence = true;
+    QSet<QUrl> recovered;
+    if (!isSender) {
+        const QString sender = message().service();
+        const quint32 lastSequence = m_senderSequences.value(sender);
+        m_senderSequences.insert(sender, sequence);
+        // The sender saved the entries of the broadcasts we missed already
+        if (lastSequence != 0 && sequence != lastSequence + 1) {
+            qWarning() << "Missed history broadcasts from" << sender << ", reading the changes from disk";
+            recovered = recoverFromDisk();
+            inSequence = false;
+        }
+    }
+
+    QList<QUrl> urls;
+    foreach (const QByteArray &serialized, entries) {
+        QDataStream entryStream(serialized);
+        KonqHistoryEntry e;
+        e.load(entryStream, KonqHistoryEntry::MarshalUrlAsStrings);
+        // The sender may have saved this batch before we read its changes,
+        // its visits would be counted twice then
+        if (recovered.contains(e.url)) {
+            KonqHistoryList::const_iterator it = m_history.constFindEntry(e.url);
+            if (it != m_history.constEnd() && it->lastVisited >= e.lastVisited) {
+                continue;
+            }
+        }
+        applyEntry(e);
+        if (!urls.contains(e.url)) {
+            urls.append(e.url);
+        }
+    }
+
+    adjustSize();
+    finishAddingEntries(urls, isSender);
+
+    // What the other instances appended to the journal so far came with
+    // the broadcasts we got, a later recovery doesn't need to read it again.
+    // Our own records are skipped by appendToJournal(). Should a record be
+    // only partially written yet, the recovery falls back to a full load.
+    if (!isSender && inSequence) {
+        const qint64 journalSize = QFileInfo(KonqHistoryLoader::journalFileName()).size();
+        if (journalSize > m_journalOffset) {
+            m_journalOffset = journalSize;
+        }
+    }
+}
+
+void KonqHistoryProviderPrivate::applyEntry(const KonqHistoryEntry &e)
+{
     KonqHistoryList::iterator existingEntry = q->findEntry(e.url);
     QString urlString = e.url.url();
     const bool newEntry = existingEntry == m_history.end();
@@ -298,12 +542,90 @@ void KonqHistoryProviderPrivate::slotNotifyHistoryEntry(const QByteArray &data)
     } else {
         *existingEntry = entry;
     }
+}
 
-    adjustSize();
+void KonqHistoryProviderPrivate::finishAddingEntries(const QList<QUrl> &urls, bool isSender)
+{
+    // Some might have been removed by adjustSize() already
+    QList<KonqHistoryEntry> entries;
+    foreach (const QUrl &url, urls) {
+        KonqHistoryList::const_iterator it = m_history.constFindEntry(url);
+        if (it != m_history.constEnd()) {
+            entries.append(*it);
+        }
+    }
+
+    if (!entries.isEmpty()) {
+        q->finishAddingEntries(entries, isSender);
+    }
+    if (isSender && !entries.isEmpty()) {
+        // we are the sender of the broadcast, so we save
+        saveEntries(entries);
+    }
+    foreach (const KonqHistoryEntry &entry, entries) {
+        emit q->entryAdded(entry);
+    }
+}
+
+static bool lastVisitedOrder(const KonqHistoryEntry &lhs, const KonqHistoryEntry &rhs)
+{
+    return lhs.lastVisited < rhs.lastVisited;
+}
+
+bool KonqHistoryProviderPrivate::mergeFromDisk(const KonqHistoryEntry &entry)
+{
+    KonqHistoryList::iterator existingEntry = q->findEntry(entry.url);
+    if (existingEntry == m_history.end()) {
+        q->KParts::HistoryProvider::insert(entry.url.url());
+        m_history.append(entry);
+        return true;
+    }
+    if (existingEntry->lastVisited < entry.lastVisited) {
+        *existingEntry = entry;
+        return true;
+    }
+    return false;
+}
 
-    q->finishAddingEntry(entry, isSenderOfSignal(message()));
+QSet<QUrl> KonqHistoryProviderPrivate::recoverFromDisk()
+{
+    QList<QUrl> urls;
+
+    QList<KonqHistoryLoader::JournalRecord> records;
+    const bool compacted = QFileInfo(KonqHistoryLoader::journalFileName()).size() < m_journalOffset;
+    if (!compacted && KonqHistoryLoader::readJournal(&m_journalOffset, &records)) {
+        foreach (const KonqHistoryLoader::JournalRecord &record, records) {
+            if (record.type == KonqHistoryLoader::JournalUpsert) {
+                if (mergeFromDisk(record.entry)) {
+                    urls.append(record.entry.url);
+                }
+            } else {
+                KonqHistoryList::iterator existingEntry = q->findEntry(record.entry.url);
+                if (existingEntry != m_history.end()) {
+                    q->removeEntry(existingEntry);
+                    urls.removeAll(record.entry.url);
+                }
+            }
+        }
+    } else {
+        // Somebody wrote the whole history since, we can't tell what changed
+        KonqHistoryLoader loader;
+        loader.loadHistory();
+        foreach (const KonqHistoryEntry &entry, loader.entries()) {
+            if (mergeFromDisk(entry)) {
+                urls.append(entry.url);
+            }
+        }
+        m_journalOffset = loader.journalSize();
+    }
 
-    emit q->entryAdded(entry);
+    if (urls.isEmpty()) {
+        return QSet<QUrl>();
+    }
+    std::stable_sort(m_history.begin(), m_history.end(), lastVisitedOrder);
+    adjustSize();
+    finishAddingEntries(urls, false);
+    return urls.toSet();
 }
 
 void KonqHistoryProviderPrivate::slotNotifyMaxCount(int count)
@@ -355,26 +677,26 @@ void KonqHistoryProviderPrivate::slotNotifyRemove(const QString &urlStr)
     if (existingEntry != m_history.end()) {
         q->removeEntry(existingEntry);
         if (isSenderOfSignal(message())) {
-            saveHistory();
+            saveRemovedEntries(QList<QUrl>() << url);
         }
     }
 }
 
 void KonqHistoryProviderPrivate::slotNotifyRemoveList(const QStringList &urls)
 {
-    bool doSave = false;
+    QList<QUrl> removedUrls;
     QStringList::const_iterator it = urls.begin();
     for (; it != urls.end(); ++it) {
         QUrl url(*it);
         KonqHistoryList::iterator existingEntry = m_history.findEntry(url);
         if (existingEntry != m_history.end()) {
             q->removeEntry(existingEntry);
-            doSave = true;
+            removedUrls.append(url);
         }
     }
 
-    if (doSave && isSenderOfSignal(message())) {
-        saveHistory();
+    if (!removedUrls.isEmpty() && isSenderOfSignal(message())) {
+        saveRemovedEntries(removedUrls);
     }
 }
 
@@ -399,34 +721,133 @@ int KonqHistoryProvider::maxAge() const
     return d->m_maxAgeDays;
 }
 
+static bool lastVisitedLessThan(const KonqHistoryEntry *lhs, const KonqHistoryEntry *rhs)
+{
+    return lhs->lastVisited < rhs->lastVisited;
+}
+
 bool KonqHistoryProviderPrivate::saveHistory()
 {
-    const QString dir = QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation) + QLatin1String("/konqueror");
-    QDir().mkpath(dir);
-    const QString filename = dir + QLatin1String("/konq_history");
+    const QString filename = KonqHistoryLoader::historyFileName();
+    QDir().mkpath(QFileInfo(filename).absolutePath());
     QSaveFile file(filename);
     if (!file.open(QIODevice::WriteOnly)) {
         qWarning() << "Can't open" << file.fileName() << "for saving history";
         return false;
     }
 
+    // The entries are written oldest first, so that the loader doesn't
+    // need to sort them. Entries updated in place may be out of order.
+    QVector<const KonqHistoryEntry *> sorted;
+    sorted.reserve(m_history.count());
+    foreach (const KonqHistoryEntry &entry, m_history) {
+        sorted.append(&entry);
+    }
+    std::stable_sort(sorted.begin(), sorted.end(), lastVisitedLessThan);
+
     QDataStream fileStream(&file);
     fileStream << KonqHistoryLoader::historyVersion();
 
     QByteArray data;
     QDataStream stream(&data, QIODevice::WriteOnly);
 
-    QListIterator<KonqHistoryEntry> it(m_history);
-    while (it.hasNext()) {
+    foreach (const KonqHistoryEntry *entry, sorted) {
         //We use QUrl for marshalling URLs in entries in the V4
         //file format
-        it.next().save(stream, KonqHistoryEntry::NoFlags);
+        entry->save(stream, KonqHistoryEntry::NoFlags);
     }
 
     quint32 crc = crc32(0, reinterpret_cast<unsigned char *>(data.data()), data.size());
     fileStream << crc << data;
 
-    return file.commit();
+    if (!file.commit()) {
+        return false;
+    }
+
+    // Everything in the journal is part of the history file now.
+    // Replaying it again would be harmless, but slow.
+    QFile::remove(KonqHistoryLoader::journalFileName());
+    m_journalOffset = 0;
+    m_needsCompaction = false;
+    return true;
+}
+
+bool KonqHistoryProviderPrivate::saveEntries(const QList<KonqHistoryEntry> &entries)
+{
+    if (!m_useJournal || m_needsCompaction) {
+        return saveHistory();
+    }
+
+    QList<QByteArray> records;
+    foreach (const KonqHistoryEntry &entry, entries) {
+        QByteArray record;
+        QDataStream stream(&record, QIODevice::WriteOnly);
+        stream << quint8(KonqHistoryLoader::JournalUpsert);
+        entry.save(stream, KonqHistoryEntry::NoFlags);
+        records.append(record);
+    }
+
+    return appendToJournal(records);
+}
+
+bool KonqHistoryProviderPrivate::saveRemovedEntries(const QList<QUrl> &urls)
+{
+    if (!m_useJournal || m_needsCompaction) {
+        return saveHistory();
+    }
+
+    QList<QByteArray> records;
+    foreach (const QUrl &url, urls) {
+        QByteArray record;
+        QDataStream stream(&record, QIODevice::WriteOnly);
+        stream << quint8(KonqHistoryLoader::JournalRemove) << url;
+        records.append(record);
+    }
+
+    return appendToJournal(records);
+}
+
+bool KonqHistoryProviderPrivate::appendToJournal(const QList<QByteArray> &records)
+{
+    const QString filename = KonqHistoryLoader::journalFileName();
+    QDir().mkpath(QFileInfo(filename).absolutePath());
+    QFile file(filename);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        qWarning() << "Can't open" << file.fileName() << "for appending to the history journal";
+        return saveHistory();
+    }
+
+    // Build the whole chunk first, so that it hits the disk with one write
+    const qint64 start = file.size();
+    QByteArray chunk;
+    QDataStream stream(&chunk, QIODevice::WriteOnly);
+    if (start == 0) {
+        stream << KonqHistoryLoader::historyVersion();
+    }
+    foreach (const QByteArray &record, records) {
+        const quint32 crc = crc32(0, reinterpret_cast<const unsigned char *>(record.constData()), record.size());
+        stream << crc << record;
+    }
+
+    if (file.write(chunk) != chunk.size() || !file.flush()) {
+        qWarning() << "Can't write to the history journal" << file.fileName();
+        file.close();
+        return saveHistory();
+    }
+
+    const qint64 journalSize = file.size();
+    file.close();
+
+    // Unless there is something before them we haven't read,
+    // a recovery doesn't need to read our own records again
+    if (start == m_journalOffset) {
+        m_journalOffset = start + chunk.size();
+    }
+
+    if (journalSize > s_journalCompactionThreshold) {
+        return saveHistory();
+    }
+    return true;
 }
 
 KonqHistoryList::iterator KonqHistoryProvider::findEntry(const QUrl &url)
@@ -449,10 +870,15 @@ KonqHistoryList::const_iterator KonqHistoryProvider::constFindEntry(const QUrl &
 
 void KonqHistoryProvider::finishAddingEntry(const KonqHistoryEntry &entry, bool isSender)
 {
-    Q_UNUSED(entry); // this arg is used by konq's reimplementation
-    if (isSender) {
-        // we are the sender of the broadcast, so we save
-        d->saveHistory();
+    // The sender saves all entries of a broadcast at once afterwards
+    Q_UNUSED(entry);
+    Q_UNUSED(isSender);
+}
+
+void KonqHistoryProvider::finishAddingEntries(const QList<KonqHistoryEntry> &entries, bool isSender)
+{
+    foreach (const KonqHistoryEntry &entry, entries) {
+        finishAddingEntry(entry, isSender);
     }
 }
 
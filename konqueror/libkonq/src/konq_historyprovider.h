@@ -138,6 +138,13 @@ protected: // only to be used by konqueror's KonqHistoryManager
     virtual void finishAddingEntry(const KonqHistoryEntry &entry, bool isSender);
     virtual void removeEntry(KonqHistoryList::iterator it);
 
+    /**
+     * Called once for all entries added or changed by a broadcast, before
+     * entryAdded() is emitted for them. Calls finishAddingEntry() for each
+     * of them by default.
+     */
+    virtual void finishAddingEntries(const QList<KonqHistoryEntry> &entries, bool isSender);
+
     /**
      * a little optimization for KonqHistoryList::findEntry(),
      * checking the dict of KParts::HistoryProvider before traversing the list.
@@ -23,6 +23,7 @@
 #include <qdir.h>
 #include <qtimer.h>
 #include <QApplication>
+#include <QThread>
 
 #include <KLocalizedString>
 #include <kconfig.h>
@@ -36,10 +37,13 @@
 #include <kurlauthorized.h>
 
 #include "fsview.h"
+#include "scanwatch.h"
 
 // FSView
 
 QMap<QString, MetricEntry> FSView::_dirMetric;
+ScanCache FSView::_scanCache;
+bool FSView::_scanCacheLoaded = false;
 
 FSView::FSView(Inode *base, QWidget *parent)
     : TreeMapWidget(base, parent)
@@ -109,6 +113,37 @@ FSView::FSView(Inode *base, QWidget *parent)
         }
     }
 
+    // read directories in worker threads, 0 to read them in the GUI thread
+    KConfigGroup gconfig(_config, "General");
+    _sm.setThreadCount(gconfig.readEntry("ScanThreads", QThread::idealThreadCount()));
+
+    // count the blocks files take on disk instead of their length
+    _sm.setAllocatedSize(gconfig.readEntry("AllocatedSize", false));
+    // don't descend into other file systems mounted below the path
+    _sm.setOneFileSystem(gconfig.readEntry("OneFileSystem", false));
+
+    // only read directories changed since the last scan
+    if (gconfig.readEntry("ScanCache", true)) {
+        if (!_scanCacheLoaded) {
+            _scanCache.load(ScanCache::defaultFileName());
+            _scanCacheLoaded = true;
+        }
+        _sm.setCache(&_scanCache);
+    }
+
+    // keep the map up to date with changes made while it is shown
+    _watcher = 0;
+    if (gconfig.readEntry("WatchChanges", false)) {
+        _watcher = new ScanWatcher(this);
+        const int maxWatches = gconfig.readEntry("MaxWatches", 0);
+        if (maxWatches > 0) {
+            _watcher->setMaxWatches(maxWatches);
+        }
+        connect(_watcher, SIGNAL(directoriesChanged(QStringList)),
+                this, SLOT(directoriesChanged(QStringList)));
+        connect(_watcher, SIGNAL(overflowed()), this, SLOT(watchOverflowed()));
+    }
+
     _sm.setListener(this);
 }
 
@@ -133,6 +168,10 @@ void FSView::setPath(const QString &p)
 
     // stop any previous updating
     stop();
+    if (_watcher) {
+        _watcher->clear();
+    }
+    _changedDirs.clear();
 
     QFileInfo fi(p);
     _path = fi.absoluteFilePath();
@@ -154,7 +193,7 @@ void FSView::setPath(const QString &p)
     b->setPeer(d);
 
     setWindowTitle(QStringLiteral("%1 - FSView").arg(_path));
-    requestUpdate(b);
+    requestUpdate(b, true);
 }
 
 KUrl::List FSView::selectedUrls()
@@ -201,7 +240,7 @@ void FSView::setDirMetric(const QString &k,
     _dirMetric.insert(k, MetricEntry(s, f, d));
 }
 
-void FSView::requestUpdate(Inode *i)
+void FSView::requestUpdate(Inode *i, bool useCache)
 {
     if (0) kDebug(90100) << "FSView::requestUpdate(" << i->path()
                              << ")" << endl;
@@ -235,7 +274,7 @@ void FSView::requestUpdate(Inode *i)
         emit started();
     }
 
-    _sm.startScan(peer);
+    _sm.startScan(peer, useCache);
 }
 
 void FSView::scanFinished(ScanDir *d)
@@ -279,6 +318,12 @@ void FSView::scanFinished(ScanDir *d)
     _lastDir = d;
     _dirsFinished++;
 
+    // directories which go over the budget are only updated together
+    // with a watched parent, when its subdirectories change
+    if (_watcher) {
+        _watcher->watch(d->path());
+    }
+
     if (0) kDebug(90100) << "FSFiew::scanFinished: " << d->path()
                              << ", Data " << data
                              << ", Progress " << _progress << "/"
@@ -370,6 +415,13 @@ void FSView::saveMetric(KConfigGroup *g)
     g->writeEntry("Count", c - 1);
 }
 
+void FSView::saveScanCache()
+{
+    if (_sm.cache() && _scanCache.isModified()) {
+        _scanCache.save(ScanCache::defaultFileName());
+    }
+}
+
 void FSView::setColorMode(FSView::ColorMode cm)
 {
     if (_colorMode == cm) {
@@ -473,6 +525,8 @@ void FSView::saveFSOptions()
 
     KConfigGroup cconfig(_config, "MetricCache");
     saveMetric(&cconfig);
+
+    saveScanCache();
 }
 
 void FSView::quit()
@@ -505,7 +559,8 @@ void FSView::doRedraw()
         if (0) {
             kDebug(90100) << "doRedraw " << _sm.scanLength();
         }
-        redraw();
+        // only the parts of the map which changed are laid out again
+        redrawChanged();
     } else {
         redo = true;
     }
@@ -586,9 +641,75 @@ void FSView::doUpdate()
     }
 
     if (_sm.scanRunning()) {
-        QTimer::singleShot(0, this, SLOT(doUpdate()));
+        // don't spin while the scan threads are still reading
+        QTimer::singleShot(_sm.scanReady() ? 0 : 10, this, SLOT(doUpdate()));
     } else {
         emit completed(_dirsFinished);
+
+        if (!_changedDirs.isEmpty()) {
+            const QStringList changed = _changedDirs.toList();
+            _changedDirs.clear();
+            directoriesChanged(changed);
+        }
+    }
+}
+
+void FSView::directoriesChanged(const QStringList &absPaths)
+{
+    QStringList::ConstIterator it;
+    for (it = absPaths.constBegin(); it != absPaths.constEnd(); ++it) {
+        // a rescan started below may start again from further up
+        if (_sm.scanRunning()) {
+            _changedDirs.insert(*it);
+        } else {
+            refreshDirectory(*it);
+        }
+    }
+}
+
+void FSView::refreshDirectory(const QString &absPath)
+{
+    ScanDir *d = _sm.findDir(absPath);
+    if (!d) {
+        // gone, or renamed: its parent has to be read again
+        QString parent = absPath;
+        while (!d && parent.lastIndexOf(QLatin1Char('/')) > 0) {
+            parent.truncate(parent.lastIndexOf(QLatin1Char('/')));
+            d = _sm.findDir(parent);
+        }
+        if (!d) {
+            return;
+        }
+    } else if (d->refreshFiles()) {
+        // only files changed, just show them again
+        Inode *i = static_cast<Inode *>(d->listener());
+        if (i) {
+            i->clear();
+        }
+        if (_allowRefresh) {
+            redrawChanged();
+        }
+        return;
+    }
+
+    // subdirectories changed: rescan the subtree, the cache still
+    // knows the unchanged directories below
+    Inode *i = static_cast<Inode *>(d->listener());
+    while (!i && d->parent()) {
+        d = d->parent();
+        i = static_cast<Inode *>(d->listener());
+    }
+    if (i) {
+        requestUpdate(i, true);
+    }
+}
+
+void FSView::watchOverflowed()
+{
+    kDebug(90100) << "FSView: lost changes, scanning" << _path << "again";
+    Inode *b = (Inode *)base();
+    if (b && b->dirPeer()) {
+        requestUpdate(b, true);
     }
 }
 
@@ -34,9 +34,11 @@
 #include "treemap.h"
 #include "inode.h"
 #include "scan.h"
+#include "scancache.h"
 
 class QMenu;
 class KConfig;
+class ScanWatcher;
 
 /* Cached Metric info config */
 class MetricEntry
@@ -99,7 +101,15 @@ public:
     bool setColorMode(const QString &);
     QString colorModeString() const;
 
-    void requestUpdate(Inode *);
+    /* Rescan i. With useCache, directories unchanged since the last
+     * scan are not read again. */
+    void requestUpdate(Inode *i, bool useCache = false);
+
+    /* Bytes of hard links not counted again by the current scan */
+    KIO::fileoffset_t deduplicatedSize() const
+    {
+        return _sm.deduplicatedSize();
+    }
 
     /* Implementation of listener interface of ScanManager.
      * Used to calculate progress info */
@@ -110,6 +120,7 @@ public:
     static bool getDirMetric(const QString &, double &, unsigned int &, unsigned int &);
     static void setDirMetric(const QString &, double, unsigned int, unsigned int);
     void saveMetric(KConfigGroup *);
+    void saveScanCache();
     void saveFSOptions();
 
     // for color mode
@@ -125,6 +136,10 @@ public slots:
     void doRedraw();
     void colorActivated(QAction *);
 
+private slots:
+    void directoriesChanged(const QStringList &);
+    void watchOverflowed();
+
 signals:
     void started();
     void progress(int percent, int dirs, const QString &lastDir);
@@ -134,13 +149,23 @@ protected:
     void keyPressEvent(QKeyEvent *) Q_DECL_OVERRIDE;
 
 private:
+    /* Show the changes in directory absPath, read it again if needed */
+    void refreshDirectory(const QString &absPath);
+
     KConfig *_config;
     ScanManager _sm;
+    // 0 if changes are not watched
+    ScanWatcher *_watcher;
+    // changed while a scan was running, refreshed when it is done
+    QSet<QString> _changedDirs;
 
     // when a contextMenu is shown, we don't allow async. refreshing
     bool _allowRefresh;
     // a cache for directory sizes with long lasting updates
     static QMap<QString, MetricEntry> _dirMetric;
+    // contents of directories of previous runs, shared by all views
+    static ScanCache _scanCache;
+    static bool _scanCacheLoaded;
 
     // current root path
     int _pathDepth;
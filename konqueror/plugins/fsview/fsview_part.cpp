@@ -87,6 +87,10 @@ void FSJob::progressSlot(int percent, int dirs, const QString &cDir)
         slotInfoMessage(this, i18np("Read 1 folder, in %2",
                                     "Read %1 folders, in %2",
                                     dirs, cDir), QString());
+    } else if (_view->deduplicatedSize() > 0) {
+        slotInfoMessage(this, i18np("1 folder, %2 of hard links counted once",
+                                    "%1 folders, %2 of hard links counted once",
+                                    dirs, KIO::convertSize(_view->deduplicatedSize())), QString());
     } else {
         slotInfoMessage(this, i18np("1 folder", "%1 folders", dirs), QString());
     }
@@ -271,6 +275,7 @@ void FSViewPart::completedSlot(int dirs)
 
     KConfigGroup cconfig(_view->config(), "MetricCache");
     _view->saveMetric(&cconfig);
+    _view->saveScanCache();
 
     emit completed();
 }
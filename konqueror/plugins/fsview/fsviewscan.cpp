@@ -0,0 +1,333 @@
+/* This file is part of FSView.
+
+   KCachegrind is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation, version 2.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+/*
+ * fsview-scan: FSView's directory scanning without a display.
+ * Prints the largest folders of a tree, or writes the whole tree
+ * as JSON, as one JSON object per line, or as an ncdu export.
+ */
+
+#include <stdio.h>
+
+#include <algorithm>
+
+#include <QCommandLineOption>
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QTextStream>
+#include <QThread>
+
+#include <KAboutData>
+#include <KLocalizedString>
+
+#ifdef Q_OS_UNIX
+#include <sys/resource.h>
+#endif
+
+#include "scan.h"
+
+static QString jsonString(const QString &s)
+{
+    QString result;
+    result.reserve(s.length() + 2);
+    result += QLatin1Char('"');
+    for (int i = 0; i < s.length(); i++) {
+        const QChar c = s.at(i);
+        switch (c.unicode()) {
+        case '"':
+            result += QLatin1String("\\\"");
+            break;
+        case '\\':
+            result += QLatin1String("\\\\");
+            break;
+        case '\n':
+            result += QLatin1String("\\n");
+            break;
+        case '\t':
+            result += QLatin1String("\\t");
+            break;
+        default:
+            if (c.unicode() < 0x20) {
+                result += QStringLiteral("\\u%1").arg(c.unicode(), 4, 16, QLatin1Char('0'));
+            } else {
+                result += c;
+            }
+        }
+    }
+    result += QLatin1Char('"');
+    return result;
+}
+
+static QString childPath(const QString &path, const QString &name)
+{
+    if (path.endsWith(QLatin1Char('/'))) {
+        return path + name;
+    }
+    return path + QLatin1Char('/') + name;
+}
+
+/* {"name":..,"size":..,"files":..,"dirs":..,"children":[..]} */
+static void writeJson(QTextStream &out, ScanDir *d, const QString &name)
+{
+    out << "{\"name\":" << jsonString(name)
+        << ",\"size\":" << (qulonglong)d->size()
+        << ",\"files\":" << d->fileCount()
+        << ",\"dirs\":" << d->dirCount()
+        << ",\"children\":[";
+
+    bool first = true;
+    const ScanFileVector &files = d->files();
+    for (int i = 0; i < files.count(); i++) {
+        out << (first ? "" : ",")
+            << "{\"name\":" << jsonString(d->fileName(files.at(i)))
+            << ",\"size\":" << (qulonglong)files.at(i).size() << '}';
+        first = false;
+    }
+    ScanDirVector &dirs = d->dirs();
+    for (int i = 0; i < dirs.count(); i++) {
+        out << (first ? "" : ",");
+        writeJson(out, &dirs[i], dirs[i].name());
+        first = false;
+    }
+    out << "]}";
+}
+
+/* One object with the full path per line, a folder before its contents */
+static void writeNdjson(QTextStream &out, ScanDir *d, const QString &path)
+{
+    out << "{\"path\":" << jsonString(path)
+        << ",\"type\":\"dir\",\"size\":" << (qulonglong)d->size()
+        << ",\"files\":" << d->fileCount()
+        << ",\"dirs\":" << d->dirCount() << "}\n";
+
+    const ScanFileVector &files = d->files();
+    for (int i = 0; i < files.count(); i++) {
+        out << "{\"path\":" << jsonString(childPath(path, d->fileName(files.at(i))))
+            << ",\"type\":\"file\",\"size\":" << (qulonglong)files.at(i).size() << "}\n";
+    }
+    ScanDirVector &dirs = d->dirs();
+    for (int i = 0; i < dirs.count(); i++) {
+        writeNdjson(out, &dirs[i], childPath(path, dirs[i].name()));
+    }
+}
+
+/*
+ * A folder in the export format of ncdu: [{info}, file, file, [folder]...]
+ * Sizes go into asize (apparent size) or, when counting allocated
+ * blocks, into dsize (disk usage).
+ */
+static void writeNcdu(QTextStream &out, ScanDir *d, const QString &name, const char *sizeField)
+{
+    out << "[{\"name\":" << jsonString(name) << '}';
+
+    const ScanFileVector &files = d->files();
+    for (int i = 0; i < files.count(); i++) {
+        out << ",\n{\"name\":" << jsonString(d->fileName(files.at(i)))
+            << ",\"" << sizeField << "\":" << (qulonglong)files.at(i).size() << '}';
+    }
+    ScanDirVector &dirs = d->dirs();
+    for (int i = 0; i < dirs.count(); i++) {
+        out << ",\n";
+        writeNcdu(out, &dirs[i], dirs[i].name(), sizeField);
+    }
+    out << ']';
+}
+
+static void collectDirs(ScanDir *d, QVector<ScanDir *> &list)
+{
+    list.append(d);
+    ScanDirVector &dirs = d->dirs();
+    for (int i = 0; i < dirs.count(); i++) {
+        collectDirs(&dirs[i], list);
+    }
+}
+
+static bool largerDir(ScanDir *d1, ScanDir *d2)
+{
+    return d1->size() > d2->size();
+}
+
+static void writeTop(QTextStream &out, ScanDir *top, int count)
+{
+    QVector<ScanDir *> dirs;
+    collectDirs(top, dirs);
+    count = qMin(count, dirs.count());
+    std::partial_sort(dirs.begin(), dirs.begin() + count, dirs.end(), largerDir);
+
+    for (int i = 0; i < count; i++) {
+        ScanDir *d = dirs.at(i);
+        out << QStringLiteral("%1  %2").arg(KIO::convertSize(d->size()), 10).arg(d->path()) << '\n';
+    }
+    out << i18n("Total: %1 in %2 files, %3 folders",
+                KIO::convertSize(top->size()), top->fileCount(), top->dirCount()) << '\n';
+}
+
+/* Peak resident memory of this process in bytes, -1 if unknown */
+static qint64 peakMemory()
+{
+#ifdef Q_OS_UNIX
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+#ifdef Q_OS_MAC
+        return usage.ru_maxrss;
+#else
+        return qint64(usage.ru_maxrss) * 1024;
+#endif
+    }
+#endif
+    return -1;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    KLocalizedString::setApplicationDomain("fsview");
+
+    KAboutData aboutData(QStringLiteral("fsview-scan"), i18n("FSView Scan"), QStringLiteral("0.1"),
+                         i18n("Disk usage of a folder tree, without a display"),
+                         KAboutLicense::GPL,
+                         i18n("(c) 2002, Josef Weidendorfer"));
+    KAboutData::setApplicationData(aboutData);
+
+    QCommandLineParser parser;
+    parser.addPositionalArgument(QStringLiteral("folder"), i18n("Folder to scan"));
+    parser.addOption(QCommandLineOption(QStringList() << QStringLiteral("f") << QStringLiteral("format"),
+                                        i18n("Output format: top (the largest folders), json, ndjson or ncdu"),
+                                        QStringLiteral("format"), QStringLiteral("top")));
+    parser.addOption(QCommandLineOption(QStringList() << QStringLiteral("n") << QStringLiteral("top"),
+                                        i18n("Number of folders listed by the top format"),
+                                        QStringLiteral("count"), QStringLiteral("20")));
+    parser.addOption(QCommandLineOption(QStringList() << QStringLiteral("o") << QStringLiteral("output"),
+                                        i18n("Write to file instead of standard output"),
+                                        QStringLiteral("file")));
+    parser.addOption(QCommandLineOption(QStringList() << QStringLiteral("j") << QStringLiteral("threads"),
+                                        i18n("Number of threads reading folders, 0 to read them in the main thread"),
+                                        QStringLiteral("count"), QString::number(QThread::idealThreadCount())));
+    parser.addOption(QCommandLineOption(QStringLiteral("allocated-size"),
+                                        i18n("Count the blocks allocated for files instead of their length")));
+    parser.addOption(QCommandLineOption(QStringList() << QStringLiteral("x") << QStringLiteral("one-file-system"),
+                                        i18n("Skip folders on other file systems")));
+    parser.addOption(QCommandLineOption(QStringLiteral("no-native"),
+                                        i18n("Read folders with QDir instead of the system calls directly")));
+    parser.addOption(QCommandLineOption(QStringLiteral("stats"),
+                                        i18n("Print scan time, entries per second, system calls and peak memory to standard error")));
+
+    aboutData.setupCommandLine(&parser);
+    parser.process(app);
+    aboutData.processCommandLine(&parser);
+
+    if (parser.positionalArguments().count() != 1) {
+        parser.showHelp(1);
+    }
+
+    const QString format = parser.value(QStringLiteral("format"));
+    if (format != QLatin1String("top") && format != QLatin1String("json") &&
+            format != QLatin1String("ndjson") && format != QLatin1String("ncdu")) {
+        fprintf(stderr, "%s\n", qPrintable(i18n("Unknown format: %1", format)));
+        return 1;
+    }
+
+    const QFileInfo fi(parser.positionalArguments().at(0));
+    if (!fi.isDir()) {
+        fprintf(stderr, "%s\n", qPrintable(i18n("Not a folder: %1", fi.filePath())));
+        return 1;
+    }
+    const QString path = QDir::cleanPath(fi.absoluteFilePath());
+
+    QFile file;
+    bool opened;
+    if (parser.isSet(QStringLiteral("output"))) {
+        file.setFileName(parser.value(QStringLiteral("output")));
+        opened = file.open(QIODevice::WriteOnly | QIODevice::Truncate);
+    } else {
+        opened = file.open(stdout, QIODevice::WriteOnly);
+    }
+    if (!opened) {
+        if (file.fileName().isEmpty()) {
+            fprintf(stderr, "%s\n", qPrintable(i18n("Cannot write to standard output")));
+        } else {
+            fprintf(stderr, "%s\n", qPrintable(i18n("Cannot write to %1", file.fileName())));
+        }
+        return 1;
+    }
+
+    ScanDir::setNativeReading(!parser.isSet(QStringLiteral("no-native")));
+
+    ScanManager m(path);
+    m.setThreadCount(parser.value(QStringLiteral("threads")).toInt());
+    m.setAllocatedSize(parser.isSet(QStringLiteral("allocated-size")));
+    m.setOneFileSystem(parser.isSet(QStringLiteral("one-file-system")));
+
+    const quint64 systemCalls = ScanDir::systemCalls();
+    QElapsedTimer timer;
+    timer.start();
+
+    m.startScan();
+    while (m.scanRunning() && (m.threadCount() > 0 || m.scanReady())) {
+        if (m.scanReady()) {
+            m.scan(0);
+        } else {
+            // the worker threads are still reading
+            QThread::msleep(1);
+        }
+    }
+
+    const qint64 msecs = qMax(qint64(1), timer.elapsed());
+    ScanDir *top = m.top();
+
+    QTextStream out(&file);
+    out.setCodec("UTF-8");
+    if (format == QLatin1String("json")) {
+        writeJson(out, top, path);
+        out << '\n';
+    } else if (format == QLatin1String("ndjson")) {
+        writeNdjson(out, top, path);
+    } else if (format == QLatin1String("ncdu")) {
+        out << "[1,0,{\"progname\":\"fsview-scan\",\"progver\":\"0.1\",\"timestamp\":"
+            << QDateTime::currentMSecsSinceEpoch() / 1000 << "},\n";
+        writeNcdu(out, top, path, m.allocatedSize() ? "dsize" : "asize");
+        out << "]\n";
+    } else {
+        writeTop(out, top, parser.value(QStringLiteral("top")).toInt());
+    }
+    out.flush();
+
+    if (parser.isSet(QStringLiteral("stats"))) {
+        // the top folder counts as well
+        const qulonglong entries = qulonglong(top->fileCount()) + top->dirCount() + 1;
+        QStringList lines;
+        lines << i18n("Scanned %1 entries in %2 s, %3 entries/s",
+                      entries, QString::number(msecs / 1000.0, 'f', 3), entries * 1000 / qulonglong(msecs));
+        lines << i18n("System calls: %1", ScanDir::systemCalls() - systemCalls);
+        const qint64 memory = peakMemory();
+        if (memory >= 0) {
+            lines << i18n("Peak memory: %1", KIO::convertSize(memory));
+        }
+        if (m.deduplicatedSize() > 0) {
+            lines << i18n("Hard links counted once: %1", KIO::convertSize(m.deduplicatedSize()));
+        }
+        fprintf(stderr, "%s\n", qPrintable(lines.join(QLatin1Char('\n'))));
+    }
+
+    return file.error() == QFileDevice::NoError ? 0 : 1;
+}
@@ -38,6 +38,7 @@ Inode::Inode()
 {
     _dirPeer = 0;
     _filePeer = 0;
+    _fileDir = 0;
     init(QString());
 }
 
@@ -55,6 +56,7 @@ Inode::Inode(ScanDir *d, Inode *parent)
 
     _dirPeer = d;
     _filePeer = 0;
+    _fileDir = 0;
 
     init(absPath);
 }
@@ -62,14 +64,18 @@ Inode::Inode(ScanDir *d, Inode *parent)
 Inode::Inode(ScanFile *f, Inode *parent)
     : TreeMapItem(parent)
 {
-    QString absPath;
-    if (parent) {
-        absPath = parent->path() + QLatin1Char('/');
-    }
-    absPath += f->name();
+    // the name of a file is kept by its directory
+    Q_ASSERT(parent && parent->dirPeer());
 
     _dirPeer = 0;
     _filePeer = f;
+    _fileDir = parent->dirPeer();
+
+    QString absPath = parent->path();
+    if (!absPath.endsWith(QLatin1Char('/'))) {
+        absPath += QLatin1Char('/');
+    }
+    absPath += _fileDir->fileName(*f);
 
     init(absPath);
 }
@@ -84,7 +90,7 @@ Inode::~Inode()
         _dirPeer->setListener(0);
     }
     if (_filePeer) {
-        _filePeer->setListener(0);
+        _fileDir->setFileListener(_filePeer, 0);
     }
 }
 
@@ -95,11 +101,12 @@ void Inode::setPeer(ScanDir *d)
         _dirPeer->setListener(0);
     }
     if (_filePeer) {
-        _filePeer->setListener(0);
+        _fileDir->setFileListener(_filePeer, 0);
     }
 
     _dirPeer = d;
     _filePeer = 0;
+    _fileDir = 0;
     init(d->name());
 }
 
@@ -134,7 +141,7 @@ void Inode::init(const QString &path)
         _dirPeer->setListener(this);
     }
     if (_filePeer) {
-        _filePeer->setListener(this);
+        _fileDir->setFileListener(_filePeer, this);
     }
 
     if (_dirPeer && _dirPeer->scanFinished()) {
@@ -149,6 +156,7 @@ void Inode::sizeChanged(ScanDir *d)
                              << d->name() << ": size " << d->size() << endl;
 
     _resortNeeded = true;
+    invalidateLayout();
 }
 
 void Inode::scanFinished(ScanDir *d)
@@ -157,6 +165,7 @@ void Inode::scanFinished(ScanDir *d)
                              << d->name() << ": size " << d->size() << endl;
 
     _resortNeeded = true;
+    invalidateLayout();
 
     /* no estimation any longer */
     _sizeEstimation = 0.0;
@@ -191,6 +200,7 @@ void Inode::destroyed(ScanFile *f)
 {
     if (_filePeer == f) {
         _filePeer = 0;
+        _fileDir = 0;
     }
 }
 
@@ -346,7 +356,7 @@ QString Inode::text(int i) const
                 name += QLatin1Char('/');
             }
         } else if (_filePeer) {
-            name = _filePeer->name();
+            name = _fileDir->fileName(*_filePeer);
         }
 
         return name;
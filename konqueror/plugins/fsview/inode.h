@@ -92,6 +92,8 @@ private:
     QFileInfo _info;
     ScanDir *_dirPeer;
     ScanFile *_filePeer;
+    // the directory of _filePeer
+    ScanDir *_fileDir;
 
     double _sizeEstimation;
     unsigned int _fileCountEstimation, _dirCountEstimation;
@@ -0,0 +1,278 @@
+/* This file is part of FSView.
+
+   KCachegrind is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation, version 2.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include <QThread>
+
+#include "parallelscan.h"
+
+// number of results a worker collects before handing them out
+static const int s_batchSize = 64;
+
+// A directory not allowed to be listed is never queued: it is
+// handed back right away, without contents
+static ParallelScanResult skippedResult(const QString &absPath, quint64 id, int generation)
+{
+    ParallelScanResult result;
+    result.id = id;
+    result.generation = generation;
+    result.contents.absPath = absPath;
+    result.contents.skipped = true;
+    return result;
+}
+
+// ScanWorker
+
+class ScanWorker : public QThread
+{
+public:
+    ScanWorker(ParallelScanner *scanner, int index)
+    {
+        _scanner = scanner;
+        _index = index;
+    }
+
+protected:
+    void run() Q_DECL_OVERRIDE;
+
+private:
+    ParallelScanner *_scanner;
+    int _index;
+};
+
+void ScanWorker::run()
+{
+    QList<ParallelScanResult> batch;
+    ParallelScanner::Job job;
+
+    forever {
+        if (!_scanner->pop(_index, job)) {
+            // hand out what we have before going idle
+            _scanner->addResults(batch);
+            if (!_scanner->waitForJobs()) {
+                return;
+            }
+            continue;
+        }
+
+        if (job.generation != _scanner->_generation.load()) {
+            continue;
+        }
+
+        ParallelScanResult result;
+        result.id = job.id;
+        result.generation = job.generation;
+        result.contents.absPath = job.absPath;
+        result.contents.accounting = job.accounting.data();
+        ScanDir::readContents(result.contents, job.cache);
+
+        const QStringList &dirs = result.contents.dirs;
+        QList<ParallelScanResult> skipped;
+        if (!dirs.isEmpty()) {
+            result.firstChildId = _scanner->_nextId.fetchAndAddRelaxed(dirs.count());
+
+            QString prefix = job.absPath;
+            if (!prefix.endsWith(QLatin1Char('/'))) {
+                prefix += QLatin1Char('/');
+            }
+
+            // reversed, as jobs are taken from the back of our own queue
+            QList<ParallelScanner::Job> children;
+            children.reserve(dirs.count());
+            for (int i = dirs.count() - 1; i >= 0; --i) {
+                const QString absPath = prefix + dirs.at(i);
+                if (!ScanDir::isAuthorized(absPath)) {
+                    skipped.prepend(skippedResult(absPath, result.firstChildId + i, job.generation));
+                    continue;
+                }
+                ParallelScanner::Job child;
+                child.absPath = absPath;
+                child.id = result.firstChildId + i;
+                child.generation = job.generation;
+                child.cache = job.cache;
+                child.accounting = job.accounting;
+                children.append(child);
+            }
+            _scanner->push(_index, children);
+        }
+
+        batch.append(result);
+        batch.append(skipped);
+        if (batch.count() >= s_batchSize) {
+            _scanner->addResults(batch);
+        }
+    }
+}
+
+// ParallelScanner
+
+ParallelScanner::ParallelScanner(int threads)
+    : _generation(0), _queuedJobs(0), _idleWorkers(0), _nextId(1)
+{
+    _nextQueue = 0;
+    _stopping = false;
+
+    threads = qMax(1, threads);
+    for (int i = 0; i < threads; i++) {
+        _queues.append(new JobQueue);
+    }
+    for (int i = 0; i < threads; i++) {
+        ScanWorker *w = new ScanWorker(this, i);
+        _workers.append(w);
+        w->start(QThread::LowPriority);
+    }
+}
+
+ParallelScanner::~ParallelScanner()
+{
+    {
+        QMutexLocker locker(&_waitMutex);
+        _stopping = true;
+        _jobsAvailable.wakeAll();
+    }
+    cancel();
+
+    foreach (ScanWorker *w, _workers) {
+        w->wait();
+    }
+    qDeleteAll(_workers);
+    qDeleteAll(_queues);
+}
+
+quint64 ParallelScanner::start(const QString &absPath, const ScanCache *cache,
+                               const QSharedPointer<ScanAccounting> &accounting)
+{
+    Job job;
+    job.absPath = absPath;
+    job.id = _nextId.fetchAndAddRelaxed(1);
+    job.generation = _generation.load();
+    job.cache = cache;
+    job.accounting = accounting;
+
+    if (!ScanDir::isAuthorized(absPath)) {
+        QList<ParallelScanResult> results;
+        results.append(skippedResult(absPath, job.id, job.generation));
+        addResults(results);
+        return job.id;
+    }
+
+    push(_nextQueue, QList<Job>() << job);
+    _nextQueue = (_nextQueue + 1) % _queues.count();
+
+    return job.id;
+}
+
+void ParallelScanner::cancel()
+{
+    _generation.fetchAndAddOrdered(1);
+
+    foreach (JobQueue *q, _queues) {
+        QMutexLocker locker(&q->mutex);
+        _queuedJobs.fetchAndAddOrdered(-q->jobs.count());
+        q->jobs.clear();
+    }
+
+    QMutexLocker locker(&_resultMutex);
+    _results.clear();
+}
+
+QList<ParallelScanResult> ParallelScanner::takeResults(int max)
+{
+    const int generation = _generation.load();
+    QList<ParallelScanResult> results;
+
+    QMutexLocker locker(&_resultMutex);
+    while (!_results.isEmpty() && results.count() < max) {
+        ParallelScanResult result = _results.takeFirst();
+        if (result.generation == generation) {
+            results.append(result);
+        }
+    }
+    return results;
+}
+
+bool ParallelScanner::hasResults()
+{
+    QMutexLocker locker(&_resultMutex);
+    return !_results.isEmpty();
+}
+
+void ParallelScanner::push(int worker, const QList<Job> &jobs)
+{
+    JobQueue *q = _queues.at(worker);
+    {
+        QMutexLocker locker(&q->mutex);
+        q->jobs.append(jobs);
+    }
+    _queuedJobs.fetchAndAddOrdered(jobs.count());
+
+    // Idle workers raise _idleWorkers before they check _queuedJobs,
+    // so either they see the new jobs or we see them waiting.
+    if (_idleWorkers.fetchAndAddOrdered(0) > 0) {
+        QMutexLocker locker(&_waitMutex);
+        _jobsAvailable.wakeAll();
+    }
+}
+
+bool ParallelScanner::pop(int worker, Job &job)
+{
+    // newest job from our own queue
+    {
+        JobQueue *q = _queues.at(worker);
+        QMutexLocker locker(&q->mutex);
+        if (!q->jobs.isEmpty()) {
+            job = q->jobs.takeLast();
+            _queuedJobs.fetchAndAddOrdered(-1);
+            return true;
+        }
+    }
+
+    // steal the oldest job of another worker
+    for (int i = 1; i < _queues.count(); i++) {
+        JobQueue *q = _queues.at((worker + i) % _queues.count());
+        QMutexLocker locker(&q->mutex);
+        if (!q->jobs.isEmpty()) {
+            job = q->jobs.takeFirst();
+            _queuedJobs.fetchAndAddOrdered(-1);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool ParallelScanner::waitForJobs()
+{
+    QMutexLocker locker(&_waitMutex);
+    _idleWorkers.fetchAndAddOrdered(1);
+    while (_queuedJobs.fetchAndAddOrdered(0) <= 0 && !_stopping) {
+        _jobsAvailable.wait(&_waitMutex);
+    }
+    _idleWorkers.fetchAndAddOrdered(-1);
+
+    return !_stopping;
+}
+
+void ParallelScanner::addResults(QList<ParallelScanResult> &results)
+{
+    if (results.isEmpty()) {
+        return;
+    }
+
+    QMutexLocker locker(&_resultMutex);
+    _results.append(results);
+    results.clear();
+}
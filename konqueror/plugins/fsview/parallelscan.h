@@ -0,0 +1,145 @@
+/* This file is part of FSView.
+
+   KCachegrind is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation, version 2.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+/*
+ * Reading directories in worker threads, for ScanManager
+ */
+
+#ifndef KONQ_PLUGIN_PARALLELSCAN_H
+#define KONQ_PLUGIN_PARALLELSCAN_H
+
+#include <QAtomicInt>
+#include <QList>
+#include <QMutex>
+#include <QSharedPointer>
+#include <QWaitCondition>
+
+#include "scan.h"
+
+class ScanWorker;
+
+/**
+ * A directory read by a worker thread.
+ *
+ * The job ids of the subdirectories in contents.dirs are
+ * firstChildId, firstChildId + 1, ...
+ */
+class ParallelScanResult
+{
+public:
+    ParallelScanResult()
+    {
+        id = 0;
+        firstChildId = 0;
+        generation = 0;
+    }
+
+    quint64 id;
+    quint64 firstChildId;
+    int generation;
+    ScanContents contents;
+};
+
+/**
+ * A pool of worker threads reading a directory tree.
+ *
+ * Every worker has its own job queue. It takes jobs from the back
+ * of its own queue (depth first, hot caches), and when that is empty,
+ * steals from the front of the queue of another worker (the largest
+ * pending subtrees). Subdirectories found go into the queue of the
+ * worker which found them, so there is no central queue everyone has
+ * to lock for every directory.
+ *
+ * Results are handed back in batches, and picked up by
+ * ScanManager::scan() with takeResults(). Directories which kiosk
+ * doesn't allow to be listed are not queued at all, their results
+ * come back skipped.
+ */
+class ParallelScanner
+{
+public:
+    explicit ParallelScanner(int threads);
+    ~ParallelScanner();
+
+    int threadCount() const
+    {
+        return _workers.count();
+    }
+
+    /**
+     * Start reading the tree below absPath, in addition to
+     * everything already queued. Directories unchanged since they
+     * were put into cache are taken from there, if it is not 0.
+     * Sizes are counted as accounting says, see ScanAccounting.
+     * Returns the job id of absPath.
+     */
+    quint64 start(const QString &absPath, const ScanCache *cache = 0,
+                  const QSharedPointer<ScanAccounting> &accounting = QSharedPointer<ScanAccounting>());
+
+    /**
+     * Drop all queued jobs and all results not taken yet.
+     * Jobs currently running still finish, but their results are dropped.
+     */
+    void cancel();
+
+    /* Take at most max results */
+    QList<ParallelScanResult> takeResults(int max);
+    bool hasResults();
+
+private:
+    friend class ScanWorker;
+
+    class Job
+    {
+    public:
+        QString absPath;
+        quint64 id;
+        int generation;
+        const ScanCache *cache;
+        // kept alive by the jobs of a cancelled scan still running
+        QSharedPointer<ScanAccounting> accounting;
+    };
+
+    class JobQueue
+    {
+    public:
+        QMutex mutex;
+        QList<Job> jobs;
+    };
+
+    void push(int worker, const QList<Job> &jobs);
+    bool pop(int worker, Job &job);
+    bool waitForJobs();
+    void addResults(QList<ParallelScanResult> &results);
+
+    QList<ScanWorker *> _workers;
+    QList<JobQueue *> _queues;
+    QAtomicInt _generation;
+    QAtomicInt _queuedJobs;
+    QAtomicInt _idleWorkers;
+    QAtomicInteger<quint64> _nextId;
+    int _nextQueue;
+
+    QMutex _waitMutex;
+    QWaitCondition _jobsAvailable;
+    bool _stopping;
+
+    QMutex _resultMutex;
+    QList<ParallelScanResult> _results;
+};
+
+#endif // KONQ_PLUGIN_PARALLELSCAN_H
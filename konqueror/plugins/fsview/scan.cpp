@@ -16,6 +16,9 @@
    Boston, MA 02110-1301, USA.
 */
 
+#include <string.h>
+
+#include <qatomic.h>
 #include <qdir.h>
 #include <qstringlist.h>
 #include <qset.h>
@@ -27,7 +30,82 @@
 #include <kurlauthorized.h>
 
 #include "scan.h"
-#include "inode.h"
+#include "scancache.h"
+#include "parallelscan.h"
+
+#ifdef Q_OS_LINUX
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <dirent.h>
+#endif
+
+// number of worker results applied in one ScanManager::scan() call
+static const int s_resultsPerScan = 100;
+
+// read directories with the system calls directly, not with QDir
+static bool s_nativeReading = true;
+
+// system calls made for reading directories, see ScanDir::systemCalls()
+static QAtomicInteger<quint64> s_systemCalls;
+
+/* Counts the system calls of one reading, adding them to s_systemCalls
+ * once at the end instead of touching the shared counter for every file */
+class SystemCallCounter
+{
+public:
+    SystemCallCounter()
+    {
+        count = 0;
+    }
+    ~SystemCallCounter()
+    {
+        s_systemCalls.fetchAndAddRelaxed(count);
+    }
+
+    quint64 count;
+};
+
+// ScanAccounting
+
+ScanAccounting::ScanAccounting(bool allocatedSize, bool oneFileSystem,
+                               quint64 rootDevice)
+{
+    _deduplicatedSize = 0;
+    _allocatedSize = allocatedSize;
+    _oneFileSystem = oneFileSystem;
+    _rootDevice = rootDevice;
+}
+
+bool ScanAccounting::countedElsewhere(quint64 device, quint64 inode,
+                                      const QString &filePath, KIO::fileoffset_t size)
+{
+    QMutexLocker locker(&_mutex);
+
+    const QPair<quint64, quint64> key(device, inode);
+    QHash<QPair<quint64, quint64>, QString>::const_iterator it = _owners.constFind(key);
+    if (it == _owners.constEnd()) {
+        _owners.insert(key, filePath);
+        return false;
+    }
+    if (it.value() == filePath) {
+        return false;
+    }
+
+    // reading the directory again must not count it twice
+    if (!_duplicates.contains(filePath)) {
+        _duplicates.insert(filePath);
+        _deduplicatedSize += size;
+    }
+    return true;
+}
+
+KIO::fileoffset_t ScanAccounting::deduplicatedSize() const
+{
+    QMutexLocker locker(&_mutex);
+    return _deduplicatedSize;
+}
 
 // ScanManager
 
@@ -35,21 +113,67 @@ ScanManager::ScanManager()
 {
     _topDir = 0;
     _listener = 0;
+    _cache = 0;
+    _allocatedSize = false;
+    _oneFileSystem = false;
+    _scanner = 0;
 }
 
 ScanManager::ScanManager(const QString &path)
 {
     _topDir = 0;
     _listener = 0;
+    _cache = 0;
+    _allocatedSize = false;
+    _oneFileSystem = false;
+    _scanner = 0;
     setTop(path);
 }
 
 ScanManager::~ScanManager()
 {
     stopScan();
+    delete _scanner;
     delete _topDir;
 }
 
+void ScanManager::setThreadCount(int threads)
+{
+    if (threads == threadCount()) {
+        return;
+    }
+
+    stopScan();
+    delete _scanner;
+    _scanner = (threads > 0) ? new ParallelScanner(threads) : 0;
+}
+
+void ScanManager::setCache(ScanCache *cache)
+{
+    stopScan();
+    _cache = cache;
+}
+
+int ScanManager::threadCount() const
+{
+    return _scanner ? _scanner->threadCount() : 0;
+}
+
+void ScanManager::setAllocatedSize(bool allocated)
+{
+    _allocatedSize = allocated;
+}
+
+void ScanManager::setOneFileSystem(bool one)
+{
+    _oneFileSystem = one;
+}
+
+KIO::fileoffset_t ScanManager::deduplicatedSize() const
+{
+    return _accounting ? _accounting->deduplicatedSize() : 0;
+}
+
 void ScanManager::setListener(ScanListener *l)
 {
     _listener = l;
@@ -68,16 +192,68 @@ ScanDir *ScanManager::setTop(const QString &path, int data)
     return _topDir;
 }
 
+ScanDir *ScanManager::findDir(const QString &absPath)
+{
+    if (!_topDir) {
+        return 0;
+    }
+
+    QString top = _topDir->path();
+    if (absPath == top) {
+        return _topDir;
+    }
+    if (!top.endsWith(QLatin1Char('/'))) {
+        top += QLatin1Char('/');
+    }
+    if (!absPath.startsWith(top)) {
+        return 0;
+    }
+
+    ScanDir *d = _topDir;
+    const QStringList names = absPath.mid(top.length()).split(QLatin1Char('/'),
+                                                              QString::SkipEmptyParts);
+    QStringList::ConstIterator name;
+    for (name = names.constBegin(); name != names.constEnd(); ++name) {
+        ScanDirVector &dirs = d->dirs();
+        ScanDir *found = 0;
+        ScanDirVector::iterator it;
+        for (it = dirs.begin(); it != dirs.end(); ++it) {
+            if ((*it).name() == *name) {
+                found = &(*it);
+                break;
+            }
+        }
+        if (!found) {
+            return 0;
+        }
+        d = found;
+    }
+    return d;
+}
+
 bool ScanManager::scanRunning()
 {
     if (!_topDir) {
         return false;
     }
 
+    // directories queued for worker threads are not started yet
+    if (!_jobDirs.isEmpty()) {
+        return true;
+    }
+
     return _topDir->scanRunning();
 }
 
-void ScanManager::startScan(ScanDir *from)
+bool ScanManager::scanReady() const
+{
+    if (_scanner) {
+        return _scanner->hasResults();
+    }
+    return !_list.isEmpty();
+}
+
+void ScanManager::startScan(ScanDir *from, bool useCache)
 {
     if (!_topDir) {
         return;
@@ -95,7 +271,23 @@ void ScanManager::startScan(ScanDir *from)
         from->parent()->setupChildRescan();
     }
 
-    _list.append(new ScanItem(from->path(), from));
+    // a rescan below the top has to count like the scan it is part of
+    if (from == _topDir || !_accounting) {
+        quint64 rootDevice = 0;
+        QT_STATBUF buff;
+        if (QT_STAT(QFile::encodeName(_topDir->path()).constData(), &buff) == 0) {
+            rootDevice = buff.st_dev;
+        }
+        _accounting = QSharedPointer<ScanAccounting>(
+                          new ScanAccounting(_allocatedSize, _oneFileSystem, rootDevice));
+    }
+
+    const ScanCache *cache = useCache ? _cache : 0;
+    if (_scanner) {
+        _jobDirs.insert(_scanner->start(from->path(), cache, _accounting), from);
+    } else {
+        _list.append(new ScanItem(from->path(), from, cache, _accounting.data()));
+    }
 }
 
 void ScanManager::stopScan()
@@ -112,10 +304,33 @@ void ScanManager::stopScan()
         si->dir->finish();
         delete si;
     }
+
+    if (_scanner) {
+        _scanner->cancel();
+
+        QHash<quint64, ScanDir *>::const_iterator it;
+        for (it = _jobDirs.constBegin(); it != _jobDirs.constEnd(); ++it) {
+            if (it.value()) {
+                it.value()->finish();
+            }
+        }
+        _jobDirs.clear();
+        qDeleteAll(_orphans);
+        _orphans.clear();
+    }
 }
 
 int ScanManager::scan(int data)
 {
+    if (_scanner) {
+        int newCount = 0;
+        const QList<ParallelScanResult> results = _scanner->takeResults(s_resultsPerScan);
+        foreach (const ParallelScanResult &result, results) {
+            newCount += applyResult(result, data);
+        }
+        return newCount;
+    }
+
     if (_list.isEmpty()) {
         return false;
     }
@@ -127,26 +342,44 @@ int ScanManager::scan(int data)
     return newCount;
 }
 
-// ScanFile
-
-ScanFile::ScanFile()
+int ScanManager::applyResult(const ParallelScanResult &first, int data)
 {
-    _size = 0;
-    _listener = 0;
-}
+    int newCount = 0;
+
+    // applying a result may make orphans of its subdirectories applicable
+    QList<ParallelScanResult> todo;
+    todo.append(first);
+    while (!todo.isEmpty()) {
+        ParallelScanResult r = todo.takeFirst();
+
+        QHash<quint64, ScanDir *>::iterator it = _jobDirs.find(r.id);
+        if (it == _jobDirs.end()) {
+            // parent directory not applied yet
+            _orphans.insert(r.id, new ParallelScanResult(r));
+            continue;
+        }
+        ScanDir *dir = it.value();
+        _jobDirs.erase(it);
 
-ScanFile::ScanFile(const QString &n, KIO::fileoffset_t s)
-{
-    _name = n;
-    _size = s;
-    _listener = 0;
-}
+        // directories not allowed to be listed were never read, see ParallelScanner
+        const int subDirs = r.contents.dirs.count();
+        if (dir) {
+            newCount += dir->setContents(r.contents, data);
+        }
 
-ScanFile::~ScanFile()
-{
-    if (_listener) {
-        _listener->destroyed(this);
+        for (int i = 0; i < subDirs; i++) {
+            const quint64 id = r.firstChildId + i;
+            _jobDirs.insert(id, dir ? dir->dirs().data() + i : 0);
+
+            ParallelScanResult *orphan = _orphans.take(id);
+            if (orphan) {
+                todo.append(*orphan);
+                delete orphan;
+            }
+        }
     }
+
+    return newCount;
 }
 
 // ScanDir
@@ -154,6 +387,8 @@ ScanFile::~ScanFile()
 ScanDir::ScanDir()
 {
     _dirty = true;
+    _filesCached = false;
+    _cachedFileCount = 0;
     _dirsFinished = -1; /* scan not started */
 
     _parent = Q_NULLPTR;
@@ -167,6 +402,8 @@ ScanDir::ScanDir(const QString &n, ScanManager *m,
     : _name(n)
 {
     _dirty = true;
+    _filesCached = false;
+    _cachedFileCount = 0;
     _dirsFinished = -1; /* scan not started */
 
     _parent = p;
@@ -177,6 +414,7 @@ ScanDir::ScanDir(const QString &n, ScanManager *m,
 
 ScanDir::~ScanDir()
 {
+    clearFiles();
     if (_listener) {
         _listener->destroyed(this);
     }
@@ -187,6 +425,27 @@ void ScanDir::setListener(ScanListener *l)
     _listener = l;
 }
 
+void ScanDir::setFileListener(const ScanFile *f, ScanListener *l)
+{
+    const int i = f - _files.constData();
+    if (l) {
+        _fileListeners.insert(i, l);
+    } else {
+        _fileListeners.remove(i);
+    }
+}
+
+void ScanDir::clearFiles()
+{
+    QHash<int, ScanListener *>::const_iterator it;
+    for (it = _fileListeners.constBegin(); it != _fileListeners.constEnd(); ++it) {
+        it.value()->destroyed(_files.data() + it.key());
+    }
+    _fileListeners.clear();
+    _files.clear();
+    _fileNames.clear();
+}
+
 QString ScanDir::path()
 {
     if (_parent) {
@@ -205,7 +464,9 @@ void ScanDir::clear()
     _dirty = true;
     _dirsFinished = -1; /* scan not started */
 
-    _files.clear();
+    _filesCached = false;
+    _cachedFileCount = 0;
+    clearFiles();
     _dirs.clear();
 }
 
@@ -224,8 +485,9 @@ void ScanDir::update()
         return;
     }
 
-    if (_files.count() > 0) {
-        _fileCount += _files.count();
+    const unsigned int files = _filesCached ? _cachedFileCount : _files.count();
+    if (files > 0) {
+        _fileCount += files;
         _size = _fileSize;
     }
     if (_dirs.count() > 0) {
@@ -240,80 +502,404 @@ void ScanDir::update()
     }
 }
 
-bool ScanDir::isForbiddenDir(QString &d)
+bool ScanDir::isForbiddenDir(const QString &d)
 {
-    static QSet<QString> *s = 0;
+    // directories without real files on Linux
+    // TODO: should be OS specific
+    // (function local statics are initialized thread-safe)
+    static const QSet<QString> s = QSet<QString>()
+                                   << QStringLiteral("/proc")
+                                   << QStringLiteral("/dev")
+                                   << QStringLiteral("/sys");
+
+    return (s.contains(d));
+}
 
-    if (!s) {
-        s = new QSet<QString>;
-        // directories without real files on Linux
-        // TODO: should be OS specific
-        s->insert(QStringLiteral("/proc"));
-        s->insert(QStringLiteral("/dev"));
-        s->insert(QStringLiteral("/sys"));
+bool ScanDir::isAuthorized(const QString &absPath)
+{
+    KUrl u;
+    u.setPath(absPath);
+    return KUrlAuthorized::authorizeUrlAction(QStringLiteral("list"), KUrl(), u);
+}
+
+template<typename Stat>
+static KIO::fileoffset_t allocatedSize(const Stat &buff)
+{
+#ifdef Q_OS_WIN
+    return buff.st_size;
+#else
+    return KIO::fileoffset_t(buff.st_blocks) * 512;
+#endif
+}
+
+static QString filePath(const QString &absPath, const QString &name)
+{
+    QString path = absPath;
+    if (!path.endsWith(QLatin1Char('/'))) {
+        path += QLatin1Char('/');
     }
-    return (s->contains(d));
+    return path + name;
 }
 
-int ScanDir::scan(ScanItem *si, ScanItemList &list, int data)
+/* Append a file to contents, counted as contents.accounting says */
+static void addFile(ScanContents &contents, const char *name, int length,
+                    KIO::fileoffset_t size, KIO::fileoffset_t allocated,
+                    quint64 linkCount, quint64 device, quint64 inode)
 {
-    clear();
-    _dirsFinished = 0;
-    _fileSize = 0;
-    _dirty = true;
+    ScanAccounting *accounting = contents.accounting;
+    KIO::fileoffset_t counted = (accounting && accounting->allocatedSize()) ? allocated : size;
+
+    if (linkCount > 1) {
+        ScanHardLink link;
+        link.name = QFile::decodeName(QByteArray::fromRawData(name, length));
+        link.inode = inode;
+        link.size = size;
+        link.allocatedSize = allocated;
+        contents.links.append(link);
+
+        if (accounting && accounting->countedElsewhere(device, inode,
+                                                       filePath(contents.absPath, link.name), counted)) {
+            counted = 0;
+        }
+    }
 
-    if (isForbiddenDir(si->absPath)) {
-        if (_parent) {
-            _parent->subScanFinished();
+    contents.files.append(ScanFile(contents.fileNames.size(), length, counted));
+    contents.fileNames.append(name, length);
+    contents.fileSize += counted;
+    contents.apparentSize += size;
+    contents.allocatedSize += allocated;
+}
+
+/* Drop the files read so far, to read them again */
+static void resetFiles(ScanContents &contents)
+{
+    contents.files.clear();
+    contents.fileNames.clear();
+    contents.links.clear();
+    contents.fileSize = 0;
+    contents.apparentSize = 0;
+    contents.allocatedSize = 0;
+    contents.fileCount = 0;
+}
+
+/* Set contents from a cache entry, counting its files as if read */
+static void takeCached(ScanContents &contents, const ScanCacheEntry &entry)
+{
+    contents.cached = true;
+    contents.fileCount = entry.fileCount;
+    contents.apparentSize = entry.fileSize;
+    contents.allocatedSize = entry.allocatedSize;
+    contents.links = entry.links;
+    contents.dirs = entry.dirs;
+
+    ScanAccounting *accounting = contents.accounting;
+    const bool allocated = accounting && accounting->allocatedSize();
+    contents.fileSize = allocated ? entry.allocatedSize : entry.fileSize;
+    if (!accounting) {
+        return;
+    }
+    foreach (const ScanHardLink &link, entry.links) {
+        const KIO::fileoffset_t size = allocated ? link.allocatedSize : link.size;
+        if (accounting->countedElsewhere(contents.device, link.inode,
+                                         filePath(contents.absPath, link.name), size)) {
+            contents.fileSize -= size;
         }
-        return 0;
     }
+}
 
-    KUrl u;
-    u.setPath(si->absPath);
-    if (!KUrlAuthorized::authorizeUrlAction(QStringLiteral("list"), KUrl(), u)) {
-        if (_parent) {
-            _parent->subScanFinished();
+/* True if the directory of contents is not to be read, being on another file system */
+static bool onOtherFileSystem(const ScanContents &contents)
+{
+    return contents.accounting && contents.accounting->oneFileSystem() &&
+           contents.device != contents.accounting->rootDevice();
+}
+
+#ifdef Q_OS_LINUX
+
+// a record filled in by getdents64(), glibc has no declaration for it
+struct LinuxDirent64 {
+    quint64 d_ino;
+    qint64 d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[1];
+};
+
+/*
+ * Read the entries of the directory opened as dirFd. Like QDir with
+ * Files | Dirs | Hidden | NoSymLinks, only regular files and directories
+ * count. Directories are known from d_type without a stat, and files are
+ * stat'ed relative to dirFd, so the kernel doesn't walk the whole path
+ * again for every one of them.
+ */
+static bool readDirFd(int dirFd, ScanContents &contents, bool withDirs,
+                      SystemCallCounter &calls)
+{
+    // aligned for the records
+    quint64 records[4096];
+    const char *buffer = reinterpret_cast<const char *>(records);
+
+    while (true) {
+        const long n = syscall(SYS_getdents64, dirFd, records, sizeof(records));
+        calls.count++;
+        if (n < 0) {
+            return false;
+        }
+        if (n == 0) {
+            break;
         }
 
-        return 0;
+        for (long pos = 0; pos < n;) {
+            const LinuxDirent64 *entry = reinterpret_cast<const LinuxDirent64 *>(buffer + pos);
+            pos += entry->d_reclen;
+
+            const char *name = entry->d_name;
+            if (name[0] == '.' && (name[1] == 0 || (name[1] == '.' && name[2] == 0))) {
+                continue;
+            }
+
+            unsigned char type = entry->d_type;
+            struct stat buff;
+            // not all file systems fill in d_type
+            if (type == DT_REG || type == DT_UNKNOWN) {
+                calls.count++;
+                if (fstatat(dirFd, name, &buff, AT_SYMLINK_NOFOLLOW) != 0) {
+                    continue;
+                }
+                type = S_ISDIR(buff.st_mode) ? DT_DIR : S_ISREG(buff.st_mode) ? DT_REG : DT_UNKNOWN;
+            }
+
+            if (type == DT_DIR) {
+                if (withDirs) {
+                    contents.dirs.append(QFile::decodeName(name));
+                }
+            } else if (type == DT_REG) {
+                addFile(contents, name, strlen(name), buff.st_size, allocatedSize(buff),
+                        buff.st_nlink, buff.st_dev, buff.st_ino);
+            }
+        }
+    }
+
+    contents.fileCount = contents.files.count();
+    return true;
+}
+
+#endif
+
+void ScanDir::setNativeReading(bool native)
+{
+    s_nativeReading = native;
+}
+
+quint64 ScanDir::systemCalls()
+{
+    return s_systemCalls.load();
+}
+
+void ScanDir::readContents(ScanContents &contents, const ScanCache *cache)
+{
+    if (isForbiddenDir(contents.absPath)) {
+        contents.skipped = true;
+        return;
+    }
+
+    SystemCallCounter calls;
+#ifdef Q_OS_LINUX
+    if (s_nativeReading) {
+        const int fd = open(QFile::encodeName(contents.absPath).constData(),
+                            O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        calls.count++;
+        if (fd >= 0) {
+            struct stat buff;
+            // and close() below
+            calls.count += 2;
+            if (fstat(fd, &buff) == 0) {
+                contents.device = buff.st_dev;
+                contents.inode = buff.st_ino;
+                contents.mtime = buff.st_mtime;
+
+                if (onOtherFileSystem(contents)) {
+                    contents.skipped = true;
+                    close(fd);
+                    return;
+                }
+
+                ScanCacheEntry entry;
+                if (cache && cache->lookup(contents.absPath, contents.device,
+                                           contents.inode, contents.mtime, entry)) {
+                    takeCached(contents, entry);
+                    close(fd);
+                    return;
+                }
+            }
+
+            const bool ok = readDirFd(fd, contents, true, calls);
+            close(fd);
+            if (ok) {
+                return;
+            }
+            // failed half way, start over
+            resetFiles(contents);
+            contents.dirs.clear();
+        }
+        // not allowed to open it, let QDir handle it as before
+    }
+#endif
+
+    QT_STATBUF buff;
+    calls.count++;
+    if (QT_LSTAT(QFile::encodeName(contents.absPath).constData(), &buff) == 0) {
+        contents.device = buff.st_dev;
+        contents.inode = buff.st_ino;
+        contents.mtime = buff.st_mtime;
+
+        if (onOtherFileSystem(contents)) {
+            contents.skipped = true;
+            return;
+        }
+
+        ScanCacheEntry entry;
+        if (cache && cache->lookup(contents.absPath, contents.device,
+                                   contents.inode, contents.mtime, entry)) {
+            takeCached(contents, entry);
+            return;
+        }
+    }
+
+    // the native read above failed or is disabled, don't try it again
+    QDir d(contents.absPath);
+    readFilesQDir(d, contents);
+
+    contents.dirs = d.entryList(QDir::Dirs |
+                                QDir::Hidden | QDir::NoSymLinks | QDir::NoDotAndDotDot);
+}
+
+void ScanDir::readFiles(const QDir &d, ScanContents &contents)
+{
+#ifdef Q_OS_LINUX
+    if (s_nativeReading) {
+        SystemCallCounter calls;
+        const int fd = open(QFile::encodeName(contents.absPath).constData(),
+                            O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        calls.count++;
+        if (fd >= 0) {
+            calls.count++; // close()
+            const bool ok = readDirFd(fd, contents, false, calls);
+            close(fd);
+            if (ok) {
+                return;
+            }
+            resetFiles(contents);
+        }
     }
+#endif
+
+    readFilesQDir(d, contents);
+}
 
-    QDir d(si->absPath);
+void ScanDir::readFilesQDir(const QDir &d, ScanContents &contents)
+{
+    SystemCallCounter calls;
     const QStringList fileList = d.entryList(QDir::Files |
                                  QDir::Hidden | QDir::NoSymLinks);
 
     if (fileList.count() > 0) {
         QT_STATBUF buff;
 
-        _files.reserve(fileList.count());
+        contents.files.reserve(fileList.count());
 
         QStringList::ConstIterator it;
         for (it = fileList.constBegin(); it != fileList.constEnd(); ++it) {
-            QString tmp(si->absPath + QLatin1Char('/') + (*it));
-            if (QT_LSTAT(tmp.toStdString().c_str(), &buff) != 0) {
+            QString tmp(contents.absPath + QLatin1Char('/') + (*it));
+            calls.count++;
+            if (QT_LSTAT(QFile::encodeName(tmp).constData(), &buff) != 0) {
                 continue;
             }
-            _files.append(ScanFile(*it, buff.st_size));
-            _fileSize += buff.st_size;
+            const QByteArray name = QFile::encodeName(*it);
+            addFile(contents, name.constData(), name.size(), buff.st_size, allocatedSize(buff),
+                    buff.st_nlink, buff.st_dev, buff.st_ino);
+        }
+    }
+    contents.fileCount = contents.files.count();
+}
+
+void ScanDir::loadFiles()
+{
+    _filesCached = false;
+
+    ScanContents contents;
+    contents.absPath = path();
+    contents.accounting = _manager ? _manager->accounting() : 0;
+    if (!isForbiddenDir(contents.absPath)) {
+        readFiles(QDir(contents.absPath), contents);
+    }
+    clearFiles();
+    _files.swap(contents.files);
+    _fileNames.swap(contents.fileNames);
+    _fileSize = contents.fileSize;
+
+    // the files may have changed since they were counted
+    for (ScanDir *d = this; d; d = d->_parent) {
+        d->_dirty = true;
+    }
+}
+
+int ScanDir::scan(ScanItem *si, ScanItemList &list, int data)
+{
+    ScanContents contents;
+    contents.absPath = si->absPath;
+    contents.accounting = si->accounting;
+
+    if (isForbiddenDir(si->absPath) || !isAuthorized(si->absPath)) {
+        contents.skipped = true;
+    } else {
+        readContents(contents, si->cache);
+    }
+
+    int newCount = setContents(contents, data);
+
+    for (int i = 0; i < newCount; i++) {
+        QString newpath = si->absPath;
+        if (!newpath.endsWith(QChar('/'))) {
+            newpath.append("/");
+        }
+        newpath.append(contents.dirs.at(i));
+        list.append(new ScanItem(newpath, _dirs.data() + i, si->cache, si->accounting));
+    }
+
+    return newCount;
+}
+
+int ScanDir::setContents(ScanContents &contents, int data)
+{
+    clear();
+    _dirsFinished = 0;
+    _fileSize = 0;
+    _dirty = true;
+
+    if (contents.skipped) {
+        if (_parent) {
+            _parent->subScanFinished();
         }
+        return 0;
     }
 
-    const QStringList dirList = d.entryList(QDir::Dirs |
-                                            QDir::Hidden | QDir::NoSymLinks | QDir::NoDotAndDotDot);
+    _files.swap(contents.files);
+    _fileNames.swap(contents.fileNames);
+    _fileSize = contents.fileSize;
+    if (contents.cached) {
+        _filesCached = true;
+        _cachedFileCount = contents.fileCount;
+    } else {
+        cacheContents(contents);
+    }
 
-    if (dirList.count() > 0) {
-        _dirs.reserve(dirList.count());
+    if (contents.dirs.count() > 0) {
+        _dirs.reserve(contents.dirs.count());
 
         QStringList::ConstIterator it;
-        for (it = dirList.constBegin(); it != dirList.constEnd(); ++it) {
+        for (it = contents.dirs.constBegin(); it != contents.dirs.constEnd(); ++it) {
             _dirs.append(ScanDir(*it, _manager, this, data));
-            QString newpath = si->absPath;
-            if (!newpath.endsWith(QChar('/'))) {
-                newpath.append("/");
-            }
-            newpath.append(*it);
-            list.append(new ScanItem(newpath, &(_dirs.last())));
         }
         _dirCount += _dirs.count();
     }
@@ -332,6 +918,68 @@ int ScanDir::scan(ScanItem *si, ScanItemList &list, int data)
     return _dirs.count();
 }
 
+void ScanDir::cacheContents(const ScanContents &contents)
+{
+    if (contents.inode == 0 || !_manager || !_manager->cache()) {
+        return;
+    }
+
+    ScanCacheEntry entry;
+    entry.device = contents.device;
+    entry.inode = contents.inode;
+    entry.mtime = contents.mtime;
+    entry.fileCount = contents.fileCount;
+    entry.fileSize = contents.apparentSize;
+    entry.allocatedSize = contents.allocatedSize;
+    entry.links = contents.links;
+    entry.dirs = contents.dirs;
+    _manager->cache()->insert(contents.absPath, entry);
+}
+
+bool ScanDir::refreshFiles()
+{
+    if (!scanStarted() || !scanFinished()) {
+        return false;
+    }
+
+    ScanContents contents;
+    contents.absPath = path();
+    contents.accounting = _manager ? _manager->accounting() : 0;
+    if (isForbiddenDir(contents.absPath) || !isAuthorized(contents.absPath)) {
+        return false;
+    }
+    // the cache would say nothing changed if it happened in the same second
+    readContents(contents);
+    if (contents.skipped || contents.inode == 0) {
+        return false;
+    }
+
+    // read in directory order, which may differ from the last time
+    QStringList oldDirs;
+    oldDirs.reserve(_dirs.count());
+    ScanDirVector::iterator it;
+    for (it = _dirs.begin(); it != _dirs.end(); ++it) {
+        oldDirs.append((*it).name());
+    }
+    QStringList newDirs = contents.dirs;
+    oldDirs.sort();
+    newDirs.sort();
+    if (oldDirs != newDirs) {
+        return false;
+    }
+
+    clearFiles();
+    _filesCached = false;
+    _cachedFileCount = 0;
+    _files.swap(contents.files);
+    _fileNames.swap(contents.fileNames);
+    _fileSize = contents.fileSize;
+    cacheContents(contents);
+
+    callSizeChanged();
+    return true;
+}
+
 void ScanDir::subScanFinished()
 {
     _dirsFinished++;
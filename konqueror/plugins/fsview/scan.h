@@ -24,23 +24,91 @@
 #define KONQ_PLUGIN_SCAN_H
 
 #include <qfile.h>
+#include <qhash.h>
+#include <qmutex.h>
+#include <qpair.h>
+#include <qset.h>
+#include <qstringlist.h>
+#include <QSharedPointer>
 #include <QVector>
 #include <kio/global.h>
 
+class QDir;
 class ScanDir;
 class ScanFile;
+class ScanCache;
+class ParallelScanner;
+class ParallelScanResult;
+
+/**
+ * How the sizes of files are counted in one scan.
+ *
+ * A file with several hard links is counted once, at the first of its
+ * paths the scan comes across. That path keeps it for rescans of parts
+ * of the tree, so sizes don't change however often a directory is read.
+ * Optionally, files count with the blocks allocated for them instead of
+ * their length, which makes sparse files small, and directories on other
+ * file systems than the top directory are skipped.
+ */
+class ScanAccounting
+{
+public:
+    ScanAccounting(bool allocatedSize = false, bool oneFileSystem = false,
+                   quint64 rootDevice = 0);
+
+    bool allocatedSize() const
+    {
+        return _allocatedSize;
+    }
+    bool oneFileSystem() const
+    {
+        return _oneFileSystem;
+    }
+    quint64 rootDevice() const
+    {
+        return _rootDevice;
+    }
+
+    /**
+     * Returns true if the file at filePath is a hard link of a file
+     * counted at another path, and remembers size as deduplicated then.
+     * Thread-safe.
+     */
+    bool countedElsewhere(quint64 device, quint64 inode,
+                          const QString &filePath, KIO::fileoffset_t size);
+
+    /* Bytes of hard links not counted, as they are counted elsewhere */
+    KIO::fileoffset_t deduplicatedSize() const;
+
+private:
+    mutable QMutex _mutex;
+    // the path counting a file, by device and inode
+    QHash<QPair<quint64, quint64>, QString> _owners;
+    // paths found to be counted elsewhere
+    QSet<QString> _duplicates;
+    KIO::fileoffset_t _deduplicatedSize;
+
+    bool _allocatedSize, _oneFileSystem;
+    quint64 _rootDevice;
+};
 
 class ScanItem
 {
 public:
-    ScanItem(const QString &p, ScanDir *d)
+    ScanItem(const QString &p, ScanDir *d, const ScanCache *c = 0,
+             ScanAccounting *a = 0)
     {
         absPath = p;
         dir = d;
+        cache = c;
+        accounting = a;
     }
 
     QString absPath;
     ScanDir *dir;
+    // where to look up unchanged directories, if anywhere
+    const ScanCache *cache;
+    ScanAccounting *accounting;
 };
 
 typedef QList<ScanItem *> ScanItemList;
@@ -75,6 +143,12 @@ public:
  *   ScanManager m("/opt");
  *   m.startScan();
  *   while(m.scan());
+ *
+ * By default, scan() reads one directory per call in the calling
+ * thread. With setThreadCount(), directories are read by worker
+ * threads instead, and scan() only applies the finished results
+ * to the ScanDir tree. All ScanDir objects and listener callbacks
+ * still live in the thread calling scan().
  */
 class ScanManager
 {
@@ -83,6 +157,55 @@ public:
     ScanManager(const QString &path);
     ~ScanManager();
 
+    /**
+     * Look up directories unchanged since a previous scan in cache,
+     * instead of reading them again, and put everything read into it.
+     * The cache is not owned, 0 switches it off.
+     * Stops a running scan.
+     */
+    void setCache(ScanCache *);
+    ScanCache *cache()
+    {
+        return _cache;
+    }
+
+    /**
+     * Set the number of worker threads reading directories.
+     * 0 switches back to reading in scan() itself.
+     * Stops a running scan.
+     */
+    void setThreadCount(int threads);
+    int threadCount() const;
+
+    /**
+     * Count files with the blocks allocated for them instead of
+     * their length. Used from the next scan of the top directory.
+     */
+    void setAllocatedSize(bool);
+    bool allocatedSize() const
+    {
+        return _allocatedSize;
+    }
+
+    /**
+     * Skip directories on other file systems than the top directory.
+     * Used from the next scan of the top directory.
+     */
+    void setOneFileSystem(bool);
+    bool oneFileSystem() const
+    {
+        return _oneFileSystem;
+    }
+
+    /* How sizes are counted in the current scan, 0 before the first one */
+    ScanAccounting *accounting()
+    {
+        return _accounting.data();
+    }
+
+    /* Bytes of hard links not counted again in the current scan */
+    KIO::fileoffset_t deduplicatedSize() const;
+
     /** Set the top path for scanning
      * The ScanDir object created gets attribute data.
      */
@@ -92,12 +215,22 @@ public:
         return _topDir;
     }
 
+    /* The directory with absolute path absPath, 0 if not below the top */
+    ScanDir *findDir(const QString &absPath);
+
     bool scanRunning();
     int scanLength() const
     {
-        return _list.count();
+        return _scanner ? _jobDirs.count() : _list.count();
     }
 
+    /**
+     * Returns true if a call to scan() would do any work right now.
+     * With worker threads, this is false while they are still busy
+     * reading, so callers polling scan() can back off.
+     */
+    bool scanReady() const;
+
     /**
      * Starts the scan. Stop previous scan if running.
      * For the actual scan to happen, you have to call
@@ -105,8 +238,11 @@ public:
      *
      * If from !=0, restart scan at given position; from must
      * be from the previous scan of this manager.
+     *
+     * With useCache false, every directory is read again, even
+     * if the cache says it did not change.
      */
-    void startScan(ScanDir *from = 0);
+    void startScan(ScanDir *from = 0, bool useCache = true);
 
     /** Stop a current running scan.
      * Make all directories to finish their scan.
@@ -115,6 +251,7 @@ public:
 
     /**
      * Scan first directory from todo list.
+     * With worker threads, apply a batch of directories read by them.
      * Directories added to the todo list are attributed with data.
      * Returns the number of new subdirectories created for scanning.
      */
@@ -128,46 +265,134 @@ public:
     }
 
 private:
+    int applyResult(const ParallelScanResult &, int data);
+
     ScanItemList _list;
     ScanDir *_topDir;
     ScanListener *_listener;
+    ScanCache *_cache;
+    bool _allocatedSize, _oneFileSystem;
+    // shared with worker threads, which may still be reading for
+    // a cancelled scan when the next one starts
+    QSharedPointer<ScanAccounting> _accounting;
+
+    // only used with worker threads
+    ParallelScanner *_scanner;
+    // jobs queued in the scanner, with the directory their result goes to.
+    // 0 if the result is to be dropped.
+    QHash<quint64, ScanDir *> _jobDirs;
+    // results which arrived before the result of their parent directory
+    QHash<quint64, ParallelScanResult *> _orphans;
 };
 
+/**
+ * A file in a scanned directory.
+ *
+ * There can be millions of them, so they are kept small: the name is
+ * a slice of the file name buffer of the directory (see
+ * ScanDir::fileName()), in the 8 bit encoding it has on disk, and
+ * listeners are kept by the directory for the few files which have one.
+ */
 class ScanFile
 {
 public:
-    ScanFile();
-    ScanFile(const QString &n, KIO::fileoffset_t s);
-    ~ScanFile();
-
-    const QString &name()
+    ScanFile()
     {
-        return _name;
+        _nameOffset = 0;
+        _nameLength = 0;
+        _size = 0;
     }
-    KIO::fileoffset_t size()
+    ScanFile(quint32 nameOffset, quint32 nameLength, KIO::fileoffset_t s)
     {
-        return _size;
+        _nameOffset = nameOffset;
+        _nameLength = nameLength;
+        _size = s;
     }
 
-    /* set listener to get callbacks from this ScanDir */
-    void setListener(ScanListener *l)
+    quint32 nameOffset() const
     {
-        _listener = l;
+        return _nameOffset;
     }
-    ScanListener *listener()
+    quint32 nameLength() const
     {
-        return _listener;
+        return _nameLength;
+    }
+    KIO::fileoffset_t size() const
+    {
+        return _size;
     }
 
 private:
-    QString _name;
+    quint32 _nameOffset, _nameLength;
     KIO::fileoffset_t _size;
-    ScanListener *_listener;
 };
 
 typedef QVector<ScanFile> ScanFileVector;
 typedef QVector<ScanDir> ScanDirVector;
 
+/**
+ * A file of a directory which has more than one hard link.
+ * Kept with cached directories, to count them once without reading.
+ */
+class ScanHardLink
+{
+public:
+    ScanHardLink()
+    {
+        inode = 0;
+        size = 0;
+        allocatedSize = 0;
+    }
+
+    QString name;
+    quint64 inode;
+    KIO::fileoffset_t size, allocatedSize;
+};
+
+/**
+ * The contents of one directory, as read by ScanDir::readContents().
+ * Reading does not touch any ScanDir, so it can be done in a worker thread.
+ */
+class ScanContents
+{
+public:
+    ScanContents()
+    {
+        accounting = 0;
+        fileSize = 0;
+        apparentSize = 0;
+        allocatedSize = 0;
+        fileCount = 0;
+        skipped = false;
+        cached = false;
+        device = 0;
+        inode = 0;
+        mtime = 0;
+    }
+
+    QString absPath;
+    // how to count sizes, 0 for the length of every file
+    ScanAccounting *accounting;
+
+    ScanFileVector files;
+    // the names of files, see ScanFile
+    QByteArray fileNames;
+    QStringList dirs;
+    // the size counted, and the sums of lengths and allocated blocks
+    KIO::fileoffset_t fileSize, apparentSize, allocatedSize;
+    QVector<ScanHardLink> links;
+    unsigned int fileCount;
+    // forbidden or not allowed to be listed, no contents
+    bool skipped;
+    // taken from a ScanCache: only fileCount and fileSize, no files
+    bool cached;
+
+    // the directory itself, inode 0 if it could not be stat'ed
+    quint64 device;
+    quint64 inode;
+    qint64 mtime;
+};
+
 /**
  * A directory to scan.
  * You can attribute a directory to scan with a
@@ -189,9 +414,47 @@ public:
      */
     int scan(ScanItem *si, ScanItemList &list, int data);
 
+    /* Set the items of this directory from contents read before.
+     * Subdirectories are attributed with data.
+     * Returns the number of new subdirectories, which still have
+     * to be scanned.
+     */
+    int setContents(ScanContents &contents, int data);
+
+    /* Read the items of directory contents.absPath, without
+     * touching any ScanDir. Thread-safe.
+     * If the directory did not change since cache got its contents,
+     * they are taken from there. Sizes are counted as told by
+     * contents.accounting.
+     */
+    static void readContents(ScanContents &contents, const ScanCache *cache = 0);
+
+    /* On Linux, directories are read with getdents64() and fstatat()
+     * by default. Switch back to QDir and lstat() with false, e.g. to
+     * compare both. Not thread-safe, set it before scanning.
+     */
+    static void setNativeReading(bool native);
+
+    /* Number of system calls made for reading directories so far, by
+     * all scans. The ones QDir makes internally are not counted.
+     * Thread-safe. */
+    static quint64 systemCalls();
+
+    /* Kiosk check for listing a directory. Thread-safe, the worker
+     * threads check every directory before they queue it. */
+    static bool isAuthorized(const QString &absPath);
+
     /* clear scan objects below */
     void clear();
 
+    /*
+     * Read the files of a finished directory again, e.g. after they
+     * changed, keeping the subdirectories. Returns false without
+     * changing anything if subdirectories were added or removed, or the
+     * directory can't be read anymore: it has to be scanned again.
+     */
+    bool refreshFiles();
+
     /*
      * Setup for child rescan
      */
@@ -212,8 +475,17 @@ public:
 
     ScanFileVector &files()
     {
+        if (_filesCached) {
+            loadFiles();
+        }
         return _files;
     }
+    /* name of file f of this directory */
+    QString fileName(const ScanFile &f) const
+    {
+        return QFile::decodeName(QByteArray::fromRawData(_fileNames.constData() + f.nameOffset(),
+                                                         f.nameLength()));
+    }
     ScanDirVector &dirs()
     {
         return _dirs;
@@ -260,6 +532,8 @@ public:
     {
         return _listener;
     }
+    /* set listener for file f of this directory, to learn when it goes away */
+    void setFileListener(const ScanFile *f, ScanListener *);
     ScanManager *manager()
     {
         return _manager;
@@ -270,7 +544,16 @@ public:
 
 private:
     void update();
-    bool isForbiddenDir(QString &);
+    static bool isForbiddenDir(const QString &);
+    static void readFiles(const QDir &, ScanContents &);
+    /* QDir based readFiles(), for when native reading is off or failed */
+    static void readFilesQDir(const QDir &, ScanContents &);
+    /* read the files of a directory taken from the cache */
+    void loadFiles();
+    /* drop the files, telling their listeners */
+    void clearFiles();
+    /* remember contents read from disk in the cache of the manager */
+    void cacheContents(const ScanContents &contents);
 
     /* this propagates file count and size to upper dirs */
     void subScanFinished();
@@ -279,12 +562,17 @@ private:
     void callScanFinished();
 
     ScanFileVector _files;
+    QByteArray _fileNames;
+    // only for the few files with a listener, by index in _files
+    QHash<int, ScanListener *> _fileListeners;
     ScanDirVector _dirs;
 
     QString _name;
     bool _dirty; /* needs a call to update() */
+    /* only counted yet, _files is read on demand */
+    bool _filesCached;
     KIO::fileoffset_t _size, _fileSize;
-    unsigned int _fileCount, _dirCount;
+    unsigned int _fileCount, _dirCount, _cachedFileCount;
     int _dirsFinished, _data;
     ScanDir *_parent;
     ScanListener *_listener;
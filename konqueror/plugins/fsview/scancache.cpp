@@ -0,0 +1,278 @@
+/* This file is part of FSView.
+
+   KCachegrind is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation, version 2.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include <time.h>
+
+#include <algorithm>
+
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QSet>
+#include <QStandardPaths>
+
+#include <kdebug.h>
+
+#include "scancache.h"
+
+// increase when the file format changes, old caches are dropped then
+static const qint32 s_cacheVersion = 3;
+
+// default for ScanCache::maxEntries()
+static const int s_defaultMaxEntries = 100000;
+
+// ScanCache
+
+ScanCache::ScanCache()
+{
+    _maxEntries = s_defaultMaxEntries;
+    _modified = false;
+}
+
+void ScanCache::setMaxEntries(int maxEntries)
+{
+    QWriteLocker locker(&_lock);
+    _maxEntries = qMax(1, maxEntries);
+    if (_entries.count() > _maxEntries) {
+        evict();
+    }
+}
+
+int ScanCache::count() const
+{
+    QReadLocker locker(&_lock);
+    return _entries.count();
+}
+
+QString ScanCache::defaultFileName()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation) +
+           QLatin1String("/fsview/scancache");
+}
+
+bool ScanCache::load(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    QDataStream stream(&file);
+    qint32 version;
+    quint32 count;
+    stream >> version;
+    if (version != s_cacheVersion) {
+        return false;
+    }
+    stream >> count;
+
+    QHash<QString, ScanCacheEntry> entries;
+    entries.reserve(count);
+    for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; i++) {
+        QString path;
+        ScanCacheEntry e;
+        quint64 fileSize, allocatedSize;
+        quint32 lastUsed, linkCount;
+        stream >> path >> e.device >> e.inode >> e.mtime >> lastUsed
+               >> e.fileCount >> fileSize >> allocatedSize >> e.dirs >> linkCount;
+        e.lastUsed.store(lastUsed);
+        e.fileSize = fileSize;
+        e.allocatedSize = allocatedSize;
+        for (quint32 j = 0; j < linkCount && stream.status() == QDataStream::Ok; j++) {
+            ScanHardLink link;
+            quint64 size, allocated;
+            stream >> link.name >> link.inode >> size >> allocated;
+            link.size = size;
+            link.allocatedSize = allocated;
+            e.links.append(link);
+        }
+        entries.insert(path, e);
+    }
+    if (stream.status() != QDataStream::Ok) {
+        kDebug(90100) << "ScanCache: dropping broken cache" << fileName;
+        return false;
+    }
+
+    QWriteLocker locker(&_lock);
+    _entries.swap(entries);
+    _modified = false;
+    if (_entries.count() > _maxEntries) {
+        evict();
+    }
+    return true;
+}
+
+bool ScanCache::save(const QString &fileName)
+{
+    QDir().mkpath(QFileInfo(fileName).absolutePath());
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+
+    QDataStream stream(&file);
+    {
+        QReadLocker locker(&_lock);
+        stream << s_cacheVersion << quint32(_entries.count());
+
+        QHash<QString, ScanCacheEntry>::const_iterator it;
+        for (it = _entries.constBegin(); it != _entries.constEnd(); ++it) {
+            const ScanCacheEntry &e = it.value();
+            stream << it.key() << e.device << e.inode << e.mtime << e.lastUsed.load()
+                   << e.fileCount << quint64(e.fileSize) << quint64(e.allocatedSize)
+                   << e.dirs << quint32(e.links.count());
+            foreach (const ScanHardLink &link, e.links) {
+                stream << link.name << link.inode
+                       << quint64(link.size) << quint64(link.allocatedSize);
+            }
+        }
+    }
+
+    if (!file.commit()) {
+        return false;
+    }
+    _modified = false;
+    return true;
+}
+
+bool ScanCache::lookup(const QString &absPath, quint64 device, quint64 inode,
+                       qint64 mtime, ScanCacheEntry &entry) const
+{
+    QReadLocker locker(&_lock);
+    QHash<QString, ScanCacheEntry>::const_iterator it = _entries.constFind(absPath);
+    if (it == _entries.constEnd()) {
+        return false;
+    }
+
+    const ScanCacheEntry &e = it.value();
+    if (e.device != device || e.inode != inode || e.mtime != mtime) {
+        return false;
+    }
+
+    // only the entry is changed, which the read lock allows
+    e.lastUsed.store(quint32(::time(0)));
+    entry = e;
+    return true;
+}
+
+void ScanCache::insert(const QString &absPath, const ScanCacheEntry &entry)
+{
+    QWriteLocker locker(&_lock);
+
+    QHash<QString, ScanCacheEntry>::iterator it = _entries.find(absPath);
+    if (it != _entries.end() && !it.value().dirs.isEmpty()) {
+        // forget about subdirectories which are gone
+        const QSet<QString> dirs = entry.dirs.toSet();
+        QString prefix = absPath;
+        if (!prefix.endsWith(QLatin1Char('/'))) {
+            prefix += QLatin1Char('/');
+        }
+        QStringList gone;
+        foreach (const QString &dir, it.value().dirs) {
+            if (!dirs.contains(dir)) {
+                gone.append(prefix + dir);
+            }
+        }
+        if (!gone.isEmpty()) {
+            removeTrees(gone);
+        }
+    }
+
+    // A directory changed in the second it was read in may change again
+    // without getting another modification time: don't trust it later.
+    const qint64 now = ::time(0);
+    if (entry.mtime >= now - 1) {
+        _entries.remove(absPath);
+    } else {
+        ScanCacheEntry &e = _entries[absPath];
+        e = entry;
+        e.lastUsed.store(quint32(now));
+        // a tenth more first, so that evicting is rare
+        if (_entries.count() > _maxEntries + _maxEntries / 10) {
+            evict();
+        }
+    }
+    _modified = true;
+}
+
+void ScanCache::clear()
+{
+    QWriteLocker locker(&_lock);
+    _entries.clear();
+    _modified = true;
+}
+
+void ScanCache::evict()
+{
+    // keep the most recently used nine tenths of the limit
+    const int keep = _maxEntries - _maxEntries / 10;
+    if (_entries.count() <= keep) {
+        return;
+    }
+
+    QVector<quint32> times;
+    times.reserve(_entries.count());
+    QHash<QString, ScanCacheEntry>::const_iterator cit;
+    for (cit = _entries.constBegin(); cit != _entries.constEnd(); ++cit) {
+        times.append(cit.value().lastUsed.load());
+    }
+    const int dropCount = times.count() - keep;
+    QVector<quint32>::iterator nth = times.begin() + dropCount;
+    std::nth_element(times.begin(), nth, times.end());
+    // entries used before oldestKept are dropped, and of the ones
+    // used just then as many as needed
+    const quint32 oldestKept = *nth;
+    int drop = dropCount - int(std::count_if(times.begin(), nth,
+                                             [oldestKept](quint32 t) { return t < oldestKept; }));
+
+    QHash<QString, ScanCacheEntry>::iterator it = _entries.begin();
+    while (it != _entries.end()) {
+        const quint32 t = it.value().lastUsed.load();
+        if (t < oldestKept || (t == oldestKept && drop > 0)) {
+            if (t == oldestKept) {
+                drop--;
+            }
+            it = _entries.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    _modified = true;
+}
+
+void ScanCache::removeTrees(const QStringList &absPaths)
+{
+    QHash<QString, ScanCacheEntry>::iterator it = _entries.begin();
+    while (it != _entries.end()) {
+        bool below = false;
+        foreach (const QString &p, absPaths) {
+            const QString &key = it.key();
+            if (key.startsWith(p) &&
+                    (key.length() == p.length() || key.at(p.length()) == QLatin1Char('/'))) {
+                below = true;
+                break;
+            }
+        }
+        if (below) {
+            it = _entries.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
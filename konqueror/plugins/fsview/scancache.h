@@ -0,0 +1,130 @@
+/* This file is part of FSView.
+
+   KCachegrind is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation, version 2.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+/*
+ * Persistent cache of directory contents, for ScanManager
+ */
+
+#ifndef KONQ_PLUGIN_SCANCACHE_H
+#define KONQ_PLUGIN_SCANCACHE_H
+
+#include <QAtomicInteger>
+#include <QHash>
+#include <QReadWriteLock>
+#include <QStringList>
+#include <kio/global.h>
+
+#include "scan.h"
+
+/**
+ * What a scan found directly in one directory.
+ */
+class ScanCacheEntry
+{
+public:
+    ScanCacheEntry()
+    {
+        device = 0;
+        inode = 0;
+        mtime = 0;
+        fileCount = 0;
+        fileSize = 0;
+        allocatedSize = 0;
+        lastUsed = 0;
+    }
+
+    // identify the directory as it was scanned
+    quint64 device;
+    quint64 inode;
+    qint64 mtime;
+
+    unsigned int fileCount;
+    // sums of the lengths and of the allocated blocks of the files
+    KIO::fileoffset_t fileSize, allocatedSize;
+    // files with other hard links, for ScanAccounting
+    QVector<ScanHardLink> links;
+    QStringList dirs;
+
+    // time of the last insert() or lookup(), for dropping unused entries
+    mutable QAtomicInteger<quint32> lastUsed;
+};
+
+/**
+ * Directory contents of previous scans, keyed by absolute path.
+ *
+ * An entry is only used while device, inode and modification time of
+ * the directory are unchanged. Creating, deleting or renaming an entry
+ * in a directory changes its modification time, so with the cache a
+ * rescan still visits every directory, but only reads the ones which
+ * changed. Files which only grew are not noticed this way: their size
+ * stays as cached until the directory is refreshed without the cache.
+ *
+ * The cache holds at most maxEntries() entries: beyond that, the ones
+ * least recently inserted or looked up are dropped.
+ *
+ * lookup() may be called from scan worker threads at any time.
+ */
+class ScanCache
+{
+public:
+    ScanCache();
+
+    /* Default location of the cache file */
+    static QString defaultFileName();
+
+    bool load(const QString &fileName);
+    bool save(const QString &fileName);
+    bool isModified() const
+    {
+        return _modified;
+    }
+
+    void setMaxEntries(int maxEntries);
+    int maxEntries() const
+    {
+        return _maxEntries;
+    }
+    int count() const;
+
+    /**
+     * Returns true and sets entry if the cache has an entry for
+     * absPath which is still valid for the given device, inode
+     * and modification time. Thread-safe.
+     */
+    bool lookup(const QString &absPath, quint64 device, quint64 inode,
+                qint64 mtime, ScanCacheEntry &entry) const;
+
+    /**
+     * Replace the entry of absPath. Entries of subdirectories which
+     * are gone are removed.
+     */
+    void insert(const QString &absPath, const ScanCacheEntry &entry);
+
+    void clear();
+
+private:
+    void removeTrees(const QStringList &absPaths);
+    // drop the least recently used entries down to below the limit
+    void evict();
+
+    mutable QReadWriteLock _lock;
+    QHash<QString, ScanCacheEntry> _entries;
+    int _maxEntries;
+    bool _modified;
+};
+
+#endif // KONQ_PLUGIN_SCANCACHE_H
@@ -0,0 +1,193 @@
+/* This file is part of FSView.
+
+   KCachegrind is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation, version 2.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include <QFile>
+#include <QSocketNotifier>
+#include <QTimer>
+
+#include <kdebug.h>
+
+#include "scanwatch.h"
+
+#ifdef Q_OS_LINUX
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+// milliseconds changes are collected before they are reported
+static const int s_changeDelay = 1000;
+// watches used if the system limit can't be read
+static const int s_defaultMaxWatches = 8192;
+
+// ScanWatcher
+
+ScanWatcher::ScanWatcher(QObject *parent)
+    : QObject(parent)
+{
+    _fd = -1;
+    _notifier = 0;
+    _maxWatches = s_defaultMaxWatches;
+    _overflowed = false;
+
+    _timer = new QTimer(this);
+    _timer->setSingleShot(true);
+    _timer->setInterval(s_changeDelay);
+    connect(_timer, SIGNAL(timeout()), this, SLOT(reportChanges()));
+
+#ifdef Q_OS_LINUX
+    _fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (_fd < 0) {
+        kDebug(90100) << "ScanWatcher: no inotify, not watching anything";
+        return;
+    }
+    _notifier = new QSocketNotifier(_fd, QSocketNotifier::Read, this);
+    connect(_notifier, SIGNAL(activated(int)), this, SLOT(readEvents()));
+
+    // leave most of the budget to others, e.g. KDirWatch
+    QFile limit(QStringLiteral("/proc/sys/fs/inotify/max_user_watches"));
+    if (limit.open(QIODevice::ReadOnly)) {
+        const int max = limit.readAll().trimmed().toInt();
+        if (max > 0) {
+            _maxWatches = max / 4;
+        }
+    }
+#endif
+}
+
+ScanWatcher::~ScanWatcher()
+{
+#ifdef Q_OS_LINUX
+    if (_fd >= 0) {
+        // removes all watches
+        close(_fd);
+    }
+#endif
+}
+
+void ScanWatcher::setMaxWatches(int max)
+{
+    _maxWatches = max;
+}
+
+bool ScanWatcher::watch(const QString &absPath)
+{
+    if (_fd < 0) {
+        return false;
+    }
+    if (_watches.contains(absPath)) {
+        return true;
+    }
+    if (_watches.count() >= _maxWatches) {
+        return false;
+    }
+
+#ifdef Q_OS_LINUX
+    const int wd = inotify_add_watch(_fd, QFile::encodeName(absPath).constData(),
+                                     IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO |
+                                     IN_MODIFY | IN_ONLYDIR | IN_EXCL_UNLINK);
+    if (wd < 0) {
+        return false;
+    }
+    // the same directory under another path gets the same descriptor
+    const QString old = _paths.value(wd);
+    if (!old.isEmpty()) {
+        _watches.remove(old);
+    }
+    _paths.insert(wd, absPath);
+    _watches.insert(absPath, wd);
+    return true;
+#else
+    return false;
+#endif
+}
+
+void ScanWatcher::clear()
+{
+#ifdef Q_OS_LINUX
+    QHash<int, QString>::const_iterator it;
+    for (it = _paths.constBegin(); it != _paths.constEnd(); ++it) {
+        inotify_rm_watch(_fd, it.key());
+    }
+#endif
+    _paths.clear();
+    _watches.clear();
+    _changed.clear();
+    _overflowed = false;
+    _timer->stop();
+}
+
+void ScanWatcher::readEvents()
+{
+#ifdef Q_OS_LINUX
+    // aligned for the events
+    quint64 events[512];
+    const char *buffer = reinterpret_cast<const char *>(events);
+
+    while (true) {
+        const ssize_t n = read(_fd, events, sizeof(events));
+        if (n <= 0) {
+            break;
+        }
+
+        for (ssize_t pos = 0; pos < n;) {
+            const struct inotify_event *event =
+                reinterpret_cast<const struct inotify_event *>(buffer + pos);
+            pos += sizeof(struct inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                _overflowed = true;
+                continue;
+            }
+            if (event->mask & IN_IGNORED) {
+                // directory deleted or unmounted, its parent hears of it
+                const QString path = _paths.take(event->wd);
+                _watches.remove(path);
+                continue;
+            }
+
+            const QString path = _paths.value(event->wd);
+            if (!path.isEmpty()) {
+                _changed.insert(path);
+            }
+        }
+    }
+
+    // not restarted for every event, so a steady stream of them is
+    // still reported once a second
+    if ((_overflowed || !_changed.isEmpty()) && !_timer->isActive()) {
+        _timer->start();
+    }
+#endif
+}
+
+void ScanWatcher::reportChanges()
+{
+    if (_overflowed) {
+        _overflowed = false;
+        _changed.clear();
+        emit overflowed();
+        return;
+    }
+
+    if (_changed.isEmpty()) {
+        return;
+    }
+    QStringList paths = _changed.toList();
+    _changed.clear();
+    paths.sort();
+    emit directoriesChanged(paths);
+}
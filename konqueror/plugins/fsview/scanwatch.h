@@ -0,0 +1,101 @@
+/* This file is part of FSView.
+
+   KCachegrind is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation, version 2.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+/*
+ * Watching scanned directories for changes, for FSView
+ */
+
+#ifndef KONQ_PLUGIN_SCANWATCH_H
+#define KONQ_PLUGIN_SCANWATCH_H
+
+#include <QHash>
+#include <QObject>
+#include <QSet>
+#include <QStringList>
+
+class QSocketNotifier;
+class QTimer;
+
+/**
+ * Watches directories for entries being created, deleted, renamed or
+ * written to, with inotify on Linux. Elsewhere, or if inotify is not
+ * available, nothing is watched.
+ *
+ * Every watched directory takes a watch of the user's inotify budget,
+ * so at most maxWatches() are watched, the ones added first. Changes
+ * are collected for a second before they are reported, so a burst of
+ * them (a build writing object files, a log growing) makes a directory
+ * read once.
+ */
+class ScanWatcher : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ScanWatcher(QObject *parent = Q_NULLPTR);
+    ~ScanWatcher();
+
+    bool isAvailable() const
+    {
+        return _fd >= 0;
+    }
+
+    /* By default, a quarter of the system wide limit per user */
+    void setMaxWatches(int max);
+    int maxWatches() const
+    {
+        return _maxWatches;
+    }
+    int watchCount() const
+    {
+        return _watches.count();
+    }
+
+    /**
+     * Watch directory absPath. Returns false if it can't be watched,
+     * e.g. because maxWatches() are watched already.
+     */
+    bool watch(const QString &absPath);
+
+    /* Stop watching all directories, forgetting changes not reported yet */
+    void clear();
+
+Q_SIGNALS:
+    /* Entries of the watched directories absPaths changed */
+    void directoriesChanged(const QStringList &absPaths);
+    /* Changes were lost, everything watched has to be read again */
+    void overflowed();
+
+private Q_SLOTS:
+    void readEvents();
+    void reportChanges();
+
+private:
+    int _fd;
+    QSocketNotifier *_notifier;
+    QTimer *_timer;
+    int _maxWatches;
+
+    // watch descriptor <-> path
+    QHash<int, QString> _paths;
+    QHash<QString, int> _watches;
+
+    QSet<QString> _changed;
+    bool _overflowed;
+};
+
+#endif // KONQ_PLUGIN_SCANWATCH_H
@@ -19,8 +19,14 @@
 /* Test Directory Scanning. Usually not build. */
 
 #include <stdio.h>
+#include <string.h>
 #include <unistd.h>
 
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QTemporaryDir>
+
 #include "scan.h"
 
 class MyListener: public ScanListener
@@ -45,8 +51,65 @@ public:
     }
 };
 
+/* A tree of dirsPerLevel^depth directories with filesPerDir small files each */
+static void createTree(const QString &path, int depth, int dirsPerLevel, int filesPerDir)
+{
+    for (int i = 0; i < filesPerDir; ++i) {
+        QFile f(path + QStringLiteral("/file%1").arg(i));
+        if (f.open(QIODevice::WriteOnly)) {
+            f.write(QByteArray(i, 'x'));
+        }
+    }
+    if (depth == 0) {
+        return;
+    }
+    for (int i = 0; i < dirsPerLevel; ++i) {
+        const QString dir = path + QStringLiteral("/dir%1").arg(i);
+        QDir().mkdir(dir);
+        createTree(dir, depth - 1, dirsPerLevel, filesPerDir);
+    }
+}
+
+static qint64 timeScan(const QString &path, bool native, KIO::fileoffset_t *size)
+{
+    ScanDir::setNativeReading(native);
+    QElapsedTimer timer;
+    timer.start();
+    ScanManager m(path);
+    m.startScan();
+    while (m.scan(1));
+    *size = m.top()->size();
+    return timer.elapsed();
+}
+
+/* Compare reading with getdents64()/fstatat() to QDir/lstat() on a
+ * synthetic tree. Run it under "strace -c -f" to see the system calls. */
+static int benchmark()
+{
+    QTemporaryDir tmp;
+    if (!tmp.isValid()) {
+        return 1;
+    }
+    createTree(tmp.path(), 3, 10, 50);
+
+    KIO::fileoffset_t size;
+    timeScan(tmp.path(), true, &size); // warm up the dentry cache
+    for (int round = 0; round < 3; ++round) {
+        KIO::fileoffset_t qdirSize;
+        const qint64 qdirTime = timeScan(tmp.path(), false, &qdirSize);
+        const qint64 nativeTime = timeScan(tmp.path(), true, &size);
+        printf("QDir: %lld ms, native: %lld ms%s\n", (long long)qdirTime,
+               (long long)nativeTime, size == qdirSize ? "" : " (sizes differ!)");
+    }
+    return 0;
+}
+
 int main(int argc, char *argv[])
 {
+    if (argc > 1 && strcmp(argv[1], "--benchmark") == 0) {
+        return benchmark();
+    }
+
     ScanManager m(QStringLiteral("/opt"));
     if (argc > 1) {
         m.setTop(argv[1]);
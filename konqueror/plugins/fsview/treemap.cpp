@@ -39,6 +39,7 @@
 #include <QToolTip>
 #include <QStylePainter>
 #include <QStyleOptionFocusRect>
+#include <QTimer>
 
 #include <KLocalizedString>
 #include <kconfig.h>
@@ -49,6 +50,9 @@
 #define DEBUG_DRAWING 0
 #define MAX_FIELD 12
 
+// milliseconds after the last resize step until the map is laid out again
+static const int s_resizeDelay = 150;
+
 //
 // StoredDrawParams
 //
@@ -917,6 +921,12 @@ TreeMapItem::TreeMapItem(TreeMapItem *parent, double value)
     _depth = -1; // not set
     _unused_self = 0;
 
+    _layoutValue = 0;
+    _layoutValid = false;
+    _layoutFrame = -1;
+    _shownFrame = -1;
+    _lastLayoutFrame = -1;
+
     if (_parent) {
         // take sorting from parent
         _sortTextNo = _parent->sorting(&_sortAscending);
@@ -953,6 +963,12 @@ TreeMapItem::TreeMapItem(TreeMapItem *parent, double value,
     _depth = -1; // not set
     _unused_self = 0;
 
+    _layoutValue = 0;
+    _layoutValid = false;
+    _layoutFrame = -1;
+    _shownFrame = -1;
+    _lastLayoutFrame = -1;
+
     if (_parent) {
         _parent->addItem(this);
     }
@@ -1011,6 +1027,14 @@ void TreeMapItem::redraw()
     }
 }
 
+void TreeMapItem::invalidateLayout()
+{
+    // the parents are drawn with this item in them
+    for (TreeMapItem *i = this; i; i = i->_parent) {
+        i->_layoutValid = false;
+    }
+}
+
 void TreeMapItem::clear()
 {
     if (_children) {
@@ -1022,6 +1046,7 @@ void TreeMapItem::clear()
         qDeleteAll(*_children);
         delete _children;
         _children = 0;
+        invalidateLayout();
     }
 }
 
@@ -1085,6 +1110,7 @@ void TreeMapItem::addItem(TreeMapItem *i)
     if (sorting(0) != -1) {
         qSort(_children->begin(), _children->end(), treeMapItemLessThan);
     }
+    invalidateLayout();
 }
 
 // default implementations of virtual functions
@@ -1155,6 +1181,7 @@ void TreeMapItem::setSorting(int textNo, bool ascending)
 
     if (_children && _sortTextNo != -1) {
         qSort(_children->begin(), _children->end(), treeMapItemLessThan);
+        invalidateLayout();
     }
 }
 
@@ -1166,6 +1193,7 @@ void TreeMapItem::resort(bool recursive)
 
     if (_sortTextNo != -1) {
         qSort(_children->begin(), _children->end(), treeMapItemLessThan);
+        invalidateLayout();
     }
 
     if (recursive)
@@ -1201,6 +1229,8 @@ void TreeMapItem::clearItemRect()
 {
     _rect = QRect();
     clearFreeRects();
+    // not drawn, so it can't be copied from this drawing later
+    _shownFrame = -1;
 }
 
 void TreeMapItem::clearFreeRects()
@@ -1292,6 +1322,13 @@ TreeMapWidget::TreeMapWidget(TreeMapItem *base,
     _pressed = 0;
     _lastOver = 0;
     _needsRefresh = _base;
+    _reuseLayout = false;
+    _frame = 0;
+
+    _resizeTimer = new QTimer(this);
+    _resizeTimer->setSingleShot(true);
+    _resizeTimer->setInterval(s_resizeDelay);
+    connect(_resizeTimer, SIGNAL(timeout()), this, SLOT(update()));
 
     setAttribute(Qt::WA_NoSystemBackground, true);
     setFocusPolicy(Qt::StrongFocus);
@@ -2438,6 +2475,15 @@ void TreeMapWidget::paintEvent(QPaintEvent *)
     drawTreeMap();
 }
 
+void TreeMapWidget::resizeEvent(QResizeEvent *e)
+{
+    // the first size is drawn right away
+    if (!_pixmap.isNull()) {
+        _resizeTimer->start();
+    }
+    QWidget::resizeEvent(e);
+}
+
 // Updates screen from shadow buffer,
 // but redraws before if needed
 void TreeMapWidget::drawTreeMap()
@@ -2448,7 +2494,15 @@ void TreeMapWidget::drawTreeMap()
     }
 
     if (_pixmap.size() != size()) {
+        if (!_pixmap.isNull() && _resizeTimer->isActive()) {
+            // still resizing: laying out big maps on every step of it
+            // is too slow, so stretch the last drawing until it stops
+            QStylePainter p(this);
+            p.drawPixmap(rect(), _pixmap);
+            return;
+        }
         _needsRefresh = _base;
+        _reuseLayout = false;
     }
 
     if (_needsRefresh) {
@@ -2459,6 +2513,10 @@ void TreeMapWidget::drawTreeMap()
 
         if (_needsRefresh == _base) {
             // redraw whole widget
+            _frame++;
+            if (_reuseLayout) {
+                _lastPixmap = _pixmap;
+            }
             _pixmap = QPixmap(size());
             _pixmap.fill(palette().color(backgroundRole()));
         }
@@ -2480,6 +2538,8 @@ void TreeMapWidget::drawTreeMap()
 
         drawItems(&p, _needsRefresh);
         _needsRefresh = 0;
+        _reuseLayout = false;
+        _lastPixmap = QPixmap();
     }
 
     QStylePainter p(this);
@@ -2499,6 +2559,7 @@ void TreeMapWidget::redraw(TreeMapItem *i)
     if (!i) {
         return;
     }
+    _reuseLayout = false;
 
     if (!_needsRefresh) {
         _needsRefresh = i;
@@ -2514,6 +2575,50 @@ void TreeMapWidget::redraw(TreeMapItem *i)
     }
 }
 
+void TreeMapWidget::redrawChanged()
+{
+    // only if nothing else asked for a full drawing
+    const bool reuse = !_needsRefresh || _reuseLayout;
+    redraw(_base);
+    _reuseLayout = reuse;
+}
+
+/**
+ * Copy item from the last frame if it would be drawn the same way
+ * again. Otherwise, remember what it is drawn with now.
+ */
+bool TreeMapWidget::reuseItem(QPainter *p, TreeMapItem *item)
+{
+    // Items are in the last frame if they were drawn or copied when
+    // their parent placed its children the last time, and the parent
+    // is in the last frame itself.
+    bool shown = false;
+    if (_reuseLayout) {
+        TreeMapItem *parent = item->parent();
+        if (item == _base) {
+            shown = (item->_shownFrame == _frame - 1);
+        } else if (parent && parent->_lastLayoutFrame >= 0) {
+            shown = (item->_shownFrame == parent->_lastLayoutFrame);
+        }
+    }
+
+    const QRect &r = item->itemRect();
+    if (shown && item->_layoutValid && (r == item->_layoutRect) &&
+            (item->value() == item->_layoutValue) &&
+            !isTransparent(item->depth())) {
+        p->drawPixmap(r, _lastPixmap, r);
+        item->_shownFrame = _frame;
+        return true;
+    }
+
+    item->_lastLayoutFrame = shown ? item->_layoutFrame : -1;
+    item->_layoutFrame = _frame;
+    item->_shownFrame = _frame;
+    item->_layoutRect = r;
+    item->_layoutValue = item->value();
+    return false;
+}
+
 void TreeMapWidget::drawItem(QPainter *p,
                              TreeMapItem *item)
 {
@@ -2579,6 +2684,10 @@ void TreeMapWidget::drawItems(QPainter *p,
                       << item->itemRect().height() << "), Val " << item->value()
                       << ", Sum " << item->sum() << endl;
 
+    if (reuseItem(p, item)) {
+        return;
+    }
+
     drawItem(p, item);
     item->clearFreeRects();
 
@@ -2588,6 +2697,8 @@ void TreeMapWidget::drawItems(QPainter *p,
                     origRect.width() - 2 * bw, origRect.height() - 2 * bw);
 
     TreeMapItemList *list = item->children();
+    // after children(), which may create or resort them
+    item->_layoutValid = true;
 
     bool stopDrawing = false;
 
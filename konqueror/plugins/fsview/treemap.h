@@ -40,8 +40,11 @@
 #include <QContextMenuEvent>
 #include <QMenu>
 #include <QMouseEvent>
+#include <QResizeEvent>
 #include <kconfiggroup.h>
 
+class QTimer;
+
 class TreeMapWidget;
 class TreeMapItem;
 class TreeMapItemList;
@@ -311,6 +314,13 @@ public:
     // force a redraw of this item
     void redraw();
 
+    /**
+     * Tell that value(), the texts or the children of this item or of
+     * an item below changed. Items not changed since they were drawn
+     * last can be copied from there by TreeMapWidget::redrawChanged().
+     */
+    void invalidateLayout();
+
     // delete all children
     void clear();
 
@@ -473,6 +483,18 @@ private:
     QList<QRect> _freeRects;
     int _depth;
 
+    // what the item was drawn with last, see TreeMapWidget::redrawChanged()
+    friend class TreeMapWidget;
+    QRect _layoutRect;
+    double _layoutValue;
+    bool _layoutValid;
+    // frame in which the children were placed last, and in which the
+    // item was drawn or copied last
+    int _layoutFrame, _shownFrame;
+    // _layoutFrame before the current drawing, if the item was shown
+    // in the last frame, -1 otherwise
+    int _lastLayoutFrame;
+
     // temporary self value (when using level skipping)
     double _unused_self;
 
@@ -786,6 +808,16 @@ public:
         redraw(_base);
     }
 
+    /**
+     * Redraws everything after values of items changed, e.g. while they
+     * are still computed. Items with the same rectangle and value which
+     * did not call TreeMapItem::invalidateLayout() are copied from the
+     * last drawing instead of being laid out again, so this is cheap if
+     * only a few parts changed. Other redraw requests before the next
+     * drawing make it a full one.
+     */
+    void redrawChanged();
+
     /**
      * Resort all TreeMapItems. See TreeMapItem::resort().
      */
@@ -832,6 +864,7 @@ protected:
     void mouseDoubleClickEvent(QMouseEvent *) Q_DECL_OVERRIDE;
     void keyPressEvent(QKeyEvent *) Q_DECL_OVERRIDE;
     void paintEvent(QPaintEvent *) Q_DECL_OVERRIDE;
+    void resizeEvent(QResizeEvent *) Q_DECL_OVERRIDE;
     void fontChange(const QFont &);
     bool event(QEvent *event) Q_DECL_OVERRIDE;
     // For "Esc deselects all" functionality implemented in FSView.
@@ -849,6 +882,7 @@ private:
 
     void drawItem(QPainter *p, TreeMapItem *);
     void drawItems(QPainter *p, TreeMapItem *);
+    bool reuseItem(QPainter *p, TreeMapItem *);
     bool horizontal(TreeMapItem *i, const QRect &r);
     void drawFill(TreeMapItem *, QPainter *p, const QRect &r);
     void drawFill(TreeMapItem *, QPainter *p, const QRect &r,
@@ -895,6 +929,15 @@ private:
 
     // back buffer pixmap
     QPixmap _pixmap;
+
+    // the back buffer of the last frame, while drawing with redrawChanged()
+    QPixmap _lastPixmap;
+    bool _reuseLayout;
+    int _frame;
+
+    // while resizing, the back buffer is stretched, and drawn again
+    // when this fires
+    QTimer *_resizeTimer;
 };
 
 #endif
@@ -0,0 +1,459 @@
+/* This file is part of the KDE project
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include "konqcompletionindex.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <queue>
+
+#include <QtCore/QSet>
+
+// visits lose half of their weight in that many seconds
+static const double s_halfLife = 30 * 24 * 3600.0;
+// typed urls count as if they had been visited that much more often
+static const int s_typedBonus = 10;
+// new keys are merged into the sorted ones when there are that many,
+// or a sixteenth of the sorted ones, so that filling the index stays cheap
+static const int s_maxNewKeys = 1024;
+
+template<typename K>
+static bool keyTextLessThan(const K &key, const QString &text)
+{
+    return key.text < text;
+}
+
+template<typename K>
+static bool keyLessThan(const K &key, const K &other)
+{
+    return key.text < other.text || (key.text == other.text && key.entry < other.entry);
+}
+
+KonqCompletionIndex::KonqCompletionIndex()
+    : m_removedKeys(0), m_newKeyCount(0), m_treeDirty(true)
+{
+}
+
+QString KonqCompletionIndex::normalizedUrl(const QString &url)
+{
+    static const char *const schemes[] = {
+        "http://",
+        "https://",
+        "ftp://",
+        "file://",
+        "file:",
+        0
+    };
+
+    QString result = url.toLower();
+    for (const char *const *scheme = schemes; *scheme; ++scheme) {
+        const QLatin1String s(*scheme);
+        if (result.startsWith(s)) {
+            result.remove(0, int(strlen(*scheme)));
+            break;
+        }
+    }
+    if (result.startsWith(QLatin1String("www."))) {
+        result.remove(0, 4);
+    }
+    if (result.length() > 1 && result.endsWith(QLatin1Char('/'))) {
+        result.chop(1);
+    }
+    return result;
+}
+
+void KonqCompletionIndex::insert(const QString &url, const QString &title, const QString &typedUrl,
+                                 int numberOfTimesVisited, const QDateTime &lastVisited)
+{
+    const QString key = normalizedUrl(url);
+    if (key.isEmpty()) {
+        return;
+    }
+
+    Source source;
+    source.url = url;
+    source.title = title;
+    source.typedUrl = typedUrl;
+    source.numberOfTimesVisited = numberOfTimesVisited;
+    source.lastVisited = lastVisited;
+    source.bookmark = false;
+    insertSource(key, source);
+}
+
+void KonqCompletionIndex::insertBookmark(const QString &url, const QString &title)
+{
+    const QString key = normalizedUrl(url);
+    if (key.isEmpty() || m_bookmarkEntries.contains(url)) {
+        return;
+    }
+
+    Source source;
+    source.url = url;
+    source.title = title;
+    source.numberOfTimesVisited = 0;
+    source.bookmark = true;
+    insertSource(key, source);
+}
+
+void KonqCompletionIndex::insertSource(const QString &key, const Source &source)
+{
+    int id = m_keyEntries.value(key, -1);
+    if (id >= 0) {
+        removeKeys(id);
+        QVector<Source> &sources = m_entries[id].sources;
+        QVector<Source>::iterator it = sources.begin();
+        while (it != sources.end() && (it->url != source.url || it->bookmark != source.bookmark)) {
+            ++it;
+        }
+        if (it != sources.end()) {
+            *it = source;
+        } else {
+            sources.append(source);
+        }
+    } else {
+        if (m_freeEntries.isEmpty()) {
+            id = m_entries.count();
+            m_entries.append(Entry());
+        } else {
+            id = m_freeEntries.takeLast();
+        }
+        Entry &entry = m_entries[id];
+        entry.key = key;
+        entry.sources.append(source);
+        m_keyEntries.insert(key, id);
+    }
+
+    if (source.bookmark) {
+        m_bookmarkEntries.insert(source.url, id);
+    } else {
+        m_urlEntries.insert(source.url, id);
+    }
+    updateEntry(id);
+    addKeys(id);
+}
+
+void KonqCompletionIndex::remove(const QString &url)
+{
+    removeSource(url, false);
+}
+
+void KonqCompletionIndex::removeSource(const QString &url, bool bookmark)
+{
+    QHash<QString, int> &urlEntries = bookmark ? m_bookmarkEntries : m_urlEntries;
+    const int id = urlEntries.value(url, -1);
+    if (id < 0) {
+        return;
+    }
+    urlEntries.remove(url);
+    removeKeys(id);
+
+    Entry &entry = m_entries[id];
+    for (int i = 0; i < entry.sources.count(); ++i) {
+        const Source &source = entry.sources.at(i);
+        if (source.url == url && source.bookmark == bookmark) {
+            entry.sources.remove(i);
+            break;
+        }
+    }
+
+    if (entry.sources.isEmpty()) {
+        m_keyEntries.remove(entry.key);
+        entry = Entry();
+        m_freeEntries.append(id);
+    } else {
+        updateEntry(id);
+        addKeys(id);
+    }
+}
+
+void KonqCompletionIndex::clearHistory()
+{
+    if (m_bookmarkEntries.isEmpty()) {
+        clear();
+        return;
+    }
+    const QStringList urls = m_urlEntries.keys();
+    foreach (const QString &url, urls) {
+        removeSource(url, false);
+    }
+}
+
+void KonqCompletionIndex::clear()
+{
+    m_entries.clear();
+    m_freeEntries.clear();
+    m_keyEntries.clear();
+    m_urlEntries.clear();
+    m_bookmarkEntries.clear();
+    m_keys.clear();
+    m_removedKeys = 0;
+    m_newKeys.clear();
+    m_newKeyCount = 0;
+    m_tree.clear();
+    m_treeDirty = true;
+}
+
+void KonqCompletionIndex::updateEntry(int id)
+{
+    Entry &entry = m_entries[id];
+
+    int visits = 0;
+    int mostVisits = -1;
+    QDateTime lastVisited;
+    bool typed = false;
+    foreach (const Source &source, entry.sources) {
+        visits += source.numberOfTimesVisited;
+        if (!lastVisited.isValid() || source.lastVisited > lastVisited) {
+            lastVisited = source.lastVisited;
+        }
+        typed = typed || !source.typedUrl.isEmpty();
+        if (source.numberOfTimesVisited > mostVisits) {
+            mostVisits = source.numberOfTimesVisited;
+            entry.url = source.url;
+        }
+    }
+
+    // log(visits * 2^(-age / halfLife)), without the part of the age which
+    // is the same for everybody: the current time
+    const double weight = qMax(1, visits + (typed ? s_typedBonus : 0));
+    const double seconds = lastVisited.isValid() ? lastVisited.toMSecsSinceEpoch() / 1000.0 : 0;
+    // The keys of the entry were removed before, and are added again
+    // afterwards, so the tree doesn't need to know about the new rank
+    entry.rank = std::log(weight) + seconds / s_halfLife * std::log(2.0);
+}
+
+QStringList KonqCompletionIndex::keyTexts(int id) const
+{
+    const Entry &entry = m_entries.at(id);
+
+    QSet<QString> texts;
+    texts.insert(entry.key);
+    foreach (const Source &source, entry.sources) {
+        if (!source.typedUrl.isEmpty()) {
+            const QString typed = normalizedUrl(source.typedUrl);
+            if (!typed.isEmpty()) {
+                texts.insert(typed);
+            }
+        }
+
+        // every word of the title
+        const QString title = source.title.toLower();
+        int start = -1;
+        for (int i = 0; i <= title.length(); ++i) {
+            const bool letter = i < title.length() && title.at(i).isLetterOrNumber();
+            if (letter && start < 0) {
+                start = i;
+            } else if (!letter && start >= 0) {
+                if (i - start > 1) {
+                    texts.insert(title.mid(start, i - start));
+                }
+                start = -1;
+            }
+        }
+    }
+    return texts.toList();
+}
+
+void KonqCompletionIndex::addKeys(int id)
+{
+    const QStringList texts = keyTexts(id);
+    m_newKeys.insert(id, texts);
+    m_newKeyCount += texts.count();
+    if (m_newKeyCount > qMax(s_maxNewKeys, m_keys.count() / 16)) {
+        mergeNewKeys();
+    }
+}
+
+void KonqCompletionIndex::removeKeys(int id)
+{
+    QHash<int, QStringList>::iterator pending = m_newKeys.find(id);
+    if (pending != m_newKeys.end()) {
+        m_newKeyCount -= pending.value().count();
+        m_newKeys.erase(pending);
+        return;
+    }
+
+    foreach (const QString &text, keyTexts(id)) {
+        QVector<Key>::iterator it = std::lower_bound(m_keys.begin(), m_keys.end(), text, keyTextLessThan<Key>);
+        for (; it != m_keys.end() && it->text == text; ++it) {
+            if (it->entry == id) {
+                it->entry = -1;
+                ++m_removedKeys;
+                updateTree(it - m_keys.begin());
+                break;
+            }
+        }
+    }
+}
+
+void KonqCompletionIndex::mergeNewKeys()
+{
+    QVector<Key> newKeys;
+    newKeys.reserve(m_newKeyCount);
+    for (QHash<int, QStringList>::const_iterator it = m_newKeys.constBegin(); it != m_newKeys.constEnd(); ++it) {
+        foreach (const QString &text, it.value()) {
+            Key key;
+            key.text = text;
+            key.entry = it.key();
+            newKeys.append(key);
+        }
+    }
+    std::sort(newKeys.begin(), newKeys.end(), keyLessThan<Key>);
+
+    QVector<Key> keys;
+    keys.reserve(m_keys.count() - m_removedKeys + newKeys.count());
+    QVector<Key>::const_iterator it = m_keys.constBegin();
+    QVector<Key>::const_iterator newIt = newKeys.constBegin();
+    while (it != m_keys.constEnd() || newIt != newKeys.constEnd()) {
+        if (it != m_keys.constEnd() && it->entry < 0) {
+            ++it;
+        } else if (newIt == newKeys.constEnd() ||
+                   (it != m_keys.constEnd() && keyLessThan(*it, *newIt))) {
+            keys.append(*it++);
+        } else {
+            keys.append(*newIt++);
+        }
+    }
+
+    m_keys.swap(keys);
+    m_removedKeys = 0;
+    m_newKeys.clear();
+    m_newKeyCount = 0;
+    m_treeDirty = true;
+}
+
+double KonqCompletionIndex::keyRank(int pos) const
+{
+    if (pos < 0 || m_keys.at(pos).entry < 0) {
+        return -HUGE_VAL;
+    }
+    return m_entries.at(m_keys.at(pos).entry).rank;
+}
+
+void KonqCompletionIndex::buildTree() const
+{
+    const int n = m_keys.count();
+    m_tree.resize(2 * n);
+    for (int i = 0; i < n; ++i) {
+        m_tree[n + i] = i;
+    }
+    for (int i = n - 1; i > 0; --i) {
+        const int left = m_tree.at(2 * i);
+        const int right = m_tree.at(2 * i + 1);
+        m_tree[i] = keyRank(left) >= keyRank(right) ? left : right;
+    }
+    m_treeDirty = false;
+}
+
+void KonqCompletionIndex::updateTree(int pos)
+{
+    if (m_treeDirty) {
+        // rebuilt before the next lookup anyway
+        return;
+    }
+    const int n = m_keys.count();
+    for (int i = (n + pos) / 2; i > 0; i /= 2) {
+        const int left = m_tree.at(2 * i);
+        const int right = m_tree.at(2 * i + 1);
+        m_tree[i] = keyRank(left) >= keyRank(right) ? left : right;
+    }
+}
+
+QStringList KonqCompletionIndex::topMatches(const QString &text, int max) const
+{
+    const QString prefix = normalizedUrl(text);
+    if (prefix.isEmpty() || max <= 0) {
+        return QStringList();
+    }
+
+    if (m_treeDirty) {
+        buildTree();
+    }
+
+    // Candidates, the best first. node >= 0 is a node of m_tree, which
+    // stands for the keys below it; otherwise entry is a single entry.
+    struct Candidate {
+        double rank;
+        int node;
+        int entry;
+        bool operator<(const Candidate &other) const
+        {
+            return rank < other.rank;
+        }
+    };
+    std::priority_queue<Candidate> candidates;
+
+    // the keys starting with prefix are [first, last)
+    const int n = m_keys.count();
+    const QString end = prefix + QChar(0xffff);
+    const int first = std::lower_bound(m_keys.constBegin(), m_keys.constEnd(), prefix, keyTextLessThan<Key>) - m_keys.constBegin();
+    const int last = std::lower_bound(m_keys.constBegin(), m_keys.constEnd(), end, keyTextLessThan<Key>) - m_keys.constBegin();
+
+    // the nodes of the tree which together cover [first, last)
+    for (int l = first + n, r = last + n; l < r; l /= 2, r /= 2) {
+        if (l & 1) {
+            const Candidate c = { keyRank(m_tree.at(l)), l, -1 };
+            candidates.push(c);
+            ++l;
+        }
+        if (r & 1) {
+            --r;
+            const Candidate c = { keyRank(m_tree.at(r)), r, -1 };
+            candidates.push(c);
+        }
+    }
+
+    for (QHash<int, QStringList>::const_iterator it = m_newKeys.constBegin(); it != m_newKeys.constEnd(); ++it) {
+        foreach (const QString &text, it.value()) {
+            if (text.startsWith(prefix)) {
+                const Candidate c = { m_entries.at(it.key()).rank, -1, it.key() };
+                candidates.push(c);
+                break;
+            }
+        }
+    }
+
+    QStringList urls;
+    QSet<int> seen;
+    while (!candidates.empty() && urls.count() < max) {
+        const Candidate c = candidates.top();
+        candidates.pop();
+        if (c.rank == -HUGE_VAL) {
+            break;
+        }
+
+        int entry = c.entry;
+        if (c.node >= n) {
+            entry = m_keys.at(c.node - n).entry;
+        } else if (c.node >= 0) {
+            const Candidate left = { keyRank(m_tree.at(2 * c.node)), 2 * c.node, -1 };
+            const Candidate right = { keyRank(m_tree.at(2 * c.node + 1)), 2 * c.node + 1, -1 };
+            candidates.push(left);
+            candidates.push(right);
+            continue;
+        }
+
+        // an entry can have several keys with the prefix
+        if (!seen.contains(entry)) {
+            seen.insert(entry);
+            urls.append(m_entries.at(entry).url);
+        }
+    }
+    return urls;
+}
@@ -0,0 +1,149 @@
+/* This file is part of the KDE project
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#ifndef KONQ_COMPLETIONINDEX_H
+#define KONQ_COMPLETIONINDEX_H
+
+#include <QtCore/QDateTime>
+#include <QtCore/QHash>
+#include <QtCore/QStringList>
+#include <QtCore/QVector>
+
+#include <konqprivate_export.h>
+
+/**
+ * The history and bookmark urls offered in the popup of the location bar.
+ *
+ * Urls which only differ in the scheme, a leading "www." or a trailing slash
+ * (http://www.kde.org/ and https://kde.org) are one entry, so there is
+ * nothing to remove afterwards. Entries are found by the start of their url
+ * without all that, of the url the user typed to get there, or of a word of
+ * their title.
+ *
+ * Entries are ranked by frecency: visits count, but lose half of their
+ * weight every 30 days, and typed urls get a bonus. As all entries lose
+ * weight at the same rate, the ranking doesn't change over time, and the
+ * best matches can be found without looking at all of them: the prefixes
+ * are kept sorted, with a tree of the best entry of every range on top.
+ */
+class KONQ_TESTS_EXPORT KonqCompletionIndex
+{
+public:
+    KonqCompletionIndex();
+
+    /**
+     * Adds the history entry for @p url, or updates it if it was added before.
+     * @param typedUrl what the user typed to get to @p url, if anything
+     */
+    void insert(const QString &url, const QString &title, const QString &typedUrl,
+                int numberOfTimesVisited, const QDateTime &lastVisited);
+    /**
+     * Removes the history entry for @p url. A bookmark for it stays.
+     */
+    void remove(const QString &url);
+    /**
+     * Adds a bookmark, which is kept apart from the history entry for
+     * the same url. Without visits, bookmarks come after the history.
+     */
+    void insertBookmark(const QString &url, const QString &title);
+    /**
+     * Removes all history entries, but keeps the bookmarks
+     */
+    void clearHistory();
+    void clear();
+
+    /**
+     * @return whether there is a history entry for @p url
+     */
+    bool contains(const QString &url) const
+    {
+        return m_urlEntries.contains(url);
+    }
+
+    /**
+     * @return the number of history entries
+     */
+    int count() const
+    {
+        return m_urlEntries.count();
+    }
+
+    /**
+     * @return the urls of the best @p max entries matching @p text, the best first
+     */
+    QStringList topMatches(const QString &text, int max) const;
+
+    /**
+     * @return the part of @p url which is compared with what the user types:
+     * lower case, without scheme, "www." and trailing slash
+     */
+    static QString normalizedUrl(const QString &url);
+
+private:
+    struct Source {
+        QString url;
+        QString title;
+        QString typedUrl;
+        int numberOfTimesVisited;
+        QDateTime lastVisited;
+        bool bookmark;
+    };
+
+    struct Entry {
+        QString key; // normalized url, empty for unused entries
+        QString url; // the url shown, from the most visited source
+        QVector<Source> sources;
+        double rank;
+    };
+
+    struct Key {
+        QString text;
+        int entry; // -1 once removed
+    };
+
+    void insertSource(const QString &key, const Source &source);
+    void removeSource(const QString &url, bool bookmark);
+    void updateEntry(int id);
+    QStringList keyTexts(int id) const;
+    void addKeys(int id);
+    void removeKeys(int id);
+    void mergeNewKeys();
+    void buildTree() const;
+    void updateTree(int pos);
+    double keyRank(int pos) const;
+
+    QVector<Entry> m_entries;
+    QVector<int> m_freeEntries;
+    QHash<QString, int> m_keyEntries; // normalized url -> entry
+    QHash<QString, int> m_urlEntries; // url of a history entry -> entry
+    QHash<QString, int> m_bookmarkEntries; // url of a bookmark -> entry
+
+    // The keys of an entry are either all in m_keys or all in m_newKeys
+    QVector<Key> m_keys; // sorted by text
+    int m_removedKeys;
+    QHash<int, QStringList> m_newKeys; // entry -> keys not merged into m_keys yet
+    int m_newKeyCount;
+
+    // m_tree[i] is the position in m_keys of the best key below node i,
+    // the leaves are m_tree[m_keys.count() + position]. Only rebuilt
+    // after merging, a removed key just updates the nodes above it.
+    mutable QVector<int> m_tree;
+    mutable bool m_treeDirty;
+};
+
+#endif // KONQ_COMPLETIONINDEX_H
@@ -128,8 +128,10 @@ void KonqFrame::saveConfig(KConfigGroup &config, const QString &prefix, const Ko
 void KonqFrame::copyHistory(KonqFrameBase *other)
 {
     Q_ASSERT(other->frameType() == KonqFrameBase::View);
-    if (m_pView) {
-        m_pView->copyHistory(static_cast<KonqFrame *>(other)->childView());
+    // other can be a KonqPendingTab, which has no view to copy from
+    KonqFrame *otherFrame = dynamic_cast<KonqFrame *>(other);
+    if (m_pView && otherFrame && otherFrame->childView()) {
+        m_pView->copyHistory(otherFrame->childView());
     }
 }
 
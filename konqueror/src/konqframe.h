@@ -58,7 +58,8 @@ public:
     enum Option {
         None = 0x0,
         saveURLs = 0x01, // TODO rename to SaveUrls
-        saveHistoryItems = 0x02 // TODO rename to SaveHistoryItems
+        saveHistoryItems = 0x02, // TODO rename to SaveHistoryItems
+        reuseSavedState = 0x04 // with saveHistoryItems: only ask parts of changed views for their state
     };
     Q_DECLARE_FLAGS(Options, Option)
 
@@ -20,6 +20,9 @@
 
 #include "konqframevisitor.h"
 #include "konqframe.h"
+#include "konqframecontainer.h"
+#include "konqmainwindow.h"
+#include "konqtabs.h"
 #include "konqview.h"
 
 bool KonqViewCollector::visit(KonqFrame *frame)
@@ -66,3 +69,58 @@ QList<KonqView *> KonqModifiedViewsCollector::collect(KonqFrameBase *topLevel)
     return collector.m_views;
 }
 
+KonqSessionStateCollector::KonqSessionStateCollector()
+    : m_stream(&m_state, QIODevice::WriteOnly)
+{
+}
+
+bool KonqSessionStateCollector::visit(KonqFrame *frame)
+{
+    // revisions are unique, they tell views apart too
+    KonqView *view = frame->childView();
+    m_stream << quint8('V') << (view ? view->sessionRevision() : -1);
+    return true;
+}
+
+bool KonqSessionStateCollector::visit(KonqFrameContainer *container)
+{
+    m_stream << quint8('C') << int(container->orientation()) << container->sizes();
+    return true;
+}
+
+bool KonqSessionStateCollector::visit(KonqFrameTabs *tabs)
+{
+    // Tabs which are not loaded yet don't visit anything, but they
+    // are replaced by another frame when they get loaded.
+    m_stream << quint8('T') << tabs->currentIndex() << tabs->childFrameList().count();
+    foreach (KonqFrameBase *frame, tabs->childFrameList()) {
+        m_stream << quintptr(frame);
+    }
+    return true;
+}
+
+bool KonqSessionStateCollector::visit(KonqMainWindow *window)
+{
+    m_stream << quint8('W') << quintptr(window) << window->size()
+             << window->fullScreenMode() << window->saveState();
+    return true;
+}
+
+bool KonqSessionStateCollector::endVisit(KonqFrameContainer *)
+{
+    m_stream << quint8('E');
+    return true;
+}
+
+bool KonqSessionStateCollector::endVisit(KonqFrameTabs *)
+{
+    m_stream << quint8('E');
+    return true;
+}
+
+QByteArray KonqSessionStateCollector::collect(KonqFrameBase *topLevel)
+{
+    KonqSessionStateCollector collector;
+    topLevel->accept(&collector);
+    return collector.m_state;
+}
@@ -21,6 +21,8 @@
 #ifndef KONQ_FRAMEVISITOR_H
 #define KONQ_FRAMEVISITOR_H
 
+#include <QByteArray>
+#include <QDataStream>
 #include <QList>
 #include "konqprivate_export.h"
 
@@ -149,5 +151,26 @@ private:
     QList<KonqView *> m_views;
 };
 
+/**
+ * Sums up what a window saves in the session: the layout of its frames
+ * and tabs, and the session revision of every view. As long as it stays
+ * the same, the window doesn't need to be saved again.
+ */
+class KONQ_TESTS_EXPORT KonqSessionStateCollector : public KonqFrameVisitor
+{
+public:
+    static QByteArray collect(KonqFrameBase *topLevel);
+    bool visit(KonqFrame *frame) Q_DECL_OVERRIDE;
+    bool visit(KonqFrameContainer *container) Q_DECL_OVERRIDE;
+    bool visit(KonqFrameTabs *tabs) Q_DECL_OVERRIDE;
+    bool visit(KonqMainWindow *window) Q_DECL_OVERRIDE;
+    bool endVisit(KonqFrameContainer *) Q_DECL_OVERRIDE;
+    bool endVisit(KonqFrameTabs *) Q_DECL_OVERRIDE;
+private:
+    KonqSessionStateCollector();
+    QByteArray m_state;
+    QDataStream m_stream;
+};
+
 #endif /* KONQ_FRAMEVISITOR_H */
 
@@ -57,16 +57,19 @@ bool KonqHistoryManager::loadHistory()
 {
     clearPending();
     m_pCompletion->clear();
+    m_completionIndex.clearHistory();
 
     if (!KonqHistoryProvider::loadHistory()) {
         return false;
     }
 
-    QListIterator<KonqHistoryEntry> it(entries());
-    while (it.hasNext()) {
-        const KonqHistoryEntry &entry = it.next();
+    const KonqHistoryList &history = entries();
+    for (KonqHistoryList::const_iterator it = history.constBegin(); it != history.constEnd(); ++it) {
+        const KonqHistoryEntry &entry = *it;
         const QString prettyUrlString = entry.url.toDisplayString();
         addToCompletion(prettyUrlString, entry.typedUrl, entry.numberOfTimesVisited);
+        m_completionIndex.insert(prettyUrlString, entry.title, entry.typedUrl,
+                                 entry.numberOfTimesVisited, entry.lastVisited);
     }
 
     return true;
@@ -218,9 +221,9 @@ void KonqHistoryManager::slotEmitUpdated()
 QStringList KonqHistoryManager::allURLs() const
 {
     QStringList list;
-    QListIterator<KonqHistoryEntry> it(entries());
-    while (it.hasNext()) {
-        list.append(it.next().url.url());
+    const KonqHistoryList &history = entries();
+    for (KonqHistoryList::const_iterator it = history.constBegin(); it != history.constEnd(); ++it) {
+        list.append((*it).url.url());
     }
     return list;
 }
@@ -252,20 +255,30 @@ void KonqHistoryManager::slotCleared()
 {
     clearPending();
     m_pCompletion->clear();
+    m_completionIndex.clearHistory();
 }
 
-void KonqHistoryManager::finishAddingEntry(const KonqHistoryEntry &entry, bool isSender)
+void KonqHistoryManager::finishAddingEntries(const QList<KonqHistoryEntry> &entries, bool isSender)
 {
-    const QString urlString = entry.url.url();
-    addToCompletion(entry.url.toDisplayString(), entry.typedUrl);
-    addToUpdateList(urlString);
-    KonqHistoryProvider::finishAddingEntry(entry, isSender);
-
-    // note, no need to do the updateBookmarkMetadata for every
-    // history object, only need to for the broadcast sender as
-    // the history object itself keeps the data consistant.
-    // ### why does the comment do exactly the opposite from the code?
-    const bool updated = m_bookmarkManager ? m_bookmarkManager->updateAccessMetadata(urlString) : false;
+    bool updated = false;
+    foreach (const KonqHistoryEntry &entry, entries) {
+        const QString urlString = entry.url.url();
+        addToCompletion(entry.url.toDisplayString(), entry.typedUrl);
+        m_completionIndex.insert(entry.url.toDisplayString(), entry.title, entry.typedUrl,
+                                 entry.numberOfTimesVisited, entry.lastVisited);
+        m_updateURLs.append(urlString);
+
+        // note, no need to do the updateBookmarkMetadata for every
+        // history object, only need to for the broadcast sender as
+        // the history object itself keeps the data consistant.
+        // ### why does the comment do exactly the opposite from the code?
+        if (m_bookmarkManager && m_bookmarkManager->updateAccessMetadata(urlString)) {
+            updated = true;
+        }
+    }
+    // the update timer and the bookmark saving only once per broadcast
+    m_updateTimer->setSingleShot(true);
+    m_updateTimer->start(500);
 
     if (isSender) {
         // note, bk save does not notify, and we don't want to!
@@ -279,5 +292,6 @@ void KonqHistoryManager::slotEntryRemoved(const KonqHistoryEntry &entry)
 {
     const QString urlString = entry.url.url();
     removeFromCompletion(entry.url.toDisplayString(), entry.typedUrl);
+    m_completionIndex.remove(entry.url.toDisplayString());
     addToUpdateList(urlString);
 }
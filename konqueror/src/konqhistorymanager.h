@@ -28,6 +28,7 @@
 #include <konqprivate_export.h>
 
 #include "konq_historyentry.h"
+#include "konqcompletionindex.h"
 #include "konq_historyprovider.h"
 
 class QTimer;
@@ -101,6 +102,14 @@ public:
         return m_pCompletion;
     }
 
+    /**
+     * @returns the index for the completion popup of the location bar.
+     */
+    KonqCompletionIndex *completionIndex()
+    {
+        return &m_completionIndex;
+    }
+
     // HistoryProvider interface, let konq handle this
     /**
      * Reimplemented in such a way that all URLs that would be filtered
@@ -160,7 +169,7 @@ private Q_SLOTS:
     void slotEntryRemoved(const KonqHistoryEntry &entry);
 
 private:
-    void finishAddingEntry(const KonqHistoryEntry &entry, bool isSender) Q_DECL_OVERRIDE;
+    void finishAddingEntries(const QList<KonqHistoryEntry> &entries, bool isSender) Q_DECL_OVERRIDE;
     void clearPending();
 
     void addToCompletion(const QString &url, const QString &typedUrl, int numberOfTimesVisited = 1);
@@ -175,6 +184,7 @@ private:
     QMap<QString, KonqHistoryEntry *> m_pending;
 
     KCompletion *m_pCompletion; // the completion object we sync with
+    KonqCompletionIndex m_completionIndex;
 
     /**
      * A timer that will emit the KParts::HistoryProvider::updated() signal
@@ -161,6 +161,8 @@ static KBookmarkManager *s_bookmarkManager = 0;
 QList<KonqMainWindow *> *KonqMainWindow::s_lstViews = 0;
 KConfig *KonqMainWindow::s_comboConfig = 0;
 KCompletion *KonqMainWindow::s_pCompletion = 0;
+// the number of history urls in the popup of the location bar
+static const int s_maxHistoryCompletionItems = 100;
 
 KonqOpenURLRequest KonqOpenURLRequest::null;
 
@@ -1670,7 +1672,7 @@ void KonqMainWindow::slotForceReload()
 void KonqMainWindow::slotReloadPopup()
 {
     KonqFrameBase *tab = m_pViewManager->tabContainer()->tabAt(m_workingTab);
-    if (tab) {
+    if (tab && tab->activeChildView()) {
         slotReload(tab->activeChildView());
     }
 }
@@ -4290,6 +4292,10 @@ QList<KBookmarkOwner::FutureBookmark> KonqExtendedBookmarkOwner::currentBookmark
     KonqFrameTabs *tabContainer = m_pKonqMainWindow->viewManager()->tabContainer();
 
     foreach (KonqFrameBase *frame, tabContainer->childFrameList()) {
+        if (KonqPendingTab *pendingTab = dynamic_cast<KonqPendingTab *>(frame)) {
+            list << KBookmarkOwner::FutureBookmark(pendingTab->title(), pendingTab->url(), KIO::iconNameForUrl(pendingTab->url()));
+            continue;
+        }
         if (!frame || !frame->activeChildView()) {
             continue;
         }
@@ -4697,6 +4703,14 @@ void KonqMainWindow::saveProperties(KConfigGroup &config)
     }
 }
 
+void KonqMainWindow::saveChangedProperties(KConfigGroup &config)
+{
+    if (m_fullyConstructed) {
+        KonqFrameBase::Options flags = KonqFrameBase::saveHistoryItems | KonqFrameBase::reuseSavedState;
+        m_pViewManager->saveViewConfigToGroup(config, flags);
+    }
+}
+
 void KonqMainWindow::readProperties(const KConfigGroup &configGroup)
 {
     m_pViewManager->loadViewConfigFromGroup(configGroup, QString() /*no profile name*/);
@@ -5026,9 +5040,10 @@ void KonqMainWindow::slotAddClosedUrl(KonqFrameBase *tab)
 
     // Did the tab contain a single frame, or a splitter?
     KonqFrame *frame = dynamic_cast<KonqFrame *>(tab);
-    if (!frame) {
+    KonqPendingTab *pendingTab = dynamic_cast<KonqPendingTab *>(tab);
+    if (!frame && !pendingTab) {
         KonqFrameContainer *frameContainer = dynamic_cast<KonqFrameContainer *>(tab);
-        if (frameContainer->activeChildView()) {
+        if (frameContainer && frameContainer->activeChildView()) {
             frame = frameContainer->activeChildView()->frame();
         }
     }
@@ -5039,6 +5054,9 @@ void KonqMainWindow::slotAddClosedUrl(KonqFrameBase *tab)
     }
     if (frame) {
         title = frame->title().trimmed();
+    } else if (pendingTab) {
+        url = pendingTab->url().url();
+        title = pendingTab->title().trimmed();
     }
     if (title.isEmpty()) {
         title = url;
@@ -5150,6 +5168,7 @@ void KonqMainWindow::addBookmarksIntoCompletion(const KBookmarkGroup &group)
 
         QString u = url.toDisplayString();
         s_pCompletion->addItem(u);
+        KonqHistoryManager::kself()->completionIndex()->insertBookmark(u, bm.text());
 
         if (url.isLocalFile()) {
             s_pCompletion->addItem(url.toLocalFile());
@@ -5198,155 +5217,16 @@ static QString hp_tryPrepend(const QString &s)
     return (s.startsWith(QLatin1String("www.")) ? "http://" : "http://www.") + s;
 }
 
-static void hp_removeDupe(KCompletionMatches &l, const QString &dupe,
-                          KCompletionMatches::Iterator it_orig)
-{
-    KCompletionMatches::Iterator it = it_orig + 1;
-    while (it != l.end()) {
-        if ((*it).value() == dupe) {
-            (*it_orig).first = qMax((*it_orig).first, (*it).key());
-            it = l.erase(it);
-            continue;
-        }
-        ++it;
-    }
-}
-
-// remove duplicates like 'http://www.kde.org' and 'http://www.kde.org/'
-// (i.e. the trailing slash)
-// some duplicates are also created by prepending protocols
-static void hp_removeDuplicates(KCompletionMatches &l)
-{
-    QString http = QStringLiteral("http://");
-    QString ftp = QStringLiteral("ftp://ftp.");
-    QString file = QStringLiteral("file:");
-    QString file2 = QStringLiteral("file://");
-    l.removeDuplicates();
-    for (KCompletionMatches::Iterator it = l.begin();
-            it != l.end();
-            ++it) {
-        QString str = (*it).value();
-        if (str.startsWith(http)) {
-            if (str.indexOf('/', 7) < 0) {    // http://something<noslash>
-                hp_removeDupe(l, str + '/', it);
-                hp_removeDupe(l, str.mid(7) + '/', it);
-            } else if (str[ str.length() - 1 ] == '/') {
-                hp_removeDupe(l, str.left(str.length() - 1), it);
-                hp_removeDupe(l, str.left(str.length() - 1).mid(7), it);
-            }
-            hp_removeDupe(l, str.mid(7), it);
-        } else if (str.startsWith(ftp)) { // ftp://ftp.
-            hp_removeDupe(l, str.mid(6), it);    // remove dupes without ftp://
-        } else if (str.startsWith(file2)) {
-            hp_removeDupe(l, str.mid(7), it);    // remove dupes without file://
-        } else if (str.startsWith(file)) {
-            hp_removeDupe(l, str.mid(5), it);    // remove dupes without file:
-        }
-    }
-}
-
-static void hp_removeCommonPrefix(KCompletionMatches &l, const QString &prefix)
-{
-    for (KCompletionMatches::Iterator it = l.begin();
-            it != l.end();
-        ) {
-        if ((*it).value().startsWith(prefix)) {
-            it = l.erase(it);
-            continue;
-        }
-        ++it;
-    }
-}
-
-// don't include common prefixes like 'http://', i.e. when s == 'h', include
-// http://hotmail.com but don't include everything just starting with 'http://'
-static void hp_checkCommonPrefixes(KCompletionMatches &matches, const QString &s)
-{
-    static const char *const prefixes[] = {
-        "http://",
-        "https://",
-        "www.",
-        "ftp://",
-        "http://www.",
-        "https://www.",
-        "ftp://ftp.",
-        "file:",
-        "file://",
-        NULL
-    };
-    for (const char *const *pos = prefixes;
-            *pos != NULL;
-            ++pos) {
-        QString prefix = *pos;
-        if (prefix.startsWith(s)) {
-            hp_removeCommonPrefix(matches, prefix);
-        }
-    }
-}
-
 QStringList KonqMainWindow::historyPopupCompletionItems(const QString &s)
 {
-    const QString http = QStringLiteral("http://");
-    const QString https = QStringLiteral("https://");
-    const QString www = QStringLiteral("http://www.");
-    const QString wwws = QStringLiteral("https://www.");
-    const QString ftp = QStringLiteral("ftp://");
-    const QString ftpftp = QStringLiteral("ftp://ftp.");
-    const QString file = QStringLiteral("file:"); // without /, because people enter /usr etc.
-    const QString file2 = QStringLiteral("file://");
     if (s.isEmpty()) {
         return QStringList();
     }
-    KCompletionMatches matches = s_pCompletion->allWeightedMatches(s);
-    hp_checkCommonPrefixes(matches, s);
-    bool checkDuplicates = false;
-    if (!s.startsWith(ftp)) {
-        matches += s_pCompletion->allWeightedMatches(ftp + s);
-        if (QStringLiteral("ftp.").startsWith(s)) {
-            hp_removeCommonPrefix(matches, ftpftp);
-        }
-        checkDuplicates = true;
-    }
-    if (!s.startsWith(https)) {
-        matches += s_pCompletion->allWeightedMatches(https + s);
-        if (QStringLiteral("www.").startsWith(s)) {
-            hp_removeCommonPrefix(matches, wwws);
-        }
-        checkDuplicates = true;
-    }
-    if (!s.startsWith(http)) {
-        matches += s_pCompletion->allWeightedMatches(http + s);
-        if (QStringLiteral("www.").startsWith(s)) {
-            hp_removeCommonPrefix(matches, www);
-        }
-        checkDuplicates = true;
-    }
-    if (!s.startsWith(www)) {
-        matches += s_pCompletion->allWeightedMatches(www + s);
-        checkDuplicates = true;
-    }
-    if (!s.startsWith(wwws)) {
-        matches += s_pCompletion->allWeightedMatches(wwws + s);
-        checkDuplicates = true;
-    }
-    if (!s.startsWith(ftpftp)) {
-        matches += s_pCompletion->allWeightedMatches(ftpftp + s);
-        checkDuplicates = true;
-    }
-    if (!s.startsWith(file)) {
-        matches += s_pCompletion->allWeightedMatches(file + s);
-        checkDuplicates = true;
-    }
-    if (!s.startsWith(file2)) {
-        matches += s_pCompletion->allWeightedMatches(file2 + s);
-        checkDuplicates = true;
-    }
-    if (checkDuplicates) {
-        hp_removeDuplicates(matches);
-    }
-    QStringList items = matches.list();
+
+    // the index doesn't care about schemes and "www.", and has no duplicates
+    QStringList items = KonqHistoryManager::kself()->completionIndex()->topMatches(s, s_maxHistoryCompletionItems);
     if (items.count() == 0
-            && !s.contains(':') && !s.isEmpty() && s[ 0 ] != '/') {
+            && !s.contains(':') && s[ 0 ] != '/') {
         QString pre = hp_tryPrepend(s);
         if (!pre.isNull()) {
             items += pre;
@@ -151,6 +151,12 @@ public:
     void saveProperties(KConfigGroup &config) Q_DECL_OVERRIDE;
     void readProperties(const KConfigGroup &config) Q_DECL_OVERRIDE;
 
+    /**
+     * Like saveProperties(), but views which didn't change since the last call
+     * keep the part state saved back then. For the session autosave.
+     */
+    void saveChangedProperties(KConfigGroup &config);
+
     void setInitialFrameName(const QString &name);
 
     void reparseConfiguration();
@@ -25,6 +25,8 @@
 #include "konqsessionmanageradaptor.h"
 #include "konqviewmanager.h"
 #include "konqsettingsxt.h"
+#include "konqframevisitor.h"
+#include "konqview.h"
 
 #include <kglobal.h>
 #include <QDebug>
@@ -429,6 +431,8 @@ void KonqSessionManager::enableAutosave()
 
     delete m_sessionConfig;
     m_sessionConfig = new KConfig(filePath, KConfig::SimpleConfig);
+    m_savedWindows.clear();
+    m_savedWindowStates.clear();
     //qDebug() << "config filename:" << m_sessionConfig->name();
 
     m_autosaveEnabled = true;
@@ -463,7 +467,8 @@ void KonqSessionManager::autoSaveSession()
         m_autoSaveTimer.stop();
     }
 
-    saveCurrentSessionToFile(m_sessionConfig);
+    // sync() doesn't write anything if no entry changed
+    saveChangedWindowsToFile(m_sessionConfig);
     m_sessionConfig->sync();
     m_sessionConfig->markAsClean();
 
@@ -513,6 +518,53 @@ void KonqSessionManager::saveCurrentSessionToFile(KConfig *config)
     configGroup.writeEntry("Number of Windows", counter);
 }
 
+void KonqSessionManager::saveChangedWindowsToFile(KConfig *config)
+{
+    QList<KonqMainWindow *> *mainWindows = KonqMainWindow::mainWindowList();
+    QList<QByteArray> states;
+
+    if (!mainWindows || mainWindows->isEmpty()) {
+        return;
+    }
+
+    foreach (KonqMainWindow *window, *mainWindows) {
+        const int counter = states.count();
+
+        // Scrolling doesn't tell the view anything, so the page the user
+        // is looking at is saved again every time.
+        if (window->isActiveWindow() && window->currentView()) {
+            window->currentView()->markSessionChanged();
+        }
+
+        const QByteArray state = KonqSessionStateCollector::collect(window);
+        const bool saved = counter < m_savedWindowStates.count();
+        if (saved && state == m_savedWindowStates.at(counter)) {
+            states.append(state);
+            continue;
+        }
+
+        const QString groupName = "Window" + QString::number(counter);
+        // windows move up when one before them is closed
+        if (saved && m_savedWindows.at(counter) != window) {
+            config->deleteGroup(groupName);
+        }
+        KConfigGroup configGroup(config, groupName);
+        window->saveChangedProperties(configGroup);
+
+        // saving may have given views a new revision
+        states.append(KonqSessionStateCollector::collect(window));
+    }
+
+    for (int i = states.count(); i < m_savedWindowStates.count(); ++i) {
+        config->deleteGroup("Window" + QString::number(i));
+    }
+    m_savedWindows = *mainWindows;
+    m_savedWindowStates = states;
+
+    KConfigGroup configGroup(config, "General");
+    configGroup.writeEntry("Number of Windows", states.count());
+}
+
 QString KonqSessionManager::autosaveDirectory() const
 {
     return m_autosaveDir;
@@ -205,6 +205,13 @@ private:
     }
 
     void saveCurrentSessionToFile(KConfig *);
+
+    /**
+     * Like saveCurrentSessionToFile(), but only saves the windows which
+     * changed since the last call into config again. The others keep
+     * their groups from back then.
+     */
+    void saveChangedWindowsToFile(KConfig *config);
 private:
     QTimer m_autoSaveTimer;
     QString m_autosaveDir;
@@ -212,6 +219,9 @@ private:
     bool m_autosaveEnabled;
     bool m_createdOwnedByDir;
     KConfig *m_sessionConfig;
+    // window and KonqSessionStateCollector result of every window group in m_sessionConfig
+    QList<KonqMainWindow *> m_savedWindows;
+    QList<QByteArray> m_savedWindowStates;
 
 Q_SIGNALS: // DBUS signals
     /**
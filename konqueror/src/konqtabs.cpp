@@ -28,6 +28,7 @@
 #include <QToolButton>
 #include <QIcon>
 #include <QMimeData>
+#include <QTimer>
 
 #include <kcolorscheme.h>
 #include <QDebug>
@@ -338,9 +339,10 @@ void KonqFrameTabs::refreshSubPopupMenuTab()
     m_pSubPopupMenuTab->addSeparator();
     foreach (KonqFrameBase *frameBase, m_childFrameList) {
         KonqFrame *frame = dynamic_cast<KonqFrame *>(frameBase);
-        if (frame && frame->activeChildView()) {
-            QString title = frame->title().trimmed();
-            const QUrl url = frame->activeChildView()->url();
+        KonqPendingTab *pendingTab = dynamic_cast<KonqPendingTab *>(frameBase);
+        if ((frame && frame->activeChildView()) || pendingTab) {
+            QString title = frame ? frame->title().trimmed() : pendingTab->title().trimmed();
+            const QUrl url = frame ? frame->activeChildView()->url() : pendingTab->url();
             if (title.isEmpty()) {
                 title = url.toDisplayString();
             }
@@ -390,7 +392,7 @@ void KonqFrameTabs::slotMouseMiddleClick(QWidget *w)
     QUrl filteredURL(KonqMisc::konqFilteredURL(m_pViewManager->mainWindow(), QApplication::clipboard()->text(QClipboard::Selection)));
     if (filteredURL.isValid() && filteredURL.scheme() != QLatin1String("error")) {
         KonqFrameBase *frame = dynamic_cast<KonqFrameBase *>(w);
-        if (frame) {
+        if (frame && frame->activeChildView()) {
             m_pViewManager->mainWindow()->openUrl(frame->activeChildView(), filteredURL);
         }
     }
@@ -419,7 +421,7 @@ void KonqFrameTabs::slotReceivedDropEvent(QWidget *w, QDropEvent *e)
 {
     QList<QUrl> lstDragURLs = KUrlMimeData::urlsFromMimeData(e->mimeData());
     KonqFrameBase *frame = dynamic_cast<KonqFrameBase *>(w);
-    if (lstDragURLs.count() && frame) {
+    if (lstDragURLs.count() && frame && frame->activeChildView()) {
         const QUrl dragUrl = lstDragURLs.first();
         if (dragUrl != frame->activeChildView()->url()) {
             emit openUrl(frame->activeChildView(), dragUrl);
@@ -431,11 +433,13 @@ void KonqFrameTabs::slotInitiateDrag(QWidget *w)
 {
     KonqFrameBase *frame = dynamic_cast<KonqFrameBase *>(w);
     if (frame) {
+        KonqPendingTab *pendingTab = dynamic_cast<KonqPendingTab *>(frame);
+        const QUrl url = pendingTab ? pendingTab->url() : frame->activeChildView()->url();
         QDrag *d = new QDrag(this);
         QMimeData *md = new QMimeData;
-        md->setUrls(QList<QUrl>() << frame->activeChildView()->url());
+        md->setUrls(QList<QUrl>() << url);
         d->setMimeData(md);
-        QString iconName = KMimeType::iconNameForUrl(frame->activeChildView()->url());
+        QString iconName = KMimeType::iconNameForUrl(url);
         d->setPixmap(KIconLoader::global()->loadIcon(iconName, KIconLoader::Small, 0));
         //d->setPixmap( KIconLoader::global()->loadMimeTypeIcon(KMimeType::pixmapForURL( frame->activeChildView()->url(), 0), KIconLoader::Small ) );
         d->start();
@@ -632,3 +636,103 @@ bool KonqFrameTabs::eventFilter(QObject *watched, QEvent *event)
     return KTabWidget::eventFilter(watched, event);
 }
 
+
+//###################################################################
+
+KonqPendingTab::KonqPendingTab(const KConfigGroup &config, const QString &prefix,
+                               KonqFrameContainerBase *parentContainer, KonqViewManager *viewManager)
+    : QWidget(parentContainer->asQWidget()),
+      m_pViewManager(viewManager)
+{
+    m_pParentContainer = parentContainer;
+
+    // The entries of the view are called <prefix>Name, the ones
+    // of its history items HistoryItem<prefix><index>Name
+    const QString urlKey = QStringLiteral("URL");
+    const QString historyPrefix = QLatin1String("HistoryItem") + prefix;
+    foreach (const QString &key, config.keyList()) {
+        // Read as bytes, so that binary entries like the history buffers survive
+        if (key.startsWith(historyPrefix)) {
+            m_historyEntries.insert(key.mid(historyPrefix.length()), config.readEntry(key, QByteArray()));
+        } else if (key.startsWith(prefix)) {
+            const QString name = key.mid(prefix.length());
+            if (name == urlKey) {
+                m_urlEntry = config.readPathEntry(key, QString());
+            } else {
+                m_entries.insert(name, config.readEntry(key, QByteArray()));
+            }
+        }
+    }
+
+    const int historySize = m_entries.value(QStringLiteral("NumberOfHistoryItems")).toInt();
+    if (historySize > 0) {
+        bool ok;
+        int currentIndex = m_entries.value(QStringLiteral("CurrentHistoryItem")).toInt(&ok);
+        if (!ok || currentIndex >= historySize) {
+            currentIndex = historySize - 1;
+        }
+        const QString item = QString::number(currentIndex);
+        m_url = QUrl(QString::fromUtf8(m_historyEntries.value(item + QLatin1String("Url"))));
+        m_title = QString::fromUtf8(m_historyEntries.value(item + QLatin1String("Title")));
+    } else if (!m_urlEntry.isEmpty()) {
+        m_url = QUrl(m_urlEntry);
+    }
+    if (m_title.isEmpty()) {
+        m_title = m_url.toDisplayString();
+    }
+}
+
+KonqPendingTab::~KonqPendingTab()
+{
+}
+
+bool KonqPendingTab::accept(KonqFrameVisitor *)
+{
+    return true;
+}
+
+void KonqPendingTab::saveConfig(KConfigGroup &config, const QString &prefix, const KonqFrameBase::Options &,
+                                KonqFrameBase *docContainer, int, int)
+{
+    const QString docContainerKey = QStringLiteral("docContainer");
+    for (QMap<QString, QByteArray>::const_iterator it = m_entries.constBegin(); it != m_entries.constEnd(); ++it) {
+        if (it.key() != docContainerKey) {
+            config.writeEntry(prefix + it.key(), it.value());
+        }
+    }
+    const QString historyPrefix = QLatin1String("HistoryItem") + prefix;
+    for (QMap<QString, QByteArray>::const_iterator it = m_historyEntries.constBegin(); it != m_historyEntries.constEnd(); ++it) {
+        config.writeEntry(historyPrefix + it.key(), it.value());
+    }
+    if (!m_urlEntry.isEmpty()) {
+        config.writePathEntry(QStringLiteral("URL").prepend(prefix), m_urlEntry);
+    }
+    if (this == docContainer) {
+        config.writeEntry(docContainerKey.prepend(prefix), true);
+    }
+}
+
+void KonqPendingTab::copyHistory(KonqFrameBase *)
+{
+    // Nothing to copy into, the history is part of the saved entries
+}
+
+void KonqPendingTab::setTitle(const QString &, QWidget *)
+{
+}
+
+void KonqPendingTab::setTabIcon(const QUrl &, QWidget *)
+{
+}
+
+void KonqPendingTab::activateChild()
+{
+    // We are called from the tab widget's currentChanged signal,
+    // don't replace the tab from in there
+    QTimer::singleShot(0, this, SLOT(slotLoad()));
+}
+
+void KonqPendingTab::slotLoad()
+{
+    m_pViewManager->loadPendingTab(this);
+}
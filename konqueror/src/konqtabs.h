@@ -26,8 +26,11 @@
 #include "konqframecontainer.h"
 
 #include <ktabwidget.h>
+#include <KConfigGroup>
 #include <QKeyEvent>
 #include <QtCore/QList>
+#include <QtCore/QMap>
+#include <QUrl>
 
 class QMenu;
 class QToolButton;
@@ -162,6 +165,88 @@ private:
     QMap<QString, QAction *> m_popupActions;
 };
 
+/**
+ * Stands in for a tab whose view has not been created yet.
+ *
+ * When a session is restored, only the current tab gets a view. The other
+ * tabs keep the config entries of their view and show its last title and
+ * icon; the view is created the first time the tab is activated.
+ * Saving a pending tab writes its entries back unchanged.
+ */
+class KONQ_TESTS_EXPORT KonqPendingTab : public QWidget, public KonqFrameBase
+{
+    Q_OBJECT
+
+public:
+    KonqPendingTab(const KConfigGroup &config, const QString &prefix,
+                   KonqFrameContainerBase *parentContainer, KonqViewManager *viewManager);
+    virtual ~KonqPendingTab();
+
+    bool isContainer() const Q_DECL_OVERRIDE
+    {
+        return false;
+    }
+
+    /**
+     * There is no view to visit, so this only returns true.
+     */
+    bool accept(KonqFrameVisitor *visitor) Q_DECL_OVERRIDE;
+
+    void saveConfig(KConfigGroup &config, const QString &prefix, const KonqFrameBase::Options &options,
+                    KonqFrameBase *docContainer, int id = 0, int depth = 0) Q_DECL_OVERRIDE;
+    void copyHistory(KonqFrameBase *other) Q_DECL_OVERRIDE;
+
+    void setTitle(const QString &title, QWidget *sender) Q_DECL_OVERRIDE;
+    void setTabIcon(const QUrl &url, QWidget *sender) Q_DECL_OVERRIDE;
+
+    QWidget *asQWidget() Q_DECL_OVERRIDE
+    {
+        return this;
+    }
+    KonqFrameBase::FrameType frameType() const Q_DECL_OVERRIDE
+    {
+        return KonqFrameBase::View;
+    }
+
+    /**
+     * Creates the view, replacing this tab, once control returns
+     * to the event loop.
+     */
+    void activateChild() Q_DECL_OVERRIDE;
+
+    KonqView *activeChildView() const Q_DECL_OVERRIDE
+    {
+        return 0;
+    }
+
+    /**
+     * The title of the page shown when the session was saved
+     */
+    QString title() const
+    {
+        return m_title;
+    }
+
+    /**
+     * The URL of the page shown when the session was saved
+     */
+    QUrl url() const
+    {
+        return m_url;
+    }
+
+private Q_SLOTS:
+    void slotLoad();
+
+private:
+    KonqViewManager *m_pViewManager;
+    QMap<QString, QByteArray> m_entries; // keys without prefix, except URL
+    QMap<QString, QByteArray> m_historyEntries; // keys without HistoryItem<prefix>
+    QString m_urlEntry; // the URL entry is a path entry
+    QString m_title;
+    QUrl m_url;
+};
+
 #include <QToolButton>
 
 class NewTabToolButton : public QToolButton // subclass with drag'n'drop functionality for links
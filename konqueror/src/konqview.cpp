@@ -111,6 +111,8 @@ KonqView::KonqView(KonqViewFactory &viewFactory,
     m_bBuiltinView = false;
     m_bURLDropHandling = false;
     m_bErrorURL = false;
+    m_savedSessionRevision = -1;
+    markSessionChanged();
 
 #ifdef KActivities_FOUND
     m_activityResourceInstance = new KActivities::ResourceInstance(mainWindow->winId(), this);
@@ -267,6 +269,7 @@ void KonqView::switchView(KonqViewFactory &viewFactory)
     }
 
     connectPart();
+    markSessionChanged();
 
     QVariant prop;
 
@@ -631,6 +634,7 @@ void KonqView::setLocationBarURL(const QString &locationBarURL)
 {
     //qDebug() << locationBarURL << "this=" << this;
     m_sLocationBarURL = locationBarURL;
+    markSessionChanged();
     if (m_pMainWindow->currentView() == this) {
         //qDebug() << "is current view" << this;
         m_pMainWindow->setLocationBarURL(m_sLocationBarURL);
@@ -655,6 +659,7 @@ void KonqView::setIconURL(const QUrl &iconURL)
 void KonqView::setPageSecurity(int pageSecurity)
 {
     m_pageSecurity = static_cast<KonqMainWindow::PageSecurity>(pageSecurity);
+    markSessionChanged();
 
     if (m_pMainWindow->currentView() == this) {
         m_pMainWindow->setPageSecurity(m_pageSecurity);
@@ -688,6 +693,7 @@ void KonqView::setCaption(const QString &caption)
     }
 
     m_caption = adjustedCaption;
+    markSessionChanged();
     if (!m_bPassiveMode) {
         frame()->setTitle(adjustedCaption, 0L);
     }
@@ -736,6 +742,7 @@ void KonqView::appendHistoryEntry(HistoryEntry *historyEntry)
     }
 
     m_lstHistory.append(historyEntry);
+    markSessionChanged();
 }
 
 void KonqView::updateHistoryEntry(bool saveLocationBarURL)
@@ -748,6 +755,7 @@ void KonqView::updateHistoryEntry(bool saveLocationBarURL)
     }
 
     current->reload = false; // We have a state for it now.
+    markSessionChanged();
     if (browserExtension()) {
         current->buffer = QByteArray(); // Start with empty buffer.
         QDataStream stream(&current->buffer, QIODevice::WriteOnly);
@@ -971,6 +979,7 @@ void KonqView::setPassiveMode(bool mode)
     // the part should be removed from the part manager,
     // and if the other way round, it should be readded to the part manager...
     m_bPassiveMode = mode;
+    markSessionChanged();
 
     if (mode && m_pMainWindow->viewCount() > 1 && m_pMainWindow->currentView() == this) {
         KParts::Part *part = m_pMainWindow->viewManager()->chooseNextView(this)->part();    // switch active part
@@ -984,6 +993,7 @@ void KonqView::setPassiveMode(bool mode)
 void KonqView::setLinkedView(bool mode)
 {
     m_bLinkedView = mode;
+    markSessionChanged();
     if (m_pMainWindow->currentView() == this) {
         m_pMainWindow->linkViewAction()->setChecked(mode);
     }
@@ -993,6 +1003,13 @@ void KonqView::setLinkedView(bool mode)
 void KonqView::setLockedLocation(bool b)
 {
     m_bLockedLocation = b;
+    markSessionChanged();
+}
+
+void KonqView::markSessionChanged()
+{
+    static int s_sessionRevision = 0;
+    m_sessionRevision = ++s_sessionRevision;
 }
 
 void KonqView::aboutToOpenURL(const QUrl &url, const KParts::OpenUrlArguments &args)
@@ -1353,9 +1370,13 @@ void KonqView::saveConfig(KConfigGroup &config, const QString &prefix, const Kon
     if (options & KonqFrameBase::saveURLs) {
         config.writePathEntry(QStringLiteral("URL").prepend(prefix), url().url());
     } else if (options & KonqFrameBase::saveHistoryItems) {
-        if (m_pPart && !m_bLockHistory) {
+        // With reuseSavedState, the state saved last time is still good
+        // unless something changed since then
+        if (m_pPart && !m_bLockHistory &&
+                (!(options & KonqFrameBase::reuseSavedState) || m_sessionRevision != m_savedSessionRevision)) {
             updateHistoryEntry(true);
         }
+        m_savedSessionRevision = m_sessionRevision;
         QList<HistoryEntry *>::Iterator it = m_lstHistory.begin();
         for (int i = 0; it != m_lstHistory.end(); ++it, ++i) {
             // In order to not end up with a huge config file, we only save full
@@ -190,8 +190,26 @@ public:
     void setHistoryIndex(int index)
     {
         m_lstHistoryIndex = index;
+        markSessionChanged();
     }
 
+    /**
+     * A number which changes whenever something this view saves in the
+     * session changes, e.g. its history, location or mode. Revisions are
+     * unique among all views, so they also tell views apart.
+     * Used by the session autosave to find out what needs to be saved again.
+     */
+    int sessionRevision() const
+    {
+        return m_sessionRevision;
+    }
+
+    /**
+     * Give the view a new session revision, e.g. because the state of
+     * the part changed in a way the view doesn't notice (scrolling).
+     */
+    void markSessionChanged();
+
     /**
      * @return the history of this view
      */
@@ -385,6 +403,7 @@ public:
     void setToggleView(bool b)
     {
         m_bToggleView = b;
+        markSessionChanged();
     }
     bool isToggleView() const
     {
@@ -661,6 +680,8 @@ private:
     QString m_dbusObjectPath;
     KonqBrowserInterface *m_browserIface;
     int m_randID;
+    int m_sessionRevision;
+    int m_savedSessionRevision;
 
 #ifdef KActivities_FOUND
     KActivities::ResourceInstance *m_activityResourceInstance;
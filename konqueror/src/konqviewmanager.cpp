@@ -559,6 +559,29 @@ void KonqViewManager::openClosedTab(const KonqClosedTabItem &closedTab)
     m_tabContainer->setCurrentIndex(pos);
 }
 
+void KonqViewManager::loadPendingTab(KonqPendingTab *pendingTab)
+{
+    const int index = m_tabContainer->childFrameList().indexOf(pendingTab);
+    if (index == -1 || m_tabContainer->currentWidget() != pendingTab) {
+        return;
+    }
+
+    KConfig config(QString(), KConfig::SimpleConfig);
+    KConfigGroup profileGroup(&config, "Profile");
+    QString prefix = KonqFrameBase::frameTypeToString(pendingTab->frameType()) + QString::number(0);
+    profileGroup.writeEntry("RootItem", prefix);
+    prefix.append(QLatin1Char('_'));
+    pendingTab->saveConfig(profileGroup, prefix, KonqFrameBase::saveHistoryItems, 0L, 0, 1);
+
+    // The new view is inserted before the pending tab; make it current
+    // first, so that removing the pending tab doesn't activate another one
+    loadRootItem(profileGroup, m_tabContainer, QUrl(), true, QUrl(), QString(), false, index);
+    m_tabContainer->setCurrentIndex(index);
+
+    m_tabContainer->childFrameRemoved(pendingTab);
+    pendingTab->deleteLater();
+}
+
 void KonqViewManager::removeView(KonqView *view)
 {
 #ifdef DEBUG_VIEWMGR
@@ -1257,9 +1280,21 @@ void KonqViewManager::loadItem(const KConfigGroup &cfg, KonqFrameContainerBase *
             parent->insertChildFrame(m_tabContainer);
         }
 
+        // Only the current tab gets a view right away, the others wait for being activated.
+        // Tabs with split views are always loaded.
+        const bool restoreOnDemand = openUrl && forcedUrl.isEmpty() && KonqSettings::restoreTabsOnDemand();
+
         const QStringList childList = cfg.readEntry(QStringLiteral("Children").prepend(prefix), QStringList());
-        for (QStringList::const_iterator it = childList.begin(); it != childList.end(); ++it) {
-            loadItem(cfg, tabContainer(), *it, defaultURL, openUrl, forcedUrl, forcedService);
+        for (int i = 0; i < childList.count(); ++i) {
+            const QString &childName = childList.at(i);
+            if (restoreOnDemand && i != index && childName.startsWith(QLatin1String("View"))) {
+                KonqPendingTab *pendingTab = new KonqPendingTab(cfg, childName + QLatin1Char('_'), m_tabContainer, this);
+                m_tabContainer->insertChildFrame(pendingTab);
+                m_tabContainer->setTitle(pendingTab->title(), pendingTab);
+                m_tabContainer->setTabIcon(pendingTab->url(), pendingTab);
+                continue;
+            }
+            loadItem(cfg, tabContainer(), childName, defaultURL, openUrl, forcedUrl, forcedService);
             QWidget *currentPage = m_tabContainer->currentWidget();
             if (currentPage != 0L) {
                 KonqView *activeChildView = dynamic_cast<KonqFrameBase *>(currentPage)->activeChildView();
@@ -46,6 +46,7 @@ class KonqFrameContainerBase;
 class KonqView;
 class KonqClosedTabItem;
 class KonqClosedWindowItem;
+class KonqPendingTab;
 
 namespace KParts
 {
@@ -153,6 +154,13 @@ public:
 
     void reloadAllTabs();
 
+    /**
+     * Creates the view of a tab restored on demand, and puts it
+     * in place of @p pendingTab, which is deleted.
+     * Does nothing if @p pendingTab isn't the current tab anymore.
+     */
+    void loadPendingTab(KonqPendingTab *pendingTab);
+
     /**
      * Creates the tabwidget on demand and returns it.
      */
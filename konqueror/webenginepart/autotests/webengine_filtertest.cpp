@@ -0,0 +1,260 @@
+/* This file is part of the KDE project
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.LIB.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include <QTest>
+#include <QObject>
+#include <QUrl>
+
+#include "settings/webengine_filter.h"
+
+using namespace KDEPrivate;
+
+class WebEngineFilterTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testPattern_data();
+    void testPattern();
+    void testThirdParty();
+    void testDomains();
+    void testTypes();
+    void testNoKeyword();
+    void testSkippedLines();
+    void testExceptions();
+    void testSharedKeywords();
+};
+
+QTEST_GUILESS_MAIN(WebEngineFilterTest)
+
+static bool isMatched(const QString &filter, const FilterRequest &request)
+{
+    FilterSet set;
+    set.addFilter(filter);
+    return set.isRequestMatched(request);
+}
+
+static FilterRequest request(const QString &url, const QString &page,
+                             FilterRequest::ResourceType type = FilterRequest::Script)
+{
+    return FilterRequest(QUrl(url), QUrl(page), type);
+}
+
+void WebEngineFilterTest::testPattern_data()
+{
+    QTest::addColumn<QString>("filter");
+    QTest::addColumn<QString>("url");
+    QTest::addColumn<bool>("matched");
+
+    // || anchors the host or one of its subdomains
+    QTest::newRow("domain") << "||example.com^" << "http://example.com/ad.js" << true;
+    QTest::newRow("subdomain") << "||example.com^" << "https://ads.example.com/ad.js" << true;
+    QTest::newRow("domain in label") << "||example.com^" << "http://badexample.com/ad.js" << false;
+    QTest::newRow("longer domain") << "||example.com^" << "http://example.community/ad.js" << false;
+    QTest::newRow("domain in query") << "||example.com^" << "http://other.org/?u=http://example.com/" << false;
+    QTest::newRow("domain and port") << "||example.com^" << "http://example.com:8080/" << true;
+
+    // | anchors the start or the end
+    QTest::newRow("start") << "|http://ads." << "http://ads.example.org/" << true;
+    QTest::newRow("not at start") << "|http://ads." << "http://example.org/?http://ads." << false;
+    QTest::newRow("other scheme") << "|http://ads." << "https://ads.example.org/" << false;
+    QTest::newRow("end") << "swf|" << "http://example.org/movie.swf" << true;
+    QTest::newRow("not at end") << "swf|" << "http://example.org/movie.swf?autoplay=1" << false;
+    QTest::newRow("start and end") << "|http://example.org/|" << "http://example.org/" << true;
+    QTest::newRow("start and end, longer") << "|http://example.org/|" << "http://example.org/index.html" << false;
+    QTest::newRow("end after wildcard") << "/ads/*.gif|" << "http://example.org/ads/a.gif?x=1" << false;
+    QTest::newRow("end after wildcard, last one") << "/ads/*.gif|" << "http://example.org/ads/a.gif?x=.gif" << true;
+
+    // ^ matches a separator or the end
+    QTest::newRow("separators") << "^ad^" << "http://example.org/ad/1.png" << true;
+    QTest::newRow("separator query") << "^ad^" << "http://example.org/ad?id=1" << true;
+    QTest::newRow("separator at end") << "^ad^" << "http://example.org/ad" << true;
+    QTest::newRow("letter") << "^ad^" << "http://example.org/load/1.png" << false;
+    QTest::newRow("dash") << "^ad^" << "http://example.org/ad-free/" << false;
+
+    // wildcards and case
+    QTest::newRow("wildcard") << "/banner/*/img^" << "http://example.org/banner/big/img?x=1" << true;
+    QTest::newRow("wildcard, wrong order") << "/banner/*/img^" << "http://example.org/img/banner/" << false;
+    QTest::newRow("case") << "Banner" << "http://example.org/BANNER.gif" << true;
+    QTest::newRow("match-case") << "Banner$match-case" << "http://example.org/Banner.gif" << true;
+    QTest::newRow("match-case, other case") << "Banner$match-case" << "http://example.org/banner.gif" << false;
+    QTest::newRow("non-ascii") << QString::fromUtf8("\xc3\xbc-ad") << QString::fromUtf8("http://example.org/\xc3\xbc-ad.js") << true;
+
+    // regular expressions, found by the plain string all of their matches contain
+    QTest::newRow("regexp") << "/banner[0-9]+\\.gif/" << "http://example.org/BANNER12.gif" << true;
+    QTest::newRow("regexp, no match") << "/banner[0-9]+\\.gif/" << "http://example.org/banner.gif" << false;
+    QTest::newRow("regexp optional") << "/adverts?\\.js/" << "http://example.org/advert.js" << true;
+    QTest::newRow("regexp escaped") << "/ad\\/server/" << "http://example.org/ad/server" << true;
+    QTest::newRow("regexp repeated") << "/tra{2}ck/" << "http://example.org/traack" << true;
+    QTest::newRow("regexp class") << "/[abc]+track/" << "http://example.org/cbtrack" << true;
+    QTest::newRow("regexp group") << "/(ads|track)\\.js/" << "http://example.org/track.js" << true;
+    // alternatives at the top leave no keyword, such filters are checked for every URL
+    QTest::newRow("regexp alternatives") << "/ads|track/" << "http://example.org/track.js" << true;
+    QTest::newRow("regexp alternatives, no match") << "/ads|track/" << "http://example.org/home" << false;
+    QTest::newRow("regexp without literal") << "/\\d{5}/" << "http://example.org/12345" << true;
+}
+
+void WebEngineFilterTest::testPattern()
+{
+    QFETCH(QString, filter);
+    QFETCH(QString, url);
+    QFETCH(bool, matched);
+
+    FilterSet set;
+    set.addFilter(filter);
+    QCOMPARE(set.isUrlMatched(url), matched);
+    QCOMPARE(set.urlMatchedBy(url), matched ? filter : QString());
+}
+
+void WebEngineFilterTest::testThirdParty()
+{
+    const QString filter = QStringLiteral("||tracker.net^$third-party");
+    QVERIFY(isMatched(filter, request(QStringLiteral("http://tracker.net/t.js"), QStringLiteral("http://news.org/"))));
+    QVERIFY(!isMatched(filter, request(QStringLiteral("http://tracker.net/t.js"), QStringLiteral("http://www.tracker.net/"))));
+    // the registered domain decides, not the host
+    QVERIFY(!isMatched(filter, request(QStringLiteral("http://cdn.tracker.net/t.js"), QStringLiteral("https://tracker.net/"))));
+    // without the page, filters with options don't match
+    QVERIFY(!isMatched(filter, FilterRequest(QStringLiteral("http://tracker.net/t.js"))));
+
+    const QString firstParty = QStringLiteral("||tracker.net^$~third-party");
+    QVERIFY(!isMatched(firstParty, request(QStringLiteral("http://tracker.net/t.js"), QStringLiteral("http://news.org/"))));
+    QVERIFY(isMatched(firstParty, request(QStringLiteral("http://tracker.net/t.js"), QStringLiteral("http://tracker.net/"))));
+}
+
+void WebEngineFilterTest::testDomains()
+{
+    const QString filter = QStringLiteral("/ad.js$domain=example.com|~shop.example.com");
+    const QString url = QStringLiteral("http://cdn.org/ad.js");
+    QVERIFY(isMatched(filter, request(url, QStringLiteral("http://example.com/"))));
+    QVERIFY(isMatched(filter, request(url, QStringLiteral("http://www.example.com/"))));
+    QVERIFY(!isMatched(filter, request(url, QStringLiteral("http://shop.example.com/"))));
+    QVERIFY(!isMatched(filter, request(url, QStringLiteral("http://www.shop.example.com/"))));
+    QVERIFY(!isMatched(filter, request(url, QStringLiteral("http://notexample.com/"))));
+    QVERIFY(!isMatched(filter, FilterRequest(url)));
+
+    const QString excluded = QStringLiteral("/ad.js$domain=~example.com");
+    QVERIFY(!isMatched(excluded, request(url, QStringLiteral("http://example.com/"))));
+    QVERIFY(isMatched(excluded, request(url, QStringLiteral("http://other.org/"))));
+}
+
+void WebEngineFilterTest::testTypes()
+{
+    const QString url = QStringLiteral("http://example.org/ads/1");
+    const QString page = QStringLiteral("http://example.org/");
+    QVERIFY(isMatched(QStringLiteral("ads/$image"), request(url, page, FilterRequest::Image)));
+    QVERIFY(!isMatched(QStringLiteral("ads/$image"), request(url, page, FilterRequest::Script)));
+    QVERIFY(isMatched(QStringLiteral("ads/$image,script"), request(url, page, FilterRequest::Script)));
+    QVERIFY(!isMatched(QStringLiteral("ads/$~script"), request(url, page, FilterRequest::Script)));
+    QVERIFY(isMatched(QStringLiteral("ads/$~script"), request(url, page, FilterRequest::Stylesheet)));
+    // options which make no sense for requests drop the filter
+    QVERIFY(!isMatched(QStringLiteral("ads/$popup"), request(url, page, FilterRequest::Script)));
+    QVERIFY(!isMatched(QStringLiteral("ads/$popup"), FilterRequest(url)));
+    // a $ followed by a path is part of the pattern
+    QVERIFY(isMatched(QStringLiteral("$ad/"), FilterRequest(QStringLiteral("http://example.org/$ad/1"))));
+}
+
+void WebEngineFilterTest::testNoKeyword()
+{
+    // found through the domains of the page
+    const QString filter = QStringLiteral("$script,domain=example.com");
+    QVERIFY(isMatched(filter, request(QStringLiteral("http://cdn.org/lib.js"), QStringLiteral("http://www.example.com/"))));
+    QVERIFY(!isMatched(filter, request(QStringLiteral("http://cdn.org/lib.png"), QStringLiteral("http://www.example.com/"), FilterRequest::Image)));
+    QVERIFY(!isMatched(filter, request(QStringLiteral("http://cdn.org/lib.js"), QStringLiteral("http://other.org/"))));
+
+    // checked for every request
+    const QString everywhere = QStringLiteral("$script,third-party");
+    QVERIFY(isMatched(everywhere, request(QStringLiteral("http://cdn.org/lib.js"), QStringLiteral("http://example.com/"))));
+    QVERIFY(!isMatched(everywhere, request(QStringLiteral("http://example.com/lib.js"), QStringLiteral("http://example.com/"))));
+
+    // together with keyword filters
+    FilterSet set;
+    set.addFilter(QStringLiteral("||ads.example.net^"));
+    set.addFilter(filter);
+    set.addFilter(QStringLiteral("/^https?:\\/\\/[0-9]+\\./"));
+    QVERIFY(set.isRequestMatched(request(QStringLiteral("http://cdn.org/lib.js"), QStringLiteral("http://example.com/"))));
+    QVERIFY(set.isUrlMatched(QStringLiteral("http://ads.example.net/")));
+    QVERIFY(set.isUrlMatched(QStringLiteral("http://12.example.org/")));
+    QVERIFY(!set.isUrlMatched(QStringLiteral("http://www.example.net/")));
+}
+
+void WebEngineFilterTest::testSkippedLines()
+{
+    FilterSet set;
+    set.addFilter(QStringLiteral("[Adblock Plus 2.0]"));
+    set.addFilter(QStringLiteral("! example.org"));
+    set.addFilter(QStringLiteral("example.org##.banner"));
+    set.addFilter(QStringLiteral("example.org#@#.banner"));
+    set.addFilter(QStringLiteral("   "));
+    QVERIFY(!set.isUrlMatched(QStringLiteral("http://example.org/")));
+    QVERIFY(!set.isUrlMatched(QStringLiteral("http://example.org/#banner")));
+}
+
+void WebEngineFilterTest::testExceptions()
+{
+    FilterSet blackList;
+    blackList.addFilter(QStringLiteral("||ads.example.com^"));
+    FilterSet whiteList;
+    whiteList.addFilter(QStringLiteral("@@||ads.example.com/allowed^"));
+    QCOMPARE(whiteList.urlMatchedBy(QStringLiteral("http://ads.example.com/allowed/1.png")),
+             QStringLiteral("@@||ads.example.com/allowed^"));
+
+    FilterSnapshots snapshots;
+    QVERIFY(!snapshots.isRequestFiltered(FilterRequest(QStringLiteral("http://ads.example.com/1.png"))));
+    snapshots.publish(blackList, whiteList);
+    QVERIFY(snapshots.isRequestFiltered(FilterRequest(QStringLiteral("http://ads.example.com/1.png"))));
+    QVERIFY(!snapshots.isRequestFiltered(FilterRequest(QStringLiteral("http://ads.example.com/allowed/1.png"))));
+    QVERIFY(!snapshots.isRequestFiltered(FilterRequest(QStringLiteral("http://www.example.com/1.png"))));
+
+    // the published copies don't change with the lists
+    blackList.clear();
+    QVERIFY(snapshots.isRequestFiltered(FilterRequest(QStringLiteral("http://ads.example.com/1.png"))));
+    snapshots.publishNone();
+    QVERIFY(!snapshots.isRequestFiltered(FilterRequest(QStringLiteral("http://ads.example.com/1.png"))));
+}
+
+void WebEngineFilterTest::testSharedKeywords()
+{
+    // a keyword ending inside a longer one, through the dictionary links
+    FilterSet set;
+    set.addFilter(QStringLiteral("abcde"));
+    set.addFilter(QStringLiteral("bc"));
+    QCOMPARE(set.urlMatchedBy(QStringLiteral("http://example.org/abcz")), QStringLiteral("bc"));
+    QVERIFY(!set.isUrlMatched(QStringLiteral("http://example.org/ab-cd")));
+
+    // a keyword starting inside a longer one, through the failure links
+    FilterSet overlapping;
+    overlapping.addFilter(QStringLiteral("abcd"));
+    overlapping.addFilter(QStringLiteral("bcx"));
+    QCOMPARE(overlapping.urlMatchedBy(QStringLiteral("http://example.org/abcx")), QStringLiteral("bcx"));
+    QCOMPARE(overlapping.urlMatchedBy(QStringLiteral("http://example.org/abcd")), QStringLiteral("abcd"));
+    QVERIFY(!overlapping.isUrlMatched(QStringLiteral("http://example.org/abc-x")));
+
+    // a keyword found several times, the first occurrence not matching
+    FilterSet anchored;
+    anchored.addFilter(QStringLiteral("/path/bc^"));
+    QVERIFY(anchored.isUrlMatched(QStringLiteral("http://example.org/path/bcd/path/bc?x")));
+    QVERIFY(!anchored.isUrlMatched(QStringLiteral("http://example.org/path/bcd/path/bcd")));
+
+    // copies match on their own
+    FilterSet copy(set);
+    set.clear();
+    QVERIFY(!set.isUrlMatched(QStringLiteral("http://example.org/abcz")));
+    QVERIFY(copy.isUrlMatched(QStringLiteral("http://example.org/abcz")));
+}
+
+#include "webengine_filtertest.moc"
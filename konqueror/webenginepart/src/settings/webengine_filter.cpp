@@ -23,322 +23,851 @@
 #include "webengine_filter.h"
 
 #include <QHash>
-#include <QBitArray>
-
-// rolling hash parameters
-#define HASH_P (1997)
-#define HASH_Q (17509)
-// HASH_MOD = (HASH_P^7) % HASH_Q
-#define HASH_MOD (523)
+#include <QRegExp>
+#include <QSet>
+#include <QStringList>
+#include <QUrl>
+#include <QVector>
 
+#include <algorithm>
 
 using namespace KDEPrivate;
 
-// Updateable Multi-String Matcher based on Rabin-Karp's algorithm
-class StringsMatcher {
+// Stands for ^ in compiled patterns. It is a noncharacter, so no URL
+// contains it.
+static const ushort s_separator = 0xffff;
+
+// QVector<QRegExp> copies share the QRegExp objects, whose matching state
+// must not be used by two threads at once. Copy them one by one instead.
+static QVector<QRegExp> detachedCopy(const QVector<QRegExp>& regExps)
+{
+    QVector<QRegExp> copy;
+    copy.reserve(regExps.size());
+    for (int i = 0; i < regExps.size(); ++i)
+        copy.append(QRegExp(regExps[i]));
+    return copy;
+}
+
+// ^ matches anything but a letter, a digit or one of _-.%
+static inline bool isSeparator(QChar c)
+{
+    return !c.isLetterOrNumber() && c != QLatin1Char('_') && c != QLatin1Char('-') &&
+           c != QLatin1Char('.') && c != QLatin1Char('%');
+}
+
+// Unlike QString::toLower(), keeps every character where it is
+static QString lowerCase(const QString& str)
+{
+    const int len = str.length();
+    QString lower(len, Qt::Uninitialized);
+    QChar* data = lower.data();
+    for (int i = 0; i < len; ++i)
+        data[i] = str.at(i).toLower();
+    return lower;
+}
+
+// Whether host is domain or one of its subdomains
+static bool isInDomain(const QString& host, const QString& domain)
+{
+    if (!host.endsWith(domain))
+        return false;
+    const int rest = host.length() - domain.length();
+    return rest == 0 || host.at(rest - 1) == QLatin1Char('.');
+}
+
+// The registered domain of url, e.g. bbc.co.uk for www.bbc.co.uk
+static QString siteOf(const QUrl& url)
+{
+    const QString host = url.host();
+    const QString tld = url.topLevelDomain();
+    if (tld.isEmpty() || tld.length() >= host.length())
+        return host;
+    const int dot = host.lastIndexOf(QLatin1Char('.'), host.length() - tld.length() - 1);
+    return host.mid(dot + 1);
+}
+
+FilterRequest::FilterRequest(const QString& url)
+    :url(url), type(UnknownType), thirdParty(-1)
+{
+    init();
+}
+
+FilterRequest::FilterRequest(const QUrl& requestUrl, const QUrl& firstPartyUrl, ResourceType resourceType)
+    :url(requestUrl.toString()), firstPartyHost(firstPartyUrl.host()), type(resourceType), thirdParty(-1)
+{
+    if (!firstPartyHost.isEmpty())
+        thirdParty = siteOf(requestUrl) != siteOf(firstPartyUrl) ? 1 : 0;
+    init();
+}
+
+void FilterRequest::init()
+{
+    lowerUrl = lowerCase(url);
+
+    const int len = url.length();
+    const int schemeEnd = url.indexOf(QLatin1String("://"));
+    hostStart = schemeEnd < 0 ? 0 : schemeEnd + 3;
+    hostEnd = hostStart;
+    while (hostEnd < len) {
+        const QChar c = url.at(hostEnd);
+        if (c == QLatin1Char('/') || c == QLatin1Char('?') || c == QLatin1Char('#'))
+            break;
+        if (c == QLatin1Char('@'))
+            hostStart = hostEnd + 1;
+        ++hostEnd;
+    }
+}
+
+// Aho-Corasick automaton, finding all keywords contained in a string in a
+// single pass over it. The transitions out of the root, which is where
+// most of the time is spent, are a table for ASCII characters; all other
+// transitions are sorted per state and binary searched.
+//
+// Compiled automata are never changed, only replaced, so copies share them.
+class KeywordMatcher {
 public:
-    // add filter to matching set
-    void addString(const QString& pattern)
+    KeywordMatcher()
     {
-        if (pattern.length() < 8) {
-            // handle short string differently
-            shortStringFilters.append(pattern);
-        } else {
-            // use modified Rabin-Karp's algorithm with 8-length string hash
-            // i.e. store hash of first 8 chars in the HashMap for fast look-up
-            stringFilters.append(pattern);
-            int ind = stringFilters.size() - 1;
-            int current = 0;
-
-            // compute hash using rolling hash
-            // hash for string: x0,x1,x2...xn-1 will be:
-            // (p^(n-1)*x0 + p^(n-2)*x1 + ... + p * xn-2 + xn-1) % q
-            // where p and q some wisely-chosen integers
-            /*for (int k = 0; k < 8; ++k)*/
-            int len = pattern.length();
-            for (int k = len - 8; k < len; ++k)
-                current = (current * HASH_P + pattern[k].unicode()) % HASH_Q;
-
-            // insert computed hash value into HashMap
-            QHash<int, QVector<int> >::iterator it = stringFiltersHash.find(current + 1);
-            if (it == stringFiltersHash.end()) {
-                QVector<int> list;
-                list.append(ind);
-                stringFiltersHash.insert(current + 1, list);
-                fastLookUp.setBit(current);
-            } else {
-                it->append(ind);
-            }
-        }
+        clear();
     }
 
+    void clear()
+    {
+        stateEdges = QVector<int>(2, 0);
+        edgeChars.clear();
+        edgeTargets.clear();
+        fail = QVector<int>(1, 0);
+        dictLink = QVector<int>(1, -1);
+        stateOutputs = QVector<int>(2, 0);
+        outputs.clear();
+        rootTable = QVector<int>(128, 0);
+    }
 
-    // check if string match at least one string from matching set
-    bool isMatched(const QString& str, QString *by = 0) const
+    // keywords must not be empty; a keyword may be added for several values
+    void compile(const QVector<QPair<QString, int> >& keywords)
     {
-        // check short strings first
-        for (int i = 0; i < shortStringFilters.size(); ++i) {
-            if (str.contains(shortStringFilters[i]))
-            {
-                if (by != 0) *by = shortStringFilters[i];
-                return true;
+        clear();
+
+        // the trie
+        QHash<quint64, int> trie;
+        QVector<QPair<int, int> > stateValues;
+        int states = 1;
+        for (int i = 0; i < keywords.size(); ++i) {
+            const QString& keyword = keywords[i].first;
+            int state = 0;
+            for (int k = 0; k < keyword.length(); ++k) {
+                const quint64 key = (quint64(state) << 16) | keyword.at(k).unicode();
+                QHash<quint64, int>::const_iterator it = trie.constFind(key);
+                if (it == trie.constEnd())
+                    it = trie.insert(key, states++);
+                state = it.value();
             }
+            stateValues.append(qMakePair(state, keywords[i].second));
         }
 
-        int len = str.length();
-        int k;
-
-        int current = 0;
-        int next = 0;
-        // compute hash for first 8 characters
-        for (k = 0; k < 8 && k < len; ++k)
-            current = (current * HASH_P + str[k].unicode()) % HASH_Q;
+        // transitions and values, sorted by state
+        QVector<Edge> edges;
+        edges.reserve(trie.size());
+        for (QHash<quint64, int>::const_iterator it = trie.constBegin(); it != trie.constEnd(); ++it) {
+            Edge edge;
+            edge.from = int(it.key() >> 16);
+            edge.c = ushort(it.key() & 0xffff);
+            edge.to = it.value();
+            edges.append(edge);
+        }
+        trie.clear();
+        std::sort(edges.begin(), edges.end());
+        std::sort(stateValues.begin(), stateValues.end());
+
+        stateEdges = QVector<int>(states + 1, 0);
+        edgeChars.resize(edges.size());
+        edgeTargets.resize(edges.size());
+        for (int i = 0; i < edges.size(); ++i) {
+            ++stateEdges[edges[i].from + 1];
+            edgeChars[i] = edges[i].c;
+            edgeTargets[i] = edges[i].to;
+        }
+        edges.clear();
 
-        QHash<int, QVector<int> >::const_iterator hashEnd = stringFiltersHash.end();
-        // main Rabin-Karp's algorithm loop
-        for (k = 7; k < len; ++k, current = next) {
-            // roll the hash if not at the end
-            // (calculate hash for the next iteration)
-            if (k + 1 < len)
-                next = (HASH_P * ((current + HASH_Q - ((HASH_MOD * str[k - 7].unicode()) % HASH_Q)) % HASH_Q) + str[k + 1].unicode()) % HASH_Q;
+        stateOutputs = QVector<int>(states + 1, 0);
+        outputs.resize(stateValues.size());
+        for (int i = 0; i < stateValues.size(); ++i) {
+            ++stateOutputs[stateValues[i].first + 1];
+            outputs[i] = stateValues[i].second;
+        }
+        for (int s = 0; s < states; ++s) {
+            stateEdges[s + 1] += stateEdges[s];
+            stateOutputs[s + 1] += stateOutputs[s];
+        }
 
-            if (!fastLookUp.testBit(current))
-                continue;
+        for (int e = stateEdges[0]; e < stateEdges[1]; ++e) {
+            if (edgeChars[e] < 128)
+                rootTable[edgeChars[e]] = edgeTargets[e];
+        }
 
-            // look-up the hash in the HashMap and check all strings
-            QHash<int, QVector<int> >::const_iterator it = stringFiltersHash.find(current + 1);
-
-            // check possible strings
-            if (it != hashEnd) {
-                for (int j = 0; j < it->size(); ++j) {
-                    int index = it->value(j);
-                    // check if we got simple string or REs prefix
-                    if (index >= 0) {
-                        int flen = stringFilters[index].length();
-                        if (k - flen + 1 >= 0 && stringFilters[index] == str.midRef(k - flen + 1 , flen))
-                        {
-                            if (by != 0) *by = stringFilters[index];
-                            return true;
-                        }
-                    } else {
-                        index = -index - 1;
-                        int flen = rePrefixes[index].length();
-                        if (k - 8 + flen < len && rePrefixes[index] == str.midRef(k - 7, flen))
-                        {
-                            int remStart = k - 7 + flen;
-                            QString remainder = QString::fromRawData(str.unicode() + remStart,
-                                                                    str.length() - remStart);
-                            if (reFilters[index].exactMatch(remainder)) {
-                                if (by != 0) *by = rePrefixes[index]+reFilters[index].pattern();
-                                return true;
-                            }
-                        }
-                    }
+        // failure and dictionary links, breadth first so that the links
+        // of shallower states are known
+        fail = QVector<int>(states, 0);
+        dictLink = QVector<int>(states, -1);
+        QVector<int> queue;
+        queue.reserve(states);
+        queue.append(0);
+        for (int q = 0; q < queue.size(); ++q) {
+            const int state = queue[q];
+            for (int e = stateEdges[state]; e < stateEdges[state + 1]; ++e) {
+                const int target = edgeTargets[e];
+                if (state != 0) {
+                    const int f = next(fail[state], edgeChars[e]);
+                    fail[target] = f;
+                    dictLink[target] = hasOutputs(f) ? f : dictLink[f];
                 }
+                queue.append(target);
             }
         }
+    }
 
+    // Calls visitor with the value of every keyword found in str, until
+    // it returns true. Returns whether it did.
+    template<typename Visitor>
+    bool find(const QString& str, Visitor visitor) const
+    {
+        const QChar* data = str.constData();
+        const int len = str.length();
+        int state = 0;
+        for (int i = 0; i < len; ++i) {
+            state = next(state, data[i].unicode());
+            for (int s = hasOutputs(state) ? state : dictLink[state]; s != -1; s = dictLink[s]) {
+                for (int o = stateOutputs[s]; o < stateOutputs[s + 1]; ++o) {
+                    if (visitor(outputs[o]))
+                        return true;
+                }
+            }
+        }
         return false;
     }
 
-    // add filter to matching set with wildcards (*,?) in it
-    void addWildedString(const QString& prefix, const QRegExp& rx)
-    {
-        rePrefixes.append(prefix);
-        reFilters.append(rx);
-        int index = -rePrefixes.size();
-
-        int current = 0;
-        for (int k = 0; k < 8; ++k)
-            current = (current * HASH_P + prefix[k].unicode()) % HASH_Q;
-
-        // insert computed hash value into HashMap
-        QHash<int, QVector<int> >::iterator it = stringFiltersHash.find(current + 1);
-        if (it == stringFiltersHash.end()) {
-            QVector<int> list;
-            list.append(index);
-            stringFiltersHash.insert(current + 1, list);
-            fastLookUp.setBit(current);
-        } else {
-            it->append(index);
+private:
+    struct Edge {
+        int from;
+        ushort c;
+        int to;
+
+        bool operator<(const Edge& other) const
+        {
+            return from < other.from || (from == other.from && c < other.c);
         }
+    };
+
+    bool hasOutputs(int state) const
+    {
+        return stateOutputs[state] != stateOutputs[state + 1];
     }
 
-    void clear()
+    int next(int state, ushort c) const
     {
-        stringFilters.clear();
-        shortStringFilters.clear();
-        reFilters.clear();
-        rePrefixes.clear();
-        stringFiltersHash.clear();
-        fastLookUp.resize(HASH_Q);
-        fastLookUp.fill(0, 0, HASH_Q);
+        forever {
+            if (state == 0 && c < 128)
+                return rootTable[c];
+            const ushort* begin = edgeChars.constData() + stateEdges[state];
+            const ushort* end = edgeChars.constData() + stateEdges[state + 1];
+            const ushort* it = std::lower_bound(begin, end, c);
+            if (it != end && *it == c)
+                return edgeTargets[int(it - edgeChars.constData())];
+            if (state == 0)
+                return 0;
+            state = fail[state];
+        }
     }
 
-private:
-    QVector<QString> stringFilters;
-    QVector<QString> shortStringFilters;
-    QVector<QRegExp> reFilters;
-    QVector<QString> rePrefixes;
-    QBitArray fastLookUp;
+    // transitions of state s are edgeChars/edgeTargets[stateEdges[s] .. stateEdges[s + 1]]
+    QVector<int> stateEdges;
+    QVector<ushort> edgeChars;
+    QVector<int> edgeTargets;
+    QVector<int> fail;
+    // the next state on the failure chain with outputs, or -1
+    QVector<int> dictLink;
+    // values of state s are outputs[stateOutputs[s] .. stateOutputs[s + 1]]
+    QVector<int> stateOutputs;
+    QVector<int> outputs;
+    QVector<int> rootTable;
+};
 
-    QHash<int, QVector<int> > stringFiltersHash;
+// A parsed filter
+struct FilterRule {
+    enum Anchor {
+        NoAnchor,
+        StartAnchor,   // |
+        DomainAnchor   // ||
+    };
+
+    FilterRule()
+        :anchor(NoAnchor), endAnchor(false), regExp(-1), matchCase(false),
+         types(FilterRequest::AllTypes), thirdParty(-1)
+    {
+    }
+
+    // as added, for urlMatchedBy()
+    QString text;
+    // the parts between the wildcards, ^ replaced by s_separator,
+    // lower case unless matchCase is set
+    QStringList pieces;
+    Anchor anchor;
+    bool endAnchor;
+    // index in FilterMatcher::regExps for /regexp/ filters
+    int regExp;
+    // the longest plain string all matching URLs contain, lower case
+    QString keyword;
+
+    bool matchCase;
+    int types;
+    int thirdParty;
+    QStringList domains;
+    QStringList excludedDomains;
 };
 
+// Parses the $options of a filter. Returns false for options which make
+// no sense for blocking requests (popup, document, elemhide, ...): such
+// filters are skipped, rather than applied to more than they should be.
+static bool parseOptions(const QString& options, FilterRule& rule)
+{
+    static QHash<QString, int> typeOptions;
+    if (typeOptions.isEmpty()) {
+        typeOptions.insert(QStringLiteral("script"), FilterRequest::Script);
+        typeOptions.insert(QStringLiteral("image"), FilterRequest::Image);
+        typeOptions.insert(QStringLiteral("stylesheet"), FilterRequest::Stylesheet);
+        typeOptions.insert(QStringLiteral("object"), FilterRequest::Object);
+        typeOptions.insert(QStringLiteral("object-subrequest"), FilterRequest::Object);
+        typeOptions.insert(QStringLiteral("xmlhttprequest"), FilterRequest::XmlHttpRequest);
+        typeOptions.insert(QStringLiteral("subdocument"), FilterRequest::Subdocument);
+        typeOptions.insert(QStringLiteral("media"), FilterRequest::Media);
+        typeOptions.insert(QStringLiteral("font"), FilterRequest::Font);
+        typeOptions.insert(QStringLiteral("ping"), FilterRequest::Ping);
+        typeOptions.insert(QStringLiteral("websocket"), FilterRequest::Other);
+        typeOptions.insert(QStringLiteral("other"), FilterRequest::Other);
+    }
 
-// We only want a subset of features of wildcards -- just the 
-// star, so we escape the rest before passing to QRegExp. 
-// The \ is escaped due to a QRegExp bug.
-// ### we really should rather parse it ourselves, in order to 
-// handle adblock-special things like | and ^ properly.
-static QRegExp fromAdBlockWildcard(const QString& wcStr) {
-    QRegExp rx;
-    rx.setPatternSyntax(QRegExp::Wildcard);
-
-    QString out;
-    for (int p = 0; p < wcStr.length(); ++p) {
-        QChar c = wcStr[p];
-        if (c == QLatin1Char('?'))
-            out += QLatin1String("[?]");
-        else if (c == QLatin1Char('['))
-            out += QLatin1String("[[]");
-        else if (c == QLatin1Char('\\'))
-            out += QLatin1String("[\\]");
-        else
-            out += c;
+    int types = 0;
+    int excludedTypes = 0;
+    const QStringList list = options.split(QLatin1Char(','), QString::SkipEmptyParts);
+    for (int i = 0; i < list.size(); ++i) {
+        QString option = list[i].trimmed().toLower();
+        const bool inverse = option.startsWith(QLatin1Char('~'));
+        if (inverse)
+            option.remove(0, 1);
+
+        const int type = typeOptions.value(option);
+        if (type) {
+            if (inverse)
+                excludedTypes |= type;
+            else
+                types |= type;
+        } else if (option == QLatin1String("third-party")) {
+            rule.thirdParty = inverse ? 0 : 1;
+        } else if (option == QLatin1String("match-case")) {
+            rule.matchCase = true;
+        } else if (option.startsWith(QLatin1String("domain="))) {
+            const QStringList domains = option.mid(7).split(QLatin1Char('|'), QString::SkipEmptyParts);
+            for (int d = 0; d < domains.size(); ++d) {
+                if (domains[d].startsWith(QLatin1Char('~')))
+                    rule.excludedDomains.append(domains[d].mid(1));
+                else
+                    rule.domains.append(domains[d]);
+            }
+        } else if (option != QLatin1String("important") && option != QLatin1String("collapse") &&
+                   option != QLatin1String("donottrack")) {
+            return false;
+        }
     }
 
-    rx.setPattern(out);
-    return rx;
+    rule.types = (types ? types : int(FilterRequest::AllTypes)) & ~excludedTypes;
+    return rule.types != 0;
 }
 
-FilterSet::FilterSet()
-    :stringFiltersMatcher(new StringsMatcher)
+// The longest string every match of a regular expression contains, or
+// nothing if that is not obvious. Groups are not looked into.
+static QString requiredLiteral(const QString& pattern)
 {
+    QString best;
+    QString run;
+    int depth = 0;
+    const int len = pattern.length();
+    for (int i = 0; i < len; ++i) {
+        QChar c = pattern.at(i);
+        bool literal = false;
+        switch (c.unicode()) {
+        case '|':
+            // alternatives, nothing is required
+            if (depth == 0)
+                return QString();
+            break;
+        case '\\':
+            if (i + 1 < len && !pattern.at(i + 1).isLetterOrNumber()) {
+                c = pattern.at(++i);
+                literal = true;
+            } else {
+                ++i; // \d, \w, ...
+            }
+            break;
+        case '[':
+            // skip the character class
+            i += 1;
+            if (i < len && pattern.at(i) == QLatin1Char('^'))
+                ++i;
+            if (i < len && pattern.at(i) == QLatin1Char(']'))
+                ++i;
+            while (i < len && pattern.at(i) != QLatin1Char(']')) {
+                if (pattern.at(i) == QLatin1Char('\\'))
+                    ++i;
+                ++i;
+            }
+            break;
+        case '(':
+            ++depth;
+            break;
+        case ')':
+            --depth;
+            break;
+        case '?':
+        case '*':
+        case '{':
+            // the previous character is optional
+            if (!run.isEmpty())
+                run.chop(1);
+            if (c == QLatin1Char('{')) {
+                while (i < len && pattern.at(i) != QLatin1Char('}'))
+                    ++i;
+            }
+            break;
+        case '.':
+        case '^':
+        case '$':
+        case '+':
+            break;
+        default:
+            literal = true;
+        }
+
+        if (literal && depth == 0) {
+            run += c;
+        } else if (!literal) {
+            if (run.length() > best.length())
+                best = run;
+            run.clear();
+        }
+    }
+    if (run.length() > best.length())
+        best = run;
+    return lowerCase(best);
+}
+// Matches piece at pos in str. Returns where the match ends, or -1.
+static int matchPieceAt(const QString& piece, const QString& str, int pos)
+{
+    const int len = str.length();
+    for (int i = 0; i < piece.length(); ++i) {
+        const QChar c = piece.at(i);
+        if (c.unicode() == s_separator) {
+            // ^ also matches the end of the URL
+            if (pos == len)
+                continue;
+            if (!isSeparator(str.at(pos)))
+                return -1;
+        } else if (pos == len || str.at(pos) != c) {
+            return -1;
+        }
+        ++pos;
+    }
+    return pos;
 }
 
-FilterSet::~FilterSet()
+// Matches the pieces of rule from index on against str, the first one
+// exactly at pos if anchored, anywhere after pos otherwise.
+static bool matchPieces(const FilterRule& rule, const QString& str, int index, int pos, bool anchored)
 {
-    delete stringFiltersMatcher;
+    const int len = str.length();
+    const int count = rule.pieces.size();
+    for (; index < count; ++index, anchored = false) {
+        const QString& piece = rule.pieces.at(index);
+        if (anchored) {
+            pos = matchPieceAt(piece, str, pos);
+            if (pos < 0)
+                return false;
+            continue;
+        }
+
+        // The leftmost match leaves the most room for the pieces after
+        // it. Only the last one may have to end the URL.
+        const bool mustEnd = rule.endAnchor && index == count - 1;
+        int end = -1;
+        for (int start = pos; start <= len && end < 0; ++start) {
+            end = matchPieceAt(piece, str, start);
+            if (mustEnd && end != len)
+                end = -1;
+        }
+        if (end < 0)
+            return false;
+        pos = end;
+    }
+    return !rule.endAnchor || pos == len;
 }
 
-void FilterSet::addFilter(const QString& filterStr)
+static bool patternMatches(const FilterRule& rule, const FilterRequest& request)
 {
-    QString filter = filterStr;
+    const QString& str = rule.matchCase ? request.url : request.lowerUrl;
+    switch (rule.anchor) {
+    case FilterRule::StartAnchor:
+        return matchPieces(rule, str, 0, 0, true);
+    case FilterRule::DomainAnchor:
+        // at the start of the host or of one of its labels
+        for (int pos = request.hostStart; pos < request.hostEnd; ++pos) {
+            if ((pos == request.hostStart || str.at(pos - 1) == QLatin1Char('.')) &&
+                matchPieces(rule, str, 0, pos, true))
+                return true;
+        }
+        return false;
+    case FilterRule::NoAnchor:
+        break;
+    }
+    return matchPieces(rule, str, 0, 0, false);
+}
 
-    /** ignore special lines starting with "[", "!", "&", or "#" or contain "#" (comments or features are not supported by KHTML's AdBlock */
+// The compiled filters of a FilterSet.
+//
+// Filters are found by their keyword with a KeywordMatcher, and only the
+// ones whose keyword occurs in the URL are checked in full. Filters without
+// any keyword, like "$script,domain=example.com", are found by the domains
+// they are restricted to. Only the few left, without keyword and domain,
+// are checked for every URL.
+class FilterMatcher {
+public:
+    FilterMatcher()
+        :compiled(true)
+    {
+    }
+
+    FilterMatcher(const FilterMatcher& other)
+        :rules(other.rules),
+         regExps(detachedCopy(other.regExps)),
+         keywords(other.keywords),
+         domainRules(other.domainRules),
+         otherRules(other.otherRules),
+         compiled(other.compiled)
+    {
+    }
+
+    void addFilter(const QString& filter);
+    void compile();
+    // the first filter matching request; the matcher must be compiled
+    const FilterRule* match(const FilterRequest& request) const;
+    void clear();
+
+private:
+    bool matches(const FilterRule& rule, const FilterRequest& request) const;
+
+    QVector<FilterRule> rules;
+    QVector<QRegExp> regExps;
+    KeywordMatcher keywords;
+    QHash<QString, QVector<int> > domainRules;
+    QVector<int> otherRules;
+    bool compiled;
+};
+
+void FilterMatcher::addFilter(const QString& filterStr)
+{
+    QString filter = filterStr.trimmed();
+    if (filter.isEmpty())
+        return;
+
+    /** ignore special lines starting with "[", "!", "&", or "#" and element hiding rules (not supported by KHTML's AdBlock */
     QChar firstChar = filter.at(0);
-    if (firstChar == QLatin1Char('[') || firstChar == QLatin1Char('!') || firstChar == QLatin1Char('&') || firstChar == QLatin1Char('#') || filter.contains(QLatin1Char('#')))
+    if (firstChar == QLatin1Char('[') || firstChar == QLatin1Char('!') || firstChar == QLatin1Char('&') || firstChar == QLatin1Char('#') ||
+        filter.contains(QLatin1String("##")) || filter.contains(QLatin1String("#@#")) || filter.contains(QLatin1String("#?#")))
         return;
 
+    FilterRule rule;
+    rule.text = filterStr;
+
     // Strip leading @@
-    int first = 0;
-    int last  = filter.length() - 1;
     if (filter.startsWith(QLatin1String("@@")))
-        first = 2;
-
-    // Strip options, we ignore them for now.
-    // TODO: Add support for filters with options. See #310230.
-    int dollar = filter.lastIndexOf(QLatin1Char('$'));
-    if (dollar != -1) {
-        return;
+        filter.remove(0, 2);
+
+    // Options. A $ followed by a path is part of the pattern.
+    const int dollar = filter.lastIndexOf(QLatin1Char('$'));
+    const bool hasOptions = dollar != -1 && filter.indexOf(QLatin1Char('/'), dollar) == -1;
+    if (hasOptions) {
+        if (!parseOptions(filter.mid(dollar + 1), rule))
+            return;
+        filter.truncate(dollar);
     }
 
-    // Perhaps nothing left?
-    if (first > last)
+    // Perhaps nothing left? Only the options can make sense of that.
+    if (filter.isEmpty() && !hasOptions)
         return;
 
-    filter = filter.mid(first, last - first + 1);
-
     // Is it a regexp filter?
-    if (filter.length()>2 && filter.startsWith(QLatin1Char('/')) && filter.endsWith(QLatin1Char('/')))
+    if (filter.length() > 2 && filter.startsWith(QLatin1Char('/')) && filter.endsWith(QLatin1Char('/')))
     {
-        QString inside = filter.mid(1, filter.length()-2);
-        QRegExp rx(inside);
-        reFilters.append(rx);
-//         qDebug() << "R:" << inside;
+        const QString inside = filter.mid(1, filter.length() - 2);
+        rule.regExp = regExps.size();
+        regExps.append(QRegExp(inside, rule.matchCase ? Qt::CaseSensitive : Qt::CaseInsensitive));
+        rule.keyword = requiredLiteral(inside);
     }
     else
     {
-        // Nope, a wildcard one.
-        // Note: For these, we also need to handle |.
+        if (filter.startsWith(QLatin1String("||"))) {
+            rule.anchor = FilterRule::DomainAnchor;
+            filter.remove(0, 2);
+        } else if (filter.startsWith(QLatin1Char('|'))) {
+            rule.anchor = FilterRule::StartAnchor;
+            filter.remove(0, 1);
+        }
+        if (filter.endsWith(QLatin1Char('|'))) {
+            rule.endAnchor = true;
+            filter.chop(1);
+        }
 
-        // Strip wildcards at the ends
-        first = 0;
-        last  = filter.length() - 1;
+        // wildcards at the ends make the anchors there pointless
+        if (filter.startsWith(QLatin1Char('*')))
+            rule.anchor = FilterRule::NoAnchor;
+        if (filter.endsWith(QLatin1Char('*')))
+            rule.endAnchor = false;
+
+        if (!rule.matchCase)
+            filter = lowerCase(filter);
+        filter.replace(QLatin1Char('^'), QChar(s_separator));
+        rule.pieces = filter.split(QLatin1Char('*'), QString::SkipEmptyParts);
+
+        // the keyword is the longest run without wildcards and separators
+        for (int i = 0; i < rule.pieces.size(); ++i) {
+            const QStringList runs = rule.pieces[i].split(QChar(s_separator), QString::SkipEmptyParts);
+            for (int r = 0; r < runs.size(); ++r) {
+                if (runs[r].length() > rule.keyword.length())
+                    rule.keyword = runs[r];
+            }
+        }
+        if (rule.matchCase)
+            rule.keyword = lowerCase(rule.keyword);
+    }
 
-        while (first < filter.length() && filter[first] == QLatin1Char('*'))
-            ++first;
+    rules.append(rule);
+    compiled = false;
+}
 
-        while (last >= 0 && filter[last] == QLatin1Char('*'))
-            --last;
+void FilterMatcher::compile()
+{
+    if (compiled)
+        return;
 
-        if (first > last)
-            filter = QStringLiteral("*"); // erm... Well, they asked for it.
-        else
-            filter = filter.mid(first, last - first + 1);
+    QVector<QPair<QString, int> > ruleKeywords;
+    domainRules.clear();
+    otherRules.clear();
+    for (int i = 0; i < rules.size(); ++i) {
+        const FilterRule& rule = rules.at(i);
+        if (!rule.keyword.isEmpty()) {
+            ruleKeywords.append(qMakePair(rule.keyword, i));
+        } else if (!rule.domains.isEmpty()) {
+            for (int d = 0; d < rule.domains.size(); ++d)
+                domainRules[rule.domains.at(d)].append(i);
+        } else {
+            otherRules.append(i);
+        }
+    }
+    keywords.compile(ruleKeywords);
+    compiled = true;
+}
 
-        // Now, do we still have any wildcard stuff left?
-        if (filter.contains(QLatin1String("*")))
-        {
-            // check if we can use RK first (and then check full RE for the rest) for better performance
-            int aPos = filter.indexOf('*');
-            if (aPos < 0)
-                aPos = filter.length();
-            if (aPos > 7) {
-                QRegExp rx = fromAdBlockWildcard(filter.mid(aPos) + QLatin1Char('*'));
-                // We pad the final r.e. with * so we can check for an exact match
-                stringFiltersMatcher->addWildedString(filter.mid(0, aPos), rx);
-            } else {
-                QRegExp rx = fromAdBlockWildcard(filter);
-                reFilters.append(rx);
+const FilterRule* FilterMatcher::match(const FilterRequest& request) const
+{
+    Q_ASSERT(compiled);
+
+    if (!domainRules.isEmpty() && !request.firstPartyHost.isEmpty()) {
+        // the host of the page and the domains above it
+        QString domain = request.firstPartyHost;
+        forever {
+            QHash<QString, QVector<int> >::const_iterator it = domainRules.constFind(domain);
+            if (it != domainRules.constEnd()) {
+                for (int i = 0; i < it->size(); ++i) {
+                    const FilterRule& rule = rules.at(it->at(i));
+                    if (matches(rule, request))
+                        return &rule;
+                }
             }
+            const int dot = domain.indexOf(QLatin1Char('.'));
+            if (dot < 0)
+                break;
+            domain.remove(0, dot + 1);
         }
-        else
-        {
-            // Fast path
-            stringFiltersMatcher->addString(filter);
-        }
     }
+
+    for (int i = 0; i < otherRules.size(); ++i) {
+        const FilterRule& rule = rules.at(otherRules.at(i));
+        if (matches(rule, request))
+            return &rule;
+    }
+
+    // a keyword may occur several times, check its filters only once
+    const FilterRule* found = 0;
+    QSet<int> checked;
+    keywords.find(request.lowerUrl, [&](int index) {
+        if (checked.contains(index))
+            return false;
+        checked.insert(index);
+        const FilterRule& rule = rules.at(index);
+        if (!matches(rule, request))
+            return false;
+        found = &rule;
+        return true;
+    });
+    return found;
 }
 
-bool FilterSet::isUrlMatched(const QString& url)
+bool FilterMatcher::matches(const FilterRule& rule, const FilterRequest& request) const
 {
-    if (stringFiltersMatcher->isMatched(url))
-        return true;
+    if (!(rule.types & request.type) && rule.types != FilterRequest::AllTypes)
+        return false;
 
-    for (int c = 0; c < reFilters.size(); ++c)
-    {
-        if (url.contains(reFilters[c]))
-            return true;
+    if (rule.thirdParty != -1 && rule.thirdParty != request.thirdParty)
+        return false;
+
+    if (!rule.domains.isEmpty() || !rule.excludedDomains.isEmpty()) {
+        const QString& host = request.firstPartyHost;
+        if (host.isEmpty())
+            return false;
+        for (int i = 0; i < rule.excludedDomains.size(); ++i) {
+            if (isInDomain(host, rule.excludedDomains.at(i)))
+                return false;
+        }
+        if (!rule.domains.isEmpty()) {
+            int i = 0;
+            while (i < rule.domains.size() && !isInDomain(host, rule.domains.at(i)))
+                ++i;
+            if (i == rule.domains.size())
+                return false;
+        }
     }
 
-    return false;
+    if (rule.regExp >= 0)
+        return regExps.at(rule.regExp).indexIn(request.url) != -1;
+
+    return patternMatches(rule, request);
 }
 
-QString FilterSet::urlMatchedBy(const QString& url)
+void FilterMatcher::clear()
 {
-    QString by;
+    rules.clear();
+    regExps.clear();
+    keywords.clear();
+    domainRules.clear();
+    otherRules.clear();
+    compiled = true;
+}
 
-    if (stringFiltersMatcher->isMatched(url, &by))
-        return by;
+FilterSet::FilterSet()
+    :matcher(new FilterMatcher)
+{
+}
 
-    for (int c = 0; c < reFilters.size(); ++c)
-    {
-        if (url.contains(reFilters[c]))
-        {
-            by = reFilters[c].pattern();
-            break;
-        }
+FilterSet::FilterSet(const FilterSet& other)
+    :matcher(new FilterMatcher(*other.matcher))
+{
+}
+
+FilterSet& FilterSet::operator=(const FilterSet& other)
+{
+    if (this != &other) {
+        delete matcher;
+        matcher = new FilterMatcher(*other.matcher);
     }
+    return *this;
+}
+
+FilterSet::~FilterSet()
+{
+    delete matcher;
+}
+
+void FilterSet::addFilter(const QString& filter)
+{
+    matcher->addFilter(filter);
+}
+
+void FilterSet::compile()
+{
+    matcher->compile();
+}
+
+bool FilterSet::isUrlMatched(const QString& url) const
+{
+    return isRequestMatched(FilterRequest(url));
+}
+
+bool FilterSet::isRequestMatched(const FilterRequest& request) const
+{
+    matcher->compile();
+    return matcher->match(request) != 0;
+}
 
-    return by;
+QString FilterSet::urlMatchedBy(const QString& url) const
+{
+    matcher->compile();
+    const FilterRule* rule = matcher->match(FilterRequest(url));
+    return rule ? rule->text : QString();
 }
 
 void FilterSet::clear()
 {
-    reFilters.clear();
-    stringFiltersMatcher->clear();
+    matcher->clear();
+}
+
+FilterSnapshots::FilterSnapshots()
+    :current(0), readers(0)
+{
+}
+
+FilterSnapshots::~FilterSnapshots()
+{
+    delete current.load();
+    qDeleteAll(retired);
+}
+
+void FilterSnapshots::publish(const FilterSet& blackList, const FilterSet& whiteList)
+{
+    Snapshot* snapshot = new Snapshot;
+    snapshot->blackList = blackList;
+    snapshot->whiteList = whiteList;
+    // never compile in the matching thread
+    snapshot->blackList.compile();
+    snapshot->whiteList.compile();
+    replace(snapshot);
+}
+
+void FilterSnapshots::publishNone()
+{
+    replace(0);
+}
+
+void FilterSnapshots::replace(Snapshot* snapshot)
+{
+    Snapshot* old = current.fetchAndStoreOrdered(snapshot);
+    if (old)
+        retired.append(old);
+
+    // Readers which came after the swap can only see the new snapshot.
+    // Retired ones stay around until the next replacement otherwise.
+    if (readers.fetchAndAddOrdered(0) == 0) {
+        qDeleteAll(retired);
+        retired.clear();
+    }
+}
+
+bool FilterSnapshots::isRequestFiltered(const FilterRequest& request) const
+{
+    readers.ref();
+    const Snapshot* snapshot = current.loadAcquire();
+    const bool filtered = snapshot &&
+                          snapshot->blackList.isRequestMatched(request) &&
+                          !snapshot->whiteList.isRequestMatched(request);
+    readers.deref();
+    return filtered;
 }
 
 // kate: indent-width 4; replace-tabs on; tab-width 4; space-indent on;
@@ -23,34 +23,120 @@
 #ifndef WEBENGNINE_FILTER_P_H
 #define WEBENGNINE_FILTER_P_H
 
+#include <QAtomicInt>
+#include <QAtomicPointer>
+#include <QList>
 #include <QString>
-#include <QRegExp>
-#include <QVector>
 #include <webenginepart.h>
 
-class StringsMatcher;
+class QUrl;
+class FilterMatcher;
 
 namespace KDEPrivate
 {
+// A URL to match, and what we know about why it is loaded.
+class FilterRequest {
+public:
+    // Resource types, for the $script, $image, ... filter options
+    enum ResourceType {
+        UnknownType = 0,
+        Script = 0x1,
+        Image = 0x2,
+        Stylesheet = 0x4,
+        Object = 0x8,
+        XmlHttpRequest = 0x10,
+        Subdocument = 0x20,
+        Media = 0x40,
+        Font = 0x80,
+        Ping = 0x100,
+        Other = 0x200,
+        AllTypes = 0x3ff
+    };
+
+    // Without the page and the type, filters with options never match.
+    explicit FilterRequest(const QString& url);
+    FilterRequest(const QUrl& requestUrl, const QUrl& firstPartyUrl, ResourceType resourceType);
+
+    QString url;
+    QString lowerUrl;
+    // where the host is in url, for || anchors
+    int hostStart;
+    int hostEnd;
+    QString firstPartyHost;
+    ResourceType type;
+    // 1 if the request goes to another site than the page, 0 if not, -1 if unknown
+    int thirdParty;
+
+private:
+    void init();
+};
+
 // This represents a set of filters that may match URLs.
-// Currently it supports a subset of AddBlock Plus functionality.
+// It understands the AdBlock Plus filter syntax for URLs: wildcards,
+// the |, || and ^ anchors, regular expressions and the type, third-party,
+// match-case and domain options. Element hiding rules are skipped.
+//
+// The filters are compiled into a keyword automaton on first use, so
+// matching a URL costs about the same for a hundred or a hundred thousand
+// filters.
 class FilterSet {
 public:
     FilterSet();
+    // Copies don't share any QRegExp with the original, so they can be
+    // used in another thread.
+    FilterSet(const FilterSet& other);
+    FilterSet& operator=(const FilterSet& other);
     ~FilterSet();
 
     // Parses and registers a filter. This will also strip @@ for exclusion rules, skip comments, etc.
     // The user does have to split black and white lists into separate sets, however
     void addFilter(const QString& filter);
 
-    bool isUrlMatched(const QString& url);
-    QString urlMatchedBy(const QString& url);
+    // Builds the matching structures, which otherwise happens on the
+    // first match after filters were added.
+    void compile();
+
+    bool isUrlMatched(const QString& url) const;
+    bool isRequestMatched(const FilterRequest& request) const;
+    // the filter matching url, as it was added
+    QString urlMatchedBy(const QString& url) const;
 
     void clear();
 
 private:
-    QVector<QRegExp> reFilters;
-    StringsMatcher* stringFiltersMatcher;
+    FilterMatcher* matcher;
+};
+
+// Read-only copies of the ad black and white lists, for matching requests
+// in the network IO thread while the GUI thread keeps changing the lists.
+//
+// Readers never lock: they announce themselves in a counter while they look
+// at the current copy. A replaced copy is only deleted once the counter was
+// seen at zero after the replacement, so nobody can still be using it.
+// Only one thread at a time may match against the copies.
+class FilterSnapshots {
+public:
+    FilterSnapshots();
+    ~FilterSnapshots();
+
+    // GUI thread: replace the current copy. Without filters, nothing is matched.
+    void publish(const FilterSet& blackList, const FilterSet& whiteList);
+    void publishNone();
+
+    // Any thread: whether the request is black listed and not white listed
+    bool isRequestFiltered(const FilterRequest& request) const;
+
+private:
+    struct Snapshot {
+        FilterSet blackList;
+        FilterSet whiteList;
+    };
+
+    void replace(Snapshot* snapshot);
+
+    QAtomicPointer<Snapshot> current;
+    mutable QAtomicInt readers;
+    QList<Snapshot*> retired;
 };
 
 }
@@ -32,6 +32,7 @@
 #include <QtWebEngineWidgets/QWebEngineSettings>
 #include <QFontDatabase>
 #include <QFileInfo>
+#include <QRegExp>
 
 // browser window color defaults -- Bernd
 #define HTML_DEFAULT_LNK_COLOR Qt::blue
@@ -139,6 +140,8 @@ public:
 
     KDEPrivate::FilterSet adBlackList;
     KDEPrivate::FilterSet adWhiteList;
+    // what the request interceptor matches against
+    KDEPrivate::FilterSnapshots adFilterSnapshots;
     QList< QPair< QString, QChar > > m_fallbackAccessKeysAssignments;
 
     KSharedConfig::Ptr nonPasswordStorableSites;
@@ -148,6 +151,19 @@ class WebEngineSettingsPrivate : public QObject, public WebEngineSettingsData
 {
     Q_OBJECT
 public:
+    /** hand the current filter lists to the request interceptor */
+    void publishAdFilters()
+    {
+        if (m_adFilterEnabled) {
+            // compiled here, the copies share it
+            adBlackList.compile();
+            adWhiteList.compile();
+            adFilterSnapshots.publish(adBlackList, adWhiteList);
+        } else {
+            adFilterSnapshots.publishNone();
+        }
+    }
+
     void adblockFilterLoadList(const QString& filename)
     {
         /** load list file and process each line */
@@ -183,8 +199,10 @@ public Q_SLOTS:
             if ( file.open(QFile::WriteOnly) )
             {
                 const bool success = (file.write(byteArray) == byteArray.size());
-                if ( success )
+                if ( success ) {
                     adblockFilterLoadList(localFileName);
+                    publishAdFilters();
+                }
                 else
                     qWarning() << "Could not write" << byteArray.size() << "to file" << localFileName;
                 file.close();
@@ -323,6 +341,8 @@ void WebEngineSettings::init()
 
   initNSPluginSettings();
   initCookieJarSettings();
+
+  d->publishAdFilters();
 }
 
 void WebEngineSettings::init( KConfig * config, bool reset )
@@ -843,6 +863,14 @@ bool WebEngineSettings::isAdFiltered( const QString &url ) const
     return d->adBlackList.isUrlMatched(url) && !d->adWhiteList.isUrlMatched(url);
 }
 
+bool WebEngineSettings::isAdFilteredThreadSafe( const KDEPrivate::FilterRequest &request ) const
+{
+    if (request.url.startsWith(QLatin1String("data:")))
+        return false;
+
+    return d->adFilterSnapshots.isRequestFiltered(request);
+}
+
 QString WebEngineSettings::adFilteredBy( const QString &url, bool *isWhiteListed ) const
 {
     QString m = d->adWhiteList.urlMatchedBy(url);
@@ -893,6 +921,7 @@ void WebEngineSettings::addAdFilter( const QString &url )
             d->adWhiteList.addFilter(url);
         else
             d->adBlackList.addFilter(url);
+        d->publishAdFilters();
     }
     else
     {
@@ -32,6 +32,9 @@ class KConfigGroup;
 
 struct KPerDomainSettings;
 class WebEngineSettingsPrivate;
+namespace KDEPrivate {
+class FilterRequest;
+}
 
 /**
  * Settings for the HTML view.
@@ -82,6 +85,14 @@ public:
 
     // AdBlocK Filtering
     bool isAdFiltered( const QString &url ) const;
+    /**
+     * Same as isAdFiltered(), but can be called from the network IO thread.
+     * It matches against a read-only copy of the filter lists, which is
+     * replaced whenever they change, and never blocks.
+     * Unlike isAdFiltered(), it also applies filters with options like
+     * $third-party or $script, as the request tells the page and the type.
+     */
+    bool isAdFilteredThreadSafe( const KDEPrivate::FilterRequest &request ) const;
     bool isAdFilterEnabled() const;
     bool isHideAdsEnabled() const;
     void addAdFilter( const QString &url );
@@ -26,6 +26,7 @@
 #include "websslinfo.h"
 #include "webengineview.h"
 #include "settings/webenginesettings.h"
+#include "webengineurlrequestinterceptor.h"
 #include <QWebEngineSettings>
 #include <QWebEngineProfile>
 
@@ -77,6 +78,17 @@ WebEnginePage::WebEnginePage(WebEnginePart *part, QWidget *parent)
     connect(this, &QWebEnginePage::loadFinished,
             this, &WebEnginePage::slotLoadFinished);
     connect(this->profile(), &QWebEngineProfile::downloadRequested, this, &WebEnginePage::downloadRequest);
+    // The blocked requests are counted per visit of a page
+    m_interceptor = WebEngineUrlRequestInterceptor::install(this->profile());
+    m_interceptor->addPage(this);
+    connect(this, &QWebEnginePage::loadStarted, this, [this]() {
+        if (m_interceptor)
+            m_interceptor->resetBlockedRequestCount(this);
+    });
+    connect(this, &QWebEnginePage::urlChanged, this, [this](const QUrl& url) {
+        if (m_interceptor)
+            m_interceptor->setPageUrl(this, url);
+    });
     if(!this->profile()->httpUserAgent().contains(QLatin1String("Konqueror")))
     {
         this->profile()->setHttpUserAgent(this->profile()->httpUserAgent() + " Konqueror (WebEnginePart)");
@@ -86,6 +98,13 @@ WebEnginePage::WebEnginePage(WebEnginePart *part, QWidget *parent)
 WebEnginePage::~WebEnginePage()
 {
     //kDebug() << this;
+    if (m_interceptor)
+        m_interceptor->removePage(this);
+}
+
+int WebEnginePage::blockedRequestCount() const
+{
+    return m_interceptor ? m_interceptor->blockedRequestCount(this) : 0;
 }
 
 const WebSslInfo& WebEnginePage::sslInfo() const
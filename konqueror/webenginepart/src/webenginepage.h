@@ -37,6 +37,7 @@ class QUrl;
 class WebSslInfo;
 class WebEnginePart;
 class QWebEngineDownloadItem;
+class WebEngineUrlRequestInterceptor;
 
 
 class WebEnginePage : public QWebEnginePage
@@ -68,6 +69,12 @@ public:
      */
     void downloadRequest(QWebEngineDownloadItem* request);
 
+    /**
+     * Returns the number of requests the ad filter blocked since the
+     * current page started loading.
+     */
+    int blockedRequestCount() const;
+
 Q_SIGNALS:
     /**
      * This signal is emitted whenever a user cancels/aborts a load resource
@@ -120,6 +127,7 @@ private:
 
     WebSslInfo m_sslInfo;
     QPointer<WebEnginePart> m_part;
+    QPointer<WebEngineUrlRequestInterceptor> m_interceptor;
 };
 
 
@@ -68,6 +68,7 @@
 #include <QVBoxLayout>
 #include <QDBusInterface>
 #include <QMenu>
+#include <QLabel>
 #include <QStatusBar>
 #include "utils.h"
 
@@ -78,6 +79,7 @@ WebEnginePart::WebEnginePart(QWidget *parentWidget, QObject *parent,
              m_hasCachedFormData(false),
              m_doLoadFinishedActions(false),
              m_statusBarWalletLabel(0),
+             m_statusBarBlockedLabel(0),
              m_searchBar(0),
              m_passwordBar(0),
              m_featurePermissionBar(0)
@@ -300,6 +302,12 @@ void WebEnginePart::connectWebEnginePageSignals(WebEnginePage* page)
 
     connect(page, SIGNAL(loadProgress(int)),
             m_browserExtension, SIGNAL(loadingProgress(int)));
+    connect(page, &QWebEnginePage::loadStarted,
+            this, &WebEnginePart::updateBlockedRequestsStatusBarItem);
+    connect(page, &QWebEnginePage::loadProgress,
+            this, &WebEnginePart::updateBlockedRequestsStatusBarItem);
+    connect(page, &QWebEnginePage::loadFinished,
+            this, &WebEnginePart::updateBlockedRequestsStatusBarItem);
     connect(page, SIGNAL(selectionChanged()),
             m_browserExtension, SLOT(updateEditActions()));
 //    connect(m_browserExtension, SIGNAL(saveUrl(QUrl)),
@@ -932,6 +940,27 @@ void WebEnginePart::addWalletStatusBarIcon ()
     m_statusBarExtension->addStatusBarItem(m_statusBarWalletLabel, 0, false);
 }
 
+void WebEnginePart::updateBlockedRequestsStatusBarItem()
+{
+    const int count = page() ? page()->blockedRequestCount() : 0;
+    if (count == 0) {
+        if (m_statusBarBlockedLabel) {
+            m_statusBarExtension->removeStatusBarItem(m_statusBarBlockedLabel);
+            delete m_statusBarBlockedLabel;
+            m_statusBarBlockedLabel = 0;
+        }
+        return;
+    }
+
+    if (!m_statusBarBlockedLabel) {
+        m_statusBarBlockedLabel = new QLabel(m_statusBarExtension->statusBar());
+        m_statusBarBlockedLabel->setSizePolicy(QSizePolicy(QSizePolicy::Fixed, QSizePolicy::Minimum));
+        m_statusBarExtension->addStatusBarItem(m_statusBarBlockedLabel, 0, false);
+    }
+    m_statusBarBlockedLabel->setText(i18np("1 request blocked", "%1 requests blocked", count));
+    m_statusBarBlockedLabel->setToolTip(i18n("Requests blocked by the ad filter while loading this page"));
+}
+
 void WebEnginePart::slotFillFormRequestCompleted (bool ok)
 {
     if ((m_hasCachedFormData = ok))
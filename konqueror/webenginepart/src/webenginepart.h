@@ -41,6 +41,7 @@ class SearchBar;
 class PasswordBar;
 class FeaturePermissionBar;
 class KUrlLabel;
+class QLabel;
 class WebEngineBrowserExtension;
 
 /**
@@ -144,6 +145,8 @@ private Q_SLOTS:
     void slotFeaturePermissionGranted(QWebEnginePage::Feature);
     void slotFeaturePermissionDenied(QWebEnginePage::Feature);
 
+    void updateBlockedRequestsStatusBarItem();
+
 private:
     WebEnginePage* page();
     const WebEnginePage* page() const;
@@ -155,6 +158,7 @@ private:
     bool m_hasCachedFormData;
     bool m_doLoadFinishedActions;
     KUrlLabel* m_statusBarWalletLabel;
+    QLabel* m_statusBarBlockedLabel;
     SearchBar* m_searchBar;
     PasswordBar* m_passwordBar;
     FeaturePermissionBar* m_featurePermissionBar;
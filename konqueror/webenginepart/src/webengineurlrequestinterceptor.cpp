@@ -0,0 +1,131 @@
+/*
+ * This file is part of the KDE project.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation; either version 2.1 of the License, or (at your
+ * option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "webengineurlrequestinterceptor.h"
+
+#include "settings/webenginesettings.h"
+#include "settings/webengine_filter.h"
+
+#include <QWebEngineProfile>
+#include <QWebEngineUrlRequestInfo>
+
+
+using KDEPrivate::FilterRequest;
+
+// what the $script, $image, ... filter options call the resource type
+static FilterRequest::ResourceType filterType(QWebEngineUrlRequestInfo::ResourceType type)
+{
+    switch (type) {
+    case QWebEngineUrlRequestInfo::ResourceTypeScript:
+        return FilterRequest::Script;
+    case QWebEngineUrlRequestInfo::ResourceTypeImage:
+    case QWebEngineUrlRequestInfo::ResourceTypeFavicon:
+        return FilterRequest::Image;
+    case QWebEngineUrlRequestInfo::ResourceTypeStylesheet:
+        return FilterRequest::Stylesheet;
+    case QWebEngineUrlRequestInfo::ResourceTypeObject:
+        return FilterRequest::Object;
+    case QWebEngineUrlRequestInfo::ResourceTypeXhr:
+        return FilterRequest::XmlHttpRequest;
+    case QWebEngineUrlRequestInfo::ResourceTypeSubFrame:
+        return FilterRequest::Subdocument;
+    case QWebEngineUrlRequestInfo::ResourceTypeMedia:
+        return FilterRequest::Media;
+    case QWebEngineUrlRequestInfo::ResourceTypeFontResource:
+        return FilterRequest::Font;
+    case QWebEngineUrlRequestInfo::ResourceTypePing:
+        return FilterRequest::Ping;
+    default:
+        return FilterRequest::Other;
+    }
+}
+
+WebEngineUrlRequestInterceptor::WebEngineUrlRequestInterceptor(QObject* parent)
+    : QWebEngineUrlRequestInterceptor(parent)
+{
+}
+
+WebEngineUrlRequestInterceptor* WebEngineUrlRequestInterceptor::install(QWebEngineProfile* profile)
+{
+    WebEngineUrlRequestInterceptor* interceptor = forProfile(profile);
+    if (!interceptor) {
+        interceptor = new WebEngineUrlRequestInterceptor(profile);
+        profile->setRequestInterceptor(interceptor);
+    }
+    return interceptor;
+}
+
+WebEngineUrlRequestInterceptor* WebEngineUrlRequestInterceptor::forProfile(QWebEngineProfile* profile)
+{
+    return profile ? profile->findChild<WebEngineUrlRequestInterceptor*>(QString(), Qt::FindDirectChildrenOnly) : 0;
+}
+
+void WebEngineUrlRequestInterceptor::interceptRequest(QWebEngineUrlRequestInfo &info)
+{
+    // Never block the page itself, only what it loads.
+    if (info.resourceType() == QWebEngineUrlRequestInfo::ResourceTypeMainFrame)
+        return;
+
+    const FilterRequest request(info.requestUrl(), info.firstPartyUrl(), filterType(info.resourceType()));
+    if (!WebEngineSettings::self()->isAdFilteredThreadSafe(request))
+        return;
+
+    info.block(true);
+
+    // The pages belong to the GUI thread, never wait for it here
+    QMetaObject::invokeMethod(this, "countBlockedRequest", Qt::QueuedConnection,
+                              Q_ARG(QUrl, info.firstPartyUrl().adjusted(QUrl::RemoveFragment)));
+}
+
+void WebEngineUrlRequestInterceptor::countBlockedRequest(const QUrl &firstPartyUrl)
+{
+    // There are only as many pages as tabs, so just look at all of them
+    for (QHash<const QWebEnginePage*, PageRequests>::iterator it = m_pages.begin(); it != m_pages.end(); ++it) {
+        if (it->url == firstPartyUrl)
+            ++it->blocked;
+    }
+}
+
+void WebEngineUrlRequestInterceptor::addPage(const QWebEnginePage* page)
+{
+    m_pages.insert(page, PageRequests());
+}
+
+void WebEngineUrlRequestInterceptor::removePage(const QWebEnginePage* page)
+{
+    m_pages.remove(page);
+}
+
+void WebEngineUrlRequestInterceptor::setPageUrl(const QWebEnginePage* page, const QUrl &url)
+{
+    QHash<const QWebEnginePage*, PageRequests>::iterator it = m_pages.find(page);
+    if (it != m_pages.end())
+        it->url = url.adjusted(QUrl::RemoveFragment);
+}
+
+int WebEngineUrlRequestInterceptor::blockedRequestCount(const QWebEnginePage* page) const
+{
+    return m_pages.value(page).blocked;
+}
+
+void WebEngineUrlRequestInterceptor::resetBlockedRequestCount(const QWebEnginePage* page)
+{
+    QHash<const QWebEnginePage*, PageRequests>::iterator it = m_pages.find(page);
+    if (it != m_pages.end())
+        it->blocked = 0;
+}
@@ -0,0 +1,90 @@
+/*
+ * This file is part of the KDE project.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation; either version 2.1 of the License, or (at your
+ * option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef WEBENGINEURLREQUESTINTERCEPTOR_H
+#define WEBENGINEURLREQUESTINTERCEPTOR_H
+
+#include <QWebEngineUrlRequestInterceptor>
+
+#include <QHash>
+#include <QUrl>
+
+class QWebEnginePage;
+class QWebEngineProfile;
+
+/**
+ * Blocks requests matched by the ad filter lists of WebEngineSettings
+ * before they reach the network.
+ *
+ * interceptRequest() is called in the network IO thread, so it only uses
+ * WebEngineSettings::isAdFilteredThreadSafe(). The blocked requests are
+ * counted in the GUI thread, everything else is only called there.
+ */
+class WebEngineUrlRequestInterceptor : public QWebEngineUrlRequestInterceptor
+{
+    Q_OBJECT
+public:
+    /**
+     * Installs the interceptor on @p profile, unless it already has one.
+     */
+    static WebEngineUrlRequestInterceptor* install(QWebEngineProfile* profile);
+
+    /**
+     * Returns the interceptor installed on @p profile, if any.
+     */
+    static WebEngineUrlRequestInterceptor* forProfile(QWebEngineProfile* profile);
+
+    void interceptRequest(QWebEngineUrlRequestInfo &info) Q_DECL_OVERRIDE;
+
+    /**
+     * Counts the requests blocked for @p page from now on, until
+     * removePage() is called.
+     *
+     * The requests don't tell which page made them, only the URL of the
+     * page, so the requests are counted for all pages showing that URL.
+     */
+    void addPage(const QWebEnginePage* page);
+    void removePage(const QWebEnginePage* page);
+
+    /**
+     * Sets the URL @p page shows, without resetting its count.
+     */
+    void setPageUrl(const QWebEnginePage* page, const QUrl &url);
+
+    /**
+     * Returns the number of requests blocked for @p page since the
+     * count was last reset.
+     */
+    int blockedRequestCount(const QWebEnginePage* page) const;
+    void resetBlockedRequestCount(const QWebEnginePage* page);
+
+private Q_SLOTS:
+    void countBlockedRequest(const QUrl &firstPartyUrl);
+
+private:
+    explicit WebEngineUrlRequestInterceptor(QObject* parent);
+
+    struct PageRequests {
+        PageRequests() : blocked(0) {}
+        QUrl url;
+        int blocked;
+    };
+
+    QHash<const QWebEnginePage*, PageRequests> m_pages;
+};
+
+#endif // WEBENGINEURLREQUESTINTERCEPTOR_H